@@ -19,12 +19,12 @@
  */
 
 #include <arm/arm_interface.h>
+#include <arm/arm_jit_slot_pool.h>
 #include <arm/arm_unicorn.h>
 
 #include <dynarmic/A32/a32.h>
 #include <dynarmic/A32/config.h>
 
-#include <map>
 #include <memory>
 
 namespace eka2l1 {
@@ -47,9 +47,14 @@ namespace eka2l1 {
         class arm_dynarmic : public arm_interface {
             friend class arm_dynarmic_callback;
 
+            // Each slot costs a page table (8MB) and a code cache, keep the pool small
+            using jit_slot_pool = basic_jit_slot_pool<Dynarmic::A32::Jit, Dynarmic::A32::Context,
+                Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES, 4>;
+
             arm_unicorn fallback_jit;
+            jit_slot_pool slots;
 
-            std::unique_ptr<Dynarmic::A32::Jit> jit;
+            Dynarmic::A32::Jit *jit;
             std::unique_ptr<arm_dynarmic_callback> cb;
 
             disasm *asmdis;
@@ -63,9 +68,6 @@ namespace eka2l1 {
             gdbstub *stub;
             debugger_ptr debugger;
 
-            std::array<std::uint8_t *, Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES>
-                page_dyn;
-
         public:
             timing_system *get_timing_sys() {
                 return timing;
@@ -94,6 +96,9 @@ namespace eka2l1 {
             void step() override;
 
             uint32_t get_reg(size_t idx) override;
+            std::uint32_t *get_regs_view() override;
+            void get_regs(gpr_array &regs) override;
+            void set_regs(const std::uint32_t *regs, const std::size_t first, const std::size_t count) override;
             uint32_t get_sp() override;
             uint32_t get_pc() override;
             uint32_t get_vfp(size_t idx) override;
@@ -125,6 +130,8 @@ namespace eka2l1 {
 
             void page_table_changed() override;
 
+            memory_map_state switch_address_space(const std::uint32_t asid) override;
+
             void map_backing_mem(address vaddr, size_t size, uint8_t *ptr, prot protection) override;
 
             void unmap_memory(address addr, size_t size) override;
@@ -29,6 +29,13 @@ namespace eka2l1 {
     using debugger_ptr = std::shared_ptr<debugger_base>;
 
     namespace arm {
+        /*! \brief State of the CPU memory map after switching address space. */
+        enum class memory_map_state {
+            up_to_date, ///< The CPU still holds the memory map of the new address space.
+            previous, ///< The CPU holds the memory map of the previous address space.
+            empty ///< The CPU holds no local memory map.
+        };
+
         /*! \brief An interface to all JIT implementation */
         class arm_interface {
         public:
@@ -45,6 +52,9 @@ namespace eka2l1 {
                 uint32_t fpscr;
             };
 
+            //! R0 to R15
+            using gpr_array = std::array<std::uint32_t, 16>;
+
             virtual ~arm_interface() {}
 
             /*! Run the CPU */
@@ -59,6 +69,32 @@ namespace eka2l1 {
             /*! Get a specific ARM Rx register. Range from r0 to r15 */
             virtual uint32_t get_reg(size_t idx) = 0;
 
+            /*! \brief Get a direct view of R0 to R15.
+             *
+             * Only available if the CPU keeps the registers in host memory. Writes through
+             * the view change the CPU registers. The view is only valid until the next address
+             * space switch or run, since the CPU may swap to another JIT then. Don't keep it.
+             *
+             * \returns Pointer to R0, followed by the other 15 registers. Null if not supported.
+            */
+            virtual std::uint32_t *get_regs_view() {
+                return nullptr;
+            }
+
+            /*! \brief Read R0 to R15 with one call. */
+            virtual void get_regs(gpr_array &regs) {
+                for (std::size_t i = 0; i < regs.size(); i++) {
+                    regs[i] = get_reg(i);
+                }
+            }
+
+            /*! \brief Write consecutive registers, starting from R[first], with one call. */
+            virtual void set_regs(const std::uint32_t *regs, const std::size_t first, const std::size_t count) {
+                for (std::size_t i = 0; i < count; i++) {
+                    set_reg(first + i, regs[i]);
+                }
+            }
+
             /*! Get the stack pointer */
             virtual uint32_t get_sp() = 0;
 
@@ -105,6 +141,18 @@ namespace eka2l1 {
 
             virtual void page_table_changed() = 0;
 
+            /*! \brief Switch the CPU to the memory map of another address space.
+             *
+             * A CPU that can cache memory maps of multiple address spaces can switch without
+             * remapping anything.
+             *
+             * \param asid Unique ID of the new address space.
+             * \returns The state of the local memory map the CPU now holds.
+            */
+            virtual memory_map_state switch_address_space(const std::uint32_t asid) {
+                return memory_map_state::previous;
+            }
+
             virtual void map_backing_mem(address vaddr, size_t size, uint8_t *ptr, prot protection) = 0;
 
             virtual void unmap_memory(address addr, size_t size) = 0;
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <arm/arm_interface.h>
+#include <common/types.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace eka2l1::arm {
+    /*! \brief JIT instances with their own page table, each caching the memory map of an address space.
+     *
+     * Switching back to an address space that still owns a slot keeps its page table as it is.
+     * Otherwise the least recently used slot is given to it, with its local memory cleared.
+     *
+     * The JIT type needs IsExecuting(), and SaveContext()/LoadContext() taking a C.
+     */
+    template <typename J, typename C, std::size_t PageCount, std::size_t PoolSize>
+    class basic_jit_slot_pool {
+    public:
+        using page_array = std::array<std::uint8_t *, PageCount>;
+
+    private:
+        struct jit_slot {
+            std::unique_ptr<J> jit;
+            std::unique_ptr<page_array> page_dyn;
+
+            std::uint32_t asid = 0;
+            std::uint64_t last_use = 0;
+
+            // Local memory mapped in the page table, by address with its size. Only
+            // these ranges are cleared when the slot is given to another address space.
+            std::map<address, std::size_t> local_ranges;
+        };
+
+        std::array<jit_slot, PoolSize> slots;
+        jit_slot *crr_slot = &slots[0];
+
+        std::uint64_t slot_use_counter = 0;
+        std::size_t page_size = 0;
+
+        void clear_local_memory(jit_slot &slot) {
+            for (const auto &[addr, size] : slot.local_ranges) {
+                std::fill(slot.page_dyn->begin() + addr / page_size, slot.page_dyn->begin() + (addr + size) / page_size, nullptr);
+            }
+
+            slot.local_ranges.clear();
+        }
+
+    public:
+        /*! \brief Create every slot, so that they all receive global memory mappings.
+         *
+         * \param make_jit Creates a JIT using the page table passed to it.
+         */
+        template <typename F>
+        void init(const std::size_t page_size_, F make_jit) {
+            page_size = page_size_;
+
+            for (jit_slot &slot : slots) {
+                slot.page_dyn = std::make_unique<page_array>();
+                slot.page_dyn->fill(nullptr);
+                slot.jit = make_jit(slot.page_dyn.get());
+            }
+
+            crr_slot = &slots[0];
+        }
+
+        J *current() {
+            return crr_slot->jit.get();
+        }
+
+        std::uint32_t current_asid() const {
+            return crr_slot->asid;
+        }
+
+        const page_array &current_page_table() const {
+            return *crr_slot->page_dyn;
+        }
+
+        /*! \brief Make the slot of an address space the current one.
+         *
+         * Only the register context is carried over to the new JIT. While the current JIT is
+         * running guest code it can't be swapped, its page table is given to the new address space instead.
+         */
+        memory_map_state switch_address_space(const std::uint32_t asid) {
+            if (crr_slot->asid == asid) {
+                crr_slot->last_use = ++slot_use_counter;
+                return memory_map_state::up_to_date;
+            }
+
+            jit_slot *target = nullptr;
+
+            for (jit_slot &slot : slots) {
+                if (slot.asid == asid) {
+                    target = &slot;
+                    break;
+                }
+            }
+
+            if (crr_slot->jit->IsExecuting()) {
+                if (target) {
+                    target->asid = 0;
+                }
+
+                crr_slot->asid = asid;
+                crr_slot->last_use = ++slot_use_counter;
+
+                return memory_map_state::previous;
+            }
+
+            memory_map_state state = memory_map_state::up_to_date;
+
+            if (!target) {
+                // Evict the least recently used slot
+                for (jit_slot &slot : slots) {
+                    if ((&slot != crr_slot) && (!target || slot.last_use < target->last_use)) {
+                        target = &slot;
+                    }
+                }
+
+                if (!target->local_ranges.empty()) {
+                    clear_local_memory(*target);
+                }
+
+                target->asid = asid;
+                state = memory_map_state::empty;
+            }
+
+            C context;
+            crr_slot->jit->SaveContext(context);
+            target->jit->LoadContext(context);
+
+            crr_slot = target;
+            crr_slot->last_use = ++slot_use_counter;
+
+            return state;
+        }
+
+        /*! \brief Map memory in the current slot, or in all of them if it's global. */
+        void map(const address vaddr, const std::size_t size, std::uint8_t *ptr, const bool is_global) {
+            for (jit_slot &slot : slots) {
+                if (!is_global && (&slot != crr_slot)) {
+                    continue;
+                }
+
+                for (std::size_t i = 0; i < size / page_size; i++) {
+                    (*slot.page_dyn)[vaddr / page_size + i] = ptr + i * page_size;
+                }
+            }
+
+            if (!is_global) {
+                auto &range_size = crr_slot->local_ranges[vaddr];
+                range_size = std::max(range_size, size);
+            }
+        }
+
+        /*! \brief Unmap memory from the current slot, or from all of them if it's global. */
+        void unmap(const address addr, const std::size_t size, const bool is_global) {
+            for (jit_slot &slot : slots) {
+                if (!is_global && (&slot != crr_slot)) {
+                    continue;
+                }
+
+                for (std::size_t i = addr / page_size; i < (addr + size) / page_size; i++) {
+                    (*slot.page_dyn)[i] = nullptr;
+                }
+            }
+
+            if (!is_global) {
+                // Ranges starting in the unmapped one are gone, the rest are cleared again on eviction at worst
+                auto &ranges = crr_slot->local_ranges;
+                ranges.erase(ranges.lower_bound(addr), ranges.lower_bound(static_cast<address>(addr + size)));
+            }
+        }
+
+        template <typename F>
+        void for_each_jit(F func) {
+            for (jit_slot &slot : slots) {
+                func(*slot.jit);
+            }
+        }
+    };
+}
@@ -101,6 +101,8 @@ namespace eka2l1 {
             void step() override;
 
             uint32_t get_reg(size_t idx) override;
+            void get_regs(gpr_array &regs) override;
+            void set_regs(const std::uint32_t *regs, const std::size_t first, const std::size_t count) override;
             uint32_t get_sp() override;
             uint32_t get_pc() override;
             uint32_t get_vfp(size_t idx) override;
@@ -35,6 +35,8 @@
 #include <dynarmic/A32/context.h>
 #include <dynarmic/A32/coprocessor.h>
 
+#include <algorithm>
+
 namespace eka2l1 {
     namespace arm {
         class arm_dynarmic_cp15 : public Dynarmic::A32::Coprocessor {
@@ -172,7 +174,7 @@ namespace eka2l1 {
                     }
                 }
 
-                return MemoryRead32(addr);
+                return parent.get_lib_manager()->patch_code_fetch(addr, MemoryRead32(addr));
             }
 
             uint8_t MemoryRead8(Dynarmic::A32::VAddr addr) override {
@@ -384,7 +386,11 @@ namespace eka2l1 {
             , fallback_jit(kern, sys, mngr, mem, asmdis, lmngr, stub)
             , cb(std::make_unique<arm_dynarmic_callback>(*this))
             , debugger(debugger) {
-            jit = make_jit(cb, &page_dyn);
+            slots.init(mem->get_page_size(), [this](jit_slot_pool::page_array *table) {
+                return make_jit(cb, table);
+            });
+
+            jit = slots.current();
         }
 
         arm_dynarmic::~arm_dynarmic() {}
@@ -405,6 +411,18 @@ namespace eka2l1 {
             return jit->Regs()[idx];
         }
 
+        std::uint32_t *arm_dynarmic::get_regs_view() {
+            return jit->Regs().data();
+        }
+
+        void arm_dynarmic::get_regs(gpr_array &regs) {
+            std::copy(jit->Regs().begin(), jit->Regs().end(), regs.begin());
+        }
+
+        void arm_dynarmic::set_regs(const std::uint32_t *regs, const std::size_t first, const std::size_t count) {
+            std::copy(regs, regs + count, jit->Regs().begin() + first);
+        }
+
         uint32_t arm_dynarmic::get_sp() {
             return jit->Regs()[13];
         }
@@ -449,15 +467,14 @@ namespace eka2l1 {
         }
 
         void arm_dynarmic::save_context(thread_context &ctx) {
-            ctx.cpsr = get_cpsr();
+            const auto &regs = jit->Regs();
 
-            for (uint8_t i = 0; i < 16; i++) {
-                ctx.cpu_registers[i] = get_reg(i);
-            }
+            ctx.cpsr = get_cpsr();
+            std::copy(regs.begin(), regs.end(), ctx.cpu_registers.begin());
 
-            ctx.pc = get_pc();
-            ctx.sp = get_sp();
-            ctx.lr = get_lr();
+            ctx.pc = regs[15];
+            ctx.sp = regs[13];
+            ctx.lr = regs[14];
 
             if (!ctx.pc) {
                 LOG_WARN("Dynarmic save context with PC = 0");
@@ -465,13 +482,12 @@ namespace eka2l1 {
         }
 
         void arm_dynarmic::load_context(const thread_context &ctx) {
-            for (uint8_t i = 0; i < 16; i++) {
-                jit->Regs()[i] = ctx.cpu_registers[i];
-            }
+            auto &regs = jit->Regs();
+            std::copy(ctx.cpu_registers.begin(), ctx.cpu_registers.begin() + regs.size(), regs.begin());
 
-            set_sp(ctx.sp);
-            set_pc(ctx.pc);
-            set_lr(ctx.lr);
+            regs[13] = ctx.sp;
+            regs[15] = ctx.pc;
+            regs[14] = ctx.lr;
             set_cpsr(ctx.cpsr);
         }
 
@@ -501,34 +517,39 @@ namespace eka2l1 {
         }
 
         void arm_dynarmic::imb_range(address start, uint32_t len) {
-            jit->InvalidateCacheRange(start, len);
+            imb_range(start, static_cast<std::size_t>(len));
         }
 
         void arm_dynarmic::page_table_changed() {
         }
 
-        void arm_dynarmic::map_backing_mem(address vaddr, size_t size, uint8_t *ptr, prot protection) {
-            for (std::size_t i = 0; i < size / mem->get_page_size(); i++) {
-                page_dyn[vaddr / mem->get_page_size() + i] = ptr + i * mem->get_page_size();
-            }
+        memory_map_state arm_dynarmic::switch_address_space(const std::uint32_t asid) {
+            const memory_map_state state = slots.switch_address_space(asid);
+            jit = slots.current();
 
+            return state;
+        }
+
+        void arm_dynarmic::map_backing_mem(address vaddr, size_t size, uint8_t *ptr, prot protection) {
+            slots.map(vaddr, size, ptr, mem->is_global_addr(vaddr));
             // fallback_jit.map_backing_mem(vaddr, size, ptr, protection);
         }
 
         void arm_dynarmic::unmap_memory(address addr, size_t size) {
-            for (std::size_t i = addr / mem->get_page_size(); i < (addr + size) / mem->get_page_size(); i++) {
-                page_dyn[i] = nullptr;
-            }
-
+            slots.unmap(addr, size, mem->is_global_addr(addr));
             // fallback_jit.unmap_memory(addr, size);
         }
 
         void arm_dynarmic::clear_instruction_cache() {
-            jit->ClearCache();
+            slots.for_each_jit([](Dynarmic::A32::Jit &slot_jit) {
+                slot_jit.ClearCache();
+            });
         }
 
         void arm_dynarmic::imb_range(address addr, std::size_t size) {
-            jit->InvalidateCacheRange(addr, size);
+            slots.for_each_jit([=](Dynarmic::A32::Jit &slot_jit) {
+                slot_jit.InvalidateCacheRange(addr, size);
+            });
         }
     }
 }
\ No newline at end of file
@@ -42,6 +42,8 @@
 
 #include <unicorn/unicorn.h>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 
 bool noppify_func = false;
@@ -84,6 +86,18 @@ void write_hook(uc_engine *uc, uc_mem_type type, uint32_t address, int size, int
     LOG_TRACE("Write at address = 0x{:x}, size = 0x{:x}, val = 0x{:x}", address, size, value);
 }
 
+bool unmapped_hook(uc_engine *uc, uc_mem_type type, uint32_t address, int size, int64_t value, void *user_data) {
+    eka2l1::arm::arm_unicorn *jit = reinterpret_cast<decltype(jit)>(user_data);
+
+    if (jit == nullptr) {
+        LOG_ERROR("Unmapped hook failed: User Data was null");
+        return false;
+    }
+
+    // Demand paged memory is committed and mapped by its fault handler, then the access is retried
+    return jit->get_memory_sys()->handle_page_fault(address, static_cast<uint32_t>(size));
+}
+
 void code_hook(uc_engine *uc, uint32_t address, uint32_t size, void *user_data) {
     eka2l1::arm::arm_unicorn *jit = reinterpret_cast<decltype(jit)>(user_data);
     eka2l1::arm::arm_interface::thread_context context_debug;
@@ -214,23 +228,28 @@ namespace eka2l1 {
             assert(err == UC_ERR_OK);
 
             uc_hook hook{};
-            manager::config_manager *cfg_mngr = mngr->get_config_manager();
 
-            if (cfg_mngr->get_or_fall<bool>("log_read", false)) {
-                uc_hook_add(engine, &hook, UC_HOOK_MEM_READ, reinterpret_cast<void *>(read_hook), this, 1, 0);                
-            }
+            // Without a manager the config defaults are used, so the CPU can run on its own
+            if (mngr) {
+                manager::config_manager *cfg_mngr = mngr->get_config_manager();
 
-            if (cfg_mngr->get_or_fall<bool>("log_write", false)) {
-                uc_hook_add(engine, &hook, UC_HOOK_MEM_WRITE, reinterpret_cast<void *>(write_hook), this, 1, 0);                
-            }
+                if (cfg_mngr->get_or_fall<bool>("log_read", false)) {
+                    uc_hook_add(engine, &hook, UC_HOOK_MEM_READ, reinterpret_cast<void *>(read_hook), this, 1, 0);                
+                }
 
-            log_pass = cfg_mngr->get_or_fall<bool>("log_passed", false);
-            log_code = cfg_mngr->get_or_fall<bool>("log_code", false);
-            
-            enable_breakpoint_script = cfg_mngr->get_or_fall<bool>("enable_breakpoint_script", false);
+                if (cfg_mngr->get_or_fall<bool>("log_write", false)) {
+                    uc_hook_add(engine, &hook, UC_HOOK_MEM_WRITE, reinterpret_cast<void *>(write_hook), this, 1, 0);                
+                }
+
+                log_pass = cfg_mngr->get_or_fall<bool>("log_passed", false);
+                log_code = cfg_mngr->get_or_fall<bool>("log_code", false);
+
+                enable_breakpoint_script = cfg_mngr->get_or_fall<bool>("enable_breakpoint_script", false);
+            }
 
             uc_hook_add(engine, &hook, UC_HOOK_CODE, reinterpret_cast<void *>(code_hook), this, 1, 0);
             uc_hook_add(engine, &hook, UC_HOOK_INTR, reinterpret_cast<void *>(intr_hook), this, 1, 0);
+            uc_hook_add(engine, &hook, UC_HOOK_MEM_UNMAPPED, reinterpret_cast<void *>(unmapped_hook), this, 1, 0);
             
             assert(err == UC_ERR_OK);
             enable_vfp_fp(engine);
@@ -345,10 +364,17 @@ namespace eka2l1 {
             execute_instructions(1);
         }
 
+        // R13 to R15 are not numbered after R12 in Unicorn
+        static const std::array<int, 16> gpr_ids = {
+            UC_ARM_REG_R0, UC_ARM_REG_R1, UC_ARM_REG_R2, UC_ARM_REG_R3,
+            UC_ARM_REG_R4, UC_ARM_REG_R5, UC_ARM_REG_R6, UC_ARM_REG_R7,
+            UC_ARM_REG_R8, UC_ARM_REG_R9, UC_ARM_REG_R10, UC_ARM_REG_R11,
+            UC_ARM_REG_R12, UC_ARM_REG_SP, UC_ARM_REG_LR, UC_ARM_REG_PC
+        };
+
         uint32_t arm_unicorn::get_reg(size_t idx) {
             uint32_t val = 0;
-            auto treg = UC_ARM_REG_R0 + static_cast<uint8_t>(idx);
-            auto err = uc_reg_read(engine, treg, &val);
+            auto err = uc_reg_read(engine, gpr_ids[idx], &val);
 
             if (err != UC_ERR_OK) {
                 LOG_ERROR("Failed to get ARM CPU registers.");
@@ -357,6 +383,30 @@ namespace eka2l1 {
             return val;
         }
 
+        void arm_unicorn::get_regs(gpr_array &regs) {
+            std::array<void *, 16> vals;
+
+            for (std::size_t i = 0; i < vals.size(); i++) {
+                vals[i] = &regs[i];
+            }
+
+            if (uc_reg_read_batch(engine, const_cast<int *>(gpr_ids.data()), vals.data(), static_cast<int>(vals.size())) != UC_ERR_OK) {
+                LOG_ERROR("Failed to get ARM CPU registers.");
+            }
+        }
+
+        void arm_unicorn::set_regs(const std::uint32_t *regs, const std::size_t first, const std::size_t count) {
+            std::array<void *, 16> vals;
+
+            for (std::size_t i = 0; i < count; i++) {
+                vals[i] = const_cast<std::uint32_t *>(regs + i);
+            }
+
+            if (uc_reg_write_batch(engine, const_cast<int *>(gpr_ids.data() + first), vals.data(), static_cast<int>(count)) != UC_ERR_OK) {
+                LOG_ERROR("Failed to set ARM CPU registers.");
+            }
+        }
+
         uint32_t arm_unicorn::get_sp() {
             uint32_t ret = 0;
             auto err = uc_reg_read(engine, UC_ARM_REG_SP, &ret);
@@ -384,8 +434,7 @@ namespace eka2l1 {
         }
 
         void arm_unicorn::set_reg(size_t idx, uint32_t val) {
-            auto treg = UC_ARM_REG_R0 + static_cast<uint8_t>(idx);
-            auto err = uc_reg_write(engine, treg, &val);
+            auto err = uc_reg_write(engine, gpr_ids[idx], &val);
 
             if (err != UC_ERR_OK) {
                 LOG_ERROR("Failed to set ARM CPU registers.");
@@ -467,9 +516,12 @@ namespace eka2l1 {
         }
 
         void arm_unicorn::save_context(thread_context &ctx) {
-            for (auto i = 0; i < ctx.cpu_registers.size(); i++) {
-                ctx.cpu_registers[i] = get_reg(i);
-            }
+            gpr_array regs;
+            get_regs(regs);
+
+            // Only R0 to R15 exist
+            std::copy(regs.begin(), regs.end(), ctx.cpu_registers.begin());
+            std::fill(ctx.cpu_registers.begin() + regs.size(), ctx.cpu_registers.end(), 0);
 
             for (auto i = 0; i < ctx.fpu_registers.size(); i++) {
                 uc_err err = uc_reg_read(engine, UC_ARM_REG_D0, &(ctx.fpu_registers[i]));
@@ -484,9 +536,7 @@ namespace eka2l1 {
         }
 
         void arm_unicorn::load_context(const thread_context &ctx) {
-            for (auto i = 0; i < ctx.cpu_registers.size(); i++) {
-                set_reg(i, ctx.cpu_registers[i]);
-            }
+            set_regs(ctx.cpu_registers.data(), 0, gpr_ids.size());
 
             for (auto i = 0; i < ctx.fpu_registers.size(); i++) {
                 uc_err err = uc_reg_write(engine, UC_ARM_REG_D0, &(ctx.fpu_registers[i]));
@@ -29,6 +29,10 @@
 #include <string>
 #include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace eka2l1 {
     /*! \brief Contains functions that use frequently in the emulator */
     namespace common {
@@ -130,6 +134,43 @@ namespace eka2l1 {
             return !(target & mask);
         }
 
+        /*! \brief Get the index of the highest set bit. The value must not be zero. */
+        inline int find_most_significant_bit(const std::uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index = 0;
+            _BitScanReverse64(&index, value);
+
+            return static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+            return 63 - __builtin_clzll(value);
+#else
+            int index = 0;
+
+            for (std::uint64_t temp = value; temp >>= 1;) {
+                index++;
+            }
+
+            return index;
+#endif
+        }
+
+        /*! \brief Count the number of set bits. */
+        inline int count_set_bits(const std::uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+            return static_cast<int>(__popcnt64(value));
+#elif defined(__GNUC__) || defined(__clang__)
+            return __builtin_popcountll(value);
+#else
+            int count = 0;
+
+            for (std::uint64_t temp = value; temp; temp &= temp - 1) {
+                count++;
+            }
+
+            return count;
+#endif
+        }
+
         /*! Do alignment */
         template <typename T>
         T align(T target, uint32_t alignment, int mode = 1) {
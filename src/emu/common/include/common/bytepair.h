@@ -19,12 +19,8 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <cstdio>
-#include <fstream>
-#include <iostream>
-#include <memory>
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -36,16 +32,29 @@ namespace eka2l1 {
          *  \param dest_size The size of the destination buffer
          *  \param buffer The compressed data
          *  \param buf_size The compressed data size		 
+         *
+         *  \returns Number of bytes decompressed, 0 if the data is corrupted.
 		*/
-        int nokia_bytepair_decompress(void *dest, unsigned int dest_size, void *buffer, unsigned int buf_size);
+        int nokia_bytepair_decompress(void *dest, unsigned int dest_size, const void *buffer, unsigned int buf_size);
 
         enum {
             BYTEPAIR_PAGE_SIZE = 4096
         };
 
-        /*! \brief A read-only bytepair stream. */
+        /*! \brief A read-only bytepair stream, over compressed data in memory.
+         *
+         * The data is made of an index table, followed by the pages. Pages are independent
+         * of each other, so they are decompressed in parallel.
+         */
         class ibytepair_stream {
-            std::shared_ptr<std::istream> compress_stream;
+            // Only used when the stream owns its data
+            std::vector<std::uint8_t> owned_data;
+
+            const std::uint8_t *data;
+            std::size_t data_size;
+
+            // Current read position in the data
+            std::size_t pos = 0;
 
         public:
             struct index_table_header {
@@ -62,8 +71,17 @@ namespace eka2l1 {
         private:
             index_table idx_tab;
 
+            // Offset of each page in the data, plus the end of the last page
+            std::vector<std::size_t> page_starts;
+
         public:
-            ibytepair_stream(std::shared_ptr<std::istream> stream);
+            /*! \brief Read from memory owned by the caller, which must outlive the stream. */
+            ibytepair_stream(const std::uint8_t *data, const std::size_t size);
+
+            /*! \brief Read data given to the stream. */
+            explicit ibytepair_stream(std::vector<std::uint8_t> &&buf);
+
+            /*! \brief Read a file from an offset, loaded in memory at once. */
             ibytepair_stream(std::string path, uint32_t start);
 
             /*! \brief Get the index table */
@@ -76,8 +94,13 @@ namespace eka2l1 {
 			 *
 			 * Bytepair compressed data always has a header (index table), that tells us the uncompressed size
 			 * and each bytepair page's size.
+             *
+             * \returns False if the table or its pages go past the end of the data.
 			*/
-            void read_table();
+            bool read_table();
+
+            /*! \brief Move past the pages of the last index table read, without decompressing them. */
+            void skip_pages();
 
             /*! \brief Read a page.
 			 *
@@ -103,7 +103,7 @@ namespace eka2l1::common {
             std::uint32_t s = static_cast<std::uint32_t>(c.size());
             absorb(s);
 
-            if (mode == SERI_MODE_WRITE) {
+            if (mode == SERI_MODE_READ) {
                 c.resize(s);
             }
 
@@ -117,7 +117,7 @@ namespace eka2l1::common {
             std::uint32_t s = static_cast<std::uint32_t>(c.size());
             absorb(s);
 
-            if (mode == SERI_MODE_WRITE) {
+            if (mode == SERI_MODE_READ) {
                 c.resize(s);
             }
 
@@ -131,7 +131,7 @@ namespace eka2l1::common {
             std::uint32_t s = static_cast<std::uint32_t>(c.size());
             absorb(s);
 
-            if (mode == SERI_MODE_WRITE) {
+            if (mode == SERI_MODE_READ) {
                 c.resize(s);
             }
 
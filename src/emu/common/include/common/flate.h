@@ -87,8 +87,9 @@ namespace eka2l1 {
 
         /*! \brief Represents a deflate bit input. */
         class bit_input {
+            // Next bits of the stream, from the most significant bit
+            uint64_t bits;
             int count;
-            uint32_t bits;
             int remain;
             const uint32_t *buf_ptr;
 
@@ -105,12 +106,37 @@ namespace eka2l1 {
 
             uint32_t read(int size);
             uint32_t huffman(const uint32_t *tree);
+
+            /*! \brief Fill the bit buffer, so that at least 32 bits can be peeked if the stream has them. */
+            void refill();
+
+            /*! \brief Get the next bits without consuming them.
+             *
+             * Bits past the end of the stream are garbage. Check the number of available bits
+             * before consuming them.
+             *
+             * \param size Number of bits, 1 to 32.
+            */
+            uint32_t peek(const int size) const {
+                return static_cast<uint32_t>(bits >> (64 - size));
+            }
+
+            void consume(const int size) {
+                bits <<= size;
+                count -= size;
+            }
+
+            /*! \brief Get number of bits buffered, that can be consumed without a refill. */
+            int available() const {
+                return count;
+            }
         };
 
         enum {
             HUFFMAN_MAX_CODELENGTH = 27,
             HUFFMAN_METACODE = HUFFMAN_MAX_CODELENGTH + 1,
-            HUFFMAN_MAX_CODES = 0x8000
+            HUFFMAN_MAX_CODES = 0x8000,
+            HUFFMAN_LOOKUP_BITS = 10
         };
 
         /*! \brief Contains Huffman decoding/encoding functions. */
@@ -120,6 +146,38 @@ namespace eka2l1 {
             void decoding(const int *huffman, uint32_t num_codes, uint32_t *decode_tree, int sym_base = 0);
             bool valid(const uint32_t *huffman, int num_codes);
 
+            /*! \brief Table to decode a canonical Huffman code from the next bits at once.
+             *
+             * Indexed by the next HUFFMAN_LOOKUP_BITS bits of the stream. Each entry has the symbol
+             * and the length of its code. If the code of a literal is short enough, the entry also
+             * holds the literal coming after it.
+             *
+             * Codes longer than the index are decoded from the first code of each length.
+            */
+            struct lookup_table {
+                uint32_t entries[1 << HUFFMAN_LOOKUP_BITS];
+
+                uint32_t first_code[HUFFMAN_MAX_CODELENGTH + 1];
+                uint16_t first_symbol[HUFFMAN_MAX_CODELENGTH + 1];
+                uint16_t code_count[HUFFMAN_MAX_CODELENGTH + 1];
+
+                // Symbols, sorted by code length
+                uint16_t symbols[ENCODING_LITERAL_LEN];
+            };
+
+            /*! \brief Build a lookup table from the code lengths.
+             *
+             * \param pair_literals Store two literals in an entry when they both fit.
+             * \returns False if there are too many codes.
+            */
+            bool lookup(const uint32_t *huffman, uint32_t num_codes, lookup_table &table, bool pair_literals);
+
+            /*! \brief Decode a symbol with a lookup table.
+             *
+             * \returns The symbol, -1 if the stream is corrupted or ended.
+            */
+            int decode(bit_input &input, const lookup_table &table);
+
             void externalize(bit_output &output, const int *huff_man, uint32_t num_codes);
             void internalize(bit_input &input, uint32_t *huffman, int num_codes);
         }
@@ -137,9 +195,18 @@ namespace eka2l1 {
             const uint8_t *avail;
             const uint8_t *limit;
             encoding encode;
-            uint8_t out[DEFLATE_MAX_DIST];
+
+            huffman::lookup_table lit_len_table;
+            huffman::lookup_table dist_table;
+
+            // Last inflated block followed by the one being inflated, so matches never wrap.
+            // Matches are copied a word at a time, and can write past the end of the window.
+            uint8_t out[DEFLATE_MAX_DIST * 2 + INFLATER_SAFE_ZONE];
             uint8_t huff[INFLATER_BUF_SIZE + INFLATER_SAFE_ZONE];
 
+            /*! \brief Copy a match from the history to the current block. */
+            uint8_t *copy_match(uint8_t *tout, int size);
+
             /*! \brief Do inflation */
             int inflate();
 
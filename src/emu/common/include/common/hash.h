@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -31,6 +32,9 @@ namespace eka2l1 {
         // https://stackoverflow.com/questions/7968674/unexpected-collision-with-stdhash
         uint32_t hash(std::string const &s);
         std::string normalize_for_hash(std::string org);
+
+        /*! \brief 64-bit FNV-1a hash of a block of memory. */
+        std::uint64_t hash64(const void *data, const std::size_t size, std::uint64_t h = 0xCBF29CE484222325ULL);
     }
 }
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+namespace eka2l1::common {
+    /*! \brief Pointer to an object that keeps its own reference count.
+     *
+     * The object type provides intrusive_ptr_add_ref(T*) and intrusive_ptr_release(T*),
+     * found by argument-dependent lookup. Unlike std::shared_ptr there is no separate
+     * control block, and copies don't use atomics.
+     */
+    template <typename T>
+    class intrusive_ptr {
+        T *obj = nullptr;
+
+    public:
+        intrusive_ptr() = default;
+
+        intrusive_ptr(std::nullptr_t) {}
+
+        explicit intrusive_ptr(T *ptr)
+            : obj(ptr) {
+            if (obj) {
+                intrusive_ptr_add_ref(obj);
+            }
+        }
+
+        intrusive_ptr(const intrusive_ptr &rhs)
+            : obj(rhs.obj) {
+            if (obj) {
+                intrusive_ptr_add_ref(obj);
+            }
+        }
+
+        intrusive_ptr(intrusive_ptr &&rhs) noexcept
+            : obj(rhs.obj) {
+            rhs.obj = nullptr;
+        }
+
+        ~intrusive_ptr() {
+            if (obj) {
+                intrusive_ptr_release(obj);
+            }
+        }
+
+        intrusive_ptr &operator=(const intrusive_ptr &rhs) {
+            intrusive_ptr(rhs).swap(*this);
+            return *this;
+        }
+
+        intrusive_ptr &operator=(intrusive_ptr &&rhs) noexcept {
+            intrusive_ptr(std::move(rhs)).swap(*this);
+            return *this;
+        }
+
+        intrusive_ptr &operator=(std::nullptr_t) {
+            reset();
+            return *this;
+        }
+
+        void reset() {
+            intrusive_ptr().swap(*this);
+        }
+
+        void swap(intrusive_ptr &rhs) noexcept {
+            std::swap(obj, rhs.obj);
+        }
+
+        T *get() const {
+            return obj;
+        }
+
+        T &operator*() const {
+            return *obj;
+        }
+
+        T *operator->() const {
+            return obj;
+        }
+
+        explicit operator bool() const {
+            return obj != nullptr;
+        }
+
+        bool operator==(const intrusive_ptr &rhs) const {
+            return obj == rhs.obj;
+        }
+
+        bool operator!=(const intrusive_ptr &rhs) const {
+            return obj != rhs.obj;
+        }
+
+        bool operator==(std::nullptr_t) const {
+            return obj == nullptr;
+        }
+
+        bool operator!=(std::nullptr_t) const {
+            return obj != nullptr;
+        }
+    };
+}
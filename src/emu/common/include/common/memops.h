@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eka2l1::common {
+    /*! \brief Find the first differing byte of two buffers.
+     *
+     * \returns Index of the first differing byte, or count if the buffers are equal.
+    */
+    std::size_t find_mismatch8(const std::uint8_t *lhs, const std::uint8_t *rhs, const std::size_t count);
+
+    /*! \brief Find the first differing UTF-16 unit of two buffers.
+     *
+     * \returns Index of the first differing unit, or count if the buffers are equal.
+    */
+    std::size_t find_mismatch16(const std::uint16_t *lhs, const std::uint16_t *rhs, const std::size_t count);
+
+    /*! \brief Find the first null byte, looking at most max_count bytes.
+     *
+     * \returns Index of the null byte, or max_count if there is none.
+    */
+    std::size_t find_null8(const std::uint8_t *str, const std::size_t max_count);
+
+    /*! \brief Find the first null UTF-16 unit, looking at most max_count units.
+     *
+     * \returns Index of the null unit, or max_count if there is none.
+    */
+    std::size_t find_null16(const std::uint16_t *str, const std::size_t max_count);
+}
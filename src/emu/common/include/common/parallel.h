@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace eka2l1::common {
+    /*! \brief Run a job for each index in [0, count), spread over a shared pool of worker threads.
+     *
+     * The calling thread works on the job too, and the call returns once every index is done.
+     * Jobs must be independent of each other. A job started from inside a worker runs on
+     * the calling thread only.
+     *
+     * The pool is created on first use, with one worker less than the host's hardware threads.
+     */
+    void parallel_for(const std::size_t count, const std::function<void(std::size_t)> &job);
+
+    /*! \brief Number of threads parallel_for may use, including the caller. */
+    std::size_t parallel_thread_count();
+}
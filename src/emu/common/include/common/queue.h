@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <optional>
 #include <queue>
@@ -126,4 +127,76 @@ namespace eka2l1 {
             return queue.back();
         }
     };
-}
\ No newline at end of file
+
+    /*! \brief Unbounded multi-producer, single-consumer queue.
+     *
+     * Push never takes a lock and finishes in a fixed number of steps, whatever the other
+     * producers are doing. Only one thread may pop.
+     * 
+     * Based on Dmitry Vyukov's intrusive MPSC node-based queue.
+    */
+    template <typename T>
+    class mpsc_queue {
+        struct node {
+            std::atomic<node *> next{ nullptr };
+            T value;
+        };
+
+        // Producers append here
+        std::atomic<node *> head;
+
+        // Owned by the consumer, always a node already consumed (or the stub)
+        node *tail;
+
+    public:
+        mpsc_queue() {
+            node *stub = new node;
+
+            head.store(stub, std::memory_order_relaxed);
+            tail = stub;
+        }
+
+        ~mpsc_queue() {
+            while (pop()) {
+            }
+
+            delete tail;
+        }
+
+        mpsc_queue(const mpsc_queue &) = delete;
+        mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+        /*! \brief Add a value to the queue. Safe to call from any thread. */
+        void push(const T &val) {
+            node *new_node = new node;
+            new_node->value = val;
+
+            node *prev = head.exchange(new_node, std::memory_order_acq_rel);
+            prev->next.store(new_node, std::memory_order_release);
+        }
+
+        /*! \brief Take the oldest value out. Must only be called from the consumer thread.
+         *
+         * A push which is still in progress may not be visible yet.
+        */
+        std::optional<T> pop() {
+            node *next = tail->next.load(std::memory_order_acquire);
+
+            if (!next) {
+                return std::nullopt;
+            }
+
+            std::optional<T> val = std::move(next->value);
+
+            delete tail;
+            tail = next;
+
+            return val;
+        }
+
+        /*! \brief Check if there is nothing to pop. Consumer thread only. */
+        bool empty() const {
+            return tail->next.load(std::memory_order_acquire) == nullptr;
+        }
+    };
+}
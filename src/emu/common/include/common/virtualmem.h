@@ -21,6 +21,7 @@
 #pragma once
 
 #include <common/types.h>
+#include <cstddef>
 #include <cstdint>
 
 namespace eka2l1::common {
@@ -77,15 +78,18 @@ namespace eka2l1::common {
 
     /*!\brief Map a file to memory with read-only attribute.
      *
-     * \returns A valid pointer to the mapped region on success.
+     * \returns A valid pointer to the mapped region on success, nullptr on failure.
     */
     void *map_file(const std::string &file_name);
 
     /*!\brief Unmap a file mapped to memory
+     *
+     * \param size Size of the file when it was mapped. The mapping is kept if 0, on hosts
+     *             that need the size to unmap.
      *
      * \returns True on success.
     */
-    bool unmap_file(void *ptr);
+    bool unmap_file(void *ptr, const std::size_t size = 0);
 
     /*!\brief Returns true if the platform doesn't allow write and executable memory at the same time.
     */
@@ -20,73 +20,152 @@
 #include <common/algorithm.h>
 #include <common/bytepair.h>
 #include <common/log.h>
+#include <common/parallel.h>
 
 #include <cstdint>
-#include <functional>
-#include <stack>
+#include <cstring>
+#include <fstream>
 
 namespace eka2l1 {
     namespace common {
-        int nokia_bytepair_decompress(void *destination, unsigned int dest_size, void *buffer, unsigned int buf_size) {
-            uint8_t *data8 = reinterpret_cast<uint8_t *>(buffer);
-            uint32_t lookup_table[0x200];
+        namespace {
+            /*! \brief Expansions of the pair tokens of a page, flattened.
+             *
+             * A token is expanded once, the first time it's met, into a run of plain bytes.
+             * Decompressing then only copies runs, instead of walking the pair tree for every
+             * occurrence of the token.
+             */
+            struct pair_expansions {
+                const std::uint8_t *first;
+                const std::uint8_t *second;
+                const std::uint32_t marker;
+
+                std::uint32_t offset[0x100];
+                std::uint16_t length[0x100];
+
+                // Expansion is in progress, to catch corrupted tables with cycles
+                bool expanding[0x100];
+
+                std::vector<std::uint8_t> &runs;
+
+                explicit pair_expansions(const std::uint8_t *first, const std::uint8_t *second, const std::uint32_t marker,
+                    std::vector<std::uint8_t> &runs)
+                    : first(first)
+                    , second(second)
+                    , marker(marker)
+                    , runs(runs) {
+                    std::memset(length, 0, sizeof(length));
+                    std::memset(expanding, 0, sizeof(expanding));
+                    runs.clear();
+                }
 
-            uint8_t *lookup_table_first = reinterpret_cast<uint8_t *>(lookup_table);
-            uint8_t *lookup_table_second = lookup_table_first + 0x100;
+                // Returns false if the token can't be expanded in a page
+                bool expand(const std::uint8_t token) {
+                    if (token == marker) {
+                        return false;
+                    }
 
-            uint32_t marker = ~0u;
-            uint8_t p1, p2;
+                    if (length[token] || expanding[token]) {
+                        return length[token] != 0;
+                    }
+
+                    expanding[token] = true;
+
+                    const std::uint8_t parts[2] = { first[token], second[token] };
+
+                    for (const std::uint8_t part : parts) {
+                        if ((first[part] != part) && !expand(part)) {
+                            return false;
+                        }
+                    }
+
+                    const std::size_t first_len = (first[parts[0]] == parts[0]) ? 1 : length[parts[0]];
+                    const std::size_t second_len = (first[parts[1]] == parts[1]) ? 1 : length[parts[1]];
+
+                    if (first_len + second_len > BYTEPAIR_PAGE_SIZE) {
+                        return false;
+                    }
 
-            // Fill the table
-            uint32_t b = 0x03020100;
-            uint32_t step = 0x04040404;
+                    const std::size_t start = runs.size();
+                    runs.resize(start + first_len + second_len);
 
-            std::stack<uint8_t> sec_stack;
+                    for (std::size_t i = 0; i < 2; i++) {
+                        const std::uint8_t part = parts[i];
+                        std::uint8_t *run_dest = runs.data() + start + (i ? first_len : 0);
 
-            uint8_t *buf_end = reinterpret_cast<uint8_t *>(buffer) + buf_size;
-            uint8_t *dest_end = reinterpret_cast<uint8_t *>(destination) + dest_size;
+                        if (first[part] == part) {
+                            *run_dest = part;
+                        } else {
+                            std::memcpy(run_dest, runs.data() + offset[part], length[part]);
+                        }
+                    }
+
+                    offset[token] = static_cast<std::uint16_t>(start);
+                    length[token] = static_cast<std::uint16_t>(first_len + second_len);
+
+                    return true;
+                }
+            };
+        }
+
+        int nokia_bytepair_decompress(void *destination, unsigned int dest_size, const void *buffer, unsigned int buf_size) {
+            const uint8_t *data8 = reinterpret_cast<const uint8_t *>(buffer);
+            const uint8_t *buf_end = data8 + buf_size;
 
             uint8_t *dest = reinterpret_cast<uint8_t *>(destination);
+            uint8_t *dest_end = dest + dest_size;
+
+            // Byte b is a pair if lookup_table_first[b] != b
+            alignas(4) uint8_t lookup_table_first[0x100];
+            alignas(4) uint8_t lookup_table_second[0x100];
+
+            // Fill the table, 4 bytes at a time
+            uint32_t *lut = reinterpret_cast<uint32_t *>(lookup_table_first);
 
-            uint32_t *lut = (uint32_t *)(lookup_table);
+            for (uint32_t b = 0x03020100, i = 0; i < 0x40; i++, b += 0x04040404) {
+                lut[i] = b;
+            }
 
-            do {
-                *lut++ = b;
-                b += step;
-            } while (b > step);
+            if (data8 >= buf_end) {
+                return 0;
+            }
 
             uint8_t total_pair = *data8++;
+            uint32_t marker = ~0u;
 
             if (total_pair) {
+                if (data8 >= buf_end) {
+                    return 0;
+                }
+
                 marker = *data8++;
-                lookup_table_first[marker] = (uint8_t)(~marker);
+                lookup_table_first[marker] = static_cast<uint8_t>(~marker);
 
                 if (total_pair < 32) {
-                    uint8_t *pair_end = data8 + 3 * total_pair;
-
-                    do {
-                        b = *data8++;
-                        p1 = *data8++;
-                        p2 = *data8++;
-
-                        lookup_table_first[b] = p1;
-                        lookup_table_second[b] = p2;
-                    } while (data8 < pair_end);
+                    if (buf_end - data8 < 3 * total_pair) {
+                        return 0;
+                    }
 
+                    for (uint8_t i = 0; i < total_pair; i++, data8 += 3) {
+                        lookup_table_first[data8[0]] = data8[1];
+                        lookup_table_second[data8[0]] = data8[2];
+                    }
                 } else {
-                    uint8_t *mask_st = data8;
-                    data8 += 32;
+                    if (buf_end - data8 < 32) {
+                        return 0;
+                    }
 
-                    for (b = 0; b < 0x100; b++) {
-                        uint8_t mask = mask_st[b >> 3];
+                    const uint8_t *mask_st = data8;
+                    data8 += 32;
 
-                        if (mask & (1 << (b & 7))) {
-                            // Read the pair
-                            p1 = *data8++;
-                            p2 = *data8++;
+                    for (uint32_t b = 0; b < 0x100; b++) {
+                        if (mask_st[b >> 3] & (1 << (b & 7))) {
+                            if (buf_end - data8 < 2) {
+                                return 0;
+                            }
 
-                            lookup_table_first[b] = p1;
-                            lookup_table_second[b] = p2;
+                            lookup_table_first[b] = *data8++;
+                            lookup_table_second[b] = *data8++;
 
                             --total_pair;
                         }
@@ -98,79 +177,68 @@ namespace eka2l1 {
                 }
             }
 
-            b = *data8++;
-            p1 = lookup_table_first[b];
-
-            // I'm so depressed that i have to do this
-            if (p1 != b)
-                goto not_single;
-
-        process_replace:
-            if (data8 >= buf_end) {
-                goto done_data8;
-            }
-
-            b = *data8++;
-            *dest++ = p1;
+            // Each worker keeps its own run storage around
+            static thread_local std::vector<uint8_t> runs;
+            pair_expansions expansions(lookup_table_first, lookup_table_second, marker, runs);
 
-            if (dest >= dest_end) {
-                goto done_dest;
-            }
+            while ((data8 < buf_end) && (dest < dest_end)) {
+                const uint8_t b = *data8++;
 
-            p1 = lookup_table_first[b];
+                if (lookup_table_first[b] == b) {
+                    *dest++ = b;
+                    continue;
+                }
 
-            if (p1 == b)
-                goto process_replace;
+                if (b == marker) {
+                    // The next byte is a literal
+                    if (data8 >= buf_end) {
+                        break;
+                    }
 
-        not_single:
-            if (b == marker) {
-                goto do_marker;
-            }
+                    *dest++ = *data8++;
+                    continue;
+                }
 
-        do_pair:
-            p2 = lookup_table_second[b];
-            b = p1;
-            p1 = lookup_table_first[b];
-            sec_stack.push(p2);
+                if (!expansions.expand(b)) {
+                    return 0;
+                }
 
-        recurse:
-            if (b != p1) {
-                goto do_pair;
-            }
+                const std::size_t copy_size = common::min<std::size_t>(expansions.length[b], dest_end - dest);
+                std::memcpy(dest, runs.data() + expansions.offset[b], copy_size);
 
-            if (sec_stack.empty()) {
-                goto process_replace;
+                dest += copy_size;
             }
 
-            b = sec_stack.top();
-            sec_stack.pop();
-
-            *dest++ = p1;
-            p1 = lookup_table_first[b];
-
-            goto recurse;
-
-        do_marker:
-            p1 = *data8++;
-            goto process_replace;
-
-        done_data8:
-            *dest++ = p1;
-            return static_cast<int>(dest - static_cast<uint8_t *>(destination));
-
-        done_dest:
             return static_cast<int>(dest - static_cast<uint8_t *>(destination));
+        }
 
-            return 1;
+        ibytepair_stream::ibytepair_stream(const std::uint8_t *data, const std::size_t size)
+            : data(data)
+            , data_size(size) {
         }
 
-        ibytepair_stream::ibytepair_stream(std::shared_ptr<std::istream> stream) {
-            compress_stream = stream;
+        ibytepair_stream::ibytepair_stream(std::vector<std::uint8_t> &&buf)
+            : owned_data(std::move(buf))
+            , data(owned_data.data())
+            , data_size(owned_data.size()) {
         }
 
         ibytepair_stream::ibytepair_stream(std::string path, uint32_t start) {
-            compress_stream = std::make_shared<std::ifstream>(path, std::ios::binary);
-            compress_stream->seekg(start);
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+            if (file) {
+                const std::streamoff size = file.tellg();
+
+                if (size > start) {
+                    owned_data.resize(static_cast<std::size_t>(size - start));
+
+                    file.seekg(start);
+                    file.read(reinterpret_cast<char *>(owned_data.data()), owned_data.size());
+                }
+            }
+
+            data = owned_data.data();
+            data_size = owned_data.size();
         }
 
         ibytepair_stream::index_table ibytepair_stream::table() const {
@@ -178,76 +246,123 @@ namespace eka2l1 {
         }
 
         void ibytepair_stream::seek_fwd(size_t size) {
-            compress_stream->seekg(size, std::ios::cur);
+            pos = common::min(pos + size, data_size);
         }
 
         // Read the table entry
-        void ibytepair_stream::read_table() {
-            compress_stream->read(reinterpret_cast<char *>(&idx_tab.header), 10);
+        bool ibytepair_stream::read_table() {
+            constexpr std::size_t header_size = 10;
+
+            idx_tab.header = index_table_header{};
+            idx_tab.page_size.clear();
+            page_starts.clear();
+
+            if (data_size - pos < header_size) {
+                return false;
+            }
+
+            std::memcpy(&idx_tab.header.size_of_data, data + pos, 4);
+            std::memcpy(&idx_tab.header.decompressed_size, data + pos + 4, 4);
+            std::memcpy(&idx_tab.header.number_of_pages, data + pos + 8, 2);
+
+            pos += header_size;
+
+            const std::size_t table_size = idx_tab.header.number_of_pages * sizeof(uint16_t);
+
+            if (data_size - pos < table_size) {
+                return false;
+            }
+
             idx_tab.page_size.resize(idx_tab.header.number_of_pages);
+            std::memcpy(idx_tab.page_size.data(), data + pos, table_size);
 
-            compress_stream->read(reinterpret_cast<char *>(idx_tab.page_size.data()),
-                idx_tab.page_size.size() * sizeof(uint16_t));
-        }
+            pos += table_size;
 
-        uint32_t ibytepair_stream::read_page(char *dest, uint32_t page, size_t size) {
-            size_t len = common::min<size_t>(size, 4096);
-            auto crr_pos = compress_stream->tellg();
-            std::vector<char> buf;
+            page_starts.resize(idx_tab.page_size.size() + 1);
+            page_starts[0] = pos;
+
+            for (std::size_t i = 0; i < idx_tab.page_size.size(); i++) {
+                page_starts[i + 1] = page_starts[i] + idx_tab.page_size[i];
+            }
 
-            buf.resize(idx_tab.page_size[page]);
+            if (page_starts.back() > data_size) {
+                LOG_ERROR("Bytepair pages go past the end of the data ({} > {})", page_starts.back(), data_size);
+                return false;
+            }
+
+            return true;
+        }
 
-            compress_stream->read(buf.data(), buf.size());
+        void ibytepair_stream::skip_pages() {
+            if (!page_starts.empty()) {
+                pos = page_starts.back();
+            }
+        }
 
-            if (buf.data() == nullptr) {
-                LOG_ERROR("Buffer is null! Size: {}", idx_tab.page_size[page]);
+        uint32_t ibytepair_stream::read_page(char *dest, uint32_t page, size_t size) {
+            if (page + 1 >= page_starts.size()) {
+                LOG_ERROR("Bytepair page {} doesn't exist", page);
                 return 0;
             }
 
-            auto omitted = nokia_bytepair_decompress(dest, static_cast<int>(len), buf.data(), idx_tab.page_size[page]);
+            size_t len = common::min<size_t>(size, BYTEPAIR_PAGE_SIZE);
+            pos = page_starts[page + 1];
 
-            return omitted;
+            return nokia_bytepair_decompress(dest, static_cast<unsigned int>(len), data + page_starts[page],
+                idx_tab.page_size[page]);
         }
 
         uint32_t ibytepair_stream::read_pages(char *dest, size_t size) {
-            uint32_t decompressed_size = 0;
-            read_table();
+            if (!read_table()) {
+                return 0;
+            }
 
-            uint64_t tsize = 0;
+            const std::size_t page_count = idx_tab.page_size.size();
+            std::vector<uint32_t> decompressed(page_count);
 
-            for (uint32_t i = 0; i < idx_tab.page_size.size(); i++) {
-                tsize += idx_tab.page_size[i];
-            }
+            // Every page but the last decompresses to a full page, so each has its own slot in the destination
+            common::parallel_for(page_count, [&](const std::size_t i) {
+                const std::size_t page_off = i * BYTEPAIR_PAGE_SIZE;
+
+                if (page_off >= size) {
+                    return;
+                }
+
+                const std::size_t len = common::min<std::size_t>(size - page_off, BYTEPAIR_PAGE_SIZE);
+
+                decompressed[i] = nokia_bytepair_decompress(dest + page_off, static_cast<unsigned int>(len),
+                    data + page_starts[i], idx_tab.page_size[i]);
+            });
 
-            LOG_INFO("Total size: {}, needed size: {}", tsize, size);
+            pos = page_starts.back();
 
-            for (auto i = 0; i < idx_tab.header.number_of_pages; i++) {
-                uint32_t dcs_page = read_page(dest, i, size);
+            // Short pages in the middle, pack the rest of the data after them
+            uint32_t decompressed_size = 0;
+
+            for (std::size_t i = 0; i < page_count; i++) {
+                const std::size_t page_off = i * BYTEPAIR_PAGE_SIZE;
+
+                if (decompressed_size != page_off && decompressed[i]) {
+                    std::memmove(dest + decompressed_size, dest + page_off, decompressed[i]);
+                }
 
-                decompressed_size += dcs_page;
-                dest += dcs_page;
-                size -= dcs_page;
+                decompressed_size += decompressed[i];
             }
 
             return decompressed_size;
         }
 
         std::vector<uint32_t> ibytepair_stream::page_offsets(uint32_t initial_off) {
+            const std::size_t table_pos = pos;
             read_table();
-            std::vector<uint32_t> res;
-
-            res.resize(idx_tab.header.number_of_pages + 1);
 
-            size_t bytes = initial_off + 10 + res.size() * sizeof(uint16_t);
+            std::vector<uint32_t> res(page_starts.size());
 
-            for (auto i = 0; i < res.size(); ++i) {
-                res[i] = static_cast<uint32_t>(bytes);
-                bytes += idx_tab.page_size[i];
+            for (std::size_t i = 0; i < page_starts.size(); ++i) {
+                res[i] = static_cast<uint32_t>(initial_off + page_starts[i] - table_pos);
             }
 
-            res[res.size()] = static_cast<uint32_t>(bytes);
-
             return res;
         }
     }
-}
\ No newline at end of file
+}
@@ -36,6 +36,7 @@
 #include <common/cvt.h>
 #endif
 
+#include <cstdio>
 #include <string.h>
 
 namespace eka2l1::common {
@@ -293,7 +294,7 @@ namespace eka2l1::common {
 
         return DeleteFileA(path.c_str());
 #else
-        return (remove(path.c_str()) == 0);
+        return (std::remove(path.c_str()) == 0);
 #endif
     }
 
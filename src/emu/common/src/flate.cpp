@@ -23,6 +23,9 @@
 
 #include <miniz.h>
 
+#include <array>
+#include <cstring>
+
 namespace eka2l1 {
     namespace flate {
         bool inflate_data(mz_stream *stream, void *in, void *out, uint32_t in_size, uint32_t *out_size) {
@@ -394,7 +397,7 @@ namespace eka2l1 {
                 }
 
                 if (codes == 1) {
-                    uint8_t term = decode_tree[0] >> 16;
+                    uint32_t term = decode_tree[0] >> 16;
                     decode_tree[0] = term | (term << 16);
                 } else if (codes > 1) {
                     huffman_subtree(decode_tree + codes - 1, decode_tree + codes - 1, &lvl[0]);
@@ -457,6 +460,152 @@ namespace eka2l1 {
                     --rl;
                 }
             }
+
+            // Entry: symbol, the literal after it, its code length and the length of both codes
+            enum : uint32_t {
+                LOOKUP_SYMBOL_MASK = 0x3FF,
+                LOOKUP_SECOND_SHIFT = 10,
+                LOOKUP_LENGTH_SHIFT = 18,
+                LOOKUP_TOTAL_SHIFT = 23,
+                LOOKUP_LENGTH_MASK = 0x1F
+            };
+
+            bool lookup(const uint32_t *huffman, uint32_t num_codes, lookup_table &table, bool pair_literals) {
+                if (num_codes > ENCODING_LITERAL_LEN) {
+                    LOG_ERROR("Too much codes for a Huffman lookup table!");
+                    return false;
+                }
+
+                std::array<uint16_t, HUFFMAN_MAX_CODELENGTH + 1> counts{};
+                uint32_t codes = 0;
+
+                for (uint32_t i = 0; i < num_codes; ++i) {
+                    if (huffman[i] > HUFFMAN_MAX_CODELENGTH) {
+                        LOG_ERROR("Huffman code is too long!");
+                        return false;
+                    }
+
+                    if (huffman[i]) {
+                        ++counts[huffman[i]];
+                        ++codes;
+                    }
+                }
+
+                // Canonical code: shorter codes first, then by symbol
+                uint32_t code = 0;
+                uint16_t symbol_index = 0;
+
+                table.first_code[0] = 0;
+                table.first_symbol[0] = 0;
+                table.code_count[0] = 0;
+
+                for (uint32_t len = 1; len <= HUFFMAN_MAX_CODELENGTH; ++len) {
+                    code = (code + counts[len - 1]) << 1;
+
+                    table.first_code[len] = code;
+                    table.first_symbol[len] = symbol_index;
+                    table.code_count[len] = counts[len];
+
+                    symbol_index += counts[len];
+                }
+
+                std::array<uint16_t, HUFFMAN_MAX_CODELENGTH + 1> next_symbol;
+                std::copy(table.first_symbol, table.first_symbol + HUFFMAN_MAX_CODELENGTH + 1, next_symbol.begin());
+
+                for (uint32_t i = 0; i < num_codes; ++i) {
+                    if (huffman[i]) {
+                        table.symbols[next_symbol[huffman[i]]++] = static_cast<uint16_t>(i);
+                    }
+                }
+
+                std::fill(table.entries, table.entries + (1 << HUFFMAN_LOOKUP_BITS), 0);
+
+                if (codes == 1) {
+                    // The decoding tree takes both bits as the only code
+                    std::fill(table.entries, table.entries + (1 << HUFFMAN_LOOKUP_BITS),
+                        table.symbols[0] | (1 << LOOKUP_LENGTH_SHIFT) | (1 << LOOKUP_TOTAL_SHIFT));
+
+                    return true;
+                }
+
+                for (uint32_t len = 1; len <= HUFFMAN_LOOKUP_BITS; ++len) {
+                    const uint32_t fill_shift = HUFFMAN_LOOKUP_BITS - len;
+
+                    for (uint32_t i = 0; i < table.code_count[len]; ++i) {
+                        const uint32_t entry_start = (table.first_code[len] + i) << fill_shift;
+                        const uint32_t entry_end = entry_start + (1 << fill_shift);
+
+                        if (entry_end > (1 << HUFFMAN_LOOKUP_BITS)) {
+                            LOG_ERROR("Huffman codes are oversubscribed!");
+                            return false;
+                        }
+
+                        std::fill(table.entries + entry_start, table.entries + entry_end,
+                            table.symbols[table.first_symbol[len] + i] | (len << LOOKUP_LENGTH_SHIFT) | (len << LOOKUP_TOTAL_SHIFT));
+                    }
+                }
+
+                if (!pair_literals) {
+                    return true;
+                }
+
+                // The literal after a short one is in the rest of the index
+                const uint32_t index_mask = (1 << HUFFMAN_LOOKUP_BITS) - 1;
+
+                for (uint32_t i = 0; i <= index_mask; ++i) {
+                    const uint32_t entry = table.entries[i];
+                    const uint32_t len = (entry >> LOOKUP_LENGTH_SHIFT) & LOOKUP_LENGTH_MASK;
+
+                    if ((len == 0) || (len == HUFFMAN_LOOKUP_BITS) || ((entry & LOOKUP_SYMBOL_MASK) >= ENCODING_LITERALS)) {
+                        continue;
+                    }
+
+                    const uint32_t next_entry = table.entries[(i << len) & index_mask];
+                    const uint32_t next_len = (next_entry >> LOOKUP_LENGTH_SHIFT) & LOOKUP_LENGTH_MASK;
+                    const uint32_t next_symbol = next_entry & LOOKUP_SYMBOL_MASK;
+
+                    if ((next_len == 0) || (len + next_len > HUFFMAN_LOOKUP_BITS) || (next_symbol >= ENCODING_LITERALS)) {
+                        continue;
+                    }
+
+                    table.entries[i] = (entry & ~(LOOKUP_LENGTH_MASK << LOOKUP_TOTAL_SHIFT)) | (next_symbol << LOOKUP_SECOND_SHIFT)
+                        | ((len + next_len) << LOOKUP_TOTAL_SHIFT);
+                }
+
+                return true;
+            }
+
+            int decode(bit_input &input, const lookup_table &table) {
+                input.refill();
+
+                const uint32_t entry = table.entries[input.peek(HUFFMAN_LOOKUP_BITS)];
+                int len = (entry >> LOOKUP_LENGTH_SHIFT) & LOOKUP_LENGTH_MASK;
+                int symbol = entry & LOOKUP_SYMBOL_MASK;
+
+                if (len == 0) {
+                    symbol = -1;
+
+                    for (len = HUFFMAN_LOOKUP_BITS + 1; len <= HUFFMAN_MAX_CODELENGTH; ++len) {
+                        const uint32_t code_index = input.peek(len) - table.first_code[len];
+
+                        if (code_index < table.code_count[len]) {
+                            symbol = table.symbols[table.first_symbol[len] + code_index];
+                            break;
+                        }
+                    }
+
+                    if (symbol < 0) {
+                        return -1;
+                    }
+                }
+
+                if (len > input.available()) {
+                    return -1;
+                }
+
+                input.consume(len);
+                return symbol;
+            }
         }
 
         void bit_output::do_write(int bits, uint32_t size) {
@@ -552,11 +701,13 @@ namespace eka2l1 {
             uint32_t *nptr = (uint32_t *)(p & ~3); // word containing this byte
             off += (p & 3) << 3; // bit offset within the word
 
+            bits = 0;
+
             if (len == 0)
                 count = 0;
             else {
                 // read the first few bits of the stream
-                bits = swap_bo(*nptr++) << off;
+                bits = static_cast<uint64_t>(swap_bo(*nptr++) << off) << 32;
                 off = 32 - off;
                 len -= off;
 
@@ -570,17 +721,25 @@ namespace eka2l1 {
             buf_ptr = nptr;
         }
 
-        uint32_t bit_input::read() {
-            uint32_t tbits = bits;
-            int tcount = count;
+        void bit_input::refill() {
+            while ((count <= 32) && (remain > 0)) {
+                bits |= static_cast<uint64_t>(swap_bo(*buf_ptr++)) << (32 - count);
+                count += 32;
+                remain -= 32;
+
+                if (remain < 0)
+                    count += remain;
+            }
+        }
 
-            if (--tcount < 0)
+        uint32_t bit_input::read() {
+            if (count == 0)
                 return read(1);
 
-            count = tcount;
-            bits = tbits << 1;
+            const uint32_t val = static_cast<uint32_t>(bits >> 63);
+            consume(1);
 
-            return tbits >> 31;
+            return val;
         }
 
         uint32_t bit_input::read(int size) {
@@ -588,39 +747,19 @@ namespace eka2l1 {
             if (!size)
                 return 0;
 
-            uint32_t val = 0;
-            uint32_t tbits = bits;
-
-            count -= size;
-
-            while (count < 0) {
-                // Disable warning
-                if (count + size != 0)
-                    val |= tbits >> (32 - (count + size)) << (-count);
-
-                size = -count; // bits still required
-
-                // Things are still remain shit
-                if (remain > 0) {
-                    tbits = swap_bo(*buf_ptr++);
-                    count += 32;
-                    remain -= 32;
-
-                    if (remain < 0)
-                        count += remain;
+            if (count < size) {
+                refill();
 
-                } else {
+                if (count < size) {
                     LOG_ERROR("Bit input read underflow!");
-                    tbits = bits;
-                    count -= size;
-
                     return 0;
                 }
             }
 
-            bits = (size == 32) ? 0 : tbits << size;
+            const uint32_t val = peek(size);
+            consume(size);
 
-            return val | (tbits >> (32 - size));
+            return val;
         }
 
         uint32_t bit_input::huffman(const uint32_t *tree) {
@@ -641,80 +780,137 @@ namespace eka2l1 {
 
         inflater::inflater(bit_input &input)
             : bits(&input) {
-            out[0] = 5;
+            std::memset(out, 0, sizeof(out));
 
             len = 0;
-            avail = out;
-            limit = out;
+            avail = out + DEFLATE_MAX_DIST;
+            limit = avail;
         }
 
-        int inflater::inflate() {
-            uint8_t *tout = out;
-            uint8_t *end = out + DEFLATE_MAX_DIST;
-            uint32_t *tree = encode.lit_len;
+        static int read_extra_bits(bit_input &bits, int code) {
+            if (code >= 8) {
+                int xtra = (code >> 2) - 1;
+                code -= xtra << 2;
+                code <<= xtra;
+                code |= bits.read(xtra);
+            }
+
+            return code;
+        }
+
+        uint8_t *inflater::copy_match(uint8_t *tout, int size) {
+            const uint8_t *from = rptr;
+            uint8_t *stop = tout + size;
+
+            const std::ptrdiff_t dist = tout - from;
+
+            if (dist >= 8) {
+                // Word by word, the last word may go past the match
+                do {
+                    std::memcpy(tout, from, 8);
+                    tout += 8;
+                    from += 8;
+                } while (tout < stop);
+
+                from -= tout - stop;
+            } else if (dist == 1) {
+                std::memset(tout, *from, size);
+                from += size;
+            } else {
+                // Repeating pattern
+                do {
+                    *tout++ = *from++;
+                } while (tout < stop);
+            }
+
+            rptr = from;
+            return stop;
+        }
 
+        int inflater::inflate() {
             if (len < 0) // Nothing more for you
                 return 0;
-            if (len > 0)
-                goto useHistory; // TODO: Lambda.
+
+            // The last block becomes the history
+            std::memcpy(out, out + DEFLATE_MAX_DIST, DEFLATE_MAX_DIST);
+
+            uint8_t *tout = out + DEFLATE_MAX_DIST;
+            uint8_t *end = tout + DEFLATE_MAX_DIST;
+
+            if (len > 0) {
+                // Finish the match from the last block
+                rptr -= DEFLATE_MAX_DIST;
+
+                const int tfr = common::min(static_cast<int>(end - tout), len);
+                len -= tfr;
+
+                tout = copy_match(tout, tfr);
+            }
 
             while (tout < end) {
-                {
-                    int val = bits->huffman(reinterpret_cast<uint32_t *>(tree)) - ENCODING_LITERALS;
+                bits->refill();
 
-                    if (val < 0) {
-                        *tout++ = (uint8_t)val;
-                        continue; // Combo literal, please continue getting them
-                    }
+                const uint32_t entry = lit_len_table.entries[bits->peek(HUFFMAN_LOOKUP_BITS)];
+                const int code_len = (entry >> huffman::LOOKUP_LENGTH_SHIFT) & huffman::LOOKUP_LENGTH_MASK;
+                const int total_len = (entry >> huffman::LOOKUP_TOTAL_SHIFT) & huffman::LOOKUP_LENGTH_MASK;
 
-                    if (val == ENCODING_EOS - ENCODING_LITERALS) {
-                        len -= 1;
-                        break;
-                    }
+                int val = 0;
 
-                    // Get the extra bits for the code
-                    int code = val & 0xff;
+                if (code_len && (total_len <= bits->available())) {
+                    val = entry & huffman::LOOKUP_SYMBOL_MASK;
 
-                    if (code >= 8) {
-                        int xtra = (code >> 2) - 1;
-                        code -= xtra << 2;
-                        code <<= xtra;
-                        code |= bits->read(xtra);
-                    }
+                    if ((total_len != code_len) && (tout + 1 < end)) {
+                        // Two literals at once
+                        bits->consume(total_len);
+
+                        tout[0] = static_cast<uint8_t>(val);
+                        tout[1] = static_cast<uint8_t>(entry >> huffman::LOOKUP_SECOND_SHIFT);
+                        tout += 2;
 
-                    if (val < DEFLATE_DIST_CODE_BASE - ENCODING_LITERALS) {
-                        // Length code
-                        len = code + DEFLATE_MIN_LENGTH;
-                        tree = encode.dist;
-                        continue; // read the huffman code
+                        continue;
                     }
 
-                    // distance code
-                    rptr = tout - (code + 1);
+                    bits->consume(code_len);
+                } else {
+                    val = huffman::decode(*bits, lit_len_table);
 
-                    if (rptr + DEFLATE_MAX_DIST < end) {
-                        rptr += DEFLATE_MAX_DIST;
+                    if (val < 0) {
+                        LOG_ERROR("Inflate stream corrupted!");
+                        len = -1;
+                        break;
                     }
                 }
-            // Digging things up from the cache: rptr
-            useHistory:
-                int tfr = common::min(static_cast<int>(end - tout), static_cast<int>(len));
-                len -= tfr;
 
-                const uint8_t *from = rptr;
-                do {
-                    *tout++ = *from++;
+                if (val < ENCODING_LITERALS) {
+                    *tout++ = static_cast<uint8_t>(val);
+                    continue; // Combo literal, please continue getting them
+                }
+
+                if (val == ENCODING_EOS) {
+                    len = -1;
+                    break;
+                }
 
-                    if (from == end)
-                        from -= DEFLATE_MAX_DIST;
+                len = read_extra_bits(*bits, val - ENCODING_LITERALS) + DEFLATE_MIN_LENGTH;
 
-                } while (--tfr != 0);
+                const int dist_code = huffman::decode(*bits, dist_table);
 
-                rptr = from;
-                tree = encode.lit_len;
-            };
+                if (dist_code < 0) {
+                    LOG_ERROR("Inflate stream corrupted!");
+                    len = -1;
+                    break;
+                }
+
+                // The history is right before the block, so the distance never goes out of the window
+                rptr = tout - (read_extra_bits(*bits, dist_code) + 1);
+
+                const int tfr = common::min(static_cast<int>(end - tout), len);
+                len -= tfr;
 
-            return static_cast<int>(tout - out);
+                tout = copy_match(tout, tfr);
+            }
+
+            return static_cast<int>(tout - (out + DEFLATE_MAX_DIST));
         }
 
         void inflater::init() {
@@ -726,11 +922,15 @@ namespace eka2l1 {
                 }
             } else {
                 LOG_ERROR("Inflate stream invalid!");
+                len = -1;
                 return;
             }
 
-            huffman::decoding(reinterpret_cast<int *>(encode.lit_len), ENCODING_LITERAL_LEN, reinterpret_cast<uint32_t *>(encode.lit_len));
-            huffman::decoding(reinterpret_cast<int *>(encode.dist), ENCODING_DISTS, reinterpret_cast<uint32_t *>(encode.dist), DEFLATE_DIST_CODE_BASE);
+            if (!huffman::lookup(encode.lit_len, ENCODING_LITERAL_LEN, lit_len_table, true)
+                || !huffman::lookup(encode.dist, ENCODING_DISTS, dist_table, false)) {
+                LOG_ERROR("Inflate stream invalid!");
+                len = -1;
+            }
         }
 
         int inflater::read(uint8_t *buf, size_t rlen) {
@@ -757,7 +957,7 @@ namespace eka2l1 {
                 if (hlen == 0)
                     return tfr;
 
-                avail = out;
+                avail = out + DEFLATE_MAX_DIST;
                 limit = avail + hlen;
             }
         }
@@ -20,6 +20,16 @@ namespace eka2l1 {
             return h;
         }
 
+        std::uint64_t hash64(const void *data, const std::size_t size, std::uint64_t h) {
+            const std::uint8_t *bytes = reinterpret_cast<const std::uint8_t *>(data);
+
+            for (std::size_t i = 0; i < size; i++) {
+                h = (h ^ bytes[i]) * 0x100000001B3ULL;
+            }
+
+            return h;
+        }
+
         std::string normalize_for_hash(std::string org) {
             auto remove = [](std::string &inp, std::string to_remove) {
                 size_t pos = 0;
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <common/memops.h>
+#include <common/platform.h>
+
+#include <cstring>
+
+#if EKA2L1_ARCH(X64)
+#include <emmintrin.h>
+#endif
+
+namespace eka2l1::common {
+#if EKA2L1_ARCH(X64)
+    // SSE2 is part of the x64 baseline, no need to detect it
+    static inline int first_set_bit(const int mask) {
+#ifdef _MSC_VER
+        unsigned long idx = 0;
+        _BitScanForward(&idx, static_cast<unsigned long>(mask));
+        return static_cast<int>(idx);
+#else
+        return __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+    }
+#endif
+
+    std::size_t find_mismatch8(const std::uint8_t *lhs, const std::uint8_t *rhs, const std::size_t count) {
+        std::size_t i = 0;
+
+#if EKA2L1_ARCH(X64)
+        for (; i + 16 <= count; i += 16) {
+            const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i));
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i));
+            const int diff = _mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) ^ 0xFFFF;
+
+            if (diff) {
+                return i + first_set_bit(diff);
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            if (lhs[i] != rhs[i]) {
+                return i;
+            }
+        }
+
+        return count;
+    }
+
+    std::size_t find_mismatch16(const std::uint16_t *lhs, const std::uint16_t *rhs, const std::size_t count) {
+        std::size_t i = 0;
+
+#if EKA2L1_ARCH(X64)
+        for (; i + 8 <= count; i += 8) {
+            const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i));
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i));
+            const int diff = _mm_movemask_epi8(_mm_cmpeq_epi16(l, r)) ^ 0xFFFF;
+
+            if (diff) {
+                // Two mask bits per unit
+                return i + first_set_bit(diff) / 2;
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            if (lhs[i] != rhs[i]) {
+                return i;
+            }
+        }
+
+        return count;
+    }
+
+    std::size_t find_null8(const std::uint8_t *str, const std::size_t max_count) {
+        const void *null_pos = std::memchr(str, 0, max_count);
+        return null_pos ? static_cast<const std::uint8_t *>(null_pos) - str : max_count;
+    }
+
+    std::size_t find_null16(const std::uint16_t *str, const std::size_t max_count) {
+        std::size_t i = 0;
+
+#if EKA2L1_ARCH(X64)
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 8 <= max_count; i += 8) {
+            const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+            const int nulls = _mm_movemask_epi8(_mm_cmpeq_epi16(units, zero));
+
+            if (nulls) {
+                return i + first_set_bit(nulls) / 2;
+            }
+        }
+#endif
+
+        for (; i < max_count; i++) {
+            if (str[i] == 0) {
+                return i;
+            }
+        }
+
+        return max_count;
+    }
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <common/parallel.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace eka2l1::common {
+    namespace {
+        struct parallel_batch {
+            const std::function<void(std::size_t)> *job;
+            std::size_t count;
+
+            std::atomic<std::size_t> next{ 0 };
+            std::atomic<std::size_t> done{ 0 };
+
+            // Run jobs until the batch is empty
+            void work() {
+                std::size_t finished = 0;
+
+                for (std::size_t idx = next++; idx < count; idx = next++) {
+                    (*job)(idx);
+                    finished++;
+                }
+
+                done += finished;
+            }
+        };
+
+        class worker_pool {
+            std::vector<std::thread> workers;
+
+            std::mutex lock;
+            std::condition_variable work_cond;
+            std::condition_variable done_cond;
+
+            std::shared_ptr<parallel_batch> current;
+            std::uint64_t generation = 0;
+            bool quit = false;
+
+            void worker_loop() {
+                in_worker = true;
+                std::uint64_t seen = 0;
+
+                while (true) {
+                    std::shared_ptr<parallel_batch> batch;
+
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        work_cond.wait(guard, [&]() { return quit || (generation != seen); });
+
+                        if (quit) {
+                            return;
+                        }
+
+                        seen = generation;
+                        batch = current;
+                    }
+
+                    if (batch) {
+                        batch->work();
+
+                        std::lock_guard<std::mutex> guard(lock);
+                        done_cond.notify_all();
+                    }
+                }
+            }
+
+        public:
+            static thread_local bool in_worker;
+
+            explicit worker_pool(const std::size_t count) {
+                for (std::size_t i = 0; i < count; i++) {
+                    workers.emplace_back([this]() { worker_loop(); });
+                }
+            }
+
+            ~worker_pool() {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    quit = true;
+                }
+
+                work_cond.notify_all();
+
+                for (auto &worker : workers) {
+                    worker.join();
+                }
+            }
+
+            std::size_t size() const {
+                return workers.size();
+            }
+
+            void run(const std::size_t count, const std::function<void(std::size_t)> &job) {
+                auto batch = std::make_shared<parallel_batch>();
+                batch->job = &job;
+                batch->count = count;
+
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    current = batch;
+                    generation++;
+                }
+
+                work_cond.notify_all();
+                batch->work();
+
+                std::unique_lock<std::mutex> guard(lock);
+                done_cond.wait(guard, [&]() { return batch->done == count; });
+
+                if (current == batch) {
+                    current.reset();
+                }
+            }
+        };
+
+        thread_local bool worker_pool::in_worker = false;
+
+        worker_pool &get_pool() {
+            static worker_pool pool(std::max(1U, std::thread::hardware_concurrency()) - 1);
+            return pool;
+        }
+    }
+
+    std::size_t parallel_thread_count() {
+        return get_pool().size() + 1;
+    }
+
+    void parallel_for(const std::size_t count, const std::function<void(std::size_t)> &job) {
+        worker_pool &pool = get_pool();
+
+        if (count <= 1 || pool.size() == 0 || worker_pool::in_worker) {
+            for (std::size_t i = 0; i < count; i++) {
+                job(i);
+            }
+
+            return;
+        }
+
+        pool.run(count, job);
+    }
+}
@@ -37,8 +37,10 @@ namespace eka2l1::common {
         return VirtualAlloc(nullptr, size,
             MEM_RESERVE, PAGE_NOACCESS);
 #else
-        return mmap(nullptr, size, PROT_NONE,
-            MAP_ANONYMOUS | MAP_PRIVATE, 0, 0);
+        void *result = mmap(nullptr, size, PROT_NONE,
+            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+        return (result == MAP_FAILED) ? nullptr : result;
 #endif
     }
 
@@ -161,14 +163,25 @@ namespace eka2l1::common {
 
         auto map_ptr = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE,
             file_handle, 0);
+
+        // The mapping holds its own reference to the file
+        close(file_handle);
+
+        if (map_ptr == MAP_FAILED) {
+            return nullptr;
+        }
 #endif
 
         return map_ptr;
     }
 
-    bool unmap_file(void *ptr) {
+    bool unmap_file(void *ptr, const std::size_t size) {
 #if EKA2L1_PLATFORM(WIN32)
         UnmapViewOfFile(ptr);
+#else
+        if (size) {
+            return munmap(ptr, size) == 0;
+        }
 #endif
 
         return true;
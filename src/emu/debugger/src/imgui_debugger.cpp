@@ -200,7 +200,8 @@ namespace eka2l1 {
                         ImGui::Text("0x%08x: %-10u    %s", pc, *reinterpret_cast<std::uint32_t *>(codeptr), dis.c_str());
                     } else {
                         const std::uint32_t svc_num = std::stoul(dis.substr(5), nullptr, 16);
-                        const std::string svc_call_name = sys->get_lib_manager()->svc_funcs.find(svc_num) != sys->get_lib_manager()->svc_funcs.end() ? sys->get_lib_manager()->svc_funcs[svc_num].name : "Unknown";
+                        const std::string *svc_name = sys->get_lib_manager()->get_svc_name(svc_num);
+                        const std::string svc_call_name = svc_name ? *svc_name : "Unknown";
 
                         ImGui::Text("0x%08x: %-10u    %s            ; %s", pc, *reinterpret_cast<std::uint32_t *>(codeptr), dis.c_str(), svc_call_name.c_str());
                     }
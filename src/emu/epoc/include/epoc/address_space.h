@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <epoc/page_table.h>
+
+#include <cstdint>
+#include <map>
+
+namespace eka2l1 {
+    /*! \brief A committed range of local memory, as mapped to the CPU. */
+    struct mapped_range {
+        address addr;
+        std::uint32_t size;
+        std::uint8_t *host;
+        prot protection;
+
+        bool operator==(const mapped_range &rhs) const {
+            return (addr == rhs.addr) && (size == rhs.size) && (host == rhs.host)
+                && (protection == rhs.protection);
+        }
+
+        bool operator!=(const mapped_range &rhs) const {
+            return !(*this == rhs);
+        }
+    };
+
+    /*! \brief The guest address space of a process.
+     *
+     * Global sections (shared data, code segments and ROM) are leaves of the global table,
+     * shared by reference. The address space also tracks local committed ranges, so
+     * that switching between two address spaces only has to remap the ranges that differ.
+     */
+    class address_space {
+        page_table table;
+        std::map<address, mapped_range> local_ranges;
+
+        std::uint32_t id;
+
+    public:
+        explicit address_space(page_table *global_table, int page_size);
+
+        std::uint32_t get_id() const {
+            return id;
+        }
+
+        page_table &get_page_table() {
+            return table;
+        }
+
+        const std::map<address, mapped_range> &get_local_ranges() const {
+            return local_ranges;
+        }
+
+        /*! \brief Record a committed range. Ranges overlapped by the new one are trimmed. */
+        void add_local_range(const address addr, const std::uint32_t size, std::uint8_t *host,
+            const prot protection);
+
+        /*! \brief Forget all committed memory in a range. */
+        void remove_local_range(const address addr, const std::uint32_t size);
+    };
+}
@@ -20,8 +20,13 @@
 
 #pragma once
 
+#include <common/intrusive.h>
 #include <epoc/ptr.h>
+
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace eka2l1 {
     namespace kernel {
@@ -85,6 +90,9 @@ namespace eka2l1 {
         completed
     };
 
+    class ipc_msg_pool;
+    class ipc_msg_queue;
+
     /* An IPC msg (ver 2) contains the IPC context. */
     /* Function: The IPC function ordinal */
     /* Arg: IPC args. Max args = 4 */
@@ -102,12 +110,174 @@ namespace eka2l1 {
         ipc_message_status msg_status;
         uint32_t id;
 
-        bool free : true;
+        // Number of ipc_msg_ptr referencing this message. Goes back to its pool at zero.
+        std::uint32_t ref_count = 0;
+
+        // The message handle is with a LLE server, keep alive until it's completed
+        bool lle_pinned = false;
+
+        ipc_msg_pool *owner_pool = nullptr;
+        ipc_msg *next_free = nullptr;
+
+        // Links of the server queue the message is waiting in
+        ipc_msg_queue *queue = nullptr;
+        ipc_msg *queue_next = nullptr;
+        ipc_msg *queue_prev = nullptr;
 
         ipc_msg() {}
-        ipc_msg(thread_ptr own)
-            : own_thr(own) {}
     };
 
-    using ipc_msg_ptr = std::shared_ptr<ipc_msg>;
-}
\ No newline at end of file
+    void intrusive_ptr_add_ref(ipc_msg *msg);
+    void intrusive_ptr_release(ipc_msg *msg);
+
+    using ipc_msg_ptr = common::intrusive_ptr<ipc_msg>;
+
+    class ipc_msg_slab;
+
+    /*! \brief A free list of messages.
+     *
+     * The kernel owns the root pool, which grows from the slab on demand. A session with
+     * async slots reserves its messages from the root pool into its own pool, so that a
+     * session can't starve the others, and gets them back at O(1) cost.
+    */
+    class ipc_msg_pool {
+        friend class ipc_msg_slab;
+
+        ipc_msg_slab *slab;
+        ipc_msg_pool *parent;
+
+        ipc_msg *free_head = nullptr;
+        std::size_t free_count = 0;
+
+        // Messages taken from the parent. Empty for the root pool.
+        std::vector<ipc_msg *> reserved;
+
+        void push(ipc_msg *msg);
+        ipc_msg *pop();
+
+    public:
+        explicit ipc_msg_pool(ipc_msg_slab *slab, ipc_msg_pool *parent = nullptr);
+
+        /*! \brief Give all reserved messages back to the parent.
+         *
+         * Messages still in use are returned to the parent when their last reference goes away.
+        */
+        ~ipc_msg_pool();
+
+        ipc_msg_pool(const ipc_msg_pool &) = delete;
+        ipc_msg_pool &operator=(const ipc_msg_pool &) = delete;
+
+        /*! \brief Move messages from the parent pool to this pool.
+         *
+         * \returns False if the parent can't provide that many messages.
+        */
+        bool reserve(const std::size_t count);
+
+        /*! \brief Get a free message.
+         *
+         * \param own The thread owning the message.
+         * \returns Null if the pool is a sub-pool and all of its messages are in use.
+        */
+        ipc_msg_ptr allocate(thread_ptr own);
+
+        /*! \brief Return a message that has no reference left. */
+        void release(ipc_msg *msg);
+
+        std::size_t free_size() const {
+            return free_count;
+        }
+
+        std::size_t reserved_size() const {
+            return reserved.size();
+        }
+    };
+
+    /*! \brief Storage of all IPC messages.
+     *
+     * Messages are allocated in fixed blocks that never move, so a message ID stays valid
+     * for the lifetime of the slab and translates to the message with an index.
+    */
+    class ipc_msg_slab {
+        friend class ipc_msg_pool;
+
+        std::vector<std::unique_ptr<ipc_msg[]>> blocks;
+        std::vector<ipc_msg *> msgs;
+
+        ipc_msg_pool root;
+        bool tearing_down = false;
+
+        void grow();
+
+    public:
+        static constexpr std::size_t block_size = 64;
+
+        explicit ipc_msg_slab();
+        ~ipc_msg_slab();
+
+        ipc_msg_slab(const ipc_msg_slab &) = delete;
+        ipc_msg_slab &operator=(const ipc_msg_slab &) = delete;
+
+        ipc_msg_pool &get_root_pool() {
+            return root;
+        }
+
+        /*! \brief Get a message by ID.
+         * \returns Null if the ID is out of range or the message is free.
+        */
+        ipc_msg *get(const std::uint32_t id);
+
+        /*! \brief Total number of messages ever allocated by the slab. */
+        std::size_t size() const {
+            return msgs.size();
+        }
+    };
+
+    /*! \brief FIFO of messages waiting for a server, linked through the messages.
+     *
+     * A message can be in one queue at a time. Since the message knows its queue, checking
+     * and removing a message, found by its ID, doesn't need a search. The queue holds a
+     * reference to each message in it.
+    */
+    class ipc_msg_queue {
+        ipc_msg *head = nullptr;
+        ipc_msg *tail = nullptr;
+
+        std::size_t count = 0;
+
+    public:
+        explicit ipc_msg_queue() = default;
+        ~ipc_msg_queue();
+
+        ipc_msg_queue(const ipc_msg_queue &) = delete;
+        ipc_msg_queue &operator=(const ipc_msg_queue &) = delete;
+
+        /*! \brief Add a message to the end of the queue.
+         * \returns False if the message is already queued somewhere.
+        */
+        bool push(ipc_msg_ptr &msg);
+
+        /*! \brief Take the oldest message out of the queue.
+         * \returns Null if the queue is empty.
+        */
+        ipc_msg_ptr pop();
+
+        /*! \brief Take a message out of the queue, wherever it is.
+         * \returns False if the message is not in this queue.
+        */
+        bool remove(ipc_msg *msg);
+
+        void clear();
+
+        bool contains(const ipc_msg *msg) const {
+            return msg->queue == this;
+        }
+
+        std::size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+    };
+}
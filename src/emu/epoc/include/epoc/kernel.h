@@ -25,7 +25,9 @@
 #include <epoc/kernel/library.h>
 #include <epoc/kernel/mutex.h>
 #include <epoc/kernel/object_ix.h>
+#include <epoc/kernel/object_registry.h>
 #include <epoc/kernel/codeseg.h>
+#include <epoc/kernel/hle_dispatch.h>
 #include <epoc/kernel/process.h>
 #include <epoc/kernel/scheduler.h>
 #include <epoc/kernel/sema.h>
@@ -41,6 +43,7 @@
 #include <epoc/ptr.h>
 
 #include <atomic>
+#include <deque>
 #include <exception>
 #include <map>
 #include <memory>
@@ -130,8 +133,10 @@ namespace eka2l1 {
 
         friend class kernel::process;
 
+        // Declared first so it outlives every object that can hold a message
+        ipc_msg_slab msgs;
+
         /* Kernel objects map */
-        std::array<ipc_msg_ptr, 0x1000> msgs;
 
         /* End kernel objects map */
         std::mutex kern_lock;
@@ -150,6 +155,15 @@ namespace eka2l1 {
         std::vector<codeseg_ptr> codesegs;
         std::vector<timer_ptr> timers;
 
+        // Lookup indexes over all the lists above
+        kernel::object_registry registry;
+
+        // HLE servers with messages waiting
+        kernel::basic_hle_dispatch_queue<service::server> ready_servers;
+
+        // Messages processed per slice at most. Zero drains the ready list
+        int hle_dispatch_budget = 32;
+
         timing_system *timing;
         manager_system *mngr;
         memory_system *mem;
@@ -209,8 +223,20 @@ namespace eka2l1 {
             thr_sch->unschedule_wakeup();
         }
 
+        /*! \brief Process messages queued to HLE servers, up to the dispatch budget. */
         void processing_requests();
 
+        /*! \brief Put a HLE server with pending messages on the ready list. */
+        void queue_hle_server(service::server *svr);
+
+        void set_hle_dispatch_budget(const int budget) {
+            hle_dispatch_budget = budget;
+        }
+
+        const hle_dispatch_stats &get_hle_dispatch_stats() const {
+            return ready_servers.get_stats();
+        }
+
         epocver get_epoc_version() const {
             return kern_ver;
         }
@@ -223,12 +249,17 @@ namespace eka2l1 {
         void prepare_reschedule();
 
         ipc_msg_ptr create_msg(kernel::owner_type owner);
+
+        /*! \brief Get a message in use by its handle.
+         * \returns Null if the handle is invalid or the message has been freed.
+        */
         ipc_msg_ptr get_msg(int handle);
 
-        void free_msg(ipc_msg_ptr msg);
+        /*! \brief Keep a message handed to a LLE server alive until it's completed. */
+        void pin_msg(ipc_msg_ptr &msg);
 
-        /*! \brief Completely destroy a message. */
-        void destroy_msg(ipc_msg_ptr msg);
+        /*! \brief Drop the reference taken by pin_msg. */
+        void unpin_msg(ipc_msg_ptr &msg);
 
         /* Fast duplication, unsafe */
         kernel::handle mirror(thread_ptr own_thread, kernel::handle handle, kernel::owner_type owner);
@@ -240,6 +271,7 @@ namespace eka2l1 {
 
         void add_custom_server(server_ptr svr) {
             SYNCHRONIZE_ACCESS;
+            registry.add(svr);
             servers.push_back(std::move(svr));
         }
 
@@ -283,6 +315,14 @@ namespace eka2l1 {
             return codesegs;
         }
 
+        kernel::object_registry &get_object_registry() {
+            return registry;
+        }
+
+        ipc_msg_slab &get_msg_slab() {
+            return msgs;
+        }
+
         /*! \brief Get kernel object by handle
         */
         template <typename T>
@@ -293,45 +333,13 @@ namespace eka2l1 {
         template <typename T>
         constexpr std::shared_ptr<T> get_by_name_and_type(const std::string &name, const kernel::object_type
             obj_type) {
-            switch (obj_type) {
-            #define OBJECT_SEARCH(obj_type, obj_map)                                                   \
-                case kernel::object_type::obj_type: {                                                  \
-                    auto res = std::find_if(obj_map.begin(), obj_map.end(), [&](const auto &rhs) {     \
-                        return name == rhs->name();                                                    \
-                    });                                                                                \
-                    if (res == obj_map.end())                                                          \
-                        return nullptr;                                                                \
-                    return std::reinterpret_pointer_cast<T>(*res);                                     \
-                }
-
-            OBJECT_SEARCH(mutex, mutexes)
-            OBJECT_SEARCH(sema, semas)
-            OBJECT_SEARCH(chunk, chunks)
-            OBJECT_SEARCH(thread, threads)
-            OBJECT_SEARCH(process, processes)
-            OBJECT_SEARCH(change_notifier, change_notifiers)
-            OBJECT_SEARCH(library, libraries)
-            OBJECT_SEARCH(codeseg, codesegs)
-            OBJECT_SEARCH(server, servers)
-            OBJECT_SEARCH(prop, props)
-            OBJECT_SEARCH(session, sessions)
-            OBJECT_SEARCH(timer, timers)
-
-            #undef OBJECT_SEARCH
-
-            default:
-                break;
-            }
-
-            return nullptr;
+            return std::reinterpret_pointer_cast<T>(registry.get_by_name(name, obj_type));
         }
 
         /*! \brief Get kernel object by name
         */
         template <typename T>
         constexpr std::shared_ptr<T> get_by_name(const std::string &name) {
-            SYNCHRONIZE_ACCESS;
-
             constexpr kernel::object_type obj_type = get_object_type<T>();
             return get_by_name_and_type<T>(name, obj_type);
         }
@@ -340,44 +348,8 @@ namespace eka2l1 {
         */
         template <typename T>
         constexpr std::shared_ptr<T> get_by_id(const kernel::uid uid) {
-            SYNCHRONIZE_ACCESS;
-
             constexpr kernel::object_type obj_type = get_object_type<T>();
-            
-            switch (obj_type) {
-                // It's gurantee that object are sorted by unique id, by just adding it
-                // Deletion will not affect that fact.
-            #define OBJECT_SEARCH(obj_type, obj_map)                                                                                \
-                case kernel::object_type::obj_type: {                                                                               \
-                    auto res = std::lower_bound(obj_map.begin(), obj_map.end(), nullptr, [&](const auto &lhs, const auto &rhs) {    \
-                        return lhs->unique_id() < uid;                                                                              \
-                    });                                                                                                             \
-                    if (res != obj_map.end()) {                                                                                     \
-                        return std::reinterpret_pointer_cast<T>(*res);                                                              \
-                    }                                                                                                               \
-                    return nullptr;                                                                                                 \
-                }
-
-            OBJECT_SEARCH(mutex, mutexes)
-            OBJECT_SEARCH(sema, semas)
-            OBJECT_SEARCH(chunk, chunks)
-            OBJECT_SEARCH(thread, threads)
-            OBJECT_SEARCH(process, processes)
-            OBJECT_SEARCH(change_notifier, change_notifiers)
-            OBJECT_SEARCH(library, libraries)
-            OBJECT_SEARCH(codeseg, codesegs)
-            OBJECT_SEARCH(server, servers)
-            OBJECT_SEARCH(prop, props)
-            OBJECT_SEARCH(session, sessions)
-            OBJECT_SEARCH(timer, timers)
-
-            #undef OBJECT_SEARCH
-
-            default:
-                break;
-            }
-
-            return nullptr;
+            return std::reinterpret_pointer_cast<T>(registry.get(uid, obj_type));
         }
 
         /*! \brief Create and add to object array.
@@ -393,7 +365,7 @@ namespace eka2l1 {
                 obj = std::make_shared<T>(this, creation_arg...);
             }
 
-            const kernel::uid obj_uid = obj->unique_id();
+            registry.add(obj);
 
             switch (obj_type) {
             case kernel::object_type::thread: {
@@ -424,7 +396,10 @@ namespace eka2l1 {
             }
 
             case kernel::object_type::session: {
-                sessions.push_back(std::move(std::reinterpret_pointer_cast<service::session>(obj)));
+                session_ptr ss = std::reinterpret_pointer_cast<service::session>(obj);
+                ss->set_self(ss);
+
+                sessions.push_back(std::move(ss));
                 return std::reinterpret_pointer_cast<T>(sessions.back());
             }
 
@@ -24,6 +24,7 @@
 #include <epoc/ptr.h>
 #include <epoc/utils/sec.h>
 
+#include <functional>
 #include <tuple>
 #include <vector>
 
@@ -60,8 +61,20 @@ namespace eka2l1::kernel {
 
         std::vector<std::uint32_t> export_table;
         epoc::security_info sinfo;
+
+        // Reserve the code chunk without committing it, see codeseg::set_code_page_loader
+        bool demand_paged_code = false;
     };
 
+    /*! \brief Fill a page of code on its first access.
+     *
+     * \param page_index Index of the page, from the start of the code.
+     * \param dest       Host memory of the page, committed and zeroed.
+     *
+     * \returns False if the page can't be loaded.
+    */
+    using code_page_loader = std::function<bool(const std::uint32_t page_index, std::uint8_t *dest)>;
+
     class codeseg: public kernel::kernel_obj {
         std::uint32_t uids[3];
 
@@ -92,6 +105,13 @@ namespace eka2l1::kernel {
 
         bool mark { false };
 
+        code_page_loader page_loader;
+
+        // Code pages loaded through the page loader
+        std::uint32_t touched_code_pages { 0 };
+
+        bool page_in_code(const address page_addr);
+
     public:
         /*! \brief Create a new codeseg
          *
@@ -105,7 +125,7 @@ namespace eka2l1::kernel {
         explicit codeseg(kernel_system *kern, const std::string &name,
             codeseg_create_info &info);
 
-        virtual ~codeseg() {}
+        ~codeseg() override;
 
         void queries_call_list(std::vector<std::uint32_t> &call_list);
 
@@ -117,6 +137,30 @@ namespace eka2l1::kernel {
         */
         address lookup(const std::uint32_t ord);
 
+        /*! \brief Load the code lazily, a page at a time, as it's accessed.
+         *
+         * Only usable if the codeseg was created with demand_paged_code. The loader is kept
+         * until the codeseg is destroyed.
+        */
+        bool set_code_page_loader(code_page_loader loader);
+
+        bool is_code_demand_paged() const {
+            return static_cast<bool>(page_loader);
+        }
+
+        std::uint32_t get_code_page_count() const;
+
+        /*! \brief Run the code page loader on a page, without committing it in the code chunk.
+         *
+         * The page doesn't count as touched.
+        */
+        bool load_code_page(const std::uint32_t page_index, std::uint8_t *dest);
+
+        /*! \brief Number of code pages loaded so far by the code page loader. */
+        std::uint32_t get_touched_code_page_count() const {
+            return touched_code_pages;
+        }
+
         void set_full_path(const std::u16string &seg_full_path) {
             full_path = seg_full_path;
         }
@@ -164,5 +208,9 @@ namespace eka2l1::kernel {
         std::vector<std::uint32_t> &get_export_table() {
             return export_table;
         }
+
+        const std::vector<codeseg_ptr> &get_dependencies() const {
+            return dependencies;
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+namespace eka2l1 {
+    /*! \brief Counters of the HLE server dispatch loop. */
+    struct hle_dispatch_stats {
+        //! Messages handed to HLE servers
+        std::uint64_t dispatched = 0;
+
+        //! Times an idle server joined the ready list
+        std::uint64_t wakeups = 0;
+
+        //! Slices that ran out of budget with servers still ready
+        std::uint64_t budget_exhausted = 0;
+
+        //! Most servers ready at once
+        std::size_t max_ready = 0;
+    };
+
+    namespace kernel {
+        /*! \brief HLE servers with messages waiting, in the order they got them.
+         *
+         * Servers get one message at a time, and go to the back of the list if they still
+         * have more, so a server with a backlog doesn't hold up the others.
+         *
+         * The server type needs a dispatch_pending flag, process_accepted_msg() and has_pending_msgs().
+         */
+        template <typename T>
+        class basic_hle_dispatch_queue {
+        public:
+            using server_ref = std::shared_ptr<T>;
+
+        private:
+            std::deque<server_ref> ready;
+            hle_dispatch_stats stats;
+
+            // Server in process_accepted_msg, and if it was removed meanwhile
+            T *dispatching = nullptr;
+            bool dispatching_removed = false;
+
+        public:
+            /*! \brief Add a server to the back of the list, if it's not there already. */
+            void queue(server_ref svr) {
+                if (svr->dispatch_pending) {
+                    return;
+                }
+
+                svr->dispatch_pending = true;
+                ready.push_back(std::move(svr));
+
+                stats.wakeups++;
+                stats.max_ready = std::max(stats.max_ready, ready.size());
+            }
+
+            /*! \brief Take a server off the list, when it's destroyed.
+             *
+             * Safe to call from the server's own dispatch, the server is then not queued again.
+             */
+            void remove(T *svr) {
+                if (svr == dispatching) {
+                    dispatching_removed = true;
+                }
+
+                if (!svr->dispatch_pending) {
+                    return;
+                }
+
+                auto ite = std::find_if(ready.begin(), ready.end(), [svr](const server_ref &ready_svr) {
+                    return ready_svr.get() == svr;
+                });
+
+                if (ite != ready.end()) {
+                    ready.erase(ite);
+                }
+
+                svr->dispatch_pending = false;
+            }
+
+            /*! \brief Dispatch messages until no server is ready, or the budget is used up.
+             *
+             * \param budget Most messages to dispatch, 0 for no limit.
+             */
+            void dispatch(const int budget) {
+                int left = budget;
+
+                while (!ready.empty()) {
+                    if (budget > 0 && left-- == 0) {
+                        stats.budget_exhausted++;
+                        break;
+                    }
+
+                    // Keep the server alive, its handler may destroy it
+                    server_ref svr = std::move(ready.front());
+                    ready.pop_front();
+
+                    svr->dispatch_pending = false;
+
+                    dispatching = svr.get();
+                    dispatching_removed = false;
+
+                    svr->process_accepted_msg();
+                    stats.dispatched++;
+
+                    dispatching = nullptr;
+
+                    // The handler may have delivered to the server again, which queued it already
+                    if (!dispatching_removed && !svr->dispatch_pending && svr->has_pending_msgs()) {
+                        svr->dispatch_pending = true;
+                        ready.push_back(std::move(svr));
+                    }
+                }
+            }
+
+            const hle_dispatch_stats &get_stats() const {
+                return stats;
+            }
+
+            std::size_t size() const {
+                return ready.size();
+            }
+
+            bool empty() const {
+                return ready.empty();
+            }
+        };
+    }
+}
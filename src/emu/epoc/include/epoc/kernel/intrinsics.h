@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <epoc/kernel/libmanager.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eka2l1 {
+    class memory_system;
+}
+
+namespace eka2l1::hle {
+    /*! \brief A host implementation of a guest library export.
+     *
+     * The export is trapped to the host function once its library is loaded. The
+     * host function follows the guest's calling convention, like any bridged function.
+     */
+    struct intrinsic_info {
+        const char *lib_name;
+        std::uint32_t ordinal;
+
+        // Enabled by "intrinsic_<name>" in the config
+        const char *name;
+        import_func_ptr func;
+    };
+
+    /*! \brief SVC numbers at and above this call an intrinsic, with the intrinsic index in the low bits.
+     *
+     * Out of the executive call ranges, and only reachable from trapped exports.
+     */
+    constexpr sid intrinsic_svc_base = 0x00FF0000;
+
+    /*! \brief Get the intrinsics for an EPOC version.
+     *
+     * Ordinals are only known for EKA2 libraries, there are none for EKA1.
+     *
+     * \param count Number of intrinsics in the returned array.
+     */
+    const intrinsic_info *get_intrinsics(const epocver ver, std::size_t &count);
+
+    /*! \brief Compare two guest byte buffers of the current address space.
+     *
+     * \returns Same as memcompare: the difference of the first differing bytes, or of the
+     *          lengths if one buffer is the start of the other.
+     */
+    std::int32_t compare_guest_memory8(memory_system *mem, const address lhs, const std::int32_t lhs_length,
+        const address rhs, const std::int32_t rhs_length);
+
+    /*! \brief Compare two guest UTF-16 buffers, same result as Mem::Compare. */
+    std::int32_t compare_guest_memory16(memory_system *mem, const address lhs, const std::int32_t lhs_length,
+        const address rhs, const std::int32_t rhs_length);
+
+    /*! \brief Length of a null-terminated guest string, same as User::StringLength. */
+    std::int32_t guest_string_length8(memory_system *mem, const address str);
+    std::int32_t guest_string_length16(memory_system *mem, const address str);
+
+    /*! \brief Fill a guest range, which may cross chunks.
+     *
+     * \returns False if part of the range is not committed.
+     */
+    bool fill_guest_memory(memory_system *mem, const address dest, const std::uint8_t value, const std::uint32_t size);
+}
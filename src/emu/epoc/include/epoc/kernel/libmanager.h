@@ -21,7 +21,9 @@
 #pragma once
 
 #include <common/types.h>
+#include <epoc/kernel/svc_table.h>
 
+#include <array>
 #include <functional>
 #include <map>
 #include <memory>
@@ -41,6 +43,9 @@ namespace eka2l1 {
     class kernel_system;
     class system;
 
+    struct file;
+    using symfile = std::shared_ptr<file>;
+
     using sid = uint32_t;
     using sids = std::vector<uint32_t>;
     using exportaddr = uint32_t;
@@ -65,20 +70,18 @@ namespace eka2l1 {
         struct e32img;
         struct romimg;
 
+        class codeseg_cache;
+
         using e32img_ptr = std::shared_ptr<e32img>;
         using romimg_ptr = std::shared_ptr<romimg>;
     }
 
     namespace hle {
-        struct epoc_import_func {
-            std::function<void(system *)> func;
-            std::string name;
-        };
-
-        using func_map = std::unordered_map<uint32_t, eka2l1::hle::epoc_import_func>;
         using export_table = std::vector<std::uint32_t>;
         using symbols = std::vector<std::string>;
 
+        struct intrinsic_info;
+
         /*! \brief Manage libraries and HLE functions.
 		 * 
 		 * HLE functions are stored here. Libraries and images are also cached
@@ -98,12 +101,92 @@ namespace eka2l1 {
 
             bool log_svc { false };
 
+            // Load the code of E32 images a page at a time, when it's touched
+            bool demand_paging { false };
+
+            std::vector<std::weak_ptr<kernel::codeseg>> demand_paged_segs;
+
+            // Loaded codesegs kept on disk, so they don't have to be decompressed and relocated again
+            std::shared_ptr<loader::codeseg_cache> cache;
+
+            /*! \brief Parse an E32 image, or make it from the codeseg cache if it has the image. */
+            std::optional<loader::e32img> parse_e32img(symfile f, const std::u16string &path);
+
+            /*! \brief Load an image made from the codeseg cache.
+             *
+             * If the entry doesn't fit anymore, the image is parsed and loaded like any other one,
+             * and the entry is replaced.
+            */
+            codeseg_ptr load_e32img_from_cache(loader::e32img &img, const std::u16string &path);
+
+            void store_codeseg_to_cache(codeseg_ptr cs, loader::e32img &img, const std::u16string &path);
+
+            svc_table svcs;
+
+            const intrinsic_info *intrinsics = nullptr;
+            std::size_t intrinsic_count = 0;
+            std::vector<bool> intrinsic_enabled;
+
+            // Instructions seen by the CPU instead of the guest code, by halfword address
+            std::unordered_map<address, std::uint16_t> code_patches;
+
+            void patch_code(const address addr, const std::uint16_t inst);
+
+            /*! \brief Make an export jump to an intrinsic.
+             *
+             * The export is replaced by an SVC to the intrinsic and a return. Thumb exports
+             * switch to ARM first, since the Thumb SVC can't hold an intrinsic number.
+            */
+            void trap_export(const address addr, const sid svcnum);
+
+            /*! \brief Trap the exports of a codeseg that have an intrinsic.
+             *
+             * An export is left alone if the trap doesn't fit before the next export or the
+             * end of the code, since it would overwrite code that isn't part of the export.
+            */
+            void trap_intrinsics(const std::string &lib_name_lower, codeseg_ptr cs);
+
+            bool call_intrinsic(const std::uint32_t idx);
+
         public:
-            std::unordered_map<sid, epoc_import_func> svc_funcs;
+            struct demand_paging_stats {
+                std::size_t segment_count = 0;
+
+                // Code pages of the segments, which are all loaded up front without demand paging
+                std::uint64_t page_count = 0;
+
+                // Code pages loaded because they were touched
+                std::uint64_t touched_page_count = 0;
+            };
 
             lib_manager(){};
 
-            bool register_exports(const std::string &lib_name, export_table &table);
+            /*! \brief Add SVCs to the dispatch tables, replacing ones with the same number. */
+            void register_svcs(const func_map &svcs);
+
+            /*! \brief Get the name of an SVC, or nullptr if it's not registered. */
+            const std::string *get_svc_name(const sid svcnum) const;
+
+            /*! \brief Number of times an SVC was called.
+             *
+             * Only counted if "count_svc" is enabled in the config.
+            */
+            std::uint64_t get_svc_call_count(const sid svcnum) const;
+
+            bool register_exports(const std::string &lib_name, codeseg_ptr cs);
+
+            /*! \brief Remove the code patches in a range, once the code there is unloaded. */
+            void remove_code_patches(const address addr, const std::uint32_t size);
+
+            /*! \brief Apply the code patches to an instruction fetch.
+             *
+             * Patches only exist in what the CPU fetches, the guest memory is untouched. It's
+             * up to the CPU backend to call this while translating.
+             *
+             * \param addr  Address of the fetch.
+             * \param word  32-bit word read from guest memory at addr.
+            */
+            std::uint32_t patch_code_fetch(const address addr, std::uint32_t word) const;
 
             /*! \brief Intialize the library manager. 
 			 * \param ver The EPOC version to import HLE functions.
@@ -135,6 +218,16 @@ namespace eka2l1 {
                 try_search_and_parse(const std::u16string &path);
             
             codeseg_ptr load_as_e32img(loader::e32img &img, const std::u16string &path = u"");
+
+            bool is_demand_paging_enabled() const {
+                return demand_paging;
+            }
+
+            /*! \brief Count a codeseg with demand paged code in the paging statistics. */
+            void track_demand_paged_codeseg(codeseg_ptr seg);
+
+            /*! \brief Get the paging statistics of the demand paged codesegs still alive. */
+            demand_paging_stats get_demand_paging_stats() const;
             codeseg_ptr load_as_romimg(loader::romimg &img, const std::u16string &path = u"");
 
             std::optional<std::string> get_symbol(const address addr) {
@@ -41,24 +41,46 @@ namespace eka2l1 {
 
         struct object_ix_record {
             kernel_obj_ptr object;
-            uint32_t associated_handle;
+            uint32_t associated_handle = 0;
+
+            // Instance bits of the handle to this slot, changed each time the slot is reused
+            std::uint16_t instance = 0;
+
+            // Next slot in the free list, -1 for the end
+            std::int32_t next_free = -1;
             bool free = true;
         };
 
-        /*! \brief The ultimate object handles holder. */
+        /*! \brief The ultimate object handles holder.
+         *
+         * Slots are kept in a growable table, with the free ones linked into a list. The handle
+         * carries the slot index and the slot's instance, so a stale handle to a reused slot
+         * is rejected.
+         */
         class object_ix {
-            uint64_t uid;
+            //! The handle has 15 bits of index, and 13 bits of instance
+            static constexpr std::size_t max_object = 0x8000;
+            static constexpr std::uint16_t max_instance = 0x1FFF;
+
+            static constexpr std::size_t initial_object = 16;
 
-            size_t next_instance;
+            uint64_t uid = 0;
+
+            std::vector<object_ix_record> objects;
+            std::int32_t free_head = -1;
 
-            std::array<object_ix_record, 0x100> objects;
             std::vector<std::uint32_t> handles;
 
-            handle_array_owner owner;
+            handle_array_owner owner = handle_array_owner::kernel;
 
             uint32_t make_handle(size_t index);
 
-            kernel_system *kern;
+            /*! \brief Double the table, and put the new slots on the free list. */
+            bool grow();
+
+            object_ix_record *get_record(uint32_t handle);
+
+            kernel_system *kern = nullptr;
 
         public:
             object_ix() {}
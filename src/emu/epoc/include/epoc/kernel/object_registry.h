@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <common/hash.h>
+#include <common/types.h>
+#include <epoc/kernel/kernel_obj.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace eka2l1 {
+    namespace kernel {
+        class codeseg;
+    }
+
+    namespace service {
+        class property;
+    }
+
+    using kernel_obj_ptr = std::shared_ptr<kernel::kernel_obj>;
+    using codeseg_ptr = std::shared_ptr<kernel::codeseg>;
+    using property_ptr = std::shared_ptr<service::property>;
+}
+
+namespace eka2l1::kernel {
+    using codeseg_uid_triple = std::tuple<std::uint32_t, std::uint32_t, std::uint32_t>;
+
+    struct codeseg_uid_triple_hash {
+        std::size_t operator()(const codeseg_uid_triple &uids) const {
+            // UID3 is the one that differs the most between images
+            return std::hash<std::uint64_t>{}((static_cast<std::uint64_t>(std::get<2>(uids)) << 32)
+                ^ (static_cast<std::uint64_t>(std::get<1>(uids)) << 16) ^ std::get<0>(uids));
+        }
+    };
+
+    /*! \brief Lookup indexes over the live kernel objects.
+     *
+     * Objects are indexed by ID, by name per object type, codesegs by entry point and UID
+     * triple, and properties by category and key. Objects sharing a name are ordered
+     * by ID, so a lookup by name returns the oldest one.
+     *
+     * Like the rest of the kernel, the registry belongs to the emulation thread. Lookups
+     * don't take any lock.
+     */
+    class object_registry {
+        static constexpr std::size_t total_object_type = static_cast<std::size_t>(object_type::unk) + 1;
+
+        using name_bucket = std::map<std::uint32_t, kernel_obj_ptr>;
+
+        std::unordered_map<std::uint32_t, kernel_obj_ptr> objects;
+        std::array<std::unordered_map<std::string, name_bucket>, total_object_type> names;
+
+        std::unordered_map<address, codeseg_ptr> codesegs_by_ep;
+        std::unordered_map<codeseg_uid_triple, codeseg_ptr, codeseg_uid_triple_hash> codesegs_by_uids;
+        std::unordered_map<std::pair<int, int>, property_ptr> props;
+
+    public:
+        /*! \brief Index a new object.
+         *
+         * Codesegs are also indexed by entry point and UIDs, properties by category and key.
+         * Those must not change while the object is registered.
+        */
+        void add(kernel_obj_ptr obj);
+
+        /*! \brief Drop an object from every index.
+         *
+         * \returns False if the object was not in the registry.
+        */
+        bool remove(kernel_obj *obj);
+
+        /*! \brief Move an object to a new name. Must be called before the name changes. */
+        void rename(kernel_obj *obj, const std::string &new_name);
+
+        kernel_obj_ptr get(const std::uint32_t id) const;
+        kernel_obj_ptr get(const std::uint32_t id, const object_type type) const;
+
+        /*! \brief Get the object with the lowest ID of this name and type. */
+        kernel_obj_ptr get_by_name(const std::string &name, const object_type type) const;
+
+        /*! \brief Get the object with the lowest ID not below the given one, of this name and type. */
+        kernel_obj_ptr get_by_name(const std::string &name, const object_type type, const std::uint32_t min_id) const;
+
+        codeseg_ptr get_codeseg_by_ep(const address ep) const;
+        codeseg_ptr get_codeseg_by_uids(const std::uint32_t uid0, const std::uint32_t uid1, const std::uint32_t uid2) const;
+
+        property_ptr get_prop(const int category, const int key) const;
+
+        std::size_t size() const {
+            return objects.size();
+        }
+
+        void clear();
+    };
+}
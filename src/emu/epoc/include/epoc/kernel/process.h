@@ -30,6 +30,7 @@
 #include <epoc/loader/e32img.h>
 #include <epoc/loader/romimage.h>
 
+#include <epoc/address_space.h>
 #include <epoc/page_table.h>
 
 #include <cassert>
@@ -125,7 +126,7 @@ namespace eka2l1::kernel {
         std::u16string exe_path;
         std::u16string cmd_args;
 
-        page_table page_tab;
+        address_space addr_space;
         object_ix process_handles;
 
         uint32_t flags;
@@ -217,8 +218,12 @@ namespace eka2l1::kernel {
             return puid;
         }
 
+        address_space &get_address_space() {
+            return addr_space;
+        }
+
         page_table &get_page_table() {
-            return page_tab;
+            return addr_space.get_page_table();
         }
 
         void set_flags(const uint32_t new_flags) {
@@ -21,12 +21,15 @@
 #pragma once
 
 #include <arm/arm_factory.h>
+#include <common/algorithm.h>
 #include <common/queue.h>
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <tuple>
@@ -44,18 +47,154 @@ namespace eka2l1 {
     using thread_ptr = std::shared_ptr<kernel::thread>;
     using process_ptr = std::shared_ptr<kernel::process>;
 
-    struct thread_comparator {
-        bool operator()(const thread_ptr &x, const thread_ptr &y) const;
-    };
-
     namespace kernel {
         enum class thread_state;
 
         using uid = std::uint32_t;
 
+        /*! \brief Ready threads, in a FIFO list per priority.
+         *
+         * A bitmap of non-empty priorities finds the highest one with a single bit scan.
+         * The lists are linked through the threads, so every operation is O(1).
+         *
+         * The thread type needs ready_next, ready_prev, ready_priority and current_real_priority().
+         */
+        template <typename T>
+        class basic_ready_queue {
+        public:
+            using thread_ref = std::shared_ptr<T>;
+
+            static constexpr int total_priority = 64;
+
+        private:
+            std::array<thread_ref, total_priority> heads;
+            std::array<T *, total_priority> tails{};
+
+            std::uint64_t priority_bitmap = 0;
+            std::size_t count = 0;
+
+            void link(thread_ref thr, const bool front) {
+                const int pri = clamp_priority(thr->current_real_priority());
+                T *raw = thr.get();
+
+                raw->ready_priority = pri;
+
+                if (!heads[pri]) {
+                    tails[pri] = raw;
+                    heads[pri] = std::move(thr);
+                } else if (front) {
+                    heads[pri]->ready_prev = raw;
+                    raw->ready_next = std::move(heads[pri]);
+                    heads[pri] = std::move(thr);
+                } else {
+                    raw->ready_prev = tails[pri];
+                    tails[pri]->ready_next = std::move(thr);
+                    tails[pri] = raw;
+                }
+
+                priority_bitmap |= (1ULL << pri);
+                count++;
+            }
+
+        public:
+            static int clamp_priority(const int priority) {
+                return std::clamp(priority, 0, total_priority - 1);
+            }
+
+            static bool is_queued(const T *thr) {
+                return thr->ready_priority != -1;
+            }
+
+            /*! \brief Queue a thread after the others of the same priority. */
+            void push_back(thread_ref thr) {
+                link(std::move(thr), false);
+            }
+
+            /*! \brief Queue a thread before the others of the same priority. */
+            void push_front(thread_ref thr) {
+                link(std::move(thr), true);
+            }
+
+            /*! \brief Dequeue a thread.
+             *
+             * \returns The queue's reference to the thread, nullptr if it was not queued.
+            */
+            thread_ref remove(T *thr) {
+                if (!is_queued(thr)) {
+                    return nullptr;
+                }
+
+                const int pri = thr->ready_priority;
+                thread_ref next = std::move(thr->ready_next);
+                thread_ref self;
+
+                // Take the reference owned by the previous link, so the thread outlives the unlinking
+                if (thr->ready_prev) {
+                    self = std::move(thr->ready_prev->ready_next);
+                    thr->ready_prev->ready_next = next;
+                } else {
+                    self = std::move(heads[pri]);
+                    heads[pri] = next;
+                }
+
+                if (next) {
+                    next->ready_prev = thr->ready_prev;
+                } else {
+                    tails[pri] = thr->ready_prev;
+                }
+
+                if (!heads[pri]) {
+                    priority_bitmap &= ~(1ULL << pri);
+                }
+
+                thr->ready_prev = nullptr;
+                thr->ready_priority = -1;
+                count--;
+
+                return self;
+            }
+
+            /*! \brief Move a thread to the back of the list of its current priority. */
+            void requeue(T *thr) {
+                if (thread_ref self = remove(thr)) {
+                    push_back(std::move(self));
+                }
+            }
+
+            /*! \brief Dequeue the first thread of the highest priority. */
+            thread_ref pop_highest() {
+                const int pri = highest_priority();
+
+                if (pri == -1) {
+                    return nullptr;
+                }
+
+                return remove(heads[pri].get());
+            }
+
+            /*! \brief Get the highest priority of a queued thread, -1 if empty. */
+            int highest_priority() const {
+                if (!priority_bitmap) {
+                    return -1;
+                }
+
+                return common::find_most_significant_bit(priority_bitmap);
+            }
+
+            std::size_t size() const {
+                return count;
+            }
+
+            bool empty() const {
+                return count == 0;
+            }
+        };
+
+        using ready_queue = basic_ready_queue<thread>;
+
         class thread_scheduler {
-            std::vector<thread_ptr> waiting_threads;
-            eka2l1::cp_queue<thread_ptr, thread_comparator> ready_threads;
+            std::size_t waiting_count = 0;
+            ready_queue ready_threads;
 
             thread_ptr crr_thread;
             process_ptr crr_process;
@@ -76,6 +215,8 @@ namespace eka2l1 {
 
             void switch_context(thread_ptr oldt, thread_ptr newt);
 
+            bool is_time_slice_expired(const thread_ptr &thr);
+
         public:
             // The constructor also register all the needed event
             thread_scheduler(kernel_system *kern, timing_system *sys, arm::arm_interface &jitter);
@@ -93,10 +234,11 @@ namespace eka2l1 {
 
             bool stop(thread_ptr thr);
 
-            void refresh();
+            /*! \brief Move a ready thread to the list of its new priority. */
+            void requeue(thread *thr);
 
             bool should_terminate() {
-                return waiting_threads.empty()
+                return (waiting_count == 0)
                     && ready_threads.empty() && !crr_thread;
             }
 
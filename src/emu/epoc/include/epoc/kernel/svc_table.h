@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace eka2l1 {
+    class system;
+}
+
+namespace eka2l1::hle {
+    using import_func_ptr = void (*)(system *);
+
+    struct epoc_import_func {
+        import_func_ptr func;
+        std::string name;
+    };
+
+    using func_map = std::unordered_map<std::uint32_t, epoc_import_func>;
+
+    /*! \brief HLE system calls, by SVC number.
+     *
+     * Slow executive calls and fast executive calls (at and above 0x00800000) each have
+     * a flat table, indexed by the low bits of the SVC number.
+     */
+    class svc_table {
+    public:
+        static constexpr std::uint32_t fast_exec_base = 0x00800000;
+        static constexpr std::size_t table_size = 0x100;
+
+    private:
+        std::array<import_func_ptr, table_size> slow_svcs {};
+        std::array<import_func_ptr, table_size> fast_svcs {};
+
+        std::array<std::uint64_t, table_size> slow_svc_counts {};
+        std::array<std::uint64_t, table_size> fast_svc_counts {};
+
+        // Names are only needed for logging and debugging
+        std::unordered_map<std::uint32_t, std::string> svc_names;
+
+        bool count_calls = false;
+
+        import_func_ptr *get_slot(const std::uint32_t svcnum);
+
+    public:
+        /*! \brief Add a SVC, replacing the one with the same number.
+         *
+         * \returns False if the number is out of the table range.
+         */
+        bool add(const std::uint32_t svcnum, const epoc_import_func &svc);
+
+        /*! \brief Remove all SVCs and their counts. */
+        void clear();
+
+        /*! \brief Count calls from now on, per SVC. */
+        void set_count_calls(const bool enable) {
+            count_calls = enable;
+        }
+
+        /*! \brief Get the name of an SVC, or nullptr if it's not registered. */
+        const std::string *get_name(const std::uint32_t svcnum) const;
+
+        /*! \brief Number of times an SVC was called, while counting was on. */
+        std::uint64_t get_call_count(const std::uint32_t svcnum) const;
+
+        /*! \brief Call an SVC.
+         *
+         * \param before_call Called with the SVC number right before the SVC, if it's registered.
+         * \returns False if the SVC is not registered.
+         */
+        template <typename F>
+        bool call(const std::uint32_t svcnum, system *sys, F before_call) {
+            const std::uint32_t idx = svcnum & ~fast_exec_base;
+
+            if (idx >= table_size) {
+                return false;
+            }
+
+            const bool fast = svcnum & fast_exec_base;
+            import_func_ptr func = fast ? fast_svcs[idx] : slow_svcs[idx];
+
+            if (!func) {
+                return false;
+            }
+
+            if (count_calls) {
+                (fast ? fast_svc_counts : slow_svc_counts)[idx]++;
+            }
+
+            before_call(svcnum);
+            func(sys);
+
+            return true;
+        }
+    };
+}
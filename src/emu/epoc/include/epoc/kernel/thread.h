@@ -32,6 +32,7 @@
 
 #include <epoc/kernel/chunk.h>
 #include <epoc/kernel/object_ix.h>
+#include <epoc/kernel/tls.h>
 
 #include <epoc/utils/reqsts.h>
 
@@ -61,6 +62,9 @@ namespace eka2l1 {
 
         class thread_scheduler;
 
+        template <typename T>
+        class basic_ready_queue;
+
         enum class thread_state {
             create,
             run,
@@ -93,12 +97,6 @@ namespace eka2l1 {
             priority_absolute_high = 500
         };
 
-        struct tls_slot {
-            int handle = -1;
-            int uid = -1;
-            ptr<void> pointer;
-        };
-
         struct thread_local_data {
             ptr<void> heap;
             ptr<void> scheduler;
@@ -107,7 +105,7 @@ namespace eka2l1 {
 
             // We don't use this. We use our own heap
             ptr<void> tls_heap;
-            std::array<tls_slot, 50> tls_slots;
+            tls_table tls_slots;
         };
 
         struct debug_function_trace {
@@ -119,6 +117,8 @@ namespace eka2l1 {
             friend class eka2l1::kernel_system;
 
             friend class thread_scheduler;
+            template <typename T>
+            friend class basic_ready_queue;
             friend class mutex;
             friend class semaphore;
 
@@ -185,6 +185,14 @@ namespace eka2l1 {
 
             std::uint64_t create_time = 0;
 
+            // Run queue links, managed by the scheduler. The queue holds a reference through ready_next
+            thread_ptr ready_next;
+            thread *ready_prev = nullptr;
+            int ready_priority = -1;
+
+            bool in_wait_list = false;
+            std::uint64_t time_slice_start = 0;
+
             eka2l1::ptr<epoc::request_status> sleep_nof_sts;
             eka2l1::ptr<epoc::request_status> timeout_sts;
 
@@ -248,7 +256,12 @@ namespace eka2l1 {
 
             chunk_ptr get_stack_chunk();
 
+            /*! \brief Get the TLS slot of a DLL, adding it if it doesn't exist yet. */
             tls_slot *get_tls_slot(std::uint32_t handle, std::uint32_t dll_uid);
+
+            /*! \brief Get the TLS slot of a DLL, nullptr if there is none. */
+            tls_slot *find_tls_slot(std::uint32_t handle);
+
             void close_tls_slot(tls_slot &slot);
 
             void update_priority();
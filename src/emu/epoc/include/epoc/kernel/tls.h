@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <epoc/ptr.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eka2l1::kernel {
+    struct tls_slot {
+        int handle = -1;
+        int uid = -1;
+        ptr<void> pointer;
+    };
+
+    /*! \brief TLS slots of a thread, in an open addressing hash table keyed by the DLL handle.
+     *
+     * The table has no size limit, it doubles when it gets over 3/4 full. Lookups are
+     * linear probes, with the last slot found cached in front, since a DLL usually asks for
+     * its TLS many times in a row.
+     *
+     * A slot pointer is only valid until the next slot is added or removed.
+     */
+    class tls_table {
+        static constexpr std::size_t initial_capacity = 16;
+
+        // Empty slots have a handle of -1
+        std::vector<tls_slot> slots;
+        std::size_t count = 0;
+
+        // Last slot found, may be empty
+        std::size_t mru = 0;
+
+        std::size_t home_of(const int handle) const;
+
+        void grow();
+
+    public:
+        tls_table();
+
+        /*! \brief Find the slot of a DLL.
+         *
+         * \returns nullptr if the DLL has no slot.
+         */
+        tls_slot *find(const int handle);
+
+        /*! \brief Find the slot of a DLL, or add one with a null pointer. */
+        tls_slot *get_or_add(const int handle, const int uid);
+
+        /*! \brief Remove the slot of a DLL.
+         *
+         * \returns False if the DLL has no slot.
+         */
+        bool remove(const int handle);
+
+        std::size_t size() const {
+            return count;
+        }
+    };
+}
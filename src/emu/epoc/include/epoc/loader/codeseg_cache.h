@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <common/types.h>
+#include <epoc/loader/e32img.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace eka2l1::common {
+    class chunkyseri;
+}
+
+namespace eka2l1::loader {
+    /*! \brief A codeseg as it was loaded from an E32 image, relocated and with its imports resolved.
+     *
+     * Everything needed to create the codeseg again without the image: the image headers,
+     * the export directory, the DLLs imported and the content of the code and data chunks.
+    */
+    struct codeseg_cache_entry {
+        epocver epoc_ver = epocver::epoc94;
+
+        e32img_header header;
+        e32img_header_extended header_extended;
+        bool has_extended_header = false;
+
+        std::vector<std::uint32_t> export_dir;
+        std::vector<std::string> dll_names;
+
+        // Run addresses the code and data were relocated to
+        address code_addr = 0;
+        address data_addr = 0;
+
+        // Hash of the export table of each dependency, in the order they were added
+        std::vector<std::uint64_t> dependency_hashes;
+
+        const std::uint8_t *code = nullptr;
+        std::uint32_t code_size = 0;
+
+        // Initialized data then bss, as they are in the data chunk
+        const std::uint8_t *data = nullptr;
+        std::uint32_t data_size = 0;
+
+        // Offset of the code in the cache file, the data follows
+        std::uint32_t payload_offset = 0;
+
+        // Cache file the code and data point to, if it was loaded from one
+        void *file_map = nullptr;
+        std::size_t file_map_size = 0;
+
+        codeseg_cache_entry() = default;
+        ~codeseg_cache_entry();
+
+        codeseg_cache_entry(const codeseg_cache_entry &) = delete;
+        codeseg_cache_entry &operator=(const codeseg_cache_entry &) = delete;
+
+        /*! \brief Serialize everything but the code and the data. */
+        bool do_state(common::chunkyseri &seri);
+    };
+
+    using codeseg_cache_entry_ptr = std::shared_ptr<codeseg_cache_entry>;
+
+    /*! \brief Make an image to load the cached codeseg from.
+     *
+     * The image has the headers, the export directory and the import DLL names, but no data.
+    */
+    e32img make_e32img_from_cache(codeseg_cache_entry_ptr entry);
+
+    /*! \brief Cache of loaded codesegs on the host disk.
+     *
+     * Entries are named after the hash of the image file and the EPOC version. The cache keeps
+     * an index from image path to hash, with the file size and last write time to tell if the
+     * image changed, so the image doesn't have to be read to find its entry.
+     *
+     * Entry files are mapped in memory. The code and data are copied out of the mapping as they
+     * are, with no parsing, decompression or relocation.
+    */
+    class codeseg_cache {
+        struct source_info {
+            std::uint64_t size;
+            std::uint64_t last_write;
+            std::uint64_t hash;
+        };
+
+        std::string folder;
+
+        // By lowercase guest path of the image
+        std::unordered_map<std::string, source_info> sources;
+        bool sources_changed = false;
+
+        std::string get_entry_path(const std::uint64_t hash, const epocver ver) const;
+        std::string get_index_path() const;
+
+        void load_index();
+
+    public:
+        explicit codeseg_cache(const std::string &folder);
+        ~codeseg_cache();
+
+        /*! \brief Write the index to disk, if it changed. */
+        void flush();
+
+        /*! \brief Find the entry of an image.
+         *
+         * \param path       Guest path of the image.
+         * \param size       Current size of the image file.
+         * \param last_write Current last write time of the image file.
+         *
+         * \returns nullptr if there is no entry, or the image changed since it was stored.
+        */
+        codeseg_cache_entry_ptr find(const std::string &path, const std::uint64_t size,
+            const std::uint64_t last_write, const epocver ver);
+
+        /*! \brief Write an entry to disk, replacing the one of the same image if there is.
+         *
+         * \param content_hash Hash of the content of the image file.
+        */
+        bool store(const std::string &path, const std::uint64_t size, const std::uint64_t last_write,
+            const std::uint64_t content_hash, codeseg_cache_entry &entry);
+    };
+}
@@ -43,8 +43,14 @@ namespace eka2l1 {
 
     using chunk_ptr = std::shared_ptr<kernel::chunk>;
 
+    namespace common {
+        class ibytepair_stream;
+    }
+
     /*! \brief Contains the loader for E32Image, ROMImage, SIS. */
     namespace loader {
+        struct codeseg_cache_entry;
+
         enum class e32_cpu : uint16_t {
             x86 = 0x1000,
             armv4 = 0x2000,
@@ -184,6 +190,13 @@ namespace eka2l1 {
 
             std::vector<char> data;
             uint32_t uncompressed_size;
+
+            // Code is relocated and copied to the code chunk a page at a time, when touched
+            bool demand_paged = false;
+
+            // Compressed code of a bytepair image parsed for demand paging, with the index table read.
+            // Only the code pages the loader needs (import address table, export directory) are in data.
+            std::shared_ptr<common::ibytepair_stream> code_pages;
             e32_import_section import_section;
 
             e32_reloc_section code_reloc_section;
@@ -198,6 +211,9 @@ namespace eka2l1 {
             bool has_extended_header = false;
 
             std::vector<std::string> dll_names;
+
+            // Set if the image was made from the codeseg cache, and has no data
+            std::shared_ptr<codeseg_cache_entry> cache_entry;
         };
 
         enum class relocation_type : uint16_t {
@@ -208,7 +224,9 @@ namespace eka2l1 {
         };
 
         /*! \brief Parse an E32 Image. 
-		 * \param ef The file opened from io_system. */
-        std::optional<e32img> parse_e32img(symfile ef, bool read_reloc = true);
+		 * \param ef The file opened from io_system.
+         * \param demand_paged Parse for the code to be loaded on demand. The code of bytepair
+         *                     images is left compressed, to be decompressed a page at a time. */
+        std::optional<e32img> parse_e32img(symfile ef, bool read_reloc = true, bool demand_paged = false);
     }
 }
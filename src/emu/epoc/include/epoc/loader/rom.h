@@ -21,8 +21,10 @@
 #pragma once
 
 #include <common/types.h>
+#include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
 namespace eka2l1 {
@@ -126,62 +128,35 @@ namespace eka2l1 {
             uint64_t lang;
         };
 
-        struct rom_entry;
-
-        struct rom_dir {
-            int size;
-            utf16_str name;
-
-            std::vector<rom_entry> entries;
-
-            // Subdirs filtering
-            std::vector<rom_dir> subdirs;
-        };
-
         struct rom_entry {
             uint32_t size;
             uint32_t address_lin;
             uint8_t attrib;
-            uint8_t name_len;
             utf16_str name;
-
-            // If the entry is really pointed to a directory entry
-            // this will provide it
-            std::optional<rom_dir> dir;
-        };
-
-        struct rom_dir_sort_info {
-            uint16_t subdir_count;
-            uint16_t file_count;
-
-            uint16_t *entry_offset;
-        };
-
-        struct root_dir {
-            uint32_t hardware_variant;
-            address addr_lin;
-
-            rom_dir dir;
-        };
-
-        struct root_dir_list {
-            int num_root_dirs;
-            std::vector<root_dir> root_dirs;
-
-            root_dir &operator[](uint32_t idx) {
-                return root_dirs[idx];
-            }
         };
 
         struct rom {
             rom_header header;
             rom_section_header section_header;
 
-            FILE *handler;
-
-            root_dir_list root;
+            // Files of the ROM, by path from the root folder, lowercase and with backslashes
+            // (for example sys\bin\euser.dll)
+            std::unordered_map<utf16_str, rom_entry> entries;
         };
 
-        std::optional<rom> load_rom(const std::string &path);
+        /*! \brief Parse a ROM from memory.
+         *
+         * \param data Host memory of the ROM, as mapped by memory_system::open_rom.
+         * \param size Size of the ROM.
+        */
+        std::optional<rom> load_rom(const std::uint8_t *data, const std::size_t size);
+
+        /*! \brief Find a file in the ROM.
+         *
+         * \param path Path of the file, case-insensitive. A drive is ignored.
+         *
+         * \returns nullptr if the ROM has no such file.
+        */
+        const rom_entry *find_rom_entry(const rom &romf, const utf16_str &path);
     }
 }
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <epoc/address_space.h>
 #include <epoc/page_table.h>
 
 #include <array>
 #include <functional>
+#include <map>
 #include <memory>
+#include <string>
 
 namespace eka2l1 {
     class system;
@@ -17,17 +20,24 @@ namespace eka2l1 {
         using jitter = std::unique_ptr<arm_interface>;
     }
 
+    /*! \brief Fill a reserved page on its first access.
+     *
+     * \param page_addr Guest address of the page.
+     * \returns True if the page was committed.
+    */
+    using page_fault_handler = std::function<bool(const address page_addr)>;
+
     class memory_system {
         friend class system;
 
-        page_table *current_page_table = nullptr;
-        page_table *previous_page_table = nullptr;
+        address_space *current_addr_space = nullptr;
 
-        std::array<page, shared_data_section_max_number_entries> global_pages;
-        std::array<std::uint8_t *, shared_data_section_max_number_entries> global_pointers;
+        // Cached page table of the current address space
+        page_table *current_page_table = nullptr;
 
-        std::array<page, code_seg_section_number_entries> codeseg_pages;
-        std::array<std::uint8_t *, code_seg_section_number_entries> codeseg_pointers;
+        // Holds the shared data, code segment and ROM sections. Every process table
+        // is attached to it, so those leaves are shared by reference.
+        page_table global_table{ 0x1000 };
 
         std::size_t rom_size;
 
@@ -40,25 +50,125 @@ namespace eka2l1 {
         uint32_t shared_addr;
         uint32_t shared_size;
 
-        void *rom_map;
+        void *rom_map = nullptr;
+        std::string rom_path;
+
+        // Set once the ROM is mapped to the guest, it may only be open on the host before that
+        bool rom_mapped = false;
 
         arm::arm_interface *cpu;
 
+        struct page_fault_range {
+            std::uint32_t size;
+            page_fault_handler handler;
+        };
+
+        // Reserved ranges filled on first access, by start address
+        std::map<address, page_fault_range> fault_ranges;
+
+        // Bounds of all the fault ranges, so other addresses skip the lookup
+        address fault_begin = 0;
+        address fault_end = 0;
+
+        bool may_fault(const address addr, const std::uint32_t size) const {
+            return (addr < fault_end) && (static_cast<std::uint64_t>(addr) + size > fault_begin);
+        }
+
+        /*! \brief Get the table describing an address.
+         *
+         * Global sections are in the global table, while everything else is in the
+         * current process's table.
+        */
+        page_table *get_page_table_from_addr(const address addr);
+
+        /*! \brief Table used for accessing memory, the global table if there is no address space yet. */
+        page_table *get_access_page_table() {
+            return current_page_table ? current_page_table : &global_table;
+        }
+
+        /*! \brief Record a committed range to the current address space if the range is local. */
+        void track_local_range(page_table *table, const address addr, const std::uint32_t size,
+            std::uint8_t *host, const prot protection);
+
+        void untrack_local_range(page_table *table, const address addr, const std::uint32_t size);
+
     public:
         void init(arm::jitter &jit, uint32_t code_ram_addr,
             uint32_t shared_addr, uint32_t shared_size);
 
         void shutdown();
 
+        /*! \brief Map a ROM file to host memory, without mapping it to the guest.
+         *
+         * This is to parse the ROM where it will live, before it's known where it's mapped to.
+        */
+        bool open_rom(const std::string &path);
+
+        /*! \brief Map a ROM file to the guest, reusing the host mapping of open_rom if it's the same file. */
         bool map_rom(uint32_t addr, const std::string &path);
 
+        /*! \brief Get the host memory of the ROM opened, nullptr if there is none. */
+        const std::uint8_t *get_rom_host_data() const {
+            return reinterpret_cast<const std::uint8_t *>(rom_map);
+        }
+
+        std::size_t get_rom_host_size() const {
+            return rom_map ? rom_size : 0;
+        }
+
+        /*! \brief Check if an address belongs to a section shared by all address spaces. */
+        bool is_global_addr(const address addr) const;
+
         page_table *get_current_page_table() const;
-        void set_current_page_table(page_table &table);
+
+        address_space *get_current_address_space() const;
+
+        /*! \brief Switch to another address space.
+         *
+         * Global sections are shared, so this only swaps the page table and remaps
+         * local ranges that are different between the two address spaces.
+        */
+        void set_current_address_space(address_space &space);
+
+        page_table *get_global_page_table() {
+            return &global_table;
+        }
+
+        /*! \brief Call a handler when a reserved page of a range is accessed.
+         *
+         * The handler is expected to commit the page. Accesses through the memory system,
+         * and the CPU through its memory callbacks, are retried after the handler returns.
+         * Ranges must not overlap.
+        */
+        void add_page_fault_handler(const address addr, const std::uint32_t size, page_fault_handler handler);
+
+        void remove_page_fault_handler(const address addr);
+
+        /*! \brief Call the fault handlers of the reserved pages in a guest range.
+         *
+         * \returns True if any page was committed, so the access can be retried.
+        */
+        bool handle_page_fault(const address addr, const std::uint32_t size = 1);
 
         void *get_real_pointer(address addr);
 
         bool read(address addr, void *data, uint32_t size);
-        bool write(address addr, void *data, uint32_t size);
+        bool write(address addr, const void *data, uint32_t size);
+
+        /*! \brief Read a guest range that may cross page and chunk boundaries.
+         *
+         * Data is copied with one memcpy per run of host contiguous memory.
+        */
+        bool read_span(address addr, void *data, uint32_t size);
+
+        /*! \brief Write a guest range that may cross page and chunk boundaries. */
+        bool write_span(address addr, const void *data, uint32_t size);
+
+        /*! \brief Copy between two guest ranges of the current address space. */
+        bool copy(address dest, address source, uint32_t size);
+
+        /*! \brief Walk a guest range of the current address space as contiguous host spans. */
+        host_span_iterator get_host_spans(address addr, uint32_t size);
 
         template <typename T>
         T read(address addr) {
@@ -4,6 +4,7 @@
 #include <common/types.h>
 
 #include <array>
+#include <bitset>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -38,7 +39,13 @@ enum : uint32_t {
     page_bits = 12,
     page_table_number_entries = 1 << (32 - page_bits),
     shared_data_section_max_number_entries = shared_data_section_size_max / page_size,
-    code_seg_section_number_entries = code_seg_section_size / page_size
+    code_seg_section_number_entries = code_seg_section_size / page_size,
+
+    // Same split as the ARM MMU: a leaf describes one 1MB section
+    page_leaf_bits = 8,
+    page_leaf_number_entries = 1 << page_leaf_bits,
+    page_leaf_size = page_leaf_number_entries * page_size,
+    page_directory_number_entries = page_table_number_entries >> page_leaf_bits
 };
 
 namespace eka2l1 {
@@ -56,18 +63,145 @@ namespace eka2l1 {
         prot page_protection;
     };
 
+    /*! \brief Second level of the page table, describes one 1MB section. */
+    struct page_table_leaf {
+        std::array<std::uint8_t *, page_leaf_number_entries> pointers;
+        std::array<page, page_leaf_number_entries> pages;
+
+        // One bit per page which is not free, to search free ranges a word at a time
+        std::array<std::uint64_t, page_leaf_number_entries / 64> used_bitmap;
+        std::uint32_t used_count;
+
+        page_table_leaf();
+    };
+
+    /*! \brief A run of guest memory which is contiguous in host memory. */
+    struct host_span {
+        address addr;
+        std::uint8_t *host;
+        std::uint32_t size;
+    };
+
+    struct page_table;
+
+    /*! \brief Walk a guest range as contiguous host spans.
+     *
+     * Consecutive committed pages are merged into one span as long as their host memory
+     * follows each other, so a range inside one chunk is usually a single span.
+     */
+    class host_span_iterator {
+        page_table *table;
+        address addr;
+        std::uint32_t remaining;
+
+    public:
+        explicit host_span_iterator(page_table *table, const address addr, const std::uint32_t size);
+
+        /*! \brief Get the next span.
+         *
+         * \returns False if the whole range was walked, or the next page is not committed.
+        */
+        bool next(host_span &span);
+
+        /*! \brief Check if the whole range has been walked. */
+        bool finished() const {
+            return remaining == 0;
+        }
+    };
+
+    /*! \brief A sparse two-level guest page table.
+     *
+     * The directory covers the whole 4GB guest address space, and leaves are only
+     * allocated when a page inside their section is touched.
+     * 
+     * A table can be attached to a parent table (the memory system's global table).
+     * Any empty directory slot is then looked up in the parent, so leaves describing
+     * the shared data, code segment and ROM sections are shared by reference between
+     * every process, instead of being copied.
+     */
     struct page_table {
-        std::array<std::uint8_t *, page_table_number_entries> pointers;
-        std::array<page, page_table_number_entries> pages;
+        std::array<page_table_leaf *, page_directory_number_entries> leaves;
+        std::bitset<page_directory_number_entries> owned;
 
-        std::array<page, page_table_number_entries> &get_pages();
-        std::array<std::uint8_t *, page_table_number_entries> &get_pointers();
+        page_table *parent;
 
         std::mutex mut;
+        std::size_t leaf_count;
 
         int page_size;
 
-        page_table(int page_size);
+        explicit page_table(int page_size);
+        ~page_table();
+
+        page_table(const page_table &) = delete;
+        page_table &operator=(const page_table &) = delete;
+
+        /*! \brief Share all leaves of the parent table which are not presented in this table. */
+        void attach(page_table *new_parent);
+
+        /*! \brief Get the leaf describing a page.
+         *
+         * \param page_off The page index.
+         * \param create   Allocate the leaf if it is not presented.
+         * 
+         * \returns Nullptr if the leaf doesn't exist and creation is not requested.
+        */
+        page_table_leaf *get_leaf(const std::uint32_t page_off, const bool create = false);
+
+        /*! \brief Get page info of a page index. Nullptr if the page has never been touched. */
+        page *get_page_info(const std::uint32_t page_off, const bool create = false);
+
+        /*! \brief Get the host pointer slot of a page index. */
+        std::uint8_t **get_page_pointer(const std::uint32_t page_off, const bool create = false);
+
+        /*! \brief Get the host pointer to the beginning of a page. Nullptr if not mapped. */
+        std::uint8_t *get_pointer(const std::uint32_t page_off);
+
+        /*! \brief Read a guest range which may cross page and chunk boundaries.
+         *
+         * \returns False if any page in the range is not committed.
+        */
+        bool read_span(const address addr, void *dest, const std::uint32_t size);
+
+        /*! \brief Write a guest range which may cross page and chunk boundaries. */
+        bool write_span(const address addr, const void *src, const std::uint32_t size);
+
+        /*! \brief Copy between two guest ranges, without an intermediate buffer.
+         *
+         * The two ranges can be in different tables. Overlapping ranges of the same table
+         * are handled like memmove.
+        */
+        static bool copy_span(page_table &dest_table, const address dest, page_table &source_table,
+            const address source, const std::uint32_t size);
+
+        /*! \brief Mark pages as used (reserved or committed) or free in the occupancy bitmap.
+         *
+         * Leaves are allocated for pages being marked as used.
+        */
+        void mark_pages(const std::uint32_t page_off, const std::uint32_t count, const bool used);
+
+        /*! \brief Check if all pages in a range are free. */
+        bool is_range_free(const std::uint32_t page_off, const std::uint32_t count);
+
+        /*! \brief Find the highest run of free pages in a range.
+         *
+         * \param page_beg First page of the range to search.
+         * \param page_end Page after the last one of the range.
+         * \param count    Number of free pages needed.
+         * \param result   First page of the run found.
+         *
+         * \returns False if no run is large enough.
+        */
+        bool find_free_range_top_down(const std::uint32_t page_beg, const std::uint32_t page_end,
+            const std::uint32_t count, std::uint32_t &result);
+
+        /*! \brief Host memory this table uses, not counting leaves shared from parent. */
+        std::size_t get_host_memory_usage() const;
+
+        /*! \brief Host memory a flat table covering the whole address space would use. */
+        static constexpr std::size_t get_flat_host_memory_usage() {
+            return static_cast<std::size_t>(page_table_number_entries) * (sizeof(std::uint8_t *) + sizeof(page));
+        }
 
         void read(uint32_t addr, void *dest, int size);
         void write(uint32_t addr, void *src, int size);
@@ -87,4 +221,4 @@ namespace eka2l1 {
 
         void *get_ptr(vaddress addr);
     };
-}
\ No newline at end of file
+}
@@ -24,6 +24,7 @@
 #include <common/log.h>
 
 #include <epoc/ipc.h>
+#include <epoc/page_table.h>
 #include <epoc/ptr.h>
 
 #include <cstring>
@@ -74,6 +75,20 @@ namespace eka2l1 {
             */
             std::uint8_t *get_arg_ptr(int idx);
 
+            /*
+             * \brief Walk the data of an IPC descriptor argument as runs of contiguous host memory.
+             *
+             * The descriptor data may span several pages or chunks of the client.
+             * 
+             * \param size Number of bytes to walk. Must fit in the descriptor maximum length.
+            */
+            std::optional<host_span_iterator> get_arg_spans(int idx, std::uint32_t size);
+
+            /*
+             * \brief Set the length of an IPC descriptor argument, in characters.
+            */
+            bool set_arg_des_len(int idx, std::uint32_t len);
+
             bool write_arg(int idx, uint32_t data);
             bool write_arg(int idx, const std::u16string &data);
 
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <epoc/services/context.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace eka2l1::service {
+    template <typename T>
+    struct ipc_member_class;
+
+    template <typename T>
+    struct ipc_member_class<void (T::*)(ipc_context)> {
+        using type = T;
+    };
+
+    /*! \brief Call an IPC handler of a server class.
+     *
+     * One instance is generated for each handler, so the member function is called directly
+     * instead of through std::function.
+     */
+    template <typename B, auto func>
+    void ipc_handler_thunk(B *obj, ipc_context &ctx) {
+        using T = typename ipc_member_class<decltype(func)>::type;
+        (static_cast<T *>(obj)->*func)(ctx);
+    }
+
+    /*! \brief Opcode to handler table of a server.
+     *
+     * Opcodes used by real servers are small, so handlers are looked up by index. Opcodes
+     * outside the dense range go to a map. Handler names are only needed for logging,
+     * and are kept apart from the handlers.
+     */
+    template <typename B>
+    class ipc_dispatch_table {
+    public:
+        using handler = void (*)(B *obj, ipc_context &ctx);
+
+        // Negative opcodes are connect and disconnect
+        static constexpr int first_dense_opcode = -2;
+        static constexpr int last_dense_opcode = 0x3FF;
+
+    private:
+        std::vector<handler> dense;
+        std::unordered_map<int, handler> sparse;
+
+        std::unordered_map<int, std::string> names;
+
+    public:
+        /*! \brief Add a handler for an opcode.
+         * \returns False if the opcode already has a handler, which is kept.
+        */
+        bool add(const int opcode, handler func, const std::string &name) {
+            if (get(opcode)) {
+                return false;
+            }
+
+            if (opcode >= first_dense_opcode && opcode <= last_dense_opcode) {
+                const std::size_t idx = static_cast<std::size_t>(opcode - first_dense_opcode);
+
+                if (dense.size() <= idx) {
+                    dense.resize(idx + 1, nullptr);
+                }
+
+                dense[idx] = func;
+            } else {
+                sparse.emplace(opcode, func);
+            }
+
+            names.emplace(opcode, name);
+            return true;
+        }
+
+        handler get(const int opcode) const {
+            // Wraps around for opcodes below the dense range
+            const std::size_t idx = static_cast<unsigned int>(opcode) - static_cast<unsigned int>(first_dense_opcode);
+
+            if (idx < dense.size()) {
+                return dense[idx];
+            }
+
+            if (sparse.empty()) {
+                return nullptr;
+            }
+
+            auto ite = sparse.find(opcode);
+            return (ite == sparse.end()) ? nullptr : ite->second;
+        }
+
+        std::string get_name(const int opcode) const {
+            auto ite = names.find(opcode);
+            return (ite == names.end()) ? std::string() : ite->second;
+        }
+    };
+}
@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include <epoc/services/property.h>
+
 namespace eka2l1 {
     class system;
 
@@ -27,4 +29,26 @@ namespace eka2l1 {
         /*! \brief Initialize all services and properties. */
         void init_services(system *sys);
     }
-}
\ No newline at end of file
+}
+
+// Create a property, indexed by category and key, and give it its initial value.
+// The _D variants declare the prop variable the others reuse.
+#define DEFINE_INT_PROP_D(sys, category, key, data)                                                         \
+    eka2l1::property_ptr prop = sys->get_kernel_system()->create<eka2l1::service::property>(category, key); \
+    prop->define(eka2l1::service::property_type::int_data, 0);                                              \
+    prop->set_int(data);
+
+#define DEFINE_INT_PROP(sys, category, key, data)                                      \
+    prop = sys->get_kernel_system()->create<eka2l1::service::property>(category, key); \
+    prop->define(eka2l1::service::property_type::int_data, 0);                         \
+    prop->set_int(data);
+
+#define DEFINE_BIN_PROP_D(sys, category, key, size, data)                                                   \
+    eka2l1::property_ptr prop = sys->get_kernel_system()->create<eka2l1::service::property>(category, key); \
+    prop->define(eka2l1::service::property_type::bin_data, size);                                           \
+    prop->set(data);
+
+#define DEFINE_BIN_PROP(sys, category, key, size, data)                                \
+    prop = sys->get_kernel_system()->create<eka2l1::service::property>(category, key); \
+    prop->define(eka2l1::service::property_type::bin_data, size);                      \
+    prop->set(data);
@@ -26,6 +26,7 @@
 
 #include <array>
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace eka2l1 {
@@ -66,7 +67,7 @@ namespace eka2l1 {
             } subscribe_request;
 
         public:
-            property(kernel_system *kern);
+            explicit property(kernel_system *kern, const int category = 0, const int key = 0);
 
             void define(service::property_type pt, uint32_t pre_allocated);
 
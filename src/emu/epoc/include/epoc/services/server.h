@@ -20,8 +20,10 @@
 
 #pragma once
 
+#include <epoc/kernel/hle_dispatch.h>
 #include <epoc/kernel/kernel_obj.h>
 #include <epoc/services/context.h>
+#include <epoc/services/dispatch.h>
 #include <epoc/services/session.h>
 
 #include <epoc/utils/reqsts.h>
@@ -33,9 +35,8 @@
 
 #include <memory>
 
-#define REGISTER_IPC(server, func, op, func_name) \
-    register_ipc_func(op,                         \
-        service::ipc_func(func_name, std::bind(&server::func, this, std::placeholders::_1)));
+#define REGISTER_IPC(svr_class, func, op, func_name) \
+    register_ipc_func(op, &service::ipc_handler_thunk<service::server, &svr_class::func>, func_name);
 
 namespace eka2l1 {
     class system;
@@ -46,18 +47,8 @@ namespace eka2l1 {
     namespace service {
         struct server_msg;
 
-        using ipc_func_wrapper = std::function<void(ipc_context)>;
-        using ipc_msg_ptr = std::shared_ptr<ipc_msg>;
-
-        /*! \brief A class represents an IPC function */
-        struct ipc_func {
-            ipc_func_wrapper wrapper;
-            std::string name;
-
-            ipc_func(std::string iname, ipc_func_wrapper wr)
-                : name(std::move(iname))
-                , wrapper(wr) {}
-        };
+        class server;
+        using ipc_func = ipc_dispatch_table<server>::handler;
 
         /*! \brief A class represents server message. 
          *
@@ -88,6 +79,11 @@ namespace eka2l1 {
          *  After messages were received, they will be processed by the fake HLE server and signal request semaphore of the client thread.
         */
         class server : public kernel::kernel_obj {
+            friend class eka2l1::kernel_system;
+
+            template <typename T>
+            friend class kernel::basic_hle_dispatch_queue;
+
         protected:
             system *sys;
 
@@ -95,10 +91,10 @@ namespace eka2l1 {
             /** All the sessions connected to this server */
             std::vector<session *> sessions;
 
-            /** Messages that has been delivered but not accepted yet */
-            std::vector<server_msg> delivered_msgs;
+            /** Messages that has been delivered but not accepted yet, oldest first */
+            ipc_msg_queue delivered_msgs;
 
-            std::unordered_map<int, ipc_func> ipc_funcs;
+            ipc_dispatch_table<server> ipc_funcs;
 
             /** The thread own this server */
             thread_ptr owning_thread;
@@ -117,6 +113,12 @@ namespace eka2l1 {
             bool hle = false;
             bool unhandle_callback_enable = false;
 
+            // Read once from the config, it's checked on every message
+            bool log_ipc = false;
+
+            // In the kernel's ready list
+            bool dispatch_pending = false;
+
         protected:
             bool is_msg_delivered(ipc_msg_ptr &msg);
             bool ready();
@@ -149,15 +151,15 @@ namespace eka2l1 {
             /*! Deliver the message to the server. Message will be put in queue if it's not ready. */
             int deliver(server_msg msg);
 
-            /*! Cancel a message in the delivered queue */
-            int cancel();
+            /*! Cancel a message in the delivered queue, by its ID */
+            int cancel(const std::uint32_t msg_id);
 
             void receive_async_lle(eka2l1::ptr<epoc::request_status> request_status,
                 eka2l1::ptr<message2> data);
 
             void cancel_async_lle();
 
-            void register_ipc_func(uint32_t ordinal, ipc_func func);
+            void register_ipc_func(const int ordinal, ipc_func func, const std::string &name);
 
             /*! Process an message asynchrounously */
             void process_accepted_msg();
@@ -165,6 +167,10 @@ namespace eka2l1 {
             bool is_hle() const {
                 return hle;
             }
+
+            bool has_pending_msgs() const {
+                return !delivered_msgs.empty();
+            }
         };
     }
 }
\ No newline at end of file
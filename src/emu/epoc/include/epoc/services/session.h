@@ -50,9 +50,13 @@ namespace eka2l1 {
         class session : public kernel::kernel_obj {
             server_ptr svr;
 
-            std::vector<std::pair<bool, ipc_msg_ptr>> msgs_pool;
+            // Messages reserved for async requests. Null if the session shares the global pool.
+            std::unique_ptr<ipc_msg_pool> msgs_pool;
             uint32_t cookie_address;
 
+            // Set by the kernel on creation, so sending doesn't need to look the session up
+            std::weak_ptr<session> self;
+
         protected:
             int send(ipc_msg_ptr &msg);
             ipc_msg_ptr get_free_msg();
@@ -65,7 +69,9 @@ namespace eka2l1 {
                 return svr;
             }
 
-            void prepare_destroy();
+            void set_self(const std::shared_ptr<session> &ss) {
+                self = ss;
+            }
 
             int send_receive_sync(int function, ipc_arg args, eka2l1::ptr<epoc::request_status> request_sts);
             int send_receive(int function, ipc_arg args, eka2l1::ptr<epoc::request_status> request_sts);
@@ -73,8 +79,6 @@ namespace eka2l1 {
             void set_cookie_address(const uint32_t addr) {
                 cookie_address = addr;
             }
-
-            void set_slot_free(ipc_msg_ptr &msg);
         };
     }
 }
\ No newline at end of file
@@ -19,9 +19,16 @@
  */
 #pragma once
 
+#include <common/queue.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace eka2l1 {
@@ -35,6 +42,13 @@ namespace eka2l1 {
         INITIAL_SLICE_LENGTH = 20000
     };
 
+    /*! \brief How the guest clock is paced against the host clock while the guest idles. */
+    enum class pacing_mode {
+        turbo, ///< Jump straight to the next event, never sleep
+        real_time, ///< Sleep until the next event is due on the host clock
+        scaled ///< Like real-time, with the guest clock running N times the host's speed
+    };
+
     struct event_type {
         timed_callback callback;
         std::string name;
@@ -46,6 +60,95 @@ namespace eka2l1 {
         uint64_t event_user_data;
     };
 
+    /*! \brief Event posted from another thread, scheduled when the emulation thread drains it. */
+    struct posted_event {
+        int event_type;
+        int64_t cycles_into_future;
+        uint64_t event_user_data;
+    };
+
+    /*! \brief Handle to a scheduled event.
+     *
+     * Stays valid until the event is fired or unscheduled, and is never reused for another event.
+     */
+    using event_handle = std::uint64_t;
+
+    constexpr event_handle invalid_event_handle = 0;
+
+    /*! \brief Queue of scheduled events, earliest first.
+     *
+     * Events live in a slot pool and are ordered with a 4-ary min-heap of slot indexes, so
+     * scheduling and cancelling are O(log n). Events with the same time fire in the order they
+     * were scheduled.
+     */
+    class event_queue {
+        struct slot {
+            event evt;
+
+            // Tie-break for events with the same time
+            std::uint64_t order;
+
+            std::uint32_t heap_pos;
+            std::uint32_t generation;
+        };
+
+        static constexpr std::uint32_t heap_arity = 4;
+
+        std::vector<slot> slots;
+        std::vector<std::uint32_t> free_slots;
+        std::vector<std::uint32_t> heap;
+
+        // Userdata to slot, to find events the old way (event type + userdata)
+        std::unordered_multimap<std::uint64_t, std::uint32_t> userdata_index;
+
+        std::uint64_t order_counter = 0;
+
+        bool is_before(const std::uint32_t lhs, const std::uint32_t rhs) const;
+        void sift_up(std::uint32_t pos);
+        void sift_down(std::uint32_t pos);
+
+        void unindex(const std::uint32_t slot_idx);
+        void remove_at(const std::uint32_t pos);
+
+        slot *get_slot(const event_handle handle);
+
+    public:
+        event_handle push(const event &evt);
+
+        /*! \brief Remove an event. Returns false if the handle is no longer valid. */
+        bool remove(const event_handle handle);
+
+        /*! \brief Find an event by type and userdata. */
+        event_handle find(const int event_type, const std::uint64_t userdata);
+
+        /*! \brief Change the userdata of an event, keeping its place in the queue. */
+        bool set_userdata(const event_handle handle, const std::uint64_t new_userdata);
+
+        const event &top() const {
+            return slots[heap.front()].evt;
+        }
+
+        void pop() {
+            remove_at(0);
+        }
+
+        bool empty() const {
+            return heap.empty();
+        }
+
+        std::size_t size() const {
+            return heap.size();
+        }
+
+        void clear();
+
+        /*! \brief Get all events, sorted from the latest to the earliest. */
+        std::vector<event> get_sorted_events() const;
+
+        /*! \brief Get all events of a type, in no particular order. */
+        std::vector<event_handle> find_all(const int event_type) const;
+    };
+
     namespace common {
         class chunkyseri;
     }
@@ -67,9 +170,34 @@ namespace eka2l1 {
         std::vector<mhz_change_callback> internal_mhzcs;
 
         std::vector<event_type> event_types;
-        std::vector<event> events, ts_events;
+
+        event_queue events;
+
+        // Events from other threads, drained on advance
+        mpsc_queue<posted_event> ts_events;
+
+        pacing_mode pacing;
+        double pacing_speed;
+
+        // Guest ticks at host_anchor, the point where both clocks were last in sync
+        std::chrono::steady_clock::time_point host_anchor;
+        uint64_t guest_anchor;
+        uint64_t host_idle_us;
+
+        // Lets a posted event wake up an idle emulation thread early
+        std::mutex idle_lock;
+        std::condition_variable idle_cv;
+        std::atomic<bool> idle_waiting{ false };
 
         void fire_mhz_changes();
+        void sync_host_clock();
+
+        /*! \brief Sleep until the given guest tick is due on the host clock.
+         *
+         * \returns The guest tick reached. It is earlier than the target if a posted
+         *          event woke the thread up.
+        */
+        uint64_t wait_for_ticks(const uint64_t target);
 
     public:
         inline int64_t ms_to_cycles(int ms) {
@@ -116,7 +244,16 @@ namespace eka2l1 {
         void shutdown();
 
         uint64_t get_ticks();
+
+        /*! \brief Get the number of guest ticks spent idling, in any pacing mode. */
         uint64_t get_idle_ticks();
+
+        /*! \brief Get the fraction of guest time spent idling, from 0 to 1. */
+        double get_idle_ratio();
+
+        /*! \brief Get the host time slept while pacing, in microseconds. */
+        uint64_t get_host_idle_us();
+
         uint64_t get_global_time_us();
 
         int register_event(const std::string &name, timed_callback callback);
@@ -127,10 +264,20 @@ namespace eka2l1 {
 
         // Swap userdata, returns doing nothing if event is not present
         void swap_userdata_event(int event_type, std::uint64_t old_userdata, std::uint64_t new_userdata);
-
-        void schedule_event(int64_t cycles_into_future, int event_type, uint64_t userdata = 0);
-        void schedule_event_imm(int event_type, uint64_t userdata = 0);
+        void swap_userdata_event(event_handle handle, std::uint64_t new_userdata);
+
+        event_handle schedule_event(int64_t cycles_into_future, int event_type, uint64_t userdata = 0);
+        event_handle schedule_event_imm(int event_type, uint64_t userdata = 0);
+
+        /*! \brief Schedule an event from a thread other than the emulation thread.
+         *
+         * Driver, debugger and host I/O threads use this to complete guest requests. The event
+         * is scheduled relative to the guest time when the emulation thread next advances.
+         * All other scheduling functions must be called from the emulation thread.
+        */
+        void schedule_event_thread_safe(int64_t cycles_into_future, int event_type, uint64_t userdata = 0);
         void unschedule_event(int event_type, uint64_t userdata);
+        void unschedule_event(event_handle handle);
 
         void remove_event(int event_type);
         void remove_all_events(int event_type);
@@ -141,7 +288,28 @@ namespace eka2l1 {
 
         void force_check();
 
+        /*! \brief Idle until the next event is due.
+         *
+         * Guest time skips to the next event, or the end of the slice if there is none.
+         * Outside turbo mode, the host thread sleeps until that point is due on the host clock.
+         *
+         * \param max_idle Maximum number of ticks to idle, 0 for no limit.
+        */
         void idle(int max_idle = 0);
+
+        /*! \brief Set how guest time is paced while idling.
+         *
+         * \param speed Guest clock speed relative to the host clock, used in scaled mode.
+        */
+        void set_pacing_mode(const pacing_mode mode, const double speed = 1.0);
+
+        pacing_mode get_pacing_mode() const {
+            return pacing;
+        }
+
+        double get_pacing_speed() const {
+            return pacing_speed;
+        }
         void clear_pending_events();
         void log_pending_events();
 
@@ -78,6 +78,21 @@ namespace eka2l1::epoc {
 
         void *get_pointer_raw(eka2l1::process_ptr pr);
 
+        /*! \brief Get the guest address of the descriptor data.
+         *
+         * \param self Guest address of this descriptor.
+        */
+        address get_pointer_address(eka2l1::process_ptr pr, const address self);
+
+        /*! \brief Copy data to the descriptor buffer, one run of contiguous host memory at a time.
+         *
+         * Unlike writing through get_pointer_raw, the buffer may cross page and chunk boundaries.
+         * 
+         * \returns False if part of the buffer is not committed.
+        */
+        bool write_data(eka2l1::process_ptr pr, const address self, const std::uint8_t *data,
+            const std::uint32_t size);
+
         int assign_raw(eka2l1::process_ptr pr, const std::uint8_t *data,
             const std::uint32_t size);
 
@@ -128,6 +143,30 @@ namespace eka2l1::epoc {
             return 0;
         }
 
+        /*! \brief Assign data to a descriptor whose guest address is known.
+         *
+         * Safe for a buffer spanning multiple pages or chunks.
+        */
+        int assign(eka2l1::process_ptr pr, const address self, const std::uint8_t *data,
+            const std::uint32_t size) {
+            des_type dtype = get_descriptor_type();
+            std::uint32_t real_len = size / sizeof(T);
+
+            if (size > 0) {
+                if ((dtype == buf) || (dtype == ptr) || (dtype == ptr_to_buf)) {
+                    if (real_len > get_max_length(pr)) {
+                        return des_err_not_large_enough_to_hold;
+                    }
+                }
+
+                write_data(pr, self, data, size);
+            }
+
+            set_length(pr, real_len);
+
+            return 0;
+        }
+
         int assign(eka2l1::process_ptr pr, const std::basic_string<T> &buf) {
             return assign(pr, reinterpret_cast<const std::uint8_t *>(&buf[0]),
                 static_cast<std::uint32_t>(buf.size() * sizeof(T)));
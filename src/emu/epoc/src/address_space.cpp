@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <epoc/address_space.h>
+
+#include <atomic>
+
+namespace eka2l1 {
+    // ID 0 is reserved for no address space
+    static std::atomic<std::uint32_t> address_space_id_counter{ 1 };
+
+    address_space::address_space(page_table *global_table, int page_size)
+        : table(page_size)
+        , id(address_space_id_counter++) {
+        table.attach(global_table);
+    }
+
+    void address_space::add_local_range(const address addr, const std::uint32_t size, std::uint8_t *host,
+        const prot protection) {
+        if (size == 0) {
+            return;
+        }
+
+        remove_local_range(addr, size);
+        local_ranges.emplace(addr, mapped_range{ addr, size, host, protection });
+    }
+
+    void address_space::remove_local_range(const address addr, const std::uint32_t size) {
+        const std::uint64_t end = static_cast<std::uint64_t>(addr) + size;
+        auto ite = local_ranges.lower_bound(addr);
+
+        // The range before may overlap us
+        if (ite != local_ranges.begin()) {
+            ite--;
+
+            if (static_cast<std::uint64_t>(ite->second.addr) + ite->second.size <= addr) {
+                ite++;
+            }
+        }
+
+        while (ite != local_ranges.end() && ite->second.addr < end) {
+            const mapped_range old = ite->second;
+            const std::uint64_t old_end = static_cast<std::uint64_t>(old.addr) + old.size;
+
+            ite = local_ranges.erase(ite);
+
+            // Keep the parts that are out of the removed range
+            if (old.addr < addr) {
+                local_ranges.emplace(old.addr, mapped_range{ old.addr, addr - old.addr, old.host, old.protection });
+            }
+
+            if (old_end > end) {
+                const std::uint32_t cut = static_cast<std::uint32_t>(end - old.addr);
+                ite = local_ranges.emplace(static_cast<address>(end), mapped_range{ static_cast<address>(end),
+                                                                         static_cast<std::uint32_t>(old_end - end), old.host + cut, old.protection })
+                          .first;
+
+                break;
+            }
+        }
+    }
+}
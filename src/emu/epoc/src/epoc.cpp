@@ -300,6 +300,16 @@ namespace eka2l1 {
 
         // Initialize all the system that doesn't depend on others first
         timing.init();
+
+        const std::string pacing = mngr.get_config_manager()->get_or_fall<std::string>("pacing", "turbo");
+
+        if (pacing == "realtime") {
+            timing.set_pacing_mode(pacing_mode::real_time);
+        } else if (pacing == "scaled") {
+            timing.set_pacing_mode(pacing_mode::scaled,
+                mngr.get_config_manager()->get_or_fall<int>("pacing_speed_percent", 100) / 100.0);
+        }
+
         io.init();
         asmdis.init();
 
@@ -422,7 +432,12 @@ namespace eka2l1 {
     }
 
     bool system_impl::load_rom(const std::string &path) {
-        std::optional<loader::rom> romf_res = loader::load_rom(path);
+        // Parse the ROM where it's mapped, the guest mapping reuses it once the ROM base is known
+        if (!mem.open_rom(path)) {
+            return false;
+        }
+
+        std::optional<loader::rom> romf_res = loader::load_rom(mem.get_rom_host_data(), mem.get_rom_host_size());
 
         if (!romf_res) {
             return false;
@@ -19,6 +19,10 @@
  */
 
 #include <epoc/ipc.h>
+#include <epoc/kernel/thread.h>
+#include <epoc/services/session.h>
+
+#include <utility>
 
 namespace eka2l1 {
     ipc_arg::ipc_arg(int arg0, const int aflag) {
@@ -52,4 +56,219 @@ namespace eka2l1 {
     ipc_arg_type ipc_arg::get_arg_type(int slot) {
         return static_cast<ipc_arg_type>((flag >> (slot * 3)) & 7);
     }
-}
\ No newline at end of file
+
+    void intrusive_ptr_add_ref(ipc_msg *msg) {
+        msg->ref_count++;
+    }
+
+    void intrusive_ptr_release(ipc_msg *msg) {
+        if (--msg->ref_count == 0) {
+            msg->owner_pool->release(msg);
+        }
+    }
+
+    ipc_msg_pool::ipc_msg_pool(ipc_msg_slab *slab, ipc_msg_pool *parent)
+        : slab(slab)
+        , parent(parent) {
+    }
+
+    ipc_msg_pool::~ipc_msg_pool() {
+        if (!parent) {
+            return;
+        }
+
+        for (ipc_msg *msg : reserved) {
+            msg->owner_pool = parent;
+        }
+
+        while (ipc_msg *msg = pop()) {
+            parent->push(msg);
+        }
+    }
+
+    void ipc_msg_pool::push(ipc_msg *msg) {
+        msg->next_free = free_head;
+        free_head = msg;
+        free_count++;
+    }
+
+    ipc_msg *ipc_msg_pool::pop() {
+        if (!free_head && !parent) {
+            slab->grow();
+        }
+
+        ipc_msg *msg = free_head;
+
+        if (msg) {
+            free_head = msg->next_free;
+            msg->next_free = nullptr;
+            free_count--;
+        }
+
+        return msg;
+    }
+
+    bool ipc_msg_pool::reserve(const std::size_t count) {
+        if (!parent) {
+            return false;
+        }
+
+        reserved.reserve(reserved.size() + count);
+
+        for (std::size_t i = 0; i < count; i++) {
+            ipc_msg *msg = parent->pop();
+
+            if (!msg) {
+                return false;
+            }
+
+            msg->owner_pool = this;
+            reserved.push_back(msg);
+
+            push(msg);
+        }
+
+        return true;
+    }
+
+    ipc_msg_ptr ipc_msg_pool::allocate(thread_ptr own) {
+        ipc_msg *msg = pop();
+
+        if (!msg) {
+            return nullptr;
+        }
+
+        msg->own_thr = std::move(own);
+        msg->session_ptr_lle = 0;
+        msg->request_sts = 0;
+
+        return ipc_msg_ptr(msg);
+    }
+
+    void ipc_msg_pool::release(ipc_msg *msg) {
+        if (slab->tearing_down) {
+            return;
+        }
+
+        // Dropping these may destroy a thread or a session, which releases other messages.
+        // Put the message back first, so the free list is consistent by then.
+        thread_ptr own = std::move(msg->own_thr);
+        session_ptr ss = std::move(msg->msg_session);
+
+        msg->lle_pinned = false;
+        push(msg);
+    }
+
+    ipc_msg_slab::ipc_msg_slab()
+        : root(this) {
+    }
+
+    ipc_msg_slab::~ipc_msg_slab() {
+        tearing_down = true;
+
+        for (ipc_msg *msg : msgs) {
+            msg->own_thr.reset();
+            msg->msg_session.reset();
+        }
+    }
+
+    void ipc_msg_slab::grow() {
+        std::unique_ptr<ipc_msg[]> block = std::make_unique<ipc_msg[]>(block_size);
+        const std::uint32_t base_id = static_cast<std::uint32_t>(msgs.size());
+
+        // Push in reverse, so the lowest ID is handed out first
+        for (std::size_t i = block_size; i > 0; i--) {
+            ipc_msg *msg = &block[i - 1];
+            msg->id = base_id + static_cast<std::uint32_t>(i - 1);
+            msg->owner_pool = &root;
+
+            root.push(msg);
+        }
+
+        for (std::size_t i = 0; i < block_size; i++) {
+            msgs.push_back(&block[i]);
+        }
+
+        blocks.push_back(std::move(block));
+    }
+
+    ipc_msg *ipc_msg_slab::get(const std::uint32_t id) {
+        if (id >= msgs.size() || msgs[id]->ref_count == 0) {
+            return nullptr;
+        }
+
+        return msgs[id];
+    }
+
+    ipc_msg_queue::~ipc_msg_queue() {
+        clear();
+    }
+
+    bool ipc_msg_queue::push(ipc_msg_ptr &msg) {
+        if (msg->queue) {
+            return false;
+        }
+
+        intrusive_ptr_add_ref(msg.get());
+
+        msg->queue = this;
+        msg->queue_next = nullptr;
+        msg->queue_prev = tail;
+
+        if (tail) {
+            tail->queue_next = msg.get();
+        } else {
+            head = msg.get();
+        }
+
+        tail = msg.get();
+        count++;
+
+        return true;
+    }
+
+    ipc_msg_ptr ipc_msg_queue::pop() {
+        if (!head) {
+            return nullptr;
+        }
+
+        ipc_msg_ptr msg(head);
+        remove(head);
+
+        return msg;
+    }
+
+    bool ipc_msg_queue::remove(ipc_msg *msg) {
+        if (msg->queue != this) {
+            return false;
+        }
+
+        if (msg->queue_prev) {
+            msg->queue_prev->queue_next = msg->queue_next;
+        } else {
+            head = msg->queue_next;
+        }
+
+        if (msg->queue_next) {
+            msg->queue_next->queue_prev = msg->queue_prev;
+        } else {
+            tail = msg->queue_prev;
+        }
+
+        msg->queue = nullptr;
+        msg->queue_next = nullptr;
+        msg->queue_prev = nullptr;
+
+        count--;
+
+        // Drop the reference of the queue
+        intrusive_ptr_release(msg);
+        return true;
+    }
+
+    void ipc_msg_queue::clear() {
+        while (head) {
+            remove(head);
+        }
+    }
+}
@@ -42,6 +42,7 @@
 
 #include <epoc/services/init.h>
 
+#include <manager/config_manager.h>
 #include <manager/manager.h>
 
 namespace eka2l1 {
@@ -57,6 +58,8 @@ namespace eka2l1 {
         thr_sch = std::make_shared<kernel::thread_scheduler>(this, timing, *cpu);
 
         kernel_handles = kernel::object_ix(this, kernel::handle_array_owner::kernel);
+        hle_dispatch_budget = mngr->get_config_manager()->get_or_fall<int>("hle_dispatch_budget", 32);
+
         service::init_services(sys);
     }
 
@@ -77,44 +80,45 @@ namespace eka2l1 {
     }
 
     ipc_msg_ptr kernel_system::create_msg(kernel::owner_type owner) {
-        auto slot_free = std::find_if(msgs.begin(), msgs.end(),
-            [](auto slot) { return !slot || slot->free; });
-
-        if (slot_free != msgs.end()) {
-            ipc_msg_ptr msg
-                = std::make_shared<ipc_msg>(crr_thread());
-
-            if (!*slot_free) {
-                *slot_free = std::move(msg);
-            }
+        return msgs.get_root_pool().allocate(crr_thread());
+    }
 
-            slot_free->get()->free = false;
-            slot_free->get()->id = static_cast<std::uint32_t>(slot_free - msgs.begin());
+    ipc_msg_ptr kernel_system::get_msg(int handle) {
+        return ipc_msg_ptr(msgs.get(static_cast<std::uint32_t>(handle)));
+    }
 
-            return *slot_free;
+    void kernel_system::pin_msg(ipc_msg_ptr &msg) {
+        if (!msg->lle_pinned) {
+            intrusive_ptr_add_ref(msg.get());
+            msg->lle_pinned = true;
         }
-
-        return nullptr;
     }
 
-    ipc_msg_ptr kernel_system::get_msg(int handle) {
-        if (msgs.size() <= handle) {
-            return nullptr;
+    void kernel_system::unpin_msg(ipc_msg_ptr &msg) {
+        if (msg->lle_pinned) {
+            msg->lle_pinned = false;
+            intrusive_ptr_release(msg.get());
         }
-
-        return msgs[handle];
     }
 
     bool kernel_system::destroy(kernel_obj_ptr obj) {
         SYNCHRONIZE_ACCESS;
 
+        registry.remove(obj.get());
+
+        if (obj->get_object_type() == kernel::object_type::server) {
+            auto svr = std::reinterpret_pointer_cast<service::server>(obj);
+
+            ready_servers.remove(svr.get());
+        }
+
         switch (obj->get_object_type()) {         
         #define OBJECT_SEARCH(obj_type, obj_map)                                                                                    \
             case kernel::object_type::obj_type: {                                                                                   \
                 auto res = std::lower_bound(obj_map.begin(), obj_map.end(), obj, [&](const auto &lhs, const auto &rhs) {            \
                     return lhs->unique_id() < rhs->unique_id();                                                                     \
                 });                                                                                                                 \
-                if (res == obj_map.end())                                                                                           \
+                if (res == obj_map.end() || (*res) != obj)                                                                          \
                     return false;                                                                                                   \
                 obj_map.erase(res);                                                                                                 \
                 return true;                                                                                                        \
@@ -252,32 +256,8 @@ namespace eka2l1 {
         return crr_process()->process_handles.get_object(handle);
     }
 
-    void kernel_system::free_msg(ipc_msg_ptr msg) {
-        msg->free = true;
-    }
-
-    /*! \brief Completely destroy a message. */
-    void kernel_system::destroy_msg(ipc_msg_ptr msg) {
-        (msgs.begin() + msg->id)->reset();
-    }
-
     property_ptr kernel_system::get_prop(int cagetory, int key) {
-        SYNCHRONIZE_ACCESS;
-
-        auto prop_res = std::find_if(props.begin(), props.end(),
-            [=](const auto &prop) {
-                if (prop->first == cagetory && prop->second == key) {
-                    return true;
-                }
-
-                return false;
-            });
-
-        if (prop_res == props.end()) {
-            return property_ptr(nullptr);
-        }
-
-        return *prop_res;
+        return registry.get_prop(cagetory, key);
     }
 
     kernel::handle kernel_system::mirror(thread_ptr own_thread, kernel::handle handle, kernel::owner_type owner) {
@@ -349,14 +329,21 @@ namespace eka2l1 {
         }
     }
 
-    void kernel_system::processing_requests() {
-        for (auto &svr : servers) {
-            if (svr->is_hle()) {
-                svr->process_accepted_msg();
-            }
+    void kernel_system::queue_hle_server(service::server *svr) {
+        if (svr->dispatch_pending) {
+            return;
+        }
+
+        // The queue holds a reference, so a server destroyed by its own handler stays valid
+        if (kernel_obj_ptr obj = registry.get(svr->unique_id(), kernel::object_type::server)) {
+            ready_servers.queue(std::reinterpret_pointer_cast<service::server>(obj));
         }
     }
 
+    void kernel_system::processing_requests() {
+        ready_servers.dispatch(hle_dispatch_budget);
+    }
+
     uint32_t kernel_system::next_uid() const {
         ++uid_counter;
         return uid_counter.load();
@@ -370,45 +357,32 @@ namespace eka2l1 {
     }
 
     codeseg_ptr kernel_system::pull_codeseg_by_ep(const address ep) {
-        auto res = std::find_if(codesegs.begin(), codesegs.end(), [=](const auto &cs) -> bool {
-            return cs->get_entry_point() == ep;
-        });
-
-        if (res == codesegs.end()) {
-            return nullptr;
-        }
-
-        return *res;
+        return registry.get_codeseg_by_ep(ep);
     }
     
     codeseg_ptr kernel_system::pull_codeseg_by_uids(const kernel::uid uid0, const kernel::uid uid1,
         const kernel::uid uid2) {
-        auto res = std::find_if(codesegs.begin(), codesegs.end(), [=](const auto &cs) -> bool {
-            return cs->get_uids() == std::make_tuple(uid0, uid1, uid2);
-        });
-
-        if (res == codesegs.end()) {
-            return nullptr;
-        }
-
-        return *res;
+        return registry.get_codeseg_by_uids(uid0, uid1, uid2);
     }
         
     std::optional<find_handle> kernel_system::find_object(const std::string &name, int start, kernel::object_type type) {
         find_handle handle_find_info;
-        SYNCHRONIZE_ACCESS;
         
         switch (type) {
-        #define OBJECT_SEARCH(obj_type, obj_map)                                                           \
-            case kernel::object_type::obj_type: {                                                          \
-                auto res = std::find_if(obj_map.begin() + start, obj_map.end(), [&](const auto &rhs) {     \
-                    return name == rhs->name();                                                            \
-                });                                                                                        \
-                if (res == obj_map.end())                                                                  \
-                    return std::nullopt;                                                                   \
-                handle_find_info.index = static_cast<int>(std::distance(obj_map.begin(), res));            \
-                handle_find_info.object_id = (*res)->unique_id();                                          \
-                return handle_find_info;                                                                   \
+        // The lists are sorted by ID, so the object at the start index has the lowest ID to look from.
+        // The match found by name is then positioned back in the list.
+        #define OBJECT_SEARCH(obj_type, obj_map)                                                                                    \
+            case kernel::object_type::obj_type: {                                                                                   \
+                if (start < 0 || start >= static_cast<int>(obj_map.size()))                                                         \
+                    return std::nullopt;                                                                                            \
+                kernel_obj_ptr res = registry.get_by_name(name, type, obj_map[start]->unique_id());                                 \
+                if (!res)                                                                                                           \
+                    return std::nullopt;                                                                                            \
+                auto res_ite = std::lower_bound(obj_map.begin() + start, obj_map.end(), res->unique_id(),                           \
+                    [](const auto &lhs, const kernel::uid rhs) { return lhs->unique_id() < rhs; });                                 \
+                handle_find_info.index = static_cast<int>(std::distance(obj_map.begin(), res_ite));                                 \
+                handle_find_info.object_id = res->unique_id();                                                                      \
+                return handle_find_info;                                                                                            \
             }
 
         OBJECT_SEARCH(mutex, mutexes)
@@ -455,5 +429,7 @@ namespace eka2l1 {
         if (!s) {
             return;
         }
+
+        kernel_handles.do_state(seri);
     }
 }
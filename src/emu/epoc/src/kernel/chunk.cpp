@@ -220,8 +220,8 @@ namespace eka2l1 {
 
             own_process = kern->get_by_id<kernel::process>(uid_pr);
 
-            page_table *old = mem->get_current_page_table();
-            mem->set_current_page_table(own_process->get_page_table());
+            address_space *old = mem->get_current_address_space();
+            mem->set_current_address_space(own_process->get_address_space());
 
             // Start reading
             if (seri.get_seri_mode() == common::SERI_MODE_READ) {
@@ -234,7 +234,9 @@ namespace eka2l1 {
                 seri.absorb_impl((chunk_base + static_cast<address>(i * ps)).get(mem), ps);
             }
 
-            mem->set_current_page_table(*old);
+            if (old) {
+                mem->set_current_address_space(*old);
+            }
         }
     }
 }
@@ -18,7 +18,11 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <common/algorithm.h>
+#include <common/log.h>
+
 #include <epoc/kernel/codeseg.h>
+#include <epoc/kernel/libmanager.h>
 #include <epoc/kernel.h>
 #include <algorithm>
 
@@ -54,8 +58,14 @@ namespace eka2l1::kernel {
         data_addr = info.data_load_addr;
 
         if (code_addr == 0) {
-            code_chunk = kern->create<kernel::chunk>(mem, kern->crr_process(), name, 0, code_size_align, code_size_align, prot::read_write_exec, kernel::chunk_type::normal,
-                kernel::chunk_access::code, kernel::chunk_attrib::none, false);
+            if (info.demand_paged_code) {
+                // Only reserve, pages are committed as they are touched
+                code_chunk = kern->create<kernel::chunk>(mem, kern->crr_process(), name, 0, 0, code_size_align, prot::read_write_exec, kernel::chunk_type::disconnected,
+                    kernel::chunk_access::code, kernel::chunk_attrib::none, false);
+            } else {
+                code_chunk = kern->create<kernel::chunk>(mem, kern->crr_process(), name, 0, code_size_align, code_size_align, prot::read_write_exec, kernel::chunk_type::normal,
+                    kernel::chunk_access::code, kernel::chunk_attrib::none, false);
+            }
 
             code_addr = code_chunk->base().ptr_address();
             info.code_load_addr = code_addr;
@@ -85,6 +95,69 @@ namespace eka2l1::kernel {
         }
     }
     
+    codeseg::~codeseg() {
+        if (page_loader) {
+            kern->get_memory_system()->remove_page_fault_handler(code_addr);
+        }
+
+        // Intrinsic traps of the exports, the next code at this address is unrelated
+        if (hle::lib_manager *mngr = kern->get_lib_manager()) {
+            mngr->remove_code_patches(code_addr, code_size);
+        }
+    }
+
+    std::uint32_t codeseg::get_code_page_count() const {
+        const std::uint32_t page_size = static_cast<std::uint32_t>(kern->get_memory_system()->get_page_size());
+        return (code_size + page_size - 1) / page_size;
+    }
+
+    bool codeseg::set_code_page_loader(code_page_loader loader) {
+        if (!code_chunk || code_chunk->get_chunk_type() != kernel::chunk_type::disconnected || page_loader) {
+            return false;
+        }
+
+        page_loader = std::move(loader);
+
+        memory_system *mem = kern->get_memory_system();
+        const std::uint32_t code_size_align = static_cast<std::uint32_t>(common::align(code_size, mem->get_page_size()));
+
+        mem->add_page_fault_handler(code_addr, code_size_align, [this](const address page_addr) {
+            return page_in_code(page_addr);
+        });
+
+        return true;
+    }
+
+    bool codeseg::load_code_page(const std::uint32_t page_index, std::uint8_t *dest) {
+        if (!page_loader || page_index >= get_code_page_count()) {
+            return false;
+        }
+
+        return page_loader(page_index, dest);
+    }
+
+    bool codeseg::page_in_code(const address page_addr) {
+        memory_system *mem = kern->get_memory_system();
+        const std::uint32_t page_offset = page_addr - code_addr;
+
+        if (!code_chunk->commit(page_offset, mem->get_page_size())) {
+            return false;
+        }
+
+        std::uint8_t *dest = reinterpret_cast<std::uint8_t *>(mem->get_real_pointer(page_addr));
+
+        if (!dest || !page_loader(page_offset / mem->get_page_size(), dest)) {
+            LOG_ERROR("Unable to load code page 0x{:x} of {}", page_addr, obj_name);
+
+            // Leave it reserved, rather than giving zeroes to the guest
+            code_chunk->decommit(page_offset, mem->get_page_size());
+            return false;
+        }
+
+        touched_code_pages++;
+        return true;
+    }
+
     address codeseg::lookup(const std::uint32_t ord) {
         if (ord > export_table.size()) {
             return 0;
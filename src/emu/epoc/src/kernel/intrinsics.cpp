@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <common/algorithm.h>
+#include <common/log.h>
+#include <common/memops.h>
+
+#include <epoc/epoc.h>
+#include <epoc/kernel.h>
+#include <epoc/kernel/intrinsics.h>
+#include <epoc/kernel/process.h>
+#include <epoc/kernel/scheduler.h>
+#include <epoc/kernel/thread.h>
+#include <epoc/mem.h>
+#include <epoc/utils/des.h>
+
+#include <hle/bridge.h>
+
+#include <cstring>
+
+namespace eka2l1::hle {
+    // Any descriptor operation that would go past the maximum length panics with USER 11
+    static constexpr int des_overflow_panic = 11;
+
+    static void panic_current_thread(system *sys, const char *category, const int reason) {
+        kernel_system *kern = sys->get_kernel_system();
+        thread_ptr thr = kern->crr_thread();
+
+        LOG_TRACE("Thread {} paniced with cagetory: {} and exit code: {}", thr->name(), category, reason);
+
+        if (thr->owning_process()->decrease_thread_count() == 0) {
+            thr->owning_process()->set_exit_type(kernel::process_exit_type::panic);
+        }
+
+        kern->get_thread_scheduler()->stop(thr);
+        kern->prepare_reschedule();
+    }
+
+    // Bytes left until the end of the page
+    static std::uint32_t page_room(memory_system *mem, const address addr) {
+        const std::uint32_t page_size = static_cast<std::uint32_t>(mem->get_page_size());
+        return page_size - addr % page_size;
+    }
+
+    template <typename T>
+    static std::size_t find_mismatch(const T *lhs, const T *rhs, const std::size_t count) {
+        if constexpr (sizeof(T) == 1) {
+            return common::find_mismatch8(lhs, rhs, count);
+        } else {
+            return common::find_mismatch16(lhs, rhs, count);
+        }
+    }
+
+    template <typename T>
+    static std::size_t find_null(const T *str, const std::size_t max_count) {
+        if constexpr (sizeof(T) == 1) {
+            return common::find_null8(str, max_count);
+        } else {
+            return common::find_null16(str, max_count);
+        }
+    }
+
+    // Compare a page at a time, so the whole run inside the page goes through the host routine
+    template <typename T>
+    static std::int32_t compare_guest(memory_system *mem, address lhs, const std::int32_t lhs_length,
+        address rhs, const std::int32_t rhs_length) {
+        std::uint32_t remaining = static_cast<std::uint32_t>(common::max(0, common::min(lhs_length, rhs_length)));
+
+        while (remaining > 0) {
+            const T *lhs_host = ptr<T>(lhs).get(mem);
+            const T *rhs_host = ptr<T>(rhs).get(mem);
+
+            if (!lhs_host || !rhs_host) {
+                LOG_WARN("Comparing uncommitted memory (0x{:x} and 0x{:x})", lhs, rhs);
+                break;
+            }
+
+            // A unit straddling two pages (unaligned guest pointer) is compared on its own
+            const std::uint32_t room = common::min(page_room(mem, lhs), page_room(mem, rhs)) / sizeof(T);
+            const std::uint32_t step = common::max(1U, common::min(remaining, room));
+
+            T lhs_unit = 0;
+            T rhs_unit = 0;
+
+            if (room == 0) {
+                mem->read(lhs, &lhs_unit, sizeof(T));
+                mem->read(rhs, &rhs_unit, sizeof(T));
+
+                lhs_host = &lhs_unit;
+                rhs_host = &rhs_unit;
+            }
+
+            const std::size_t pos = find_mismatch(lhs_host, rhs_host, step);
+
+            if (pos != step) {
+                return static_cast<std::int32_t>(lhs_host[pos]) - static_cast<std::int32_t>(rhs_host[pos]);
+            }
+
+            lhs += step * sizeof(T);
+            rhs += step * sizeof(T);
+            remaining -= step;
+        }
+
+        return lhs_length - rhs_length;
+    }
+
+    template <typename T>
+    static std::int32_t string_length_guest(memory_system *mem, address str) {
+        std::int32_t length = 0;
+
+        while (true) {
+            const T *host = ptr<T>(str).get(mem);
+
+            if (!host) {
+                LOG_WARN("String at 0x{:x} runs into uncommitted memory", str);
+                return length;
+            }
+
+            const std::uint32_t room = page_room(mem, str) / sizeof(T);
+
+            if (room == 0) {
+                T unit = 0;
+                mem->read(str, &unit, sizeof(T));
+
+                if (unit == 0) {
+                    return length;
+                }
+
+                length++;
+                str += sizeof(T);
+
+                continue;
+            }
+
+            const std::size_t pos = find_null(host, room);
+            length += static_cast<std::int32_t>(pos);
+
+            if (pos != room) {
+                return length;
+            }
+
+            str += room * sizeof(T);
+        }
+    }
+
+    std::int32_t compare_guest_memory8(memory_system *mem, const address lhs, const std::int32_t lhs_length,
+        const address rhs, const std::int32_t rhs_length) {
+        return compare_guest<std::uint8_t>(mem, lhs, lhs_length, rhs, rhs_length);
+    }
+
+    std::int32_t compare_guest_memory16(memory_system *mem, const address lhs, const std::int32_t lhs_length,
+        const address rhs, const std::int32_t rhs_length) {
+        return compare_guest<std::uint16_t>(mem, lhs, lhs_length, rhs, rhs_length);
+    }
+
+    std::int32_t guest_string_length8(memory_system *mem, const address str) {
+        return string_length_guest<std::uint8_t>(mem, str);
+    }
+
+    std::int32_t guest_string_length16(memory_system *mem, const address str) {
+        return string_length_guest<std::uint16_t>(mem, str);
+    }
+
+    bool fill_guest_memory(memory_system *mem, const address dest, const std::uint8_t value, const std::uint32_t size) {
+        host_span_iterator spans = mem->get_host_spans(dest, size);
+        host_span span;
+
+        while (spans.next(span)) {
+            std::memset(span.host, value, span.size);
+        }
+
+        return spans.finished();
+    }
+
+    /*! \brief Copy or append a descriptor to a modifiable descriptor, as TDes::Copy and TDes::Append do. */
+    template <typename T>
+    static void copy_des_guest(system *sys, const address self, const address source, const bool append) {
+        memory_system *mem = sys->get_memory_system();
+        process_ptr pr = sys->get_kernel_system()->crr_process();
+
+        epoc::desc<T> *dest_des = ptr<epoc::desc<T>>(self).get(mem);
+        epoc::desc<T> *source_des = ptr<epoc::desc<T>>(source).get(mem);
+
+        if (!dest_des || !source_des) {
+            LOG_WARN("Copying descriptor 0x{:x} to 0x{:x}, one of which is not committed", source, self);
+            return;
+        }
+
+        const std::uint32_t start = append ? dest_des->get_length() : 0;
+        const std::uint32_t length = source_des->get_length();
+
+        if (start + length > dest_des->get_max_length(pr)) {
+            panic_current_thread(sys, "USER", des_overflow_panic);
+            return;
+        }
+
+        const address dest_data = dest_des->get_pointer_address(pr, self) + start * sizeof(T);
+        const address source_data = source_des->get_pointer_address(pr, source);
+
+        // Copy is memmove in euser, the descriptors may overlap
+        if (!mem->copy(dest_data, source_data, length * sizeof(T))) {
+            LOG_WARN("Descriptor data at 0x{:x} or 0x{:x} is not committed", source_data, dest_data);
+        }
+
+        dest_des->set_length(pr, start + length);
+    }
+
+    BRIDGE_FUNC(address, intrinsic_memcpy, address dest, address source, std::uint32_t size) {
+        if (!sys->get_memory_system()->copy(dest, source, size)) {
+            LOG_WARN("memcpy from 0x{:x} to 0x{:x} touched uncommitted memory", source, dest);
+        }
+
+        return dest;
+    }
+
+    BRIDGE_FUNC(address, intrinsic_memmove, address dest, address source, std::uint32_t size) {
+        if (!sys->get_memory_system()->copy(dest, source, size)) {
+            LOG_WARN("memmove from 0x{:x} to 0x{:x} touched uncommitted memory", source, dest);
+        }
+
+        return dest;
+    }
+
+    BRIDGE_FUNC(address, intrinsic_memset, address dest, std::int32_t value, std::uint32_t size) {
+        if (!fill_guest_memory(sys->get_memory_system(), dest, static_cast<std::uint8_t>(value), size)) {
+            LOG_WARN("memset at 0x{:x} touched uncommitted memory", dest);
+        }
+
+        return dest;
+    }
+
+    BRIDGE_FUNC(void, intrinsic_memclr, address dest, std::uint32_t size) {
+        if (!fill_guest_memory(sys->get_memory_system(), dest, 0, size)) {
+            LOG_WARN("memclr at 0x{:x} touched uncommitted memory", dest);
+        }
+    }
+
+    BRIDGE_FUNC(std::int32_t, intrinsic_memcompare, address lhs, std::int32_t lhs_length, address rhs, std::int32_t rhs_length) {
+        return compare_guest_memory8(sys->get_memory_system(), lhs, lhs_length, rhs, rhs_length);
+    }
+
+    BRIDGE_FUNC(std::int32_t, intrinsic_mem_compare16, address lhs, std::int32_t lhs_length, address rhs, std::int32_t rhs_length) {
+        return compare_guest_memory16(sys->get_memory_system(), lhs, lhs_length, rhs, rhs_length);
+    }
+
+    BRIDGE_FUNC(std::int32_t, intrinsic_string_length8, address str) {
+        return guest_string_length8(sys->get_memory_system(), str);
+    }
+
+    BRIDGE_FUNC(std::int32_t, intrinsic_string_length16, address str) {
+        return guest_string_length16(sys->get_memory_system(), str);
+    }
+
+    BRIDGE_FUNC(void, intrinsic_des8_copy, address self, address source) {
+        copy_des_guest<char>(sys, self, source, false);
+    }
+
+    BRIDGE_FUNC(void, intrinsic_des8_append, address self, address source) {
+        copy_des_guest<char>(sys, self, source, true);
+    }
+
+    BRIDGE_FUNC(void, intrinsic_des16_copy, address self, address source) {
+        copy_des_guest<char16_t>(sys, self, source, false);
+    }
+
+    BRIDGE_FUNC(void, intrinsic_des16_append, address self, address source) {
+        copy_des_guest<char16_t>(sys, self, source, true);
+    }
+
+#define INTRINSIC_REGISTER(lib, ordinal, name) \
+    { lib, ordinal, #name, &eka2l1::hle::bridge_thunk<&intrinsic_##name> }
+
+    // Ordinals of the EKA2 euser.dll, in the same order as hle/epoc9_n.def
+    static const intrinsic_info eka2_intrinsics[] = {
+        INTRINSIC_REGISTER("euser", 523, mem_compare16),
+        INTRINSIC_REGISTER("euser", 595, string_length8),
+        INTRINSIC_REGISTER("euser", 596, string_length16),
+        INTRINSIC_REGISTER("euser", 744, des8_copy),
+        INTRINSIC_REGISTER("euser", 760, des8_append),
+        INTRINSIC_REGISTER("euser", 953, des16_copy),
+        INTRINSIC_REGISTER("euser", 968, des16_append),
+        INTRINSIC_REGISTER("euser", 1951, memclr),
+        INTRINSIC_REGISTER("euser", 1952, memcompare),
+        INTRINSIC_REGISTER("euser", 1953, memcpy),
+        INTRINSIC_REGISTER("euser", 1954, memmove),
+        INTRINSIC_REGISTER("euser", 1955, memset)
+    };
+
+#undef INTRINSIC_REGISTER
+
+    const intrinsic_info *get_intrinsics(const epocver ver, std::size_t &count) {
+        if (ver < epocver::epoc93) {
+            count = 0;
+            return nullptr;
+        }
+
+        count = sizeof(eka2_intrinsics) / sizeof(intrinsic_info);
+        return eka2_intrinsics;
+    }
+}
@@ -34,6 +34,14 @@ namespace eka2l1 {
             
         }
 
+        void kernel_obj::rename(const std::string &new_name) {
+            if (kern) {
+                kern->get_object_registry().rename(this, new_name);
+            }
+
+            obj_name = new_name;
+        }
+
         void kernel_obj::do_state(common::chunkyseri &seri) {
             auto s = seri.section("KernelObject", 1);
 
@@ -18,7 +18,9 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include <common/algorithm.h>
+#include <common/bytepair.h>
 #include <common/cvt.h>
+#include <common/hash.h>
 #include <common/log.h>
 #include <common/path.h>
 #include <common/random.h>
@@ -33,16 +35,20 @@
 #include <manager/script_manager.h>
 #endif
 
+#include <epoc/loader/codeseg_cache.h>
 #include <epoc/loader/e32img.h>
 #include <epoc/loader/romimage.h>
 #include <epoc/vfs.h>
 
 #include <epoc/kernel/codeseg.h>
+#include <epoc/kernel/intrinsics.h>
 #include <common/configure.h>
 #include <epoc/epoc.h>
 #include <epoc/kernel.h>
 
 #include <arm/arm_analyser.h>
+#include <arm/arm_interface.h>
+#include <algorithm>
 #include <cctype>
 
 namespace eka2l1 {
@@ -153,8 +159,39 @@ namespace eka2l1 {
             return true;
         }
 
+        // Fixups of a demand paged code page, applied when the page is loaded
+        struct code_page_fixups {
+            // Relocation info as in the image, but with the offset relative to the page
+            std::vector<std::uint16_t> relocs;
+
+            // Offset in the page of each import, with the codeseg exporting it
+            std::vector<std::pair<std::uint16_t, kernel::codeseg *>> imports;
+        };
+
+        std::uint32_t resolve_elf_import(kernel::codeseg *cs, const std::uint32_t import_inf) {
+            uint32_t ord = import_inf & 0xffff;
+            uint32_t adj = import_inf >> 16;
+
+            if (ord == 0) {
+                return 0;
+            }
+
+            const address export_addr = cs->lookup(ord);
+            assert(export_addr != 0);
+
+            // The export address provided is already added with relative code/data
+            // delta, so add this directly to the adjustment address
+            return export_addr + adj;
+        }
+
+        /*! \brief Resolve the imports from a DLL.
+         *
+         * \param page_fixups If not null, imports in the code are only recorded to their page,
+         *                    to be resolved when the page is loaded.
+        */
         bool elf_fix_up_import_dir(memory_system *mem, hle::lib_manager &mngr, loader::e32img &me,
-            loader::e32img_import_block &import_block, codeseg_ptr &parent_cs) {
+            loader::e32img_import_block &import_block, codeseg_ptr &parent_cs,
+            std::vector<code_page_fixups> *page_fixups = nullptr) {
             LOG_INFO("Fixup for: {}", import_block.dll_name);
 
             const std::string dll_name8 = get_real_dll_name(import_block.dll_name);
@@ -171,36 +208,92 @@ namespace eka2l1 {
             assert(parent_cs->add_dependency(cs));
 
             std::uint32_t *imdir = &(import_block.ordinals[0]);
+            const std::uint32_t page_size = static_cast<std::uint32_t>(mem->get_page_size());
 
             for (uint32_t i = 0; i < import_block.ordinals.size(); i++) {
                 uint32_t off = imdir[i];
-                uint32_t *code_ptr = ptr<uint32_t>(me.rt_code_addr + off).get(mem);
 
-                uint32_t import_inf = *code_ptr;
-                uint32_t ord = import_inf & 0xffff;
-                uint32_t adj = import_inf >> 16;
+                if (page_fixups && (off / page_size < page_fixups->size())) {
+                    (*page_fixups)[off / page_size].imports.emplace_back(static_cast<std::uint16_t>(off % page_size), cs.get());
+                    continue;
+                }
 
-                uint32_t export_addr;
-                uint32_t val = 0;
+                uint32_t *code_ptr = ptr<uint32_t>(me.rt_code_addr + off).get(mem);
 
-                if (ord > 0) {
-                    export_addr = cs->lookup(ord);
-                    assert(export_addr != 0);
+                // LOG_TRACE("Writing 0x{:x} to 0x{:x}", val, me.header.code_base + off);
+                write(code_ptr, resolve_elf_import(cs.get(), *code_ptr));
+            }
 
-                    // The export address provided is already added with relative code/data
-                    // delta, so add this directly to the adjustment address
-                    val = export_addr + adj;
+            return true;
+        }
+
+        /*! \brief Make the code of an image load a page at a time, on first access.
+         *
+         * Pages are decompressed, relocated and have their imports resolved when loaded.
+        */
+        void set_up_code_demand_paging(loader::e32img *img, memory_system *mem, codeseg_ptr &cs,
+            std::vector<code_page_fixups> &&page_fixups, const uint32_t code_delta, const uint32_t data_delta) {
+            const std::uint32_t page_size = static_cast<std::uint32_t>(mem->get_page_size());
+            const std::uint32_t code_size = img->header.code_size;
+
+            for (auto &entry : img->code_reloc_section.entries) {
+                for (const std::uint16_t rel_info : entry.rels_info) {
+                    const std::uint32_t off = entry.base + (rel_info & 0x0FFF);
+
+                    if (off / page_size < page_fixups.size()) {
+                        page_fixups[off / page_size].relocs.push_back(static_cast<std::uint16_t>((rel_info & 0xF000) | (off % page_size)));
+                    }
                 }
+            }
 
-                // LOG_TRACE("Writing 0x{:x} to 0x{:x}", val, me.header.code_base + off);
-                write(code_ptr, val);
+            // Bytepair pages are decompressed on their own, other images keep their decompressed code
+            std::vector<char> code;
+
+            if (!img->code_pages) {
+                code.assign(img->data.begin() + img->header.code_offset, img->data.begin() + img->header.code_offset + code_size);
             }
 
-            return true;
+            cs->set_code_page_loader([=, code_pages = img->code_pages, fixups = std::move(page_fixups), code = std::move(code)](
+                                         const std::uint32_t page_index, std::uint8_t *dest) {
+                const std::uint32_t page_off = page_index * page_size;
+
+                if (page_off >= code_size) {
+                    return false;
+                }
+
+                const std::uint32_t size = common::min(code_size - page_off, page_size);
+
+                if (code_pages) {
+                    if (code_pages->read_page(reinterpret_cast<char *>(dest), page_index, size) != size) {
+                        return false;
+                    }
+                } else {
+                    std::copy(code.begin() + page_off, code.begin() + page_off + size, dest);
+                }
+
+                const code_page_fixups &page = fixups[page_index];
+
+                for (const std::uint16_t rel_info : page.relocs) {
+                    relocate(reinterpret_cast<uint32_t *>(dest + (rel_info & 0x0FFF)),
+                        static_cast<loader::relocation_type>(rel_info & 0xF000), code_delta, data_delta);
+                }
+
+                for (const auto &[offset, dependency] : page.imports) {
+                    uint32_t *import_ptr = reinterpret_cast<uint32_t *>(dest + offset);
+                    write(import_ptr, resolve_elf_import(dependency, *import_ptr));
+                }
+
+                return true;
+            });
         }
 
-        codeseg_ptr import_e32img(loader::e32img *img, memory_system *mem, kernel_system *kern, hle::lib_manager &mngr, const std::u16string &path = u"") {
-            std::uint32_t data_seg_size = img->header.data_size + img->header.bss_size;
+        bool is_e32img_code_demand_paged(const loader::e32img *img) {
+            // EKA1 images fix up their import address table in the image data, they are loaded at once
+            return img->demand_paged && (static_cast<int>(img->epoc_ver) >= static_cast<int>(epocver::epoc93));
+        }
+
+        /*! \brief Create the codeseg of an image and register its exports, with nothing loaded yet. */
+        codeseg_ptr create_e32img_codeseg(loader::e32img *img, kernel_system *kern, hle::lib_manager &mngr, const std::u16string &path) {
             kernel::codeseg_create_info info;
 
             info.full_path = path;
@@ -227,11 +320,19 @@ namespace eka2l1 {
                     info.exception_descriptor = 0;
                 }
             }
+
+            info.demand_paged_code = is_e32img_code_demand_paged(img);
             
             codeseg_ptr cs = kern->create<kernel::codeseg>("codeseg", info);
             mngr.register_exports(
-                common::ucs2_to_utf8(eka2l1::replace_extension(eka2l1::filename(path), u"")),
-                cs->get_export_table());
+                common::ucs2_to_utf8(eka2l1::replace_extension(eka2l1::filename(path), u"")), cs);
+
+            return cs;
+        }
+
+        /*! \brief Relocate the image, resolve its imports and copy it to the codeseg created for it. */
+        void load_e32img_to_codeseg(loader::e32img *img, memory_system *mem, hle::lib_manager &mngr, codeseg_ptr &cs) {
+            const bool demand_paged_code = is_e32img_code_demand_paged(img);
 
             uint32_t rtcode_addr = cs->get_code_run_addr();
             uint32_t rtdata_addr = cs->get_data_run_addr();
@@ -245,7 +346,9 @@ namespace eka2l1 {
             uint32_t code_delta = rtcode_addr - img->header.code_base;
             uint32_t data_delta = rtdata_addr - img->header.data_base;
 
-            relocate(img->code_reloc_section.entries, reinterpret_cast<uint8_t *>(img->data.data() + img->header.code_offset), code_delta, data_delta);
+            if (!demand_paged_code) {
+                relocate(img->code_reloc_section.entries, reinterpret_cast<uint8_t *>(img->data.data() + img->header.code_offset), code_delta, data_delta);
+            }
 
             if (img->header.data_size)
                 relocate(img->data_reloc_section.entries, reinterpret_cast<uint8_t *>(img->data.data() + img->header.data_offset), code_delta, data_delta);
@@ -258,7 +361,10 @@ namespace eka2l1 {
                 }
             }
 
-            memcpy(ptr<void>(rtcode_addr).get(mem), img->data.data() + img->header.code_offset, img->header.code_size);
+            if (!demand_paged_code) {
+                memcpy(ptr<void>(rtcode_addr).get(mem), img->data.data() + img->header.code_offset, img->header.code_size);
+            }
+
             std::uint8_t *dt_ptr = ptr<std::uint8_t>(rtdata_addr).get(mem);
 
             if (img->header.data_size) {
@@ -272,13 +378,30 @@ namespace eka2l1 {
             // Filling zero from beginning of code segment, with size of bss size - 1
             std::fill(dt_ptr, dt_ptr + img->header.bss_size, 0);
 
+            std::vector<code_page_fixups> page_fixups;
+
+            if (demand_paged_code) {
+                page_fixups.resize(cs->get_code_page_count());
+            }
+
             if (static_cast<int>(img->epoc_ver) >= static_cast<int>(epocver::epoc93)) {
                 for (auto &ib : img->import_section.imports) {
-                    elf_fix_up_import_dir(mem, mngr, *img, ib, cs);
+                    elf_fix_up_import_dir(mem, mngr, *img, ib, cs, demand_paged_code ? &page_fixups : nullptr);
                 }
             }
 
+            if (demand_paged_code) {
+                set_up_code_demand_paging(img, mem, cs, std::move(page_fixups), code_delta, data_delta);
+                mngr.track_demand_paged_codeseg(cs);
+            }
+
             LOG_INFO("Load e32img success");
+        }
+
+        codeseg_ptr import_e32img(loader::e32img *img, memory_system *mem, kernel_system *kern, hle::lib_manager &mngr, const std::u16string &path = u"") {
+            codeseg_ptr cs = create_e32img_codeseg(img, kern, mngr, path);
+            load_e32img_to_codeseg(img, mem, mngr, cs);
+
             return cs;
         }
 
@@ -291,6 +414,26 @@ namespace eka2l1 {
             log_svc = sys->get_manager_system()->get_config_manager()->
                 get_or_fall<bool>("log_svc", false);
 
+            svcs.set_count_calls(sys->get_manager_system()->get_config_manager()->
+                get_or_fall<bool>("count_svc", false));
+
+            demand_paging = sys->get_manager_system()->get_config_manager()->
+                get_or_fall<bool>("demand_paging", false);
+
+            if (sys->get_manager_system()->get_config_manager()->get_or_fall<bool>("codeseg_cache", false)) {
+                cache = std::make_shared<loader::codeseg_cache>(sys->get_manager_system()->get_config_manager()->
+                    get_or_fall<std::string>("codeseg_cache_path", "cache/codeseg/"));
+            }
+
+            intrinsics = get_intrinsics(ver, intrinsic_count);
+            intrinsic_enabled.resize(intrinsic_count);
+
+            for (std::size_t i = 0; i < intrinsic_count; i++) {
+                const std::string key = std::string("intrinsic_") + intrinsics[i].name;
+                intrinsic_enabled[i] = sys->get_manager_system()->get_config_manager()->
+                    get_or_fall<bool>(key.c_str(), true);
+            }
+
             // TODO (pent0): Implement external id loading
 
             std::vector<sid> tids;
@@ -335,7 +478,182 @@ namespace eka2l1 {
                 return seg;
             }
 
-            return import_e32img(&img, mem, kern, *this, path);
+            if (img.cache_entry) {
+                return load_e32img_from_cache(img, path);
+            }
+
+            codeseg_ptr cs = import_e32img(&img, mem, kern, *this, path);
+
+            if (cache && !path.empty() && (static_cast<int>(img.epoc_ver) >= static_cast<int>(epocver::epoc93))) {
+                store_codeseg_to_cache(cs, img, path);
+            }
+
+            return cs;
+        }
+
+        std::optional<loader::e32img> lib_manager::parse_e32img(symfile f, const std::u16string &path) {
+            const epocver ver = kern->get_epoc_version();
+
+            if (cache && (static_cast<int>(ver) >= static_cast<int>(epocver::epoc93))) {
+                if (auto info = io->get_entry_info(path)) {
+                    if (auto entry = cache->find(common::ucs2_to_utf8(path), info->size, info->last_write, ver)) {
+                        return loader::make_e32img_from_cache(std::move(entry));
+                    }
+                }
+            }
+
+            return loader::parse_e32img(f, true, demand_paging);
+        }
+
+        codeseg_ptr lib_manager::load_e32img_from_cache(loader::e32img &img, const std::u16string &path) {
+            loader::codeseg_cache_entry_ptr entry = img.cache_entry;
+            codeseg_ptr cs = create_e32img_codeseg(&img, kern, *this, path);
+
+            // The code and data were relocated to these addresses, and the imports point to where
+            // the dependencies were. Any of that moving means the entry can't be used as it is.
+            bool entry_valid = (cs->get_code_run_addr() == entry->code_addr) && (cs->get_data_run_addr() == entry->data_addr);
+            std::vector<codeseg_ptr> dependencies;
+
+            for (std::size_t i = 0; entry_valid && (i < entry->dll_names.size()); i++) {
+                codeseg_ptr dep = load(common::utf8_to_ucs2(get_real_dll_name(entry->dll_names[i])));
+
+                if (!dep) {
+                    entry_valid = false;
+                    break;
+                }
+
+                if (std::find_if(dependencies.begin(), dependencies.end(), [&](const codeseg_ptr &ite) {
+                        return ite->unique_id() == dep->unique_id(); }) == dependencies.end()) {
+                    dependencies.push_back(std::move(dep));
+                }
+            }
+
+            if (entry_valid && (dependencies.size() == entry->dependency_hashes.size())) {
+                for (std::size_t i = 0; i < dependencies.size(); i++) {
+                    const std::vector<std::uint32_t> &table = dependencies[i]->get_export_table();
+
+                    if (common::hash64(table.data(), table.size() * sizeof(std::uint32_t)) != entry->dependency_hashes[i]) {
+                        entry_valid = false;
+                        break;
+                    }
+                }
+            } else {
+                entry_valid = false;
+            }
+
+            if (!entry_valid) {
+                LOG_TRACE("Codeseg cache entry of {} is outdated, loading the image", common::ucs2_to_utf8(path));
+
+                symfile f = io->open_file(path, READ_MODE | BIN_MODE);
+                std::optional<loader::e32img> real_img = f ? loader::parse_e32img(f, true, demand_paging) : std::nullopt;
+
+                if (f) {
+                    f->close();
+                }
+
+                if (!real_img) {
+                    LOG_ERROR("Unable to parse {} after its cache entry got outdated", common::ucs2_to_utf8(path));
+                    return nullptr;
+                }
+
+                load_e32img_to_codeseg(&(*real_img), mem, *this, cs);
+                store_codeseg_to_cache(cs, *real_img, path);
+
+                return cs;
+            }
+
+            for (auto &dep : dependencies) {
+                cs->add_dependency(dep);
+            }
+
+            if (is_e32img_code_demand_paged(&img)) {
+                const std::uint32_t page_size = static_cast<std::uint32_t>(mem->get_page_size());
+
+                cs->set_code_page_loader([entry, page_size](const std::uint32_t page_index, std::uint8_t *dest) {
+                    const std::uint32_t page_off = page_index * page_size;
+
+                    if (page_off >= entry->code_size) {
+                        return false;
+                    }
+
+                    const std::uint32_t size = common::min(entry->code_size - page_off, page_size);
+                    std::copy(entry->code + page_off, entry->code + page_off + size, dest);
+
+                    return true;
+                });
+
+                track_demand_paged_codeseg(cs);
+            } else if (entry->code_size) {
+                std::copy(entry->code, entry->code + entry->code_size, ptr<std::uint8_t>(entry->code_addr).get(mem));
+            }
+
+            if (entry->data_size) {
+                std::copy(entry->data, entry->data + entry->data_size, ptr<std::uint8_t>(entry->data_addr).get(mem));
+            }
+
+            LOG_INFO("Load e32img from codeseg cache success");
+            return cs;
+        }
+
+        void lib_manager::store_codeseg_to_cache(codeseg_ptr cs, loader::e32img &img, const std::u16string &path) {
+            auto info = io->get_entry_info(path);
+            symfile f = io->open_file(path, READ_MODE | BIN_MODE);
+
+            if (!info || !f) {
+                return;
+            }
+
+            std::vector<std::uint8_t> content(static_cast<std::size_t>(f->size()));
+            f->read_file(content.data(), 1, static_cast<std::uint32_t>(content.size()));
+            f->close();
+
+            loader::codeseg_cache_entry entry;
+
+            entry.epoc_ver = img.epoc_ver;
+            entry.header = img.header;
+            entry.header_extended = img.header_extended;
+            entry.has_extended_header = img.has_extended_header;
+            entry.export_dir = img.ed.syms;
+
+            for (auto &import_block : img.import_section.imports) {
+                entry.dll_names.push_back(import_block.dll_name);
+            }
+
+            entry.code_addr = cs->get_code_run_addr();
+            entry.data_addr = cs->get_data_run_addr();
+
+            for (const codeseg_ptr &dep : cs->get_dependencies()) {
+                const std::vector<std::uint32_t> &table = dep->get_export_table();
+                entry.dependency_hashes.push_back(common::hash64(table.data(), table.size() * sizeof(std::uint32_t)));
+            }
+
+            // Demand paged code may not be in the chunk yet, run the loader on every page instead
+            const std::uint32_t page_size = static_cast<std::uint32_t>(mem->get_page_size());
+            std::vector<std::uint8_t> code;
+
+            if (cs->is_code_demand_paged()) {
+                code.resize(cs->get_code_page_count() * page_size);
+
+                for (std::uint32_t i = 0; i < cs->get_code_page_count(); i++) {
+                    if (!cs->load_code_page(i, code.data() + i * page_size)) {
+                        return;
+                    }
+                }
+
+                entry.code = code.data();
+            } else if (cs->get_code_size()) {
+                entry.code = ptr<std::uint8_t>(entry.code_addr).get(mem);
+            }
+
+            entry.code_size = cs->get_code_size();
+            entry.data_size = cs->get_data_size() + cs->get_bss_size();
+
+            if (entry.data_size) {
+                entry.data = ptr<std::uint8_t>(entry.data_addr).get(mem);
+            }
+
+            cache->store(common::ucs2_to_utf8(path), info->size, info->last_write,
+                common::hash64(content.data(), content.size()), entry);
         }
         
         codeseg_ptr lib_manager::load_as_romimg(loader::romimg &romimg, const std::u16string &path) {
@@ -367,8 +685,7 @@ namespace eka2l1 {
             auto cs = kern->create<kernel::codeseg>("codeseg", info);
 
             register_exports(
-                common::ucs2_to_utf8(eka2l1::replace_extension(eka2l1::filename(path), u"")),
-                cs->get_export_table());
+                common::ucs2_to_utf8(eka2l1::replace_extension(eka2l1::filename(path), u"")), cs);
 
             struct dll_ref_table {
                 uint16_t flags;
@@ -418,7 +735,7 @@ namespace eka2l1 {
                         return result;
                     }
 
-                    auto parse_result = loader::parse_e32img(f);
+                    auto parse_result = parse_e32img(f, path);
                     if (parse_result != std::nullopt) {
                         f->close();
                         result.first = std::move(parse_result);
@@ -477,7 +794,7 @@ namespace eka2l1 {
 
                         return load_as_romimg(*romimg, lib_path);
                     } else {
-                        auto e32img = loader::parse_e32img(f, mem);
+                        auto e32img = parse_e32img(f, lib_path);
                         if (!e32img) {
                             return nullptr;
                         }
@@ -526,40 +843,234 @@ namespace eka2l1 {
         }
 
         void lib_manager::shutdown() {
+            if (demand_paging) {
+                const demand_paging_stats stats = get_demand_paging_stats();
+
+                LOG_INFO("Demand paging: {} of {} code pages touched, in {} codesegs", stats.touched_page_count,
+                    stats.page_count, stats.segment_count);
+            }
+
+            if (cache) {
+                cache->flush();
+            }
+
             reset();
         }
 
+        void lib_manager::track_demand_paged_codeseg(codeseg_ptr seg) {
+            // Forget the ones that are gone while here
+            demand_paged_segs.erase(std::remove_if(demand_paged_segs.begin(), demand_paged_segs.end(),
+                                        [](const std::weak_ptr<kernel::codeseg> &ite) { return ite.expired(); }),
+                demand_paged_segs.end());
+
+            demand_paged_segs.push_back(seg);
+        }
+
+        lib_manager::demand_paging_stats lib_manager::get_demand_paging_stats() const {
+            demand_paging_stats stats;
+
+            for (const auto &weak_seg : demand_paged_segs) {
+                if (codeseg_ptr seg = weak_seg.lock()) {
+                    stats.segment_count++;
+                    stats.page_count += seg->get_code_page_count();
+                    stats.touched_page_count += seg->get_touched_code_page_count();
+                }
+            }
+
+            return stats;
+        }
+
         void lib_manager::reset() {
-            svc_funcs.clear();
+            svcs.clear();
+
+            code_patches.clear();
+            demand_paged_segs.clear();
+        }
+
+        void lib_manager::register_svcs(const func_map &svcs_to_add) {
+            for (const auto &[svcnum, svc] : svcs_to_add) {
+                if (!svcs.add(svcnum, svc)) {
+                    LOG_ERROR("SVC 0x{:x} ({}) is out of the dispatch table range", svcnum, svc.name);
+                }
+            }
+        }
+
+        const std::string *lib_manager::get_svc_name(const sid svcnum) const {
+            return svcs.get_name(svcnum);
+        }
+
+        std::uint64_t lib_manager::get_svc_call_count(const sid svcnum) const {
+            return svcs.get_call_count(svcnum);
         }
 
         bool lib_manager::call_svc(sid svcnum) {
-            auto res = svc_funcs.find(svcnum);
+            if ((svcnum & intrinsic_svc_base) == intrinsic_svc_base) {
+                return call_intrinsic(svcnum & ~intrinsic_svc_base);
+            }
 
-            if (res == svc_funcs.end()) {
+            return svcs.call(svcnum, sys, [this](const sid called) {
+                if (log_svc) {
+                    LOG_TRACE("Calling SVC 0x{:x} {}", called, *get_svc_name(called));
+                }
+
+#ifdef ENABLE_SCRIPTING
+                manager::script_manager *scripts = sys->get_manager_system()->get_script_manager();
+
+                if (scripts->has_svc_hooks()) {
+                    scripts->call_svcs(called);
+                }
+#endif
+            });
+        }
+    
+        bool lib_manager::call_intrinsic(const std::uint32_t idx) {
+            if (idx >= intrinsic_count) {
                 return false;
             }
 
-            epoc_import_func func = res->second;
+            intrinsics[idx].func(sys);
+            return true;
+        }
 
-            if (log_svc) {
-                LOG_TRACE("Calling SVC 0x{:x} {}", svcnum, func.name);
+        void lib_manager::patch_code(const address addr, const std::uint16_t inst) {
+            code_patches[addr] = inst;
+        }
+
+        void lib_manager::remove_code_patches(const address addr, const std::uint32_t size) {
+            for (auto ite = code_patches.begin(); ite != code_patches.end();) {
+                if (ite->first >= addr && ite->first - addr < size) {
+                    ite = code_patches.erase(ite);
+                } else {
+                    ite++;
+                }
             }
+        }
 
-#ifdef ENABLE_SCRIPTING
-            sys->get_manager_system()->get_script_manager()->call_svcs(svcnum);
-#endif
+        // Bytes taken by the trap of an export: SVC and BX LR, after the switch to ARM for Thumb exports
+        static std::uint32_t get_export_trap_size(const address addr) {
+            const address export_addr = addr & ~0x1;
+            std::uint32_t size = 8;
 
-            func.func(sys);
+            if (addr & 0x1) {
+                // NOPs up to a word boundary, then BX PC and a NOP
+                size += static_cast<std::uint32_t>(common::align(export_addr, 4) - export_addr) + 4;
+            }
 
-            return true;
+            return size;
+        }
+
+        void lib_manager::trap_export(const address addr, const sid svcnum) {
+            // SVC svcnum, BX LR
+            const std::uint32_t arm_svc = 0xEF000000 | svcnum;
+            const std::uint32_t arm_return = 0xE12FFF1E;
+
+            address arm_addr = addr & ~0x1;
+
+            if (addr & 0x1) {
+                // NOP up to a word boundary, then BX PC, which lands in ARM state 4 bytes later
+                const address bx_addr = common::align(arm_addr, 4);
+
+                for (address nop_addr = arm_addr; nop_addr < bx_addr; nop_addr += 2) {
+                    patch_code(nop_addr, 0x46C0);
+                }
+
+                patch_code(bx_addr, 0x4778);
+                patch_code(bx_addr + 2, 0x46C0);
+
+                arm_addr = bx_addr + 4;
+            }
+
+            patch_code(arm_addr, static_cast<std::uint16_t>(arm_svc));
+            patch_code(arm_addr + 2, static_cast<std::uint16_t>(arm_svc >> 16));
+            patch_code(arm_addr + 4, static_cast<std::uint16_t>(arm_return));
+            patch_code(arm_addr + 6, static_cast<std::uint16_t>(arm_return >> 16));
+
+            // In case the export was already translated
+            if (arm::jitter &cpu = sys->get_cpu()) {
+                cpu->imb_range(addr & ~0x1, arm_addr + 8 - (addr & ~0x1));
+            }
+        }
+
+        void lib_manager::trap_intrinsics(const std::string &lib_name_lower, codeseg_ptr cs) {
+            const export_table &table = cs->get_export_table();
+
+            const address code_start = cs->get_code_run_addr();
+            const address code_end = code_start + cs->get_code_size();
+
+            // Export starts, to know where an export ends at most
+            std::vector<address> export_starts;
+
+            for (std::size_t i = 0; i < intrinsic_count; i++) {
+                const intrinsic_info &intrinsic = intrinsics[i];
+
+                if (!intrinsic_enabled[i] || (lib_name_lower != intrinsic.lib_name)) {
+                    continue;
+                }
+
+                if (intrinsic.ordinal == 0 || intrinsic.ordinal > table.size()) {
+                    LOG_WARN("{} has no ordinal {} to trap to intrinsic {}", lib_name_lower, intrinsic.ordinal,
+                        intrinsic.name);
+                    continue;
+                }
+
+                if (export_starts.empty()) {
+                    for (const std::uint32_t export_addr : table) {
+                        export_starts.push_back(export_addr & ~0x1);
+                    }
+
+                    std::sort(export_starts.begin(), export_starts.end());
+                }
+
+                const address addr = table[intrinsic.ordinal - 1];
+                const address export_addr = addr & ~0x1;
+
+                if (export_addr < code_start || export_addr >= code_end) {
+                    LOG_WARN("{} ordinal {} is out of the code, not trapped to intrinsic {}", lib_name_lower,
+                        intrinsic.ordinal, intrinsic.name);
+                    continue;
+                }
+
+                auto next_start = std::upper_bound(export_starts.begin(), export_starts.end(), export_addr);
+                const address export_end = (next_start == export_starts.end()) ? code_end : std::min(*next_start, code_end);
+
+                if (export_end - export_addr < get_export_trap_size(addr)) {
+                    LOG_WARN("{} ordinal {} is too small to trap to intrinsic {}", lib_name_lower, intrinsic.ordinal,
+                        intrinsic.name);
+                    continue;
+                }
+
+                trap_export(addr, intrinsic_svc_base | static_cast<sid>(i));
+            }
+        }
+
+        std::uint32_t lib_manager::patch_code_fetch(const address addr, std::uint32_t word) const {
+            if (code_patches.empty()) {
+                return word;
+            }
+
+            auto low = code_patches.find(addr);
+            auto high = code_patches.find(addr + 2);
+
+            if (low != code_patches.end()) {
+                word = (word & 0xFFFF0000) | low->second;
+            }
+
+            if (high != code_patches.end()) {
+                word = (word & 0x0000FFFF) | (static_cast<std::uint32_t>(high->second) << 16);
+            }
+
+            return word;
         }
     
-        bool lib_manager::register_exports(const std::string &lib_name, export_table &table) {
+        bool lib_manager::register_exports(const std::string &lib_name, codeseg_ptr cs) {
             std::string lib_name_lower = lib_name;
             std::transform(lib_name_lower.begin(), lib_name_lower.end(), lib_name_lower.begin(), 
                    [](unsigned char c) -> unsigned char { return std::tolower(c); });
 
+            trap_intrinsics(lib_name_lower, cs);
+
+            export_table &table = cs->get_export_table();
+
             auto lib_ite = lib_symbols.find(lib_name_lower);
             if (lib_ite != lib_symbols.end()) {    
                 for (std::size_t i = 0; i < table.size(); i++) {
@@ -63,7 +63,7 @@ namespace eka2l1 {
         std::uint32_t object_ix::make_handle(size_t index) {
             std::uint32_t handle = 0;
 
-            handle |= next_instance << 16;
+            handle |= static_cast<std::uint32_t>(objects[index].instance) << 16;
             handle |= index;
 
             if (owner == handle_array_owner::thread) {
@@ -80,24 +80,62 @@ namespace eka2l1 {
             return handle;
         }
 
+        bool object_ix::grow() {
+            const std::size_t old_size = objects.size();
+            const std::size_t new_size = std::min(std::max(old_size * 2, initial_object), max_object);
+
+            if (new_size == old_size) {
+                return false;
+            }
+
+            objects.resize(new_size);
+
+            // Link the new slots in order, in front of the (empty) free list
+            for (std::size_t i = old_size; i < new_size; i++) {
+                objects[i].next_free = (i + 1 < new_size) ? static_cast<std::int32_t>(i + 1) : free_head;
+            }
+
+            free_head = static_cast<std::int32_t>(old_size);
+            return true;
+        }
+
         std::uint32_t object_ix::add_object(kernel_obj_ptr obj) {
-            auto slot = std::find_if(objects.begin(), objects.end(),
-                [](object_ix_record record) { return record.free; });
+            if (free_head == -1 && !grow()) {
+                LOG_WARN("Object table is full");
+                return INVALID_HANDLE;
+            }
 
-            if (slot != objects.end()) {
-                next_instance++;
-                std::uint32_t ret_handle = make_handle(slot - objects.begin());
+            const std::size_t index = static_cast<std::size_t>(free_head);
+            object_ix_record &slot = objects[index];
 
-                slot->associated_handle = ret_handle;
-                slot->free = false;
-                slot->object = obj;
+            free_head = slot.next_free;
 
-                obj->increase_access_count();
+            // Zero is reserved, so no handle is ever null
+            slot.instance = (slot.instance % max_instance) + 1;
+            slot.next_free = -1;
+            slot.free = false;
+            slot.object = obj;
+            slot.associated_handle = make_handle(index);
 
-                return ret_handle;
+            obj->increase_access_count();
+
+            return slot.associated_handle;
+        }
+
+        object_ix_record *object_ix::get_record(std::uint32_t handle) {
+            handle_inspect_info info = inspect_handle(handle);
+
+            if (info.object_ix_index >= objects.size()) {
+                return nullptr;
             }
 
-            return INVALID_HANDLE;
+            object_ix_record &slot = objects[info.object_ix_index];
+
+            if (slot.free || slot.instance != info.object_ix_next_instance) {
+                return nullptr;
+            }
+
+            return &slot;
         }
 
         std::uint32_t object_ix::last_handle() {
@@ -128,10 +166,8 @@ namespace eka2l1 {
         }
 
         kernel_obj_ptr object_ix::get_object(std::uint32_t handle) {
-            handle_inspect_info info = inspect_handle(handle);
-
-            if (info.object_ix_index < objects.size()) {
-                return objects[info.object_ix_index].object;
+            if (object_ix_record *slot = get_record(handle)) {
+                return slot->object;
             }
 
             LOG_WARN("Can't find object with handle: 0x{:x}", handle);
@@ -140,92 +176,86 @@ namespace eka2l1 {
         }
 
         int object_ix::close(std::uint32_t handle) {
-            handle_inspect_info info = inspect_handle(handle);
+            object_ix_record *slot = get_record(handle);
             int ret_value = 0;
 
-            if (info.object_ix_index < objects.size()) {
-                kernel_obj_ptr obj = objects[info.object_ix_index].object;
+            if (!slot || !slot->object) {
+                return -1;
+            }
 
-                if (!obj) {
-                    return -1;
-                }
+            kernel_obj_ptr obj = std::move(slot->object);
 
-                obj->decrease_access_count();
-                obj->close();
+            // Free the slot first, closing may open or close other handles in this table
+            const std::int32_t index = static_cast<std::int32_t>(slot - objects.data());
 
-                if (obj->get_access_count() <= 0 && obj->get_object_type() != object_type::process && obj->get_object_type() != object_type::thread) {
-                    if (obj->get_object_type() == object_type::chunk) {
-                        chunk_ptr c = std::reinterpret_pointer_cast<kernel::chunk>(obj);
+            slot->free = true;
+            slot->next_free = free_head;
+            free_head = index;
 
-                        // This is a force hack signaling the closing one is chunk heap, which means the
-                        // thread is in destruction, and detach needed
-                        if (c->is_chunk_heap()) {
-                            ret_value = 1;
-                        }
-                    }
+            obj->decrease_access_count();
+            obj->close();
 
-                    kern->destroy(obj);
-                }
+            if (obj->get_access_count() <= 0 && obj->get_object_type() != object_type::process && obj->get_object_type() != object_type::thread) {
+                if (obj->get_object_type() == object_type::chunk) {
+                    chunk_ptr c = std::reinterpret_pointer_cast<kernel::chunk>(obj);
 
-                objects[info.object_ix_index].free = true;
+                    // This is a force hack signaling the closing one is chunk heap, which means the
+                    // thread is in destruction, and detach needed
+                    if (c->is_chunk_heap()) {
+                        ret_value = 1;
+                    }
+                }
 
-                return ret_value;
+                kern->destroy(obj);
             }
 
-            return -1;
+            return ret_value;
         }
 
         object_ix::object_ix(kernel_system *kern, handle_array_owner owner)
             : kern(kern)
             , owner(owner)
-            , next_instance(0)
             , uid(kern->next_uid()) {}
 
         void object_ix::do_state(common::chunkyseri &seri) {
-            auto s = seri.section("ObjectIx", 1);
+            auto s = seri.section("ObjectIx", 2);
 
             if (!s) {
                 return;
             }
 
             seri.absorb(uid);
-            seri.absorb(next_instance);
             seri.absorb(owner);
 
-            std::stack<std::uint16_t> slot_used;
-            std::uint32_t slot_count = 0;
-
-            if (seri.get_seri_mode() == common::SERI_MODE_WRITE) {
-                for (std::size_t i = 0; i < objects.size(); i++) {
-                    if (!objects[i].free) {
-                        slot_count++;
-                        slot_used.push(static_cast<std::uint16_t>(i));
-                    }
-                }
-            }
-
+            std::uint32_t slot_count = static_cast<std::uint32_t>(objects.size());
             seri.absorb(slot_count);
 
-            std::uint32_t next_slot_use = 0;
+            if (seri.get_seri_mode() == common::SERI_MODE_READ) {
+                objects.assign(std::min<std::size_t>(slot_count, max_object), object_ix_record{});
+            }
 
-            for (std::uint32_t i = 0; i < slot_count; i++) {
-                std::uint32_t obj_id = 0;
+            for (object_ix_record &slot : objects) {
+                std::uint32_t obj_id = slot.object ? slot.object->unique_id() : 0;
 
-                if (seri.get_seri_mode() == common::SERI_MODE_WRITE) {
-                    next_slot_use = slot_used.top();
-                    slot_used.pop();
+                seri.absorb(slot.instance);
+                seri.absorb(slot.free);
+                seri.absorb(slot.associated_handle);
+                seri.absorb(obj_id);
 
-                    obj_id = objects[next_slot_use].object->unique_id();
+                if (seri.get_seri_mode() == common::SERI_MODE_READ && !slot.free) {
+                    slot.object = kern ? kern->get_object_registry().get(obj_id) : nullptr;
                 }
+            }
 
-                seri.absorb(next_slot_use);
-                seri.absorb(obj_id);
-                seri.absorb(objects[next_slot_use].associated_handle);
+            if (seri.get_seri_mode() == common::SERI_MODE_READ) {
+                // Lowest free slot gets used first
+                free_head = -1;
 
-                if (seri.get_seri_mode() == common::SERI_MODE_READ) {
-                    // TODO
-                    //objects[next_slot_use].object = kern->get_kernel_obj_raw(obj_id);
-                    objects[next_slot_use].free = false;
+                for (std::size_t i = objects.size(); i-- > 0;) {
+                    if (objects[i].free) {
+                        objects[i].next_free = free_head;
+                        free_head = static_cast<std::int32_t>(i);
+                    }
                 }
             }
 
@@ -233,4 +263,4 @@ namespace eka2l1 {
             seri.absorb_container(handles);
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <epoc/kernel/codeseg.h>
+#include <epoc/kernel/object_registry.h>
+#include <epoc/services/property.h>
+
+namespace eka2l1::kernel {
+    void object_registry::add(kernel_obj_ptr obj) {
+        const object_type type = obj->get_object_type();
+
+        names[static_cast<std::size_t>(type)][obj->name()].emplace(obj->unique_id(), obj);
+
+        switch (type) {
+        case object_type::codeseg: {
+            codeseg_ptr seg = std::reinterpret_pointer_cast<codeseg>(obj);
+
+            codesegs_by_ep.emplace(seg->get_entry_point(), seg);
+            codesegs_by_uids.emplace(seg->get_uids(), seg);
+            break;
+        }
+
+        case object_type::prop: {
+            property_ptr prop = std::reinterpret_pointer_cast<service::property>(obj);
+            props.emplace(std::make_pair(prop->first, prop->second), prop);
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        objects.emplace(obj->unique_id(), std::move(obj));
+    }
+
+    template <typename M, typename K>
+    static void erase_if_same(M &index, const K &key, const kernel_obj *obj) {
+        auto ite = index.find(key);
+
+        if (ite != index.end() && ite->second.get() == obj) {
+            index.erase(ite);
+        }
+    }
+
+    bool object_registry::remove(kernel_obj *obj) {
+        auto obj_ite = objects.find(obj->unique_id());
+
+        if (obj_ite == objects.end() || obj_ite->second.get() != obj) {
+            return false;
+        }
+
+        auto &type_names = names[static_cast<std::size_t>(obj->get_object_type())];
+        auto bucket_ite = type_names.find(obj->name());
+
+        if (bucket_ite != type_names.end()) {
+            bucket_ite->second.erase(obj->unique_id());
+
+            if (bucket_ite->second.empty()) {
+                type_names.erase(bucket_ite);
+            }
+        }
+
+        switch (obj->get_object_type()) {
+        case object_type::codeseg: {
+            codeseg *seg = reinterpret_cast<codeseg *>(obj);
+
+            erase_if_same(codesegs_by_ep, seg->get_entry_point(), obj);
+            erase_if_same(codesegs_by_uids, seg->get_uids(), obj);
+            break;
+        }
+
+        case object_type::prop: {
+            service::property *prop = reinterpret_cast<service::property *>(obj);
+            erase_if_same(props, std::make_pair(prop->first, prop->second), obj);
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        // Last, this may hold the last reference
+        objects.erase(obj_ite);
+        return true;
+    }
+
+    void object_registry::rename(kernel_obj *obj, const std::string &new_name) {
+        auto obj_ite = objects.find(obj->unique_id());
+
+        if (obj_ite == objects.end() || obj_ite->second.get() != obj) {
+            return;
+        }
+
+        auto &type_names = names[static_cast<std::size_t>(obj->get_object_type())];
+        auto bucket_ite = type_names.find(obj->name());
+
+        if (bucket_ite != type_names.end()) {
+            bucket_ite->second.erase(obj->unique_id());
+
+            if (bucket_ite->second.empty()) {
+                type_names.erase(bucket_ite);
+            }
+        }
+
+        type_names[new_name].emplace(obj->unique_id(), obj_ite->second);
+    }
+
+    kernel_obj_ptr object_registry::get(const std::uint32_t id) const {
+        auto obj_ite = objects.find(id);
+        return (obj_ite == objects.end()) ? nullptr : obj_ite->second;
+    }
+
+    kernel_obj_ptr object_registry::get(const std::uint32_t id, const object_type type) const {
+        auto obj_ite = objects.find(id);
+
+        if (obj_ite == objects.end() || obj_ite->second->get_object_type() != type) {
+            return nullptr;
+        }
+
+        return obj_ite->second;
+    }
+
+    kernel_obj_ptr object_registry::get_by_name(const std::string &name, const object_type type) const {
+        const auto &type_names = names[static_cast<std::size_t>(type)];
+        auto bucket_ite = type_names.find(name);
+
+        if (bucket_ite == type_names.end()) {
+            return nullptr;
+        }
+
+        return bucket_ite->second.begin()->second;
+    }
+
+    kernel_obj_ptr object_registry::get_by_name(const std::string &name, const object_type type, const std::uint32_t min_id) const {
+        const auto &type_names = names[static_cast<std::size_t>(type)];
+        auto bucket_ite = type_names.find(name);
+
+        if (bucket_ite == type_names.end()) {
+            return nullptr;
+        }
+
+        auto obj_ite = bucket_ite->second.lower_bound(min_id);
+        return (obj_ite == bucket_ite->second.end()) ? nullptr : obj_ite->second;
+    }
+
+    codeseg_ptr object_registry::get_codeseg_by_ep(const address ep) const {
+        auto seg_ite = codesegs_by_ep.find(ep);
+        return (seg_ite == codesegs_by_ep.end()) ? nullptr : seg_ite->second;
+    }
+
+    codeseg_ptr object_registry::get_codeseg_by_uids(const std::uint32_t uid0, const std::uint32_t uid1, const std::uint32_t uid2) const {
+        auto seg_ite = codesegs_by_uids.find(std::make_tuple(uid0, uid1, uid2));
+        return (seg_ite == codesegs_by_uids.end()) ? nullptr : seg_ite->second;
+    }
+
+    property_ptr object_registry::get_prop(const int category, const int key) const {
+        auto prop_ite = props.find(std::make_pair(category, key));
+        return (prop_ite == props.end()) ? nullptr : prop_ite->second;
+    }
+
+    void object_registry::clear() {
+        codesegs_by_ep.clear();
+        codesegs_by_uids.clear();
+        props.clear();
+
+        for (auto &type_names : names) {
+            type_names.clear();
+        }
+
+        objects.clear();
+    }
+}
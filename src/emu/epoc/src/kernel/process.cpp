@@ -33,8 +33,8 @@
 namespace eka2l1::kernel {
     void process::create_prim_thread(uint32_t code_addr, uint32_t ep_off, uint32_t stack_size, uint32_t heap_min,
         uint32_t heap_max, kernel::thread_priority pri) {
-        page_table *last = mem->get_current_page_table();
-        mem->set_current_page_table(page_tab);
+        address_space *last = mem->get_current_address_space();
+        mem->set_current_address_space(addr_space);
         
         primary_thread
             = kern->create<kernel::thread>(
@@ -50,7 +50,7 @@ namespace eka2l1::kernel {
         ++thread_count;
 
         if (last) {
-            mem->set_current_page_table(*last);
+            mem->set_current_address_space(*last);
         }
 
         dll_lock = kern->create<kernel::mutex>(kern->get_timing_system(),
@@ -61,7 +61,7 @@ namespace eka2l1::kernel {
     process::process(kernel_system *kern, memory_system *mem)
         : kernel_obj(kern)
         , mem(mem)
-        , page_tab(mem->get_page_size()) {
+        , addr_space(mem->get_global_page_table(), mem->get_page_size()) {
         obj_type = kernel::object_type::process;
     }
 
@@ -77,7 +77,7 @@ namespace eka2l1::kernel {
         , mem(mem)
         , exe_path(exe_path)
         , cmd_args(cmd_args)
-        , page_tab(mem->get_page_size())
+        , addr_space(mem->get_global_page_table(), mem->get_page_size())
         , priority(pri)
         , codeseg(std::move(arg_codeseg))
         , process_handles(kern, handle_array_owner::process) {
@@ -139,12 +139,14 @@ namespace eka2l1::kernel {
     }
 
     void *process::get_ptr_on_addr_space(address addr) {
-        if (!page_tab.pointers[addr / page_tab.page_size]) {
+        page_table &table = addr_space.get_page_table();
+        std::uint8_t *page_ptr = table.get_pointer(addr / table.page_size);
+
+        if (!page_ptr) {
             return nullptr;
         }
 
-        return static_cast<void *>(page_tab.pointers[addr / page_tab.page_size]
-            + addr % page_tab.page_size);
+        return static_cast<void *>(page_ptr + addr % table.page_size);
     }
 
     // EKA2L1 doesn't use multicore yet, so rendezvous and logon
@@ -219,6 +221,10 @@ namespace eka2l1::kernel {
 
         logon_requests.clear();
         rendezvous_requests.clear();
+
+        LOG_TRACE("Process {} page table uses {} KB of host memory, saved {} KB", process_name,
+            addr_space.get_page_table().get_host_memory_usage() / 1024,
+            (page_table::get_flat_host_memory_usage() - addr_space.get_page_table().get_host_memory_usage()) / 1024);
     }
 
     void process::wait_dll_lock() {
@@ -18,6 +18,7 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include <algorithm>
+#include <common/algorithm.h>
 #include <common/log.h>
 #include <epoc/kernel.h>
 #include <epoc/kernel/scheduler.h>
@@ -40,11 +41,10 @@ static void wake_thread(uint64_t ud, int cycles_late) {
 }
 
 namespace eka2l1 {
-    bool thread_comparator::operator()(const thread_ptr &x, const thread_ptr &y) const {
-        return *x < *y;
-    }
-
     namespace kernel {
+        // Time a thread runs before yielding to a ready thread of the same priority
+        static constexpr int time_slice_us = 20000;
+
         thread_scheduler::thread_scheduler(kernel_system *kern, timing_system *timing, arm::arm_interface &jit)
             : kern(kern)
             , timing(timing)
@@ -59,15 +59,29 @@ namespace eka2l1 {
             }
         }
 
+        bool thread_scheduler::is_time_slice_expired(const thread_ptr &thr) {
+            return timing->get_ticks() - thr->time_slice_start >= static_cast<std::uint64_t>(timing->us_to_cycles(time_slice_us));
+        }
+
         void thread_scheduler::switch_context(thread_ptr oldt, thread_ptr newt) {
+            if (oldt && oldt == newt) {
+                return;
+            }
+
             if (oldt) {
                 oldt->lrt = timing->get_ticks();
                 jitter->save_context(oldt->ctx);
 
-                // If it's still in run
+                // If it's still in run, it was preempted. It keeps its place in the queue,
+                // unless it has used up its time slice.
                 if (oldt->state == thread_state::run) {
-                    ready_threads.emplace(oldt);
                     oldt->state = thread_state::ready;
+
+                    if (is_time_slice_expired(oldt)) {
+                        ready_threads.push_back(oldt);
+                    } else {
+                        ready_threads.push_front(oldt);
+                    }
                 }
             }
 
@@ -77,15 +91,16 @@ namespace eka2l1 {
 
                 crr_thread = newt;
                 crr_thread->state = thread_state::run;
+                crr_thread->time_slice_start = timing->get_ticks();
 
                 if (!oldt || oldt->owning_process() != newt->owning_process()) {
                     crr_process = newt->owning_process();
 
                     memory_system *mem = kern->get_memory_system();
-                    mem->set_current_page_table(crr_process->get_page_table());
+                    mem->set_current_address_space(crr_process->get_address_space());
                 }
 
-                ready_threads.remove(newt);
+                ready_threads.remove(newt.get());
                 jitter->load_context(crr_thread->ctx);
 
                 LOG_TRACE("Switched to {}", crr_thread->name());
@@ -97,22 +112,21 @@ namespace eka2l1 {
         thread_ptr thread_scheduler::next_ready_thread() {
             thread_ptr crr = current_thread();
 
-            if (ready_threads.size() == 0) {
-                return nullptr;
-            }
-
             if (crr && crr->current_state() == thread_state::run) {
-                if (ready_threads.top()->current_real_priority() <= crr->current_real_priority()) {
+                const int crr_priority = ready_queue::clamp_priority(crr->current_real_priority());
+                const int ready_priority = ready_threads.highest_priority();
+
+                if (ready_priority < crr_priority) {
                     return crr;
                 }
 
-                return nullptr;
+                // Round robin with threads of the same priority
+                if (ready_priority == crr_priority && !is_time_slice_expired(crr)) {
+                    return crr;
+                }
             }
 
-            auto next = ready_threads.top();
-            ready_threads.pop();
-
-            return next;
+            return ready_threads.pop_highest();
         }
 
         void thread_scheduler::reschedule() {
@@ -129,7 +143,7 @@ namespace eka2l1 {
             }
 
             thr->state = thread_state::ready;
-            ready_threads.push(thr);
+            ready_threads.push_back(thr);
 
             return true;
         }
@@ -146,7 +160,10 @@ namespace eka2l1 {
 
             thr->state = thread_state::wait;
 
-            waiting_threads.push_back(thr);
+            if (!thr->in_wait_list) {
+                thr->in_wait_list = true;
+                waiting_count++;
+            }
 
             // Schedule the thread to be waken up
             timing->schedule_event(sl_time, wakeup_evt,
@@ -167,16 +184,18 @@ namespace eka2l1 {
                 return false;
             }
 
-            waiting_threads.push_back(thr);
+            if (!thr->in_wait_list) {
+                thr->in_wait_list = true;
+                waiting_count++;
+            }
+
             kern->prepare_reschedule();
 
             return true;
         }
 
         bool thread_scheduler::resume(thread_ptr thr) {
-            auto res = std::find(waiting_threads.begin(), waiting_threads.end(), thr);
-
-            if (res == waiting_threads.end()) {
+            if (!thr->in_wait_list) {
                 // Thread is not in wait
                 return false;
             }
@@ -193,8 +212,10 @@ namespace eka2l1 {
 
             thr->state = thread_state::ready;
 
-            waiting_threads.erase(res);
-            ready_threads.push(thr);
+            thr->in_wait_list = false;
+            waiting_count--;
+
+            ready_threads.push_back(thr);
 
             kern->prepare_reschedule();
 
@@ -202,33 +223,23 @@ namespace eka2l1 {
         }
 
         void thread_scheduler::unschedule(thread_ptr thr) {
-            auto res = std::find(ready_threads.begin(), ready_threads.end(), thr);
-
-            if (res == ready_threads.end()) {
-                // Thread is not in ready
-                return;
-            }
-
-            ready_threads.remove(thr);
+            ready_threads.remove(thr.get());
         }
 
         bool thread_scheduler::stop(thread_ptr thr) {
             timing->unschedule_event(wakeup_evt, reinterpret_cast<uint64_t>(thr.get()));
 
-            if (thr->state == thread_state::ready) {
+            if (ready_queue::is_queued(thr.get())) {
                 unschedule(thr);
             } else if (thr->state == thread_state::run) {
                 if (thr != crr_thread) {
                     return false;
                 }
+            } else if (thr->in_wait_list) {
+                thr->in_wait_list = false;
+                waiting_count--;
             } else if (thr->state == thread_state::wait || thr->state == thread_state::wait_fast_sema) {
-                auto thr_wait = std::find(waiting_threads.begin(), waiting_threads.end(), thr);
-
-                if (thr_wait != waiting_threads.end()) {
-                    waiting_threads.erase(thr_wait);
-                } else {
-                    return false;
-                }
+                return false;
             }
 
             thr->state = thread_state::stop;
@@ -241,8 +252,8 @@ namespace eka2l1 {
             return true;
         }
 
-        void thread_scheduler::refresh() {
-            ready_threads.resort();
+        void thread_scheduler::requeue(thread *thr) {
+            ready_threads.requeue(thr);
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <epoc/kernel/svc_table.h>
+
+namespace eka2l1::hle {
+    import_func_ptr *svc_table::get_slot(const std::uint32_t svcnum) {
+        const std::uint32_t idx = svcnum & ~fast_exec_base;
+
+        if (idx >= table_size) {
+            return nullptr;
+        }
+
+        return (svcnum & fast_exec_base) ? &fast_svcs[idx] : &slow_svcs[idx];
+    }
+
+    bool svc_table::add(const std::uint32_t svcnum, const epoc_import_func &svc) {
+        import_func_ptr *slot = get_slot(svcnum);
+
+        if (!slot) {
+            return false;
+        }
+
+        *slot = svc.func;
+        svc_names[svcnum] = svc.name;
+
+        return true;
+    }
+
+    void svc_table::clear() {
+        slow_svcs.fill(nullptr);
+        fast_svcs.fill(nullptr);
+        slow_svc_counts.fill(0);
+        fast_svc_counts.fill(0);
+
+        svc_names.clear();
+    }
+
+    const std::string *svc_table::get_name(const std::uint32_t svcnum) const {
+        auto res = svc_names.find(svcnum);
+        return (res == svc_names.end()) ? nullptr : &res->second;
+    }
+
+    std::uint64_t svc_table::get_call_count(const std::uint32_t svcnum) const {
+        const std::uint32_t idx = svcnum & ~fast_exec_base;
+
+        if (idx >= table_size) {
+            return 0;
+        }
+
+        return (svcnum & fast_exec_base) ? fast_svc_counts[idx] : slow_svc_counts[idx];
+    }
+}
@@ -317,26 +317,15 @@ namespace eka2l1 {
         }
 
         tls_slot *thread::get_tls_slot(uint32_t handle, uint32_t dll_uid) {
-            for (uint32_t i = 0; i < ldata.tls_slots.size(); i++) {
-                if (ldata.tls_slots[i].handle != -1 && ldata.tls_slots[i].handle == handle) {
-                    return &ldata.tls_slots[i];
-                }
-            }
-
-            for (uint32_t i = 0; i < ldata.tls_slots.size(); i++) {
-                if (ldata.tls_slots[i].handle == -1) {
-                    ldata.tls_slots[i].handle = handle;
-                    ldata.tls_slots[i].uid = dll_uid;
-
-                    return &ldata.tls_slots[i];
-                }
-            }
+            return ldata.tls_slots.get_or_add(static_cast<int>(handle), static_cast<int>(dll_uid));
+        }
 
-            return nullptr;
+        tls_slot *thread::find_tls_slot(uint32_t handle) {
+            return ldata.tls_slots.find(static_cast<int>(handle));
         }
 
         void thread::close_tls_slot(tls_slot &slot) {
-            slot.handle = -1;
+            ldata.tls_slots.remove(slot.handle);
         }
 
         void thread::after(eka2l1::ptr<epoc::request_status> sts, uint32_t mssecs) {
@@ -408,18 +397,14 @@ namespace eka2l1 {
                 }
             }
 
-            if (state == kernel::thread_state::ready || state == kernel::thread_state::hold_mutex_pending) {
-                scheduler->refresh();
+            if (ready_queue::is_queued(this)) {
+                scheduler->requeue(this);
             }
         }
 
         void thread::set_priority(const thread_priority new_pri) {
             priority = new_pri;
 
-            if (state == kernel::thread_state::ready) {
-                scheduler->refresh();
-            }
-
             update_priority();
             kern->prepare_reschedule();
         }
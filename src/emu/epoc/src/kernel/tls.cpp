@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <epoc/kernel/tls.h>
+
+namespace eka2l1::kernel {
+    tls_table::tls_table()
+        : slots(initial_capacity) {
+    }
+
+    std::size_t tls_table::home_of(const int handle) const {
+        // Handles are mostly addresses with the low bits clear, mix them with a Fibonacci hash
+        const std::uint32_t hash = static_cast<std::uint32_t>(handle) * 0x9E3779B9U;
+        return (hash >> 16) & (slots.size() - 1);
+    }
+
+    void tls_table::grow() {
+        std::vector<tls_slot> old_slots(slots.size() * 2);
+        old_slots.swap(slots);
+
+        const std::size_t mask = slots.size() - 1;
+
+        for (const tls_slot &slot : old_slots) {
+            if (slot.handle == -1) {
+                continue;
+            }
+
+            std::size_t idx = home_of(slot.handle);
+
+            while (slots[idx].handle != -1) {
+                idx = (idx + 1) & mask;
+            }
+
+            slots[idx] = slot;
+        }
+
+        mru = 0;
+    }
+
+    tls_slot *tls_table::find(const int handle) {
+        if (handle == -1) {
+            return nullptr;
+        }
+
+        if (slots[mru].handle == handle) {
+            return &slots[mru];
+        }
+
+        const std::size_t mask = slots.size() - 1;
+
+        for (std::size_t idx = home_of(handle); slots[idx].handle != -1; idx = (idx + 1) & mask) {
+            if (slots[idx].handle == handle) {
+                mru = idx;
+                return &slots[idx];
+            }
+        }
+
+        return nullptr;
+    }
+
+    tls_slot *tls_table::get_or_add(const int handle, const int uid) {
+        if (tls_slot *slot = find(handle)) {
+            return slot;
+        }
+
+        if (handle == -1) {
+            return nullptr;
+        }
+
+        if ((count + 1) * 4 > slots.size() * 3) {
+            grow();
+        }
+
+        const std::size_t mask = slots.size() - 1;
+        std::size_t idx = home_of(handle);
+
+        while (slots[idx].handle != -1) {
+            idx = (idx + 1) & mask;
+        }
+
+        slots[idx].handle = handle;
+        slots[idx].uid = uid;
+        slots[idx].pointer = ptr<void>(0);
+
+        count++;
+        mru = idx;
+
+        return &slots[idx];
+    }
+
+    bool tls_table::remove(const int handle) {
+        tls_slot *slot = find(handle);
+
+        if (!slot) {
+            return false;
+        }
+
+        const std::size_t mask = slots.size() - 1;
+        std::size_t hole = static_cast<std::size_t>(slot - slots.data());
+
+        // Shift the rest of the probe run back, so no lookup stops early at the hole
+        for (std::size_t idx = (hole + 1) & mask; slots[idx].handle != -1; idx = (idx + 1) & mask) {
+            const std::size_t home = home_of(slots[idx].handle);
+
+            // Move the slot only if the hole is between its home and where it is now
+            if (((idx - home) & mask) >= ((idx - hole) & mask)) {
+                slots[hole] = slots[idx];
+                hole = idx;
+            }
+        }
+
+        slots[hole] = tls_slot{};
+        count--;
+
+        return true;
+    }
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <common/algorithm.h>
+#include <common/chunkyseri.h>
+#include <common/fileutils.h>
+#include <common/log.h>
+#include <common/path.h>
+#include <common/virtualmem.h>
+
+#include <epoc/loader/codeseg_cache.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+namespace eka2l1::loader {
+    // Bump when the entry layout changes
+    static constexpr std::int16_t codeseg_cache_version = 1;
+
+    // Code is aligned in the cache file, so it's copied from aligned host memory
+    static constexpr std::uint32_t codeseg_cache_payload_align = 16;
+
+    static std::string lowercase_path(std::string path) {
+        std::transform(path.begin(), path.end(), path.begin(),
+            [](unsigned char c) -> char { return static_cast<char>(std::tolower(c)); });
+
+        return path;
+    }
+
+    codeseg_cache_entry::~codeseg_cache_entry() {
+        if (file_map) {
+            common::unmap_file(file_map, file_map_size);
+        }
+    }
+
+    bool codeseg_cache_entry::do_state(common::chunkyseri &seri) {
+        auto section = seri.section("CodesegCache", codeseg_cache_version);
+
+        if (!section) {
+            return false;
+        }
+
+        // Headers are stored as they are in memory, so a change of their layout invalidates the entry
+        std::uint32_t header_size = sizeof(e32img_header);
+        std::uint32_t header_extended_size = sizeof(e32img_header_extended);
+
+        seri.absorb(header_size);
+        seri.absorb(header_extended_size);
+
+        if ((header_size != sizeof(e32img_header)) || (header_extended_size != sizeof(e32img_header_extended))) {
+            return false;
+        }
+
+        seri.absorb(epoc_ver);
+        seri.absorb_impl(reinterpret_cast<std::uint8_t *>(&header), sizeof(e32img_header));
+        seri.absorb_impl(reinterpret_cast<std::uint8_t *>(&header_extended), sizeof(e32img_header_extended));
+        seri.absorb(has_extended_header);
+
+        seri.absorb_container(export_dir);
+        seri.absorb_container(dll_names, [](common::chunkyseri &seri, std::string &name) {
+            seri.absorb(name);
+        });
+
+        seri.absorb(code_addr);
+        seri.absorb(data_addr);
+        seri.absorb_container(dependency_hashes);
+
+        seri.absorb(code_size);
+        seri.absorb(data_size);
+        seri.absorb(payload_offset);
+
+        return !seri.eos() || (seri.get_seri_mode() != common::SERI_MODE_READ);
+    }
+
+    e32img make_e32img_from_cache(codeseg_cache_entry_ptr entry) {
+        e32img img;
+
+        img.epoc_ver = entry->epoc_ver;
+        img.header = entry->header;
+        img.header_extended = entry->header_extended;
+        img.has_extended_header = entry->has_extended_header;
+        img.ed.syms = entry->export_dir;
+        img.uncompressed_size = 0;
+
+        img.import_section.size = 0;
+        img.import_section.imports.resize(entry->dll_names.size());
+
+        for (std::size_t i = 0; i < entry->dll_names.size(); i++) {
+            img.import_section.imports[i].dll_name = entry->dll_names[i];
+            img.import_section.imports[i].number_of_imports = 0;
+        }
+
+        img.dll_names = entry->dll_names;
+        img.cache_entry = std::move(entry);
+
+        return img;
+    }
+
+    codeseg_cache::codeseg_cache(const std::string &folder)
+        : folder(folder) {
+        eka2l1::create_directories(folder);
+        load_index();
+    }
+
+    codeseg_cache::~codeseg_cache() {
+        flush();
+    }
+
+    std::string codeseg_cache::get_entry_path(const std::uint64_t hash, const epocver ver) const {
+        std::ostringstream name;
+        name << std::hex;
+        name.width(16);
+        name.fill('0');
+        name << hash;
+        name << std::dec << '_' << static_cast<int>(ver) << ".cseg";
+
+        return eka2l1::add_path(folder, name.str());
+    }
+
+    std::string codeseg_cache::get_index_path() const {
+        return eka2l1::add_path(folder, "index.txt");
+    }
+
+    void codeseg_cache::load_index() {
+        std::ifstream index(get_index_path());
+        std::string line;
+
+        // One image per line: hash, size, last write time, then the path until the end of the line
+        while (std::getline(index, line)) {
+            std::istringstream line_stream(line);
+            source_info info;
+
+            if (!(line_stream >> std::hex >> info.hash >> std::dec >> info.size >> info.last_write)) {
+                continue;
+            }
+
+            std::string path;
+            std::getline(line_stream >> std::ws, path);
+
+            if (!path.empty()) {
+                sources[path] = info;
+            }
+        }
+    }
+
+    void codeseg_cache::flush() {
+        if (!sources_changed) {
+            return;
+        }
+
+        std::ofstream index(get_index_path(), std::ios::trunc);
+
+        if (!index) {
+            LOG_WARN("Unable to write the codeseg cache index");
+            return;
+        }
+
+        for (const auto &[path, info] : sources) {
+            index << std::hex << info.hash << std::dec << ' ' << info.size << ' ' << info.last_write << ' '
+                  << path << '\n';
+        }
+
+        sources_changed = false;
+    }
+
+    codeseg_cache_entry_ptr codeseg_cache::find(const std::string &path, const std::uint64_t size,
+        const std::uint64_t last_write, const epocver ver) {
+        const auto source = sources.find(lowercase_path(path));
+
+        if (source == sources.end() || source->second.size != size || source->second.last_write != last_write) {
+            return nullptr;
+        }
+
+        const std::string entry_path = get_entry_path(source->second.hash, ver);
+        const std::int64_t entry_size = common::file_size(entry_path);
+
+        if (entry_size <= 0) {
+            return nullptr;
+        }
+
+        auto entry = std::make_shared<codeseg_cache_entry>();
+
+        entry->file_map = common::map_file(entry_path);
+        entry->file_map_size = static_cast<std::size_t>(entry_size);
+
+        if (!entry->file_map) {
+            return nullptr;
+        }
+
+        std::uint8_t *map_base = reinterpret_cast<std::uint8_t *>(entry->file_map);
+        common::chunkyseri seri(map_base, entry->file_map_size, common::SERI_MODE_READ);
+
+        if (!entry->do_state(seri) || (entry->epoc_ver != ver)
+            || (static_cast<std::uint64_t>(entry->payload_offset) + common::align(entry->code_size, codeseg_cache_payload_align)
+                   + entry->data_size > entry->file_map_size)) {
+            LOG_WARN("Codeseg cache entry of {} is corrupted", path);
+            return nullptr;
+        }
+
+        entry->code = map_base + entry->payload_offset;
+        entry->data = entry->code + common::align(entry->code_size, codeseg_cache_payload_align);
+
+        return entry;
+    }
+
+    bool codeseg_cache::store(const std::string &path, const std::uint64_t size, const std::uint64_t last_write,
+        const std::uint64_t content_hash, codeseg_cache_entry &entry) {
+        // Measure the metadata first, the payload follows it
+        common::chunkyseri measure(nullptr, 0, common::SERI_MODE_MESAURE);
+        entry.do_state(measure);
+
+        entry.payload_offset = static_cast<std::uint32_t>(common::align(measure.size(), codeseg_cache_payload_align));
+
+        const std::uint32_t code_size_align = static_cast<std::uint32_t>(common::align(entry.code_size, codeseg_cache_payload_align));
+        std::vector<std::uint8_t> buf(entry.payload_offset + code_size_align + entry.data_size, 0);
+
+        common::chunkyseri seri(buf.data(), buf.size(), common::SERI_MODE_WRITE);
+        entry.do_state(seri);
+
+        std::copy(entry.code, entry.code + entry.code_size, buf.begin() + entry.payload_offset);
+        std::copy(entry.data, entry.data + entry.data_size, buf.begin() + entry.payload_offset + code_size_align);
+
+        // Write aside then move, so a crash doesn't leave a half written entry behind
+        const std::string entry_path = get_entry_path(content_hash, entry.epoc_ver);
+        const std::string temp_path = entry_path + ".tmp";
+
+        {
+            std::ofstream entry_file(temp_path, std::ios::binary | std::ios::trunc);
+
+            if (!entry_file.write(reinterpret_cast<const char *>(buf.data()), buf.size())) {
+                LOG_WARN("Unable to write codeseg cache entry of {}", path);
+                return false;
+            }
+        }
+
+        common::remove(entry_path);
+
+        if (!common::move_file(temp_path, entry_path)) {
+            LOG_WARN("Unable to write codeseg cache entry of {}", path);
+            return false;
+        }
+
+        sources[lowercase_path(path)] = source_info{ size, last_write, content_hash };
+        sources_changed = true;
+
+        return true;
+    }
+}
@@ -151,12 +151,55 @@ namespace eka2l1 {
             }
         }
 
-        std::optional<e32img> parse_e32img(symfile ef, bool read_reloc) {
+        // Decompress the rest of a bytepair image, but only the code pages the loader reads itself:
+        // the import address table and the export directory. The code stream is kept for the rest.
+        static bool read_bytepair_image_on_demand(e32img &img, std::vector<uint8_t> &compressed) {
+            common::ibytepair_stream rest_stream(compressed.data(), compressed.size());
+
+            if (!rest_stream.read_table()) {
+                return false;
+            }
+
+            rest_stream.skip_pages();
+
+            const uint32_t restsize = rest_stream.read_pages(&img.data[img.header.code_offset + img.header.code_size],
+                img.uncompressed_size - img.header.code_size);
+
+            if (restsize != img.uncompressed_size - img.header.code_size) {
+                LOG_WARN("Bytepair image data decompressed to {} bytes, expected {}", restsize,
+                    img.uncompressed_size - img.header.code_size);
+            }
+
+            img.code_pages = std::make_shared<common::ibytepair_stream>(std::move(compressed));
+            img.code_pages->read_table();
+
+            // Offsets are from the start of the code
+            auto read_code_range = [&](const uint32_t beg, const uint32_t end) {
+                for (uint32_t page = beg / common::BYTEPAIR_PAGE_SIZE; page * common::BYTEPAIR_PAGE_SIZE < common::min(end, img.header.code_size); page++) {
+                    const uint32_t page_off = page * common::BYTEPAIR_PAGE_SIZE;
+
+                    img.code_pages->read_page(&img.data[img.header.code_offset + page_off], page,
+                        img.header.code_size - page_off);
+                }
+            };
+
+            read_code_range(img.header.text_size, img.header.code_size);
+
+            if (img.header.export_dir_offset > img.header.code_offset) {
+                const uint32_t export_dir_beg = img.header.export_dir_offset - img.header.code_offset;
+                read_code_range(export_dir_beg, export_dir_beg + img.header.export_dir_count * 4);
+            }
+
+            return true;
+        }
+
+        std::optional<e32img> parse_e32img(symfile ef, bool read_reloc, bool demand_paged) {
             if (!ef || ef->is_in_rom()) {
                 return std::nullopt;
             }
 
             e32img img;
+            img.demand_paged = demand_paged;
 
             auto file_size = ef->size();
 
@@ -236,7 +279,7 @@ namespace eka2l1 {
                 ef->seek(0, file_seek_mode::beg);
                 ef->read_file(img.data.data(), 1, img.header.code_offset);
 
-                std::vector<char> temp_buf(file_size - img.header.code_offset);
+                std::vector<uint8_t> temp_buf(file_size - img.header.code_offset);
 
                 ef->seek(img.header.code_offset, file_seek_mode::beg);
                 size_t bytes_read = ef->read_file(temp_buf.data(), 1, static_cast<uint32_t>(temp_buf.size()));
@@ -246,7 +289,7 @@ namespace eka2l1 {
                 }
 
                 if (ctype == compress_type::deflate_c) {
-                    flate::bit_input input(reinterpret_cast<uint8_t *>(temp_buf.data()),
+                    flate::bit_input input(temp_buf.data(),
                         static_cast<int>(temp_buf.size() * 8));
 
                     flate::inflater inflate_machine(input);
@@ -256,27 +299,21 @@ namespace eka2l1 {
                         img.uncompressed_size);
 
                     LOG_INFO("Readed compress, size: {}", readed);
-
-                    FILE *tempfile = fopen("nokiaDeflatedTemp.seg", "wb");
-                    fwrite(img.data.data(), 1, img.data.size(), tempfile);
-                    fclose(tempfile);
-
                 } else if (ctype == compress_type::byte_pair_c) {
-                    auto crr_pos = ef->tell();
-
-                    std::vector<char> temp(ef->size() - img.header.code_offset);
-                    ef->seek(img.header.code_offset, file_seek_mode::beg);
-
-                    ef->read_file(temp.data(), 1, static_cast<uint32_t>(temp.size()));
-
-                    FILE *tempfile = fopen("bytepairTemp.seg", "wb");
-                    fwrite(temp.data(), 1, temp.size(), tempfile);
-                    fclose(tempfile);
-
-                    common::ibytepair_stream bpstream("bytepairTemp.seg", 0);
-
-                    auto codesize = bpstream.read_pages(&img.data[img.header.code_offset], img.header.code_size);
-                    auto restsize = bpstream.read_pages(&img.data[img.header.code_offset + img.header.code_size], img.uncompressed_size);
+                    if (demand_paged && read_bytepair_image_on_demand(img, temp_buf)) {
+                        LOG_INFO("Code left compressed, size: {}", img.header.code_size);
+                    } else {
+                        // Code and the rest are two bytepair streams, one after another
+                        common::ibytepair_stream bpstream(temp_buf.data(), temp_buf.size());
+
+                        const uint32_t codesize = bpstream.read_pages(&img.data[img.header.code_offset], img.header.code_size);
+                        const uint32_t restsize = bpstream.read_pages(&img.data[img.header.code_offset + img.header.code_size],
+                            img.uncompressed_size - img.header.code_size);
+
+                        if (codesize + restsize != img.uncompressed_size) {
+                            LOG_WARN("Bytepair image decompressed to {} bytes, expected {}", codesize + restsize, img.uncompressed_size);
+                        }
+                    }
                 }
             } else {
                 img.uncompressed_size = static_cast<uint32_t>(file_size);
@@ -23,186 +23,178 @@
 
 #include <epoc/loader/rom.h>
 
+#include <cstring>
+#include <cwctype>
+
 namespace eka2l1 {
     namespace loader {
         enum class file_attrib {
             dir = 0x0010
         };
 
-        uint32_t rom_to_offset(address romstart, address off) {
-            return off - romstart;
-        }
+        // Size, address, attribute and name length, the name follows
+        static constexpr std::uint32_t rom_entry_header_size = 10;
 
-        rom_header read_rom_header(FILE *file) {
-            rom_header header;
-
-            fread(header.jump, 1, sizeof(header.jump), file);
-            fread(&header.restart_vector, 1, 4, file);
-            fread(&header.time, 1, 8, file);
-            fread(&header.time_high, 1, 4, file);
-            fread(&header.rom_base, 1, 4, file);
-            fread(&header.rom_size, 1, 4, file);
-            fread(&header.rom_root_dir_list, 1, 4, file);
-            fread(&header.kern_data_address, 1, 4, file);
-            fread(&header.kern_limit, 1, 4, file);
-            fread(&header.primary_file, 1, 4, file);
-            fread(&header.secondary_file, 1, 4, file);
-            fread(&header.checksum, 1, 4, file);
-
-            // From this section, all read are invalid
-
-            // Symbian says those are for testing though
-            fread(&header.hardware, 1, 4, file);
-            fread(&header.lang, 1, 8, file);
-
-            fread(&header.kern_config_flags, 1, 4, file);
-            fread(&header.rom_exception_search_tab, 1, 4, file);
-            fread(&header.rom_header_size, 1, 4, file);
-
-            fread(&header.rom_section_header, 1, 4, file);
-            fread(&header.total_sv_data_size, 1, 4, file);
-            fread(&header.variant_file, 1, 4, file);
-            fread(&header.extension_file, 1, 4, file);
-            fread(&header.reloc_info, 1, 4, file);
-
-            fread(&header.old_trace_mask, 1, 4, file);
-            fread(&header.user_data_addr, 1, 4, file);
-            fread(&header.total_user_data_size, 1, 4, file);
-
-            fread(&header.debug_port, 1, 4, file);
-            fread(&header.major, 1, 1, file);
-            fread(&header.minor, 1, 1, file);
-            fread(&header.build, 1, 2, file);
-
-            fread(&header.compress_type, 1, 4, file);
-            fread(&header.compress_size, 1, 4, file);
-            fread(&header.uncompress_size, 1, 4, file);
-            fread(&header.disabled_caps, 4, 2, file);
-            fread(&header.trace_mask, 4, 8, file);
-            fread(&header.initial_btrace_filter, 1, 4, file);
-
-            fread(&header.initial_btrace_buf, 1, 4, file);
-            fread(&header.initial_btrace_mode, 1, 4, file);
-
-            fread(&header.pageable_rom_start, 1, 4, file);
-            fread(&header.pageable_rom_size, 1, 4, file);
-
-            fread(&header.rom_page_idx, 1, 4, file);
-            fread(&header.compressed_unpaged_start, 1, 4, file);
-
-            fread(&header.unpaged_compressed_size, 1, 4, file);
-            fread(&header.hcr_file_addr, 1, 4, file);
-            fread(header.spare, 4, 36, file);
-
-            return header;
-        }
+        // Real ROMs are nowhere near this, it's there to stop on directories that loop
+        static constexpr int max_rom_dir_depth = 64;
 
-        rom_dir read_rom_dir(rom &romf);
+        // The ROM as it's mapped in host memory
+        struct rom_view {
+            const std::uint8_t *data;
+            std::size_t size;
+            address base;
+        };
 
-        rom_entry read_rom_entry(rom &romf, rom_dir *mother) {
-            rom_entry entry;
-            FILE *file = romf.handler;
+        const std::uint8_t *get_rom_data(const rom_view &view, const address addr, const std::size_t size) {
+            const std::size_t off = addr - view.base;
 
-            fread(&entry.size, 1, 4, file);
-            fread(&entry.address_lin, 1, 4, file);
-            fread(&entry.attrib, 1, 1, file);
-            fread(&entry.name_len, 1, 1, file);
+            if ((addr < view.base) || (off > view.size) || (size > view.size - off)) {
+                return nullptr;
+            }
 
-            entry.name.resize(entry.name_len);
+            return view.data + off;
+        }
+
+        template <typename T>
+        bool read_rom_data(const rom_view &view, const address addr, T &dest) {
+            const std::uint8_t *src = get_rom_data(view, addr, sizeof(T));
+
+            if (!src) {
+                return false;
+            }
 
-            fread(entry.name.data(), 2, entry.name_len, file);
+            std::memcpy(&dest, src, sizeof(T));
+            return true;
+        }
 
-            if (entry.attrib & (int)file_attrib::dir) {
-                auto crr_pos = ftell(file);
-                fseek(file, rom_to_offset(romf.header.rom_base, entry.address_lin), SEEK_SET);
-                entry.dir = std::make_optional<rom_dir>(read_rom_dir(romf));
-                entry.dir->name = entry.name;
-                mother->subdirs.push_back(entry.dir.value());
-                fseek(file, crr_pos, SEEK_SET);
+        char16_t fold_rom_path_char(const char16_t c) {
+            if (c == u'/') {
+                return u'\\';
             }
 
-            return entry;
+            return static_cast<char16_t>(std::towlower(c));
         }
 
-        rom_dir read_rom_dir(rom &romf) {
-            rom_dir dir;
+        /*! \brief Add the files of a directory and its subdirectories to the index.
+         *
+         * \param dir_path Lowercase path of the directory, with a trailing separator if it's not the root.
+        */
+        bool index_rom_dir(rom &romf, const rom_view &view, const address dir_addr, const utf16_str &dir_path,
+            const int depth) {
+            std::int32_t dir_size = 0;
 
-            auto old_off = ftell(romf.handler);
+            if ((depth > max_rom_dir_depth) || !read_rom_data(view, dir_addr, dir_size) || (dir_size < 0)) {
+                return false;
+            }
 
-            fread(&dir.size, 1, 4, romf.handler);
+            address entry_addr = dir_addr + 4;
 
-            while (ftell(romf.handler) - old_off < dir.size) {
-                dir.entries.push_back(read_rom_entry(romf, &dir));
+            while (entry_addr - dir_addr < static_cast<std::uint32_t>(dir_size)) {
+                const std::uint8_t *entry_data = get_rom_data(view, entry_addr, rom_entry_header_size);
 
-                if (ftell(romf.handler) % 4 != 0) {
-                    fseek(romf.handler, 2, SEEK_CUR);
+                if (!entry_data) {
+                    return false;
                 }
-            }
 
-            // Sort this for lower_bound binary search
-            std::sort(dir.entries.begin(), dir.entries.end(), [](const rom_entry &lhs, const rom_entry &rhs) {
-                return common::compare_ignore_case(lhs.name, rhs.name) == -1;
-            });
+                rom_entry entry;
 
-            // Sort this for lower_bound binary search
-            std::sort(dir.subdirs.begin(), dir.subdirs.end(), [](const rom_dir &lhs, const rom_dir &rhs) {
-                return common::compare_ignore_case(lhs.name, rhs.name) == -1;
-            });
+                std::memcpy(&entry.size, entry_data, 4);
+                std::memcpy(&entry.address_lin, entry_data + 4, 4);
+                entry.attrib = entry_data[8];
 
-            return dir;
-        }
+                const std::uint32_t name_len = entry_data[9];
+                const std::uint8_t *name_data = get_rom_data(view, entry_addr + rom_entry_header_size, name_len * 2);
 
-        root_dir read_root_dir(rom &romf) {
-            root_dir rdir;
-            FILE *file = romf.handler;
+                if (!name_data) {
+                    return false;
+                }
 
-            fread(&rdir.hardware_variant, 1, 4, file);
-            fread(&rdir.addr_lin, 1, 4, file);
+                entry.name.resize(name_len);
+                std::memcpy(&entry.name[0], name_data, name_len * 2);
 
-            fseek(file, rom_to_offset(romf.header.rom_base, rdir.addr_lin), SEEK_SET);
+                utf16_str path;
+                path.reserve(dir_path.size() + name_len + 1);
+                path = dir_path;
+
+                for (const char16_t c : entry.name) {
+                    path += fold_rom_path_char(c);
+                }
+
+                if (entry.attrib & static_cast<int>(file_attrib::dir)) {
+                    if (!index_rom_dir(romf, view, entry.address_lin, path + u'\\', depth + 1)) {
+                        return false;
+                    }
+                } else {
+                    romf.entries.emplace(std::move(path), std::move(entry));
+                }
 
-            rdir.dir = read_rom_dir(romf);
+                // Entries are 4 bytes aligned
+                entry_addr = common::align(entry_addr + rom_entry_header_size + name_len * 2, 4);
+            }
 
-            return rdir;
+            return true;
         }
 
-        root_dir_list read_root_dir_list(rom &romf) {
-            root_dir_list list;
-            FILE *file = romf.handler;
+        // Loading rom supports only uncompressed rn
+        std::optional<rom> load_rom(const std::uint8_t *data, const std::size_t size) {
+            if (!data || (size < sizeof(rom_header))) {
+                return std::nullopt;
+            }
+
+            rom romf;
 
-            fread(&list.num_root_dirs, 1, 4, file);
+            // The header is laid out in the ROM as it is in the struct
+            std::memcpy(&romf.header, data, sizeof(rom_header));
 
-            for (int i = 0; i < list.num_root_dirs; i++) {
-                auto last_pos = ftell(file);
-                list.root_dirs.push_back(read_root_dir(romf));
-                fseek(file, last_pos, SEEK_SET);
+            const rom_view view{ data, size, romf.header.rom_base };
+
+            // Root directories are one per hardware variant, only the first one is used
+            std::int32_t root_dir_count = 0;
+            address root_dir_addr = 0;
+
+            if (!read_rom_data(view, romf.header.rom_root_dir_list, root_dir_count) || (root_dir_count <= 0)
+                || !read_rom_data(view, romf.header.rom_root_dir_list + 8, root_dir_addr)) {
+                LOG_ERROR("ROM has no root directory");
+                return std::nullopt;
             }
 
-            // Sort this for lower_bound binary search
-            std::sort(list.root_dirs.begin(), list.root_dirs.end(), [](const root_dir &lhs, const root_dir &rhs) {
-                return (common::compare_ignore_case(lhs.dir.name, rhs.dir.name) == -1);
-            });
+            if (!index_rom_dir(romf, view, root_dir_addr, u"", 0)) {
+                LOG_ERROR("ROM directory tree is corrupted");
+                return std::nullopt;
+            }
 
-            return list;
+            return romf;
         }
 
-        // Loading rom supports only uncompressed rn
-        std::optional<rom> load_rom(const std::string &path) {
-            rom romf;
-            romf.handler = fopen(path.c_str(), "rb");
+        const rom_entry *find_rom_entry(const rom &romf, const utf16_str &path) {
+            std::size_t start = 0;
 
-            if (!romf.handler) {
-                return std::optional<rom>{};
+            // Skip the drive
+            if ((path.size() >= 2) && (path[1] == u':')) {
+                start = 2;
             }
 
-            romf.header = read_rom_header(romf.handler);
+            utf16_str key;
+            key.reserve(path.size() - start);
 
-            // Seek to the first entry
-            fseek(romf.handler, rom_to_offset(romf.header.rom_base, romf.header.rom_root_dir_list), SEEK_SET);
+            for (std::size_t i = start; i < path.size(); i++) {
+                const char16_t c = fold_rom_path_char(path[i]);
 
-            romf.root = read_root_dir_list(romf);
+                // The index has no leading or repeated separators
+                if ((c == u'\\') && (key.empty() || (key.back() == u'\\'))) {
+                    continue;
+                }
 
-            return romf;
+                key += c;
+            }
+
+            auto entry_ite = romf.entries.find(key);
+
+            if (entry_ite == romf.entries.end()) {
+                return nullptr;
+            }
+
+            return &entry_ite->second;
         }
     }
 }
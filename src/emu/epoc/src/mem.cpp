@@ -40,65 +40,179 @@ namespace eka2l1 {
 
         cpu = jit.get();
 
-        page clear_page;
-        clear_page.generation = 0;
-        clear_page.sts = page_status::free;
-        clear_page.page_protection = prot::none;
-
-        std::fill(global_pages.begin(), global_pages.end(), clear_page);
-        std::fill(codeseg_pages.begin(), codeseg_pages.end(), clear_page);
+        global_table.page_size = page_size;
     }
 
     void memory_system::shutdown() {
         if (rom_map) {
-            common::unmap_file(rom_map);
+            common::unmap_file(rom_map, rom_size);
+            rom_map = nullptr;
         }
+
+        rom_path.clear();
+        rom_mapped = false;
+    }
+
+    bool memory_system::open_rom(const std::string &path) {
+        if (rom_map && (rom_path == path)) {
+            return true;
+        }
+
+        void *new_map = common::map_file(path);
+
+        if (!new_map) {
+            LOG_ERROR("Unable to map ROM file {}", path);
+            return false;
+        }
+
+        rom_map = new_map;
+        rom_size = common::file_size(path);
+        rom_path = path;
+        rom_mapped = false;
+
+        return true;
     }
 
     bool memory_system::map_rom(uint32_t addr, const std::string &path) {
+        if (!open_rom(path)) {
+            return false;
+        }
+
         rom_addr = addr;
-        rom_map = common::map_file(path);
-        rom_size = common::file_size(path);
+        rom_mapped = true;
 
         LOG_TRACE("Rom mapped to address: 0x{:x}", reinterpret_cast<uint64_t>(rom_map));
 
+        page rom_page;
+        rom_page.sts = page_status::committed;
+        rom_page.generation = 250;
+        rom_page.page_protection = prot::read_exec;
+
+        const std::uint32_t rom_page_off = rom_addr / page_size;
+
+        const std::uint32_t rom_page_count = static_cast<std::uint32_t>(common::align(rom_size, page_size) / page_size);
+
+        for (std::uint32_t i = 0; i < rom_page_count; i++) {
+            *global_table.get_page_info(rom_page_off + i, true) = rom_page;
+            *global_table.get_page_pointer(rom_page_off + i, true) = reinterpret_cast<uint8_t *>(rom_map) + i * page_size;
+        }
+
+        global_table.mark_pages(rom_page_off, rom_page_count, true);
+
         cpu->map_backing_mem(rom_addr, common::align(rom_size, page_size),
             reinterpret_cast<uint8_t *>(rom_map), prot::read_exec);
 
         return true;
     }
 
-    void *memory_system::get_real_pointer(address addr) {
-        // Fallback to slow get if there is no page table
-        if (!current_page_table) {
-            if (addr >= codeseg_addr && addr < codeseg_addr + 0x10000000) {
-                if (!codeseg_pointers[(addr - codeseg_addr) / page_size]) {
-                    return nullptr;
-                }
+    bool memory_system::is_global_addr(const address addr) const {
+        return (addr >= shared_addr && addr < shared_addr + shared_size)
+            || (addr >= codeseg_addr && addr < codeseg_addr + code_seg_section_size)
+            || (rom_mapped && addr >= rom_addr && addr < rom_addr + rom_size);
+    }
+
+    void memory_system::track_local_range(page_table *table, const address addr, const std::uint32_t size,
+        std::uint8_t *host, const prot protection) {
+        if (table != &global_table && current_addr_space) {
+            current_addr_space->add_local_range(addr, size, host, protection);
+        }
+    }
+
+    void memory_system::untrack_local_range(page_table *table, const address addr, const std::uint32_t size) {
+        if (table != &global_table && current_addr_space) {
+            current_addr_space->remove_local_range(addr, size);
+        }
+    }
+
+    page_table *memory_system::get_page_table_from_addr(const address addr) {
+        if (is_global_addr(addr)) {
+            return &global_table;
+        }
 
-                return static_cast<void *>(codeseg_pointers[(addr - codeseg_addr) / page_size] + (addr - codeseg_addr) % page_size);
+        return current_page_table;
+    }
+
+    void memory_system::add_page_fault_handler(const address addr, const std::uint32_t size, page_fault_handler handler) {
+        if (fault_ranges.empty()) {
+            fault_begin = addr;
+            fault_end = addr + size;
+        } else {
+            fault_begin = common::min(fault_begin, addr);
+            fault_end = common::max(fault_end, addr + size);
+        }
+
+        fault_ranges[addr] = page_fault_range{ size, std::move(handler) };
+    }
+
+    void memory_system::remove_page_fault_handler(const address addr) {
+        fault_ranges.erase(addr);
+
+        if (fault_ranges.empty()) {
+            fault_begin = 0;
+            fault_end = 0;
+
+            return;
+        }
+
+        // Ranges don't overlap, so the last one ends last
+        const auto &last = *fault_ranges.rbegin();
+
+        fault_begin = fault_ranges.begin()->first;
+        fault_end = last.first + last.second.size;
+    }
+
+    bool memory_system::handle_page_fault(const address addr, const std::uint32_t size) {
+        if (!may_fault(addr, size) || size == 0) {
+            return false;
+        }
+
+        const std::uint32_t page_beg = addr / page_size;
+        const std::uint32_t page_end = static_cast<std::uint32_t>((static_cast<std::uint64_t>(addr) + size - 1) / page_size + 1);
+
+        bool handled = false;
+
+        for (std::uint32_t i = page_beg; i < page_end; i++) {
+            const address page_addr = i * page_size;
+            page_table *table = get_page_table_from_addr(page_addr);
+            const page *info = table ? table->get_page_info(i) : nullptr;
+
+            // Only reserved pages are waiting to be filled
+            if (!info || info->sts != page_status::reserved) {
+                continue;
             }
 
-            if (addr >= rom_addr && addr < rom_addr + 0x10000000) {
-                return &reinterpret_cast<uint8_t *>(rom_map)[addr - rom_addr];
+            auto range = fault_ranges.upper_bound(page_addr);
+
+            if (range == fault_ranges.begin()) {
+                continue;
             }
 
-            if (addr >= shared_addr && addr < shared_addr + shared_size) {
-                if (!global_pointers[(addr - shared_addr) / page_size]) {
-                    return nullptr;
-                }
+            --range;
 
-                return static_cast<void *>(global_pointers[(addr - shared_addr) / page_size] + (addr - shared_addr) % page_size);
+            if (page_addr - range->first >= range->second.size) {
+                continue;
             }
 
-            return nullptr;
+            if (range->second.handler(page_addr)) {
+                handled = true;
+            }
         }
 
-        if (!current_page_table->pointers[addr / page_size]) {
+        return handled;
+    }
+
+    void *memory_system::get_real_pointer(address addr) {
+        if (may_fault(addr, 1)) {
+            handle_page_fault(addr);
+        }
+
+        std::uint8_t *page_ptr = get_access_page_table()->get_pointer(addr / page_size);
+
+        if (!page_ptr) {
             return nullptr;
         }
 
-        return static_cast<void *>(current_page_table->pointers[addr / page_size] + addr % page_size);
+        return static_cast<void *>(page_ptr + addr % page_size);
     }
 
     // Create a new chunk with specified address. Return base of chunk
@@ -115,83 +229,40 @@ namespace eka2l1 {
 
         top = common::min(top, max_grow);
 
-        size_t page_begin_off = (addr + page_size - 1) / page_size;
-        size_t page_end_off = (addr + max_grow - 1 + page_size) / page_size;
+        const std::uint32_t page_begin_off = (addr + page_size - 1) / page_size;
+        const std::uint32_t page_end_off = (addr + max_grow - 1 + page_size) / page_size;
 
-        page *page_begin;
-        page *page_end;
+        page_table *table = get_page_table_from_addr(addr);
 
-        size_t len = common::GB(4);
-
-        if (addr >= shared_addr && addr < shared_addr + shared_size) {
-            page_begin = global_pages.data() + (page_begin_off - (shared_addr / page_size));
-            page_end = global_pages.data() + (page_end_off - (shared_addr / page_size));
-        } else if (addr >= codeseg_addr && addr < codeseg_addr + 0x10000000) {
-            page_begin = codeseg_pages.data() + (page_begin_off - ((codeseg_addr) / page_size));
-            page_end = codeseg_pages.data() + (page_end_off - ((codeseg_addr) / page_size));
-        } else {
-            page_begin = current_page_table->pages.data() + page_begin_off;
-            page_end = current_page_table->pages.data() + page_end_off;
+        if (!table) {
+            return ptr<void>(0);
         }
 
-        const size_t count = page_end_off - page_begin_off;
-
-        for (auto ite = page_begin; ite != page_end; ite++) {
-            // If the page is not free, than either it's reserved or commited
-            // We can not make a new chunk on those pages
-            if (ite->sts != page_status::free) {
-                return ptr<void>(0);
-            }
-
-            ite->sts = page_status::reserved;
+        // If a page is not free, than either it's reserved or commited
+        // We can not make a new chunk on those pages
+        if (!table->is_range_free(page_begin_off, page_end_off - page_begin_off)) {
+            return ptr<void>(0);
         }
 
         const gen generation = ++generations;
+        const size_t count = page_end_off - page_begin_off;
 
         // We commit them later, so as well as assigned there protect first
         page new_page = { generation, page_status::reserved, cprot };
+        std::uint8_t *host_base = static_cast<uint8_t *>(common::map_memory(count * page_size));
 
-        std::fill(page_begin, page_end, new_page);
-
-        if (addr >= shared_addr && addr < shared_addr + shared_size) {
-            global_pointers[page_begin_off - (shared_addr / page_size)]
-                = static_cast<uint8_t *>(common::map_memory(count * page_size));
-
-            for (size_t i = page_begin_off - (shared_addr / page_size) + 1; i < page_end_off - (shared_addr / page_size); i++) {
-                global_pointers[i] = global_pointers[i - 1] + page_size;
-            }
-
-            if (current_page_table) {
-                std::copy(global_pages.begin() + (page_begin_off - (shared_addr / page_size)),
-                    global_pages.begin() + (page_end_off - (shared_addr / page_size)), current_page_table->pages.begin() + page_begin_off);
-
-                std::copy(global_pointers.begin() + (page_begin_off - (shared_addr / page_size)),
-                    global_pointers.begin() + (page_end_off - (shared_addr / page_size)), current_page_table->pointers.begin() + page_begin_off);
-            }
-        } else if (addr >= ram_code_addr && addr < codeseg_addr + 0x10000000) {
-            codeseg_pointers[page_begin_off - (ram_code_addr / page_size)]
-                = static_cast<uint8_t *>(common::map_memory(count * page_size));
-
-            for (size_t i = page_begin_off - (ram_code_addr / page_size) + 1; i < page_end_off - (ram_code_addr / page_size); i++) {
-                codeseg_pointers[i] = codeseg_pointers[i - 1] + page_size;
-            }
-
-            if (current_page_table) {
-                std::copy(codeseg_pages.begin() + (page_begin_off - (codeseg_addr / page_size)),
-                    codeseg_pages.begin() + (page_end_off - (codeseg_addr / page_size)), current_page_table->pages.begin() + page_begin_off);
-
-                std::copy(codeseg_pointers.begin() + (page_begin_off - (codeseg_addr / page_size)),
-                    codeseg_pointers.begin() + (page_end_off - (codeseg_addr / page_size)), current_page_table->pointers.begin() + page_begin_off);
-            }
-        } else {
-            current_page_table->pointers[page_begin_off]
-                = static_cast<uint8_t *>(common::map_memory(count * page_size));
+        if (!host_base) {
+            LOG_ERROR("Unable to reserve host memory for chunk at 0x{:x}", addr);
+            return ptr<void>(0);
+        }
 
-            for (size_t i = page_begin_off + 1; i < page_end_off; i++) {
-                current_page_table->pointers[i] = current_page_table->pointers[i - 1] + page_size;
-            }
+        for (std::uint32_t i = page_begin_off; i < page_end_off; i++) {
+            *table->get_page_info(i, true) = new_page;
+            *table->get_page_pointer(i, true) = host_base + (i - page_begin_off) * page_size;
         }
 
+        table->mark_pages(page_begin_off, static_cast<std::uint32_t>(count), true);
+
         commit(addr + static_cast<uint32_t>(bottom), top - bottom);
 
         return ptr<void>(addr);
@@ -204,171 +275,89 @@ namespace eka2l1 {
         uint32_t page_begin_off = (beg_addr + page_size - 1) / page_size;
         uint32_t page_end_off = (end_addr - page_size + 1) / page_size;
 
-        page *page_begin;
-        page *page_end;
+        page_table *table = get_page_table_from_addr(beg_addr);
 
-        if (beg_addr >= shared_addr && beg_addr < shared_addr + shared_size) {
-            page_begin = global_pages.data() + (page_begin_off - (shared_addr / page_size));
-            page_end = global_pages.data() + (page_end_off - (shared_addr / page_size));
-        } else if (beg_addr >= codeseg_addr && beg_addr < codeseg_addr + 0x10000000) {
-            page_begin = codeseg_pages.data() + (page_begin_off - (codeseg_addr / page_size));
-            page_end = codeseg_pages.data() + (page_end_off - (codeseg_addr / page_size));
-        } else {
-            page_begin = current_page_table->pages.data() + page_begin_off;
-            page_end = current_page_table->pages.data() + page_end_off;
+        if (!table || page_count == 0) {
+            return ptr<void>(0);
         }
 
-        page holder;
+        // Search from top to bottom for the first free run
+        uint32_t run_begin_off = 0;
 
-        auto ite = std::search_n(std::reverse_iterator<page *>(page_end),
-            std::reverse_iterator<page *>(page_begin), page_count, holder, [](const page &lhs, const page &rhs) {
-                return (lhs.sts == page_status::free);
-            });
-
-        if (ite == std::reverse_iterator<page *>(page_begin)) {
+        if (!table->find_free_range_top_down(page_begin_off, page_end_off, page_count, run_begin_off)) {
             return ptr<void>(0);
         }
 
-        if (beg_addr >= shared_addr && beg_addr < shared_addr + shared_size) {
-            auto idx = ite.base() - global_pages.data() - page_count;
-            return chunk(static_cast<address>(shared_addr + idx * page_size), bottom, top, max_grow, cprot);
-        } else if (beg_addr >= ram_code_addr && beg_addr < codeseg_addr + 0x10000000) {
-            auto idx = ite.base() - codeseg_pages.data() - page_count;
-            return chunk(static_cast<address>(ram_code_addr + idx * page_size), bottom, top, max_grow, cprot);
-        }
-
-        auto idx = ite.base() - current_page_table->pages.data() - page_count;
-        return chunk(static_cast<address>(idx * page_size), bottom, top, max_grow, cprot);
+        return chunk(static_cast<address>(run_begin_off * page_size), bottom, top, max_grow, cprot);
     }
 
     // Change the prot of pages
     int memory_system::change_prot(ptr<void> addr, uint32_t size, prot nprot) {
-        uint32_t beg = addr.ptr_address() / page_size;
-        uint32_t end = (addr.ptr_address() + static_cast<uint32_t>(size) - 1 + page_size) / page_size;
+        const uint32_t beg = addr.ptr_address() / page_size;
+        const uint32_t end = (addr.ptr_address() + static_cast<uint32_t>(size) - 1 + page_size) / page_size;
 
-        uint32_t count = end - beg;
+        const uint32_t count = end - beg;
 
-        page *page_begin;
-        page *page_end;
+        page_table *table = get_page_table_from_addr(addr.ptr_address());
 
-        size_t len = common::GB(4);
-
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            page_begin = global_pages.data() + (beg - (shared_addr / page_size));
-            page_end = global_pages.data() + (end - (shared_addr / page_size));
-        } else if (addr.ptr_address() >= codeseg_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            page_begin = codeseg_pages.data() + (beg - ((codeseg_addr) / page_size));
-            page_end = codeseg_pages.data() + (end - ((codeseg_addr) / page_size));
-        } else {
-            page_begin = current_page_table->pages.data() + beg;
-            page_end = current_page_table->pages.data() + end;
+        if (!table) {
+            return -1;
         }
 
-        auto page_begin_orginal = page_begin;
+        for (uint32_t i = beg; i < end; i++) {
+            page *info = table->get_page_info(i);
 
-        for (; page_begin != page_end; page_begin++) {
             // Only a commited region can have a protection
-            if (page_begin->sts != page_status::committed) {
+            if (!info || info->sts != page_status::committed) {
                 return -1;
             }
 
-            page_begin->page_protection = nprot;
-            cpu->unmap_memory(static_cast<address>(addr.ptr_address() + std::distance(page_begin_orginal, page_begin) * page_size),
-                page_size);
+            info->page_protection = nprot;
+            cpu->unmap_memory(static_cast<address>(i * page_size), page_size);
         }
 
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            common::change_protection(global_pointers[(beg - (shared_addr / page_size))],
-                count * page_size, nprot);
-
-            if (current_page_table) {
-                std::copy(global_pages.begin() + (beg - (shared_addr / page_size)),
-                    global_pages.begin() + (end - (shared_addr / page_size)), current_page_table->pages.begin() + beg);
+        std::uint8_t *host_ptr = table->get_pointer(beg);
 
-                std::copy(global_pointers.begin() + (beg - (shared_addr / page_size)),
-                    global_pointers.begin() + (end - (shared_addr / page_size)), current_page_table->pointers.begin() + beg);
-            }
-
-            cpu->map_backing_mem(addr.ptr_address(), size, global_pointers[beg - (shared_addr / page_size)], nprot);
-        } else if (addr.ptr_address() >= codeseg_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            common::change_protection(codeseg_pointers[(beg - (ram_code_addr / page_size))],
-                count * page_size, nprot);
+        common::change_protection(host_ptr, count * page_size, nprot);
+        cpu->map_backing_mem(beg * page_size, count * page_size, host_ptr, nprot);
 
-            if (current_page_table) {
-                std::copy(codeseg_pages.begin() + (beg - (codeseg_addr / page_size)),
-                    codeseg_pages.begin() + (end - (codeseg_addr / page_size)), current_page_table->pages.begin() + beg);
-
-                std::copy(codeseg_pointers.begin() + (beg - (codeseg_addr / page_size)),
-                    codeseg_pointers.begin() + (end - (codeseg_addr / page_size)), current_page_table->pointers.begin() + beg);
-            }
-
-            cpu->map_backing_mem(addr.ptr_address(), size, codeseg_pointers[beg - (codeseg_addr / page_size)], nprot);
-        } else {
-            common::change_protection(current_page_table->pointers[beg],
-                count * page_size, nprot);
-
-            cpu->map_backing_mem(addr.ptr_address(), size, current_page_table->pointers[beg], nprot);
-        }
+        track_local_range(table, beg * page_size, count * page_size, host_ptr, nprot);
 
         return 0;
     }
 
     // Mark a chunk at addr as unusable
     int memory_system::unchunk(ptr<void> addr, uint32_t length) {
-        address beg = addr.ptr_address() / page_size;
-        address end = (addr.ptr_address() + length - 1 + page_size) / page_size;
-
-        size_t count = end - beg;
+        const address beg = addr.ptr_address() / page_size;
+        const address end = (addr.ptr_address() + length - 1 + page_size) / page_size;
 
-        page *page_begin;
-        page *page_end;
+        const size_t count = end - beg;
 
-        size_t len = common::GB(4);
+        page_table *table = get_page_table_from_addr(addr.ptr_address());
 
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            page_begin = global_pages.data() + (beg - (shared_addr / page_size));
-            page_end = global_pages.data() + (end - (shared_addr / page_size));
-        } else if (addr.ptr_address() >= codeseg_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            page_begin = codeseg_pages.data() + (beg - ((codeseg_addr) / page_size));
-            page_end = codeseg_pages.data() + (end - ((codeseg_addr) / page_size));
-        } else {
-            page_begin = current_page_table->pages.data() + beg;
-            page_end = current_page_table->pages.data() + end;
-        }
-
-        for (; page_begin != page_end; page_begin++) {
-            page_begin->sts = page_status::free;
-            page_begin->page_protection = prot::none;
-            page_begin->generation = 0;
+        if (!table || !table->get_pointer(beg)) {
+            return -1;
         }
 
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            eka2l1::common::unmap_memory(global_pointers[(beg - (shared_addr / page_size))], eka2l1::common::get_host_page_size());
-            global_pointers[(beg - (shared_addr / page_size))] = nullptr;
+        eka2l1::common::unmap_memory(table->get_pointer(beg), count * page_size);
+        untrack_local_range(table, beg * page_size, static_cast<std::uint32_t>(count * page_size));
 
-            if (current_page_table) {
-                std::copy(global_pages.begin() + (beg - (shared_addr / page_size)),
-                    global_pages.begin() + (end - (shared_addr / page_size)), current_page_table->pages.begin() + beg);
+        for (address i = beg; i < end; i++) {
+            page *info = table->get_page_info(i);
 
-                std::copy(global_pointers.begin() + (beg - (shared_addr / page_size)),
-                    global_pointers.begin() + (end - (shared_addr / page_size)), current_page_table->pointers.begin() + beg);
+            if (!info) {
+                continue;
             }
-        } else if (addr.ptr_address() >= ram_code_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            eka2l1::common::unmap_memory(codeseg_pointers[(beg - (ram_code_addr / page_size))], eka2l1::common::get_host_page_size());
-            codeseg_pointers[(beg - (ram_code_addr / page_size))] = nullptr;
 
-            if (current_page_table) {
-                std::copy(codeseg_pages.begin() + (beg - (codeseg_addr / page_size)),
-                    codeseg_pages.begin() + (end - (codeseg_addr / page_size)), current_page_table->pages.begin() + beg);
+            info->sts = page_status::free;
+            info->page_protection = prot::none;
+            info->generation = 0;
 
-                std::copy(codeseg_pointers.begin() + (beg - (codeseg_addr / page_size)),
-                    codeseg_pointers.begin() + (end - (codeseg_addr / page_size)), current_page_table->pointers.begin() + beg);
-            }
-        } else {
-            eka2l1::common::unmap_memory(current_page_table->pointers[beg], eka2l1::common::get_host_page_size());
-            current_page_table->pointers[beg] = nullptr;
+            *table->get_page_pointer(i) = nullptr;
         }
 
+        table->mark_pages(beg, static_cast<std::uint32_t>(count), false);
+
         // cpu->unmap_memory(addr.ptr_address(), count * page_size);
 
         return 0;
@@ -380,85 +369,45 @@ namespace eka2l1 {
             return 0;
         }
 
-        address beg = addr.ptr_address() / page_size;
-        address end = (addr.ptr_address() + size - 1 + page_size) / page_size;
-
-        size_t count = end - beg;
+        const address beg = addr.ptr_address() / page_size;
+        const address end = (addr.ptr_address() + size - 1 + page_size) / page_size;
 
-        page *page_begin;
-        page *page_end;
+        const size_t count = end - beg;
 
-        size_t len = common::GB(4);
+        page_table *table = get_page_table_from_addr(addr.ptr_address());
+        page *first_page = table ? table->get_page_info(beg) : nullptr;
 
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            page_begin = global_pages.data() + (beg - (shared_addr / page_size));
-            page_end = global_pages.data() + (end - (shared_addr / page_size));
-        } else if (addr.ptr_address() >= codeseg_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            page_begin = codeseg_pages.data() + (beg - ((codeseg_addr) / page_size));
-            page_end = codeseg_pages.data() + (end - ((codeseg_addr) / page_size));
-        } else {
-            page_begin = current_page_table->pages.data() + beg;
-            page_end = current_page_table->pages.data() + end;
+        if (!first_page) {
+            return -1;
         }
 
-        const auto page_begin_org = page_begin;
+        const prot nprot = first_page->page_protection;
 
-        prot nprot = page_begin->page_protection;
+        for (address i = beg; i < end; i++) {
+            page *info = table->get_page_info(i);
 
-        for (; page_begin != page_end; page_begin++) {
             // Can commit on commited region or reserved region
-            if (page_begin->sts == page_status::free) {
+            if (!info || info->sts == page_status::free) {
                 return -1;
             }
 
-            if (page_begin->sts == page_status::committed) {
-                cpu->unmap_memory(static_cast<address>(addr.ptr_address() + std::distance(page_begin_org, page_begin) * page_size),
-                    page_size);
+            if (info->sts == page_status::committed) {
+                cpu->unmap_memory(static_cast<address>(i * page_size), page_size);
             }
 
-            page_begin->sts = page_status::committed;
+            info->sts = page_status::committed;
         }
 
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            bool success = common::commit(global_pointers[beg - (shared_addr / page_size)],
-                count * page_size, nprot);
-
-            if (!success) {
-                LOG_WARN("Host commit failed");
-            }
-
-            if (current_page_table) {
-                std::copy(global_pages.begin() + (beg - (shared_addr / page_size)),
-                    global_pages.begin() + (end - (shared_addr / page_size)), current_page_table->pages.begin() + beg);
-
-                std::copy(global_pointers.begin() + (beg - (shared_addr / page_size)),
-                    global_pointers.begin() + (end - (shared_addr / page_size)), current_page_table->pointers.begin() + beg);
-            }
-
-            cpu->map_backing_mem(addr.ptr_address(), size, global_pointers[beg - (shared_addr / page_size)],
-                global_pages[beg - (shared_addr / page_size)].page_protection);
-        } else if (addr.ptr_address() >= codeseg_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            common::commit(codeseg_pointers[beg - (ram_code_addr / page_size)],
-                count * page_size, nprot);
-
-            if (current_page_table) {
-                std::copy(codeseg_pages.begin() + (beg - (codeseg_addr / page_size)),
-                    codeseg_pages.begin() + (end - (codeseg_addr / page_size)), current_page_table->pages.begin() + beg);
-
-                std::copy(codeseg_pointers.begin() + (beg - (codeseg_addr / page_size)),
-                    codeseg_pointers.begin() + (end - (codeseg_addr / page_size)), current_page_table->pointers.begin() + beg);
-            }
+        std::uint8_t *host_ptr = table->get_pointer(beg);
+        const bool success = common::commit(host_ptr, count * page_size, nprot);
 
-            cpu->map_backing_mem(addr.ptr_address(), size, codeseg_pointers[beg - (codeseg_addr / page_size)],
-                codeseg_pages[beg - (codeseg_addr / page_size)].page_protection);
-        } else {
-            common::commit(current_page_table->pointers[beg],
-                count * page_size, nprot);
-
-            cpu->map_backing_mem(addr.ptr_address(), size,
-                current_page_table->pointers[beg], current_page_table->pages[beg].page_protection);
+        if (!success) {
+            LOG_WARN("Host commit failed");
         }
 
+        cpu->map_backing_mem(beg * page_size, count * page_size, host_ptr, nprot);
+        track_local_range(table, beg * page_size, static_cast<std::uint32_t>(count * page_size), host_ptr, nprot);
+
         return 0;
     }
 
@@ -468,68 +417,38 @@ namespace eka2l1 {
             return 0;
         }
 
-        address beg = addr.ptr_address() / page_size;
-        address end = (addr.ptr_address() + size - 1 + page_size) / page_size;
+        const address beg = addr.ptr_address() / page_size;
+        const address end = (addr.ptr_address() + size - 1 + page_size) / page_size;
 
-        size_t count = end - beg;
+        const size_t count = end - beg;
 
-        page *page_begin;
-        page *page_end;
+        page_table *table = get_page_table_from_addr(addr.ptr_address());
 
-        size_t len = common::GB(4);
-
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            page_begin = global_pages.data() + (beg - (shared_addr / page_size));
-            page_end = global_pages.data() + (end - (shared_addr / page_size));
-        } else if (addr.ptr_address() >= codeseg_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            page_begin = codeseg_pages.data() + (beg - ((codeseg_addr) / page_size));
-            page_end = codeseg_pages.data() + (end - ((codeseg_addr) / page_size));
-        } else {
-            page_begin = current_page_table->pages.data() + beg;
-            page_end = current_page_table->pages.data() + end;
+        if (!table || !table->get_pointer(beg)) {
+            return -1;
         }
 
-        prot nprot = page_begin->page_protection;
+        for (address i = beg; i < end; i++) {
+            page *info = table->get_page_info(i);
 
-        for (; page_begin != page_end; page_begin++) {
-            if (page_begin->sts == page_status::committed) {
-                page_begin->sts = page_status::reserved;
+            if (info && info->sts == page_status::committed) {
+                info->sts = page_status::reserved;
             }
         }
 
-        if (addr.ptr_address() >= shared_addr && addr.ptr_address() < shared_addr + shared_size) {
-            common::decommit(global_pointers[(beg - (shared_addr / page_size))],
-                count * page_size);
+        common::decommit(table->get_pointer(beg), count * page_size);
+        cpu->unmap_memory(beg * page_size, count * page_size);
 
-            if (current_page_table) {
-                std::copy(global_pages.begin() + beg - (shared_addr / page_size),
-                    global_pages.begin() + end - (shared_addr / page_size), current_page_table->pages.begin() + beg);
-
-                std::copy(global_pointers.begin() + beg - (shared_addr / page_size),
-                    global_pointers.begin() + end - (shared_addr / page_size), current_page_table->pointers.begin() + beg);
-            }
-        } else if (addr.ptr_address() >= ram_code_addr && addr.ptr_address() < codeseg_addr + 0x10000000) {
-            common::decommit(codeseg_pointers[(beg - (ram_code_addr / page_size))],
-                count * page_size);
-
-            if (current_page_table) {
-                std::copy(codeseg_pages.begin() + beg - (codeseg_addr / page_size),
-                    codeseg_pages.begin() + end - (codeseg_addr / page_size), current_page_table->pages.begin() + beg);
-
-                std::copy(codeseg_pointers.begin() + beg - (codeseg_addr / page_size),
-                    codeseg_pointers.begin() + end - (codeseg_addr / page_size), current_page_table->pointers.begin() + beg);
-            }
-        } else {
-            common::decommit(current_page_table->pointers[beg],
-                count * page_size);
-        }
-
-        cpu->unmap_memory(addr.ptr_address(), size);
+        untrack_local_range(table, beg * page_size, static_cast<std::uint32_t>(count * page_size));
 
         return 0;
     }
 
     bool memory_system::read(address addr, void *data, uint32_t size) {
+        if (addr % page_size + size > static_cast<uint32_t>(page_size)) {
+            return read_span(addr, data, size);
+        }
+
         void *fptr = get_real_pointer(addr);
 
         if (fptr == nullptr) {
@@ -547,7 +466,11 @@ namespace eka2l1 {
         return true;
     }
 
-    bool memory_system::write(address addr, void *data, uint32_t size) {
+    bool memory_system::write(address addr, const void *data, uint32_t size) {
+        if (addr % page_size + size > static_cast<uint32_t>(page_size)) {
+            return write_span(addr, data, size);
+        }
+
         void *to = get_real_pointer(addr);
 
         if (to == nullptr) {
@@ -560,82 +483,109 @@ namespace eka2l1 {
         return true;
     }
 
-    page_table *memory_system::get_current_page_table() const {
-        return current_page_table;
+    bool memory_system::read_span(address addr, void *data, uint32_t size) {
+        page_table *table = get_access_page_table();
+
+        // Pages filled on first access are retried once they are in
+        if (!table->read_span(addr, data, size)
+            && (!handle_page_fault(addr, size) || !table->read_span(addr, data, size))) {
+            LOG_WARN("Reading invalid range: 0x{:x} (size 0x{:x})", addr, size);
+            return false;
+        }
+
+        return true;
     }
 
-    void memory_system::set_current_page_table(page_table &table) {
-        if (current_page_table == &table) {
-            return;
+    bool memory_system::write_span(address addr, const void *data, uint32_t size) {
+        page_table *table = get_access_page_table();
+
+        if (!table->write_span(addr, data, size)
+            && (!handle_page_fault(addr, size) || !table->write_span(addr, data, size))) {
+            LOG_WARN("Writing invalid range: 0x{:x} (size 0x{:x})", addr, size);
+            return false;
         }
 
-        previous_page_table = current_page_table;
-        current_page_table = &table;
+        return true;
+    }
 
-        std::copy(codeseg_pages.begin(), codeseg_pages.end(), current_page_table->pages.begin() + (codeseg_addr / page_size));
-        std::copy(codeseg_pointers.begin(), codeseg_pointers.end(), current_page_table->pointers.begin() + (codeseg_addr / page_size));
+    bool memory_system::copy(address dest, address source, uint32_t size) {
+        page_table *table = get_access_page_table();
 
-        std::copy(global_pages.begin(), global_pages.begin() + (shared_size / page_size), current_page_table->pages.begin() + (shared_addr / page_size));
-        std::copy(global_pointers.begin(), global_pointers.begin() + (shared_size / page_size), current_page_table->pointers.begin() + (shared_addr / page_size));
+        if (may_fault(source, size) || may_fault(dest, size)) {
+            handle_page_fault(source, size);
+            handle_page_fault(dest, size);
+        }
 
-        if (!current_page_table->pointers[rom_addr / page_size]) {
-            current_page_table->pointers[rom_addr / page_size] = reinterpret_cast<uint8_t *>(rom_map);
+        if (!page_table::copy_span(*table, dest, *table, source, size)) {
+            LOG_WARN("Copying invalid range: 0x{:x} to 0x{:x} (size 0x{:x})", source, dest, size);
+            return false;
+        }
 
-            page rom_page;
-            rom_page.sts = page_status::committed;
-            rom_page.generation = 250;
-            rom_page.page_protection = prot::read_exec;
+        return true;
+    }
 
-            current_page_table->pages[rom_addr / page_size] = rom_page;
+    host_span_iterator memory_system::get_host_spans(address addr, uint32_t size) {
+        handle_page_fault(addr, size);
+        return host_span_iterator(get_access_page_table(), addr, size);
+    }
 
-            for (size_t i = 1; i < common::align(rom_size, page_size) / page_size; i++) {
-                current_page_table->pointers[(rom_addr / page_size) + i] = current_page_table->pointers[(rom_addr / page_size) + i - 1] + page_size;
-                current_page_table->pages[(rom_addr / page_size) + i] = rom_page;
-            }
+    page_table *memory_system::get_current_page_table() const {
+        return current_page_table;
+    }
+
+    address_space *memory_system::get_current_address_space() const {
+        return current_addr_space;
+    }
+
+    void memory_system::set_current_address_space(address_space &space) {
+        if (current_addr_space == &space) {
+            return;
         }
 
-        if (previous_page_table) {
-            const std::uint32_t offset_page_local = local_data / page_size;
-            const std::uint32_t offset_page_local_end = shared_data / page_size;
+        address_space *previous_addr_space = current_addr_space;
 
-            for (std::uint32_t i = offset_page_local_end; i >= offset_page_local; i--) {
-                address beg_addr = (i + 1) * page_size;
-                address total_page = 0;
+        current_addr_space = &space;
+        current_page_table = &space.get_page_table();
 
-                while (previous_page_table->pointers[i] && previous_page_table->pages[i].sts == page_status::committed
-                    && i >= offset_page_local) {
-                    total_page++;
-                    i--;
-                    beg_addr -= page_size;
-                }
+        const auto &new_ranges = space.get_local_ranges();
 
-                if (total_page) {
-                    cpu->unmap_memory(beg_addr, total_page * page_size);
-                }
-            }
-                
-            for (std::uint32_t i = offset_page_local_end; i >= offset_page_local; i--) {
-                address beg_addr = (i + 1) * page_size;
-                address total_page = 0;
-
-                if (current_page_table->pointers[i] && current_page_table->pages[i].sts == page_status::committed) {
-                    total_page++;
-                    beg_addr -= page_size;
-
-                    while (current_page_table->pointers[i - 1] + page_size == current_page_table->pointers[i]) {
-                        total_page++;
-                        beg_addr -= page_size;
-                        i--;
+        switch (cpu->switch_address_space(space.get_id())) {
+        case arm::memory_map_state::up_to_date:
+            break;
+
+        case arm::memory_map_state::previous:
+            if (previous_addr_space) {
+                const auto &old_ranges = previous_addr_space->get_local_ranges();
+
+                for (const auto &[range_addr, range] : old_ranges) {
+                    const auto new_range = new_ranges.find(range_addr);
+
+                    if (new_range == new_ranges.end() || new_range->second != range) {
+                        cpu->unmap_memory(range.addr, range.size);
                     }
                 }
 
-                if (total_page) {
-                    cpu->map_backing_mem(beg_addr, total_page * page_size, current_page_table->pointers[beg_addr / page_size],
-                        current_page_table->pages[beg_addr / page_size].page_protection);
+                for (const auto &[range_addr, range] : new_ranges) {
+                    const auto old_range = old_ranges.find(range_addr);
+
+                    if (old_range == old_ranges.end() || old_range->second != range) {
+                        cpu->map_backing_mem(range.addr, range.size, range.host, range.protection);
+                    }
                 }
+
+                break;
             }
+
+            [[fallthrough]];
+
+        case arm::memory_map_state::empty:
+            for (const auto &[range_addr, range] : new_ranges) {
+                cpu->map_backing_mem(range.addr, range.size, range.host, range.protection);
+            }
+
+            break;
         }
 
         cpu->page_table_changed();
     }
-}
\ No newline at end of file
+}
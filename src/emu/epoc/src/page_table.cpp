@@ -18,40 +18,380 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <common/algorithm.h>
 #include <common/log.h>
 #include <epoc/page_table.h>
 
+#include <cstring>
+
 namespace eka2l1 {
-    page_table::page_table(int page_size)
-        : page_size(page_size) {
+    page_table_leaf::page_table_leaf() {
         page clear = { 0, page_status::free, prot::none };
         std::fill(pages.begin(), pages.end(), clear);
         std::fill(pointers.begin(), pointers.end(), nullptr);
+        std::fill(used_bitmap.begin(), used_bitmap.end(), 0);
+
+        used_count = 0;
     }
 
-    std::array<page, page_table_number_entries> &page_table::get_pages() {
-        const std::lock_guard<std::mutex> guard(mut);
-        return pages;
+    page_table::page_table(int page_size)
+        : parent(nullptr)
+        , leaf_count(0)
+        , page_size(page_size) {
+        std::fill(leaves.begin(), leaves.end(), nullptr);
+    }
+
+    page_table::~page_table() {
+        for (std::size_t i = 0; i < leaves.size(); i++) {
+            if (owned[i]) {
+                delete leaves[i];
+            }
+        }
+    }
+
+    void page_table::attach(page_table *new_parent) {
+        parent = new_parent;
     }
 
-    std::array<std::uint8_t *, page_table_number_entries> &page_table::get_pointers() {
+    page_table_leaf *page_table::get_leaf(const std::uint32_t page_off, const bool create) {
+        const std::uint32_t dir_off = page_off >> page_leaf_bits;
+        page_table_leaf *leaf = leaves[dir_off];
+
+        if (leaf) {
+            return leaf;
+        }
+
+        if (parent) {
+            // Shared leaves are never freed before the parent, cache them
+            leaf = parent->get_leaf(page_off, false);
+
+            if (leaf) {
+                leaves[dir_off] = leaf;
+                return leaf;
+            }
+        }
+
+        if (!create) {
+            return nullptr;
+        }
+
         const std::lock_guard<std::mutex> guard(mut);
-        return pointers;
+
+        if (!leaves[dir_off]) {
+            leaves[dir_off] = new page_table_leaf;
+            owned.set(dir_off);
+            leaf_count++;
+        }
+
+        return leaves[dir_off];
+    }
+
+    page *page_table::get_page_info(const std::uint32_t page_off, const bool create) {
+        page_table_leaf *leaf = get_leaf(page_off, create);
+
+        if (!leaf) {
+            return nullptr;
+        }
+
+        return &leaf->pages[page_off & (page_leaf_number_entries - 1)];
+    }
+
+    std::uint8_t **page_table::get_page_pointer(const std::uint32_t page_off, const bool create) {
+        page_table_leaf *leaf = get_leaf(page_off, create);
+
+        if (!leaf) {
+            return nullptr;
+        }
+
+        return &leaf->pointers[page_off & (page_leaf_number_entries - 1)];
+    }
+
+    std::uint8_t *page_table::get_pointer(const std::uint32_t page_off) {
+        page_table_leaf *leaf = get_leaf(page_off, false);
+
+        if (!leaf) {
+            return nullptr;
+        }
+
+        return leaf->pointers[page_off & (page_leaf_number_entries - 1)];
+    }
+
+    // Get the bits of pages [page_off, page_off + count) inside one bitmap word.
+    static std::uint64_t get_word_mask(const std::uint32_t page_off, const std::uint32_t count) {
+        const std::uint64_t bits = (count == 64) ? ~0ULL : ((1ULL << count) - 1);
+        return bits << (page_off & 63);
+    }
+
+    void page_table::mark_pages(const std::uint32_t page_off, const std::uint32_t count, const bool used) {
+        std::uint32_t i = page_off;
+        const std::uint32_t end = page_off + count;
+
+        while (i < end) {
+            // Process a bitmap word at a time
+            const std::uint32_t word_count = common::min(end - i, 64 - (i & 63));
+            page_table_leaf *leaf = get_leaf(i, used);
+
+            if (leaf) {
+                std::uint64_t &word = leaf->used_bitmap[(i & (page_leaf_number_entries - 1)) >> 6];
+                const std::uint64_t mask = get_word_mask(i, word_count);
+                const std::uint64_t changed = used ? (mask & ~word) : (mask & word);
+
+                if (used) {
+                    word |= mask;
+                    leaf->used_count += common::count_set_bits(changed);
+                } else {
+                    word &= ~mask;
+                    leaf->used_count -= common::count_set_bits(changed);
+                }
+            }
+
+            i += word_count;
+        }
+    }
+
+    bool page_table::is_range_free(const std::uint32_t page_off, const std::uint32_t count) {
+        std::uint32_t i = page_off;
+        const std::uint32_t end = page_off + count;
+
+        while (i < end) {
+            const std::uint32_t word_count = common::min(end - i, 64 - (i & 63));
+            page_table_leaf *leaf = get_leaf(i);
+
+            if (leaf && (leaf->used_bitmap[(i & (page_leaf_number_entries - 1)) >> 6] & get_word_mask(i, word_count))) {
+                return false;
+            }
+
+            i += word_count;
+        }
+
+        return true;
+    }
+
+    bool page_table::find_free_range_top_down(const std::uint32_t page_beg, const std::uint32_t page_end,
+        const std::uint32_t count, std::uint32_t &result) {
+        if (count == 0 || page_end <= page_beg) {
+            return false;
+        }
+
+        // Free pages counted down from run_end (exclusive)
+        std::uint32_t run_end = page_end;
+        std::uint32_t hi = page_end;
+
+        while (hi > page_beg) {
+            const std::uint32_t leaf_beg = (hi - 1) & ~(page_leaf_number_entries - 1);
+            page_table_leaf *leaf = get_leaf(hi - 1);
+
+            // Untouched leaves are free, full leaves have no run in them
+            if (!leaf || leaf->used_count == 0 || leaf->used_count == page_leaf_number_entries) {
+                const std::uint32_t lo = common::max(leaf_beg, page_beg);
+
+                if (leaf && leaf->used_count != 0) {
+                    run_end = lo;
+                } else if (run_end - lo >= count) {
+                    result = run_end - count;
+                    return true;
+                }
+
+                hi = lo;
+                continue;
+            }
+
+            const std::uint32_t lo = common::max((hi - 1) & ~63U, page_beg);
+            const std::uint32_t word_count = hi - lo;
+
+            // Bit i is page lo + i
+            std::uint64_t used = (leaf->used_bitmap[(lo & (page_leaf_number_entries - 1)) >> 6] >> (lo & 63))
+                & ((word_count == 64) ? ~0ULL : ((1ULL << word_count) - 1));
+
+            while (used) {
+                const std::uint32_t top_used = lo + common::find_most_significant_bit(used);
+
+                if (run_end - (top_used + 1) >= count) {
+                    result = run_end - count;
+                    return true;
+                }
+
+                run_end = top_used;
+                used &= ~(1ULL << (top_used - lo));
+            }
+
+            if (run_end - lo >= count) {
+                result = run_end - count;
+                return true;
+            }
+
+            hi = lo;
+        }
+
+        return false;
+    }
+
+    host_span_iterator::host_span_iterator(page_table *table, const address addr, const std::uint32_t size)
+        : table(table)
+        , addr(addr)
+        , remaining(size) {
+    }
+
+    // Get the host memory of a committed page, nullptr otherwise
+    static std::uint8_t *get_committed_pointer(page_table *table, const std::uint32_t page_off) {
+        page_table_leaf *leaf = table->get_leaf(page_off);
+
+        if (!leaf) {
+            return nullptr;
+        }
+
+        const std::uint32_t leaf_off = page_off & (page_leaf_number_entries - 1);
+
+        if (leaf->pages[leaf_off].sts != page_status::committed) {
+            return nullptr;
+        }
+
+        return leaf->pointers[leaf_off];
+    }
+
+    bool host_span_iterator::next(host_span &span) {
+        if (remaining == 0) {
+            return false;
+        }
+
+        const std::uint32_t page_size = static_cast<std::uint32_t>(table->page_size);
+        std::uint8_t *host = get_committed_pointer(table, addr / page_size);
+
+        if (!host) {
+            return false;
+        }
+
+        host += addr % page_size;
+        std::uint32_t size = common::min(remaining, page_size - addr % page_size);
+
+        // Merge the following pages if they are next to each other in host memory
+        while (size < remaining) {
+            if (get_committed_pointer(table, (addr + size) / page_size) != host + size) {
+                break;
+            }
+
+            size += common::min(remaining - size, page_size);
+        }
+
+        span = { addr, host, size };
+
+        addr += size;
+        remaining -= size;
+
+        return true;
+    }
+
+    bool page_table::read_span(const address addr, void *dest, const std::uint32_t size) {
+        host_span_iterator spans(this, addr, size);
+        host_span span;
+
+        std::uint8_t *dest_ptr = reinterpret_cast<std::uint8_t *>(dest);
+
+        while (spans.next(span)) {
+            std::memcpy(dest_ptr + (span.addr - addr), span.host, span.size);
+        }
+
+        return spans.finished();
+    }
+
+    bool page_table::write_span(const address addr, const void *src, const std::uint32_t size) {
+        host_span_iterator spans(this, addr, size);
+        host_span span;
+
+        const std::uint8_t *src_ptr = reinterpret_cast<const std::uint8_t *>(src);
+
+        while (spans.next(span)) {
+            std::memcpy(span.host, src_ptr + (span.addr - addr), span.size);
+        }
+
+        return spans.finished();
+    }
+
+    bool page_table::copy_span(page_table &dest_table, const address dest, page_table &source_table,
+        const address source, const std::uint32_t size) {
+        if (size == 0) {
+            return true;
+        }
+
+        const std::uint32_t page_size = static_cast<std::uint32_t>(dest_table.page_size);
+
+        // Overlapping forward copy would overwrite source data before it's read, go from the end
+        if ((&dest_table == &source_table) && (dest > source) && (dest - source < size)) {
+            std::uint32_t remaining = size;
+
+            while (remaining > 0) {
+                const address source_last = source + remaining - 1;
+                const address dest_last = dest + remaining - 1;
+
+                // Bytes left until the start of the page, for both ranges
+                const std::uint32_t source_room = source_last % page_size + 1;
+                const std::uint32_t dest_room = dest_last % page_size + 1;
+
+                const std::uint32_t step = common::min(remaining, common::min(source_room, dest_room));
+
+                std::uint8_t *source_host = get_committed_pointer(&source_table, source_last / page_size);
+                std::uint8_t *dest_host = get_committed_pointer(&dest_table, dest_last / page_size);
+
+                if (!source_host || !dest_host) {
+                    return false;
+                }
+
+                std::memmove(dest_host + dest_room - step, source_host + source_room - step, step);
+
+                remaining -= step;
+            }
+
+            return true;
+        }
+
+        host_span_iterator dest_spans(&dest_table, dest, size);
+        host_span_iterator source_spans(&source_table, source, size);
+
+        host_span dest_span{ dest, nullptr, 0 };
+        host_span source_span{ source, nullptr, 0 };
+
+        while (!dest_spans.finished() || dest_span.size != 0) {
+            if (dest_span.size == 0 && !dest_spans.next(dest_span)) {
+                return false;
+            }
+
+            if (source_span.size == 0 && !source_spans.next(source_span)) {
+                return false;
+            }
+
+            const std::uint32_t step = common::min(dest_span.size, source_span.size);
+            std::memmove(dest_span.host, source_span.host, step);
+
+            dest_span = { dest_span.addr + step, dest_span.host + step, dest_span.size - step };
+            source_span = { source_span.addr + step, source_span.host + step, source_span.size - step };
+        }
+
+        return true;
+    }
+
+    std::size_t page_table::get_host_memory_usage() const {
+        return sizeof(page_table) + leaf_count * sizeof(page_table_leaf);
     }
 
     void page_table::read(vaddress addr, void *dest, int size) {
-        int page = addr / page_size;
+        const std::uint32_t page_off = addr / page_size;
 
         std::fill(reinterpret_cast<std::uint8_t *>(dest), reinterpret_cast<std::uint8_t *>(dest) + size,
             0);
 
-        switch (get_pages()[page].sts) {
+        page *info = get_page_info(page_off);
+
+        if (!info) {
+            return;
+        }
+
+        switch (info->sts) {
         case page_status::free:
         case page_status::reserved:
             break;
 
         case page_status::committed:
-            memcpy(dest, &((pointers[page])[addr % page_size]), size);
+            memcpy(dest, &(get_pointer(page_off)[addr % page_size]), size);
         }
 
         return;
@@ -68,21 +408,22 @@ namespace eka2l1 {
             return;
         }
 
-        int page = addr / page_size;
+        const std::uint32_t page_off = addr / page_size;
+        page *info = get_page_info(page_off);
+
+        if (!info) {
+            LOG_WARN("Writing free / reserved page at addr: 0x{:x}", addr);
+            return;
+        }
 
-        switch (pages[page].sts) {
+        switch (info->sts) {
         case page_status::free:
         case page_status::reserved:
             LOG_WARN("Writing free / reserved page at addr: 0x{:x}", addr);
             break;
 
-        /* Maybe get an invalid data when the main thread is writing new page status and 
-           this threading is reading (only happens with shared and ram code).
-        
-           Block all pointers modification.
-        */
         case page_status::committed:
-            memcpy(&((get_pointers()[page])[addr % page_size]), src, size);
+            memcpy(&(get_pointer(page_off)[addr % page_size]), src, size);
         }
 
         return;
@@ -99,20 +440,14 @@ namespace eka2l1 {
             return nullptr;
         }
 
-        int page = addr / page_size;
+        const std::uint32_t page_off = addr / page_size;
+        page *info = get_page_info(page_off);
 
-        switch (get_pages()[page].sts) {
-        case page_status::free:
-        case page_status::reserved:
+        if (!info || info->sts != page_status::committed) {
             LOG_WARN("Reading free / reserved page at addr: 0x{:x}", addr);
             return nullptr;
-
-        /* This time, can't gurantee memory read/write safe, since other thread may 
-           write async with the JIT. */
-        case page_status::committed:
-            return &((get_pointers()[page])[addr % page_size]);
         }
 
-        return nullptr;
+        return &(get_pointer(page_off)[addr % page_size]);
     }
-}
\ No newline at end of file
+}
@@ -20,6 +20,7 @@
 
 #include <epoc/epoc.h>
 #include <epoc/kernel.h>
+#include <epoc/kernel/process.h>
 #include <epoc/ptr.h>
 
 #include <epoc/services/context.h>
@@ -137,7 +138,7 @@ namespace eka2l1 {
                         return false;
                     }
 
-                    des->assign(msg->own_thr->owning_process(), data, len);
+                    des->assign(own_pr, msg->args.args[idx], data, len);
                 } else {
                     eka2l1::epoc::des8 *des = ptr<epoc::des8>(msg->args.args[idx]).get(own_pr);
 
@@ -146,7 +147,7 @@ namespace eka2l1 {
                         return false;
                     }
 
-                    des->assign(msg->own_thr->owning_process(), data, len);
+                    des->assign(own_pr, msg->args.args[idx], data, len);
                 }
 
                 return true;
@@ -156,6 +157,49 @@ namespace eka2l1 {
             return false;
         }
 
+        std::optional<host_span_iterator> ipc_context::get_arg_spans(int idx, std::uint32_t size) {
+            if (idx >= 4) {
+                return std::nullopt;
+            }
+
+            ipc_arg_type arg_type = msg->args.get_arg_type(idx);
+
+            if (!((int)arg_type & (int)ipc_arg_type::flag_des)) {
+                return std::nullopt;
+            }
+
+            process_ptr own_pr = msg->own_thr->owning_process();
+            eka2l1::epoc::des8 *des = ptr<epoc::des8>(msg->args.args[idx]).get(own_pr);
+
+            const std::uint32_t char_size = ((int)arg_type & (int)ipc_arg_type::flag_16b) ? 2 : 1;
+
+            if (des->get_max_length(own_pr) * char_size < size) {
+                return std::nullopt;
+            }
+
+            return host_span_iterator(&own_pr->get_page_table(), des->get_pointer_address(own_pr, msg->args.args[idx]),
+                size);
+        }
+
+        bool ipc_context::set_arg_des_len(int idx, std::uint32_t len) {
+            if (idx >= 4) {
+                return false;
+            }
+
+            ipc_arg_type arg_type = msg->args.get_arg_type(idx);
+
+            if (!((int)arg_type & (int)ipc_arg_type::flag_des)) {
+                return false;
+            }
+
+            process_ptr own_pr = msg->own_thr->owning_process();
+            eka2l1::epoc::des8 *des = ptr<epoc::des8>(msg->args.args[idx]).get(own_pr);
+
+            des->set_length(own_pr, len);
+
+            return true;
+        }
+
         std::uint8_t *ipc_context::get_arg_ptr(int idx) {
             ipc_arg_type arg_type = msg->args.get_arg_type(idx);
 
@@ -160,10 +160,8 @@ namespace eka2l1 {
             parent->child = std::move(dm);
         }
 
-        property_ptr prop = kern->create<service::property>();
-
-        prop->first = dm_category;
-        prop->second = make_state_domain_key(hier->id, domain_db.id);
+        property_ptr prop = kern->create<service::property>(dm_category,
+            make_state_domain_key(hier->id, domain_db.id));
 
         prop->define(service::property_type::int_data, 0);
         prop->set_int(make_state_domain_value(0, domain_db.init_state));
@@ -832,10 +830,7 @@ namespace eka2l1 {
         mngr->timing = sys->get_timing_system();
         mngr->kern = sys->get_kernel_system();
 
-        property_ptr init_prop = kern->create<service::property>();
-
-        init_prop->first = dm_category;
-        init_prop->second = dm_init_key;
+        property_ptr init_prop = kern->create<service::property>(dm_category, dm_init_key);
 
         init_prop->define(service::property_type::int_data, 0);
 
@@ -639,13 +639,6 @@ namespace eka2l1 {
             return;
         }
 
-        std::optional<std::string> write_data = ctx.get_arg<std::string>(0);
-
-        if (!write_data) {
-            ctx.set_request_status(KErrArgument);
-            return;
-        }
-
         fs_node *node = get_file_node(*handle_res);
 
         if (node == nullptr || node->vfs_node->type != io_component_type::file) {
@@ -663,6 +656,14 @@ namespace eka2l1 {
         int write_len = *ctx.get_arg<int>(1);
         int write_pos_provided = *ctx.get_arg<int>(2);
 
+        // Write straight from the client's descriptor
+        std::optional<host_span_iterator> write_spans = ctx.get_arg_spans(0, write_len);
+
+        if (!write_spans) {
+            ctx.set_request_status(KErrArgument);
+            return;
+        }
+
         std::uint64_t write_pos = 0;
         std::uint64_t last_pos = vfs_file->tell();
         bool should_reseek = false;
@@ -676,7 +677,12 @@ namespace eka2l1 {
 
         // If this write pos is beyond the current end of file, use last pos
         vfs_file->seek(write_pos > last_pos ? last_pos : write_pos, file_seek_mode::beg);
-        size_t wrote_size = vfs_file->write_file(&(*write_data)[0], 1, write_len);
+        size_t wrote_size = 0;
+        host_span span;
+
+        while (write_spans->next(span)) {
+            wrote_size += vfs_file->write_file(span.host, 1, span.size);
+        }
 
         LOG_TRACE("File {} wroted with size: {}",
             common::ucs2_to_utf8(vfs_file->file_name()), wrote_size);
@@ -728,12 +734,19 @@ namespace eka2l1 {
             read_len = static_cast<int>(size - last_pos);
         }
 
-        std::vector<char> read_data;
-        read_data.resize(read_len);
+        // Read straight into the client's descriptor
+        std::optional<host_span_iterator> dest_spans = ctx.get_arg_spans(0, read_len);
+        size_t read_finish_len = 0;
 
-        size_t read_finish_len = vfs_file->read_file(read_data.data(), 1, read_len);
+        if (dest_spans) {
+            host_span span;
 
-        ctx.write_arg_pkg(0, reinterpret_cast<uint8_t *>(read_data.data()), read_len);
+            while (dest_spans->next(span)) {
+                read_finish_len += vfs_file->read_file(span.host, 1, span.size);
+            }
+
+            ctx.set_arg_des_len(0, read_len);
+        }
 
         LOG_TRACE("Readed {} from {} to address 0x{:x}", read_finish_len, read_pos, ctx.msg->args.args[0]);
         ctx.set_request_status(KErrNone);
@@ -53,34 +53,6 @@
     temp = std::make_shared<svr>(sys); \
     sys->get_kernel_system()->add_custom_server(temp)
 
-#define DEFINE_INT_PROP_D(sys, category, key, data)                             \
-    property_ptr prop = sys->get_kernel_system()->create<service::property>();  \
-    prop->first = category;                                                     \
-    prop->second = key;                                                         \
-    prop->define(service::property_type::int_data, 0);                          \
-    prop->set_int(data);
-
-#define DEFINE_INT_PROP(sys, category, key, data)                            \
-    prop = sys->get_kernel_system()->create<service::property>();            \
-    prop->first = category;                                                  \
-    prop->second = key;                                                      \
-    prop->define(service::property_type::int_data, 0);                       \
-    prop->set_int(data);
-
-#define DEFINE_BIN_PROP_D(sys, category, key, size, data)                       \
-    property_ptr prop = sys->get_kernel_system()->create<service::property>();  \
-    prop->first = category;                                                     \
-    prop->second = key;                                                         \
-    prop->define(service::property_type::bin_data, size);                       \
-    prop->set(data);
-
-#define DEFINE_BIN_PROP(sys, category, key, size, data)                      \
-    prop = sys->get_kernel_system()->create<service::property>();            \
-    prop->first = category;                                                  \
-    prop->second = key;                                                      \
-    prop->define(service::property_type::bin_data, size);                    \
-    prop->set(data);
-
 const uint32_t sys_category = 0x101f75b6;
 
 const uint32_t hal_key_base = 0x1020e306;
@@ -26,8 +26,9 @@
 
 namespace eka2l1 {
     namespace service {
-        property::property(kernel_system *kern)
-            : kernel::kernel_obj(kern, "", kernel::access_type::global_access) {
+        property::property(kernel_system *kern, const int category, const int key)
+            : kernel::kernel_obj(kern, "", kernel::access_type::global_access)
+            , std::pair<int, int>(category, key) {
             obj_type = kernel::object_type::prop;
         }
 
@@ -38,14 +38,7 @@ namespace eka2l1 {
         }
 
         bool server::is_msg_delivered(ipc_msg_ptr &msg) {
-            auto res = std::find_if(delivered_msgs.begin(), delivered_msgs.end(),
-                [&](const auto &svr_msg) { return svr_msg.real_msg->id == msg->id; });
-
-            if (res != delivered_msgs.end()) {
-                return true;
-            }
-
-            return false;
+            return delivered_msgs.contains(msg.get());
         }
 
         // Create a server with name
@@ -58,25 +51,27 @@ namespace eka2l1 {
             process_msg = kern->create_msg(kernel::owner_type::process);
 
             obj_type = kernel::object_type::server;
+            log_ipc = sys->get_manager_system()->get_config_manager()->get_or_fall<bool>("log_ipc", false);
 
             REGISTER_IPC(server, connect, -1, "Server::Connect");
             REGISTER_IPC(server, disconnect, -2, "Server::Disconnect");
         }
 
         int server::receive(ipc_msg_ptr &msg) {
-            /* If there is pending message, pop the last one and accept it */
-            if (!delivered_msgs.empty()) {
-                server_msg yet_pending = std::move(delivered_msgs.back());
+            /* If there is pending message, pop the oldest one and accept it */
+            ipc_msg_ptr pending = delivered_msgs.pop();
 
-                yet_pending.dest_msg = msg;
+            if (!pending) {
+                return -1;
+            }
 
-                accept(yet_pending);
-                delivered_msgs.pop_back();
+            server_msg yet_pending;
+            yet_pending.real_msg = std::move(pending);
+            yet_pending.dest_msg = msg;
 
-                return 0;
-            }
+            accept(yet_pending);
 
-            return -1;
+            return 0;
         }
 
         int server::accept(server_msg msg) {
@@ -96,8 +91,6 @@ namespace eka2l1 {
             msg.dest_msg->session_ptr_lle = msg.real_msg->session_ptr_lle;
             msg.dest_msg->msg_session = msg.real_msg->msg_session;
 
-            msg.real_msg->msg_session->set_slot_free(msg.real_msg);
-
             return 0;
         }
 
@@ -113,20 +106,28 @@ namespace eka2l1 {
 
                 finish_request_lle(msg.dest_msg, true);
             } else {
-                delivered_msgs.push_back(msg);
+                delivered_msgs.push(msg.real_msg);
+
+                if (hle) {
+                    sys->get_kernel_system()->queue_hle_server(this);
+                }
             }
 
             return 0;
         }
 
-        int server::cancel() {
-            delivered_msgs.pop_back();
+        int server::cancel(const std::uint32_t msg_id) {
+            ipc_msg *msg = sys->get_kernel_system()->get_msg_slab().get(msg_id);
+
+            if (!msg || !delivered_msgs.remove(msg)) {
+                return -1;
+            }
 
             return 0;
         }
 
-        void server::register_ipc_func(uint32_t ordinal, ipc_func func) {
-            ipc_funcs.emplace(ordinal, func);
+        void server::register_ipc_func(const int ordinal, ipc_func func, const std::string &name) {
+            ipc_funcs.add(ordinal, func, name);
         }
 
         // Processed asynchronously, use for HLE service where accepted function
@@ -140,9 +141,9 @@ namespace eka2l1 {
 
             int func = process_msg->function;
 
-            auto func_ite = ipc_funcs.find(func);
+            ipc_func handler = ipc_funcs.get(func);
 
-            if (func_ite == ipc_funcs.end()) {
+            if (!handler) {
                 if (unhandle_callback_enable) {
                     ipc_context context{ sys, process_msg };
                     on_unhandled_opcode(context);
@@ -158,24 +159,25 @@ namespace eka2l1 {
                 return;
             }
 
-            ipc_func ipf = func_ite->second;
             ipc_context context{ sys, process_msg };
 
-            if (sys->get_manager_system()->get_config_manager()->
-                get_or_fall<bool>("log_ipc", false)) {
-                LOG_INFO("Calling IPC: {}, id: {}", ipf.name, func);
+            if (log_ipc) {
+                LOG_INFO("Calling IPC: {}, id: {}", ipc_funcs.get_name(func), func);
             }
 
-            ipf.wrapper(context);
+            handler(this, context);
         }
 
         void server::destroy() {
-            sys->get_kernel_system()->free_msg(process_msg);
+            process_msg = nullptr;
         }
 
         void server::finish_request_lle(ipc_msg_ptr &msg, bool notify_owner) {
             message2 *dat_hle = request_data.get(request_own_thread->owning_process());
 
+            // The server only knows the handle from now on
+            sys->get_kernel_system()->pin_msg(msg);
+
             dat_hle->ipc_msg_handle = msg->id;
             dat_hle->flags = msg->args.flag;
             dat_hle->function = msg->function;
@@ -197,7 +199,6 @@ namespace eka2l1 {
         void server::receive_async_lle(eka2l1::ptr<epoc::request_status> msg_request_status,
             eka2l1::ptr<message2> data) {
             ipc_msg_ptr msg = sys->get_kernel_system()->create_msg(kernel::owner_type::process);
-            msg->free = false;
 
             int res = receive(msg);
 
@@ -36,11 +36,9 @@ namespace eka2l1 {
             svr->attach(this);
 
             if (async_slot_count > 0) {
-                msgs_pool.resize(async_slot_count);
-
-                for (auto &msg : msgs_pool) {
-                    msg = std::make_pair(true, kern->create_msg(kernel::owner_type::process));
-                }
+                ipc_msg_slab &slab = kern->get_msg_slab();
+                msgs_pool = std::make_unique<ipc_msg_pool>(&slab, &slab.get_root_pool());
+                msgs_pool->reserve(async_slot_count);
             }
         }
 
@@ -49,37 +47,11 @@ namespace eka2l1 {
         }
 
         ipc_msg_ptr session::get_free_msg() {
-            if (msgs_pool.empty()) {
+            if (!msgs_pool) {
                 return kern->create_msg(kernel::owner_type::process);
             }
 
-            auto free_msg_in_pool = std::find_if(msgs_pool.begin(), msgs_pool.end(),
-                [](const auto &msg) { return msg.first; });
-
-            if (free_msg_in_pool != msgs_pool.end()) {
-                free_msg_in_pool->first = false;
-                return free_msg_in_pool->second;
-            }
-
-            return ipc_msg_ptr(nullptr);
-        }
-
-        void session::set_slot_free(ipc_msg_ptr &msg) {
-            if (msg->own_thr->get_sync_msg() == msg) {
-                return;
-            }
-
-            if (msgs_pool.empty()) {
-                msg->free = true;
-                return;
-            }
-
-            auto wrap_msg = std::find_if(msgs_pool.begin(), msgs_pool.end(),
-                [&](const auto &wrap_msg) { return wrap_msg.second == msg; });
-
-            if (wrap_msg != msgs_pool.end()) {
-                wrap_msg->first = true;
-            }
+            return msgs_pool->allocate(kern->crr_thread());
         }
 
         // This behaves a little different then other
@@ -134,16 +106,10 @@ namespace eka2l1 {
 
             smsg.real_msg = msg;
             smsg.real_msg->msg_status = ipc_message_status::delivered;
-            smsg.real_msg->msg_session = kern->get_by_id<service::session>(uid);
+            smsg.real_msg->msg_session = self.lock();
             smsg.real_msg->session_ptr_lle = cookie_address;
 
             return svr->deliver(smsg);
         }
-
-        void session::prepare_destroy() {
-            for (const auto &msg : msgs_pool) {
-                kern->free_msg(msg.second);
-            }
-        }
     }
-}
\ No newline at end of file
+}
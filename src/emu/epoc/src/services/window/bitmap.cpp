@@ -141,14 +141,14 @@ namespace eka2l1 {
         memory_system *mem = sys->get_memory_system();
 
         bool switch_page = false;
-        auto current_page_table = mem->get_current_page_table();
+        address_space *current_addr_space = mem->get_current_address_space();
 
-        if (current_page_table != &(call_pr->get_page_table())) {
+        if (current_addr_space != &(call_pr->get_address_space())) {
             switch_page = true;
         }
 
         if (switch_page) {
-            mem->set_current_page_table(call_pr->get_page_table());
+            mem->set_current_address_space(call_pr->get_address_space());
         }
 
         arm::jitter &cpu = sys->get_cpu();
@@ -186,8 +186,8 @@ namespace eka2l1 {
             cpu->set_reg(14, lr14);
         }
 
-        if (switch_page) {
-            mem->set_current_page_table(*current_page_table);
+        if (switch_page && current_addr_space) {
+            mem->set_current_address_space(*current_addr_space);
         }
 
         return data_addr;
@@ -198,14 +198,14 @@ namespace eka2l1 {
         memory_system *mem = sys->get_memory_system();
 
         bool switch_page = false;
-        auto current_page_table = mem->get_current_page_table();
+        address_space *current_addr_space = mem->get_current_address_space();
 
-        if (current_page_table != &(call_pr->get_page_table())) {
+        if (current_addr_space != &(call_pr->get_address_space())) {
             switch_page = true;
         }
 
         if (switch_page) {
-            mem->set_current_page_table(call_pr->get_page_table());
+            mem->set_current_address_space(call_pr->get_address_space());
         }
 
         arm::jitter &cpu = sys->get_cpu();
@@ -243,8 +243,8 @@ namespace eka2l1 {
             cpu->set_reg(14, lr14);
         }
 
-        if (switch_page) {
-            mem->set_current_page_table(*current_page_table);
+        if (switch_page && current_addr_space) {
+            mem->set_current_address_space(*current_addr_space);
         }
 
         return data_addr;
@@ -96,7 +96,7 @@ namespace eka2l1::epoc {
 
     /*! \brief Get the current heap allocator */
     BRIDGE_FUNC(eka2l1::ptr<void>, Heap) {
-        auto local_data = current_local_data(sys);
+        auto &local_data = current_local_data(sys);
 
         if (local_data.heap.ptr_address() == 0) {
             LOG_WARN("Allocator is not available.");
@@ -114,7 +114,7 @@ namespace eka2l1::epoc {
     }
 
     BRIDGE_FUNC(eka2l1::ptr<void>, TrapHandler) {
-        auto local_data = current_local_data(sys);
+        auto &local_data = current_local_data(sys);
         return local_data.trap_handler;
     }
 
@@ -127,7 +127,7 @@ namespace eka2l1::epoc {
     }
 
     BRIDGE_FUNC(eka2l1::ptr<void>, ActiveScheduler) {
-        auto local_data = current_local_data(sys);
+        auto &local_data = current_local_data(sys);
         return local_data.scheduler;
     }
 
@@ -416,13 +416,10 @@ namespace eka2l1::epoc {
     /*******************/
 
     BRIDGE_FUNC(eka2l1::ptr<void>, DllTls, TInt aHandle, TInt aDllUid) {
-        eka2l1::kernel::thread_local_data dat = current_local_data(sys);
         thread_ptr thr = sys->get_kernel_system()->crr_thread();
 
-        for (const auto &tls : dat.tls_slots) {
-            if (tls.handle == aHandle) {
-                return tls.pointer;
-            }
+        if (eka2l1::kernel::tls_slot *slot = thr->find_tls_slot(aHandle)) {
+            return slot->pointer;
         }
 
         LOG_WARN("TLS for 0x{:x}, thread {} return 0, may results unexpected crash", static_cast<TUint>(aHandle),
@@ -432,7 +429,7 @@ namespace eka2l1::epoc {
     }
 
     BRIDGE_FUNC(TInt, DllSetTls, TInt aHandle, TInt aDllUid, eka2l1::ptr<void> aPtr) {
-        eka2l1::kernel::tls_slot *slot = get_tls_slot(sys, aHandle);
+        eka2l1::kernel::tls_slot *slot = sys->get_kernel_system()->crr_thread()->get_tls_slot(aHandle, aDllUid);
 
         if (!slot) {
             return KErrNoMemory;
@@ -450,7 +447,9 @@ namespace eka2l1::epoc {
 
     BRIDGE_FUNC(void, DllFreeTLS, TInt iHandle) {
         thread_ptr thr = sys->get_kernel_system()->crr_thread();
-        thr->close_tls_slot(*thr->get_tls_slot(iHandle, iHandle));
+        if (eka2l1::kernel::tls_slot *slot = thr->find_tls_slot(iHandle)) {
+            thr->close_tls_slot(*slot);
+        }
 
         LOG_TRACE("TLS slot closed for 0x{:x}, thread {}", static_cast<TUint>(iHandle), thr->name());
     }
@@ -544,6 +543,8 @@ namespace eka2l1::epoc {
 
         LOG_TRACE("Message completed with code: {}, thread to signal: {}", aVal, msg->own_thr->name());
 
+        kern->unpin_msg(msg);
+
         return KErrNone;
     }
 
@@ -594,6 +595,8 @@ namespace eka2l1::epoc {
         kern->get_thread_scheduler()->stop(msg->own_thr);
         kern->prepare_reschedule();
 
+        kern->unpin_msg(msg);
+
         return KErrNone;
     }
 
@@ -1817,15 +1820,12 @@ namespace eka2l1::epoc {
 
         if (!prop) {
             auto prop_handle_and_obj = kern->create_and_add<service::property>
-                (static_cast<kernel::owner_type>(aOwnerType));
+                (static_cast<kernel::owner_type>(aOwnerType), aCagetory, aValue);
 
             if (prop_handle_and_obj.first == INVALID_HANDLE) {
                 return KErrGeneral;
             }
 
-            prop_handle_and_obj.second->first = aCagetory;
-            prop_handle_and_obj.second->second = aValue;
-
             return prop_handle_and_obj.first;
         }
 
@@ -1862,14 +1862,11 @@ namespace eka2l1::epoc {
         property_ptr prop = kern->get_prop(aCagetory, aKey);
 
         if (!prop) {
-            prop = kern->create<service::property>();
+            prop = kern->create<service::property>(aCagetory, aKey);
 
             if (!prop) {
                 return KErrGeneral;
             }
-
-            prop->first = aCagetory;
-            prop->second = aKey;
         }
 
         prop->define(prop_type, info->iSize);
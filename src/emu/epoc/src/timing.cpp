@@ -29,6 +29,231 @@
 #include <vector>
 
 namespace eka2l1 {
+    // Resync the clocks when the guest falls behind the host by more than this, so a stall
+    // (debugger, slow load) isn't followed by a burst of idling without sleeps
+    static constexpr std::chrono::milliseconds MAX_PACING_LAG{ 100 };
+
+    bool event_queue::is_before(const std::uint32_t lhs, const std::uint32_t rhs) const {
+        const slot &lhs_slot = slots[lhs];
+        const slot &rhs_slot = slots[rhs];
+
+        if (lhs_slot.evt.event_time != rhs_slot.evt.event_time) {
+            return lhs_slot.evt.event_time < rhs_slot.evt.event_time;
+        }
+
+        return lhs_slot.order < rhs_slot.order;
+    }
+
+    void event_queue::sift_up(std::uint32_t pos) {
+        const std::uint32_t slot_idx = heap[pos];
+
+        while (pos > 0) {
+            const std::uint32_t parent = (pos - 1) / heap_arity;
+
+            if (!is_before(slot_idx, heap[parent])) {
+                break;
+            }
+
+            heap[pos] = heap[parent];
+            slots[heap[pos]].heap_pos = pos;
+
+            pos = parent;
+        }
+
+        heap[pos] = slot_idx;
+        slots[slot_idx].heap_pos = pos;
+    }
+
+    void event_queue::sift_down(std::uint32_t pos) {
+        const std::uint32_t slot_idx = heap[pos];
+        const std::uint32_t count = static_cast<std::uint32_t>(heap.size());
+
+        while (true) {
+            const std::uint32_t first_child = pos * heap_arity + 1;
+
+            if (first_child >= count) {
+                break;
+            }
+
+            std::uint32_t best = first_child;
+            const std::uint32_t last_child = std::min(first_child + heap_arity, count);
+
+            for (std::uint32_t child = first_child + 1; child < last_child; child++) {
+                if (is_before(heap[child], heap[best])) {
+                    best = child;
+                }
+            }
+
+            if (!is_before(heap[best], slot_idx)) {
+                break;
+            }
+
+            heap[pos] = heap[best];
+            slots[heap[pos]].heap_pos = pos;
+
+            pos = best;
+        }
+
+        heap[pos] = slot_idx;
+        slots[slot_idx].heap_pos = pos;
+    }
+
+    void event_queue::unindex(const std::uint32_t slot_idx) {
+        auto range = userdata_index.equal_range(slots[slot_idx].evt.event_user_data);
+
+        for (auto ite = range.first; ite != range.second; ite++) {
+            if (ite->second == slot_idx) {
+                userdata_index.erase(ite);
+                break;
+            }
+        }
+    }
+
+    void event_queue::remove_at(const std::uint32_t pos) {
+        const std::uint32_t slot_idx = heap[pos];
+
+        unindex(slot_idx);
+
+        // Invalidate handles to this slot
+        if (++slots[slot_idx].generation == 0) {
+            slots[slot_idx].generation = 1;
+        }
+
+        free_slots.push_back(slot_idx);
+
+        const std::uint32_t last = heap.back();
+        heap.pop_back();
+
+        if (pos == heap.size()) {
+            return;
+        }
+
+        // Put the last element in the hole, then restore order either way
+        heap[pos] = last;
+        slots[last].heap_pos = pos;
+
+        if (pos > 0 && is_before(last, heap[(pos - 1) / heap_arity])) {
+            sift_up(pos);
+        } else {
+            sift_down(pos);
+        }
+    }
+
+    event_queue::slot *event_queue::get_slot(const event_handle handle) {
+        const std::uint32_t slot_idx = static_cast<std::uint32_t>(handle);
+        const std::uint32_t generation = static_cast<std::uint32_t>(handle >> 32);
+
+        if (slot_idx >= slots.size() || slots[slot_idx].generation != generation) {
+            return nullptr;
+        }
+
+        return &slots[slot_idx];
+    }
+
+    event_handle event_queue::push(const event &evt) {
+        std::uint32_t slot_idx = 0;
+
+        if (free_slots.empty()) {
+            slot_idx = static_cast<std::uint32_t>(slots.size());
+            slots.push_back(slot{ evt, 0, 0, 1 });
+        } else {
+            slot_idx = free_slots.back();
+            free_slots.pop_back();
+
+            slots[slot_idx].evt = evt;
+        }
+
+        slots[slot_idx].order = order_counter++;
+
+        heap.push_back(slot_idx);
+        sift_up(static_cast<std::uint32_t>(heap.size() - 1));
+
+        userdata_index.emplace(evt.event_user_data, slot_idx);
+
+        return (static_cast<event_handle>(slots[slot_idx].generation) << 32) | slot_idx;
+    }
+
+    bool event_queue::remove(const event_handle handle) {
+        slot *target = get_slot(handle);
+
+        if (!target) {
+            return false;
+        }
+
+        remove_at(target->heap_pos);
+        return true;
+    }
+
+    event_handle event_queue::find(const int event_type, const std::uint64_t userdata) {
+        auto range = userdata_index.equal_range(userdata);
+
+        for (auto ite = range.first; ite != range.second; ite++) {
+            if (slots[ite->second].evt.event_type == event_type) {
+                return (static_cast<event_handle>(slots[ite->second].generation) << 32) | ite->second;
+            }
+        }
+
+        return invalid_event_handle;
+    }
+
+    bool event_queue::set_userdata(const event_handle handle, const std::uint64_t new_userdata) {
+        slot *target = get_slot(handle);
+
+        if (!target) {
+            return false;
+        }
+
+        const std::uint32_t slot_idx = static_cast<std::uint32_t>(handle);
+
+        unindex(slot_idx);
+        target->evt.event_user_data = new_userdata;
+        userdata_index.emplace(new_userdata, slot_idx);
+
+        return true;
+    }
+
+    void event_queue::clear() {
+        for (const std::uint32_t slot_idx : heap) {
+            if (++slots[slot_idx].generation == 0) {
+                slots[slot_idx].generation = 1;
+            }
+
+            free_slots.push_back(slot_idx);
+        }
+
+        heap.clear();
+        userdata_index.clear();
+    }
+
+    std::vector<event> event_queue::get_sorted_events() const {
+        std::vector<std::uint32_t> sorted = heap;
+
+        std::sort(sorted.begin(), sorted.end(), [this](const std::uint32_t lhs, const std::uint32_t rhs) {
+            return is_before(rhs, lhs);
+        });
+
+        std::vector<event> result;
+        result.reserve(sorted.size());
+
+        for (const std::uint32_t slot_idx : sorted) {
+            result.push_back(slots[slot_idx].evt);
+        }
+
+        return result;
+    }
+
+    std::vector<event_handle> event_queue::find_all(const int event_type) const {
+        std::vector<event_handle> result;
+
+        for (const std::uint32_t slot_idx : heap) {
+            if (slots[slot_idx].evt.event_type == event_type) {
+                result.push_back((static_cast<event_handle>(slots[slot_idx].generation) << 32) | slot_idx);
+            }
+        }
+
+        return result;
+    }
+
     void timing_system::fire_mhz_changes() {
         for (auto &mhz_change : internal_mhzcs) {
             mhz_change();
@@ -40,6 +265,7 @@ namespace eka2l1 {
         last_global_time_us = get_global_time_us();
 
         CPU_HZ = cpu_mhz;
+        sync_host_clock();
 
         fire_mhz_changes();
     }
@@ -56,6 +282,20 @@ namespace eka2l1 {
         return idle_ticks;
     }
 
+    double timing_system::get_idle_ratio() {
+        const uint64_t ticks = get_ticks();
+
+        if (ticks == 0) {
+            return 0.0;
+        }
+
+        return static_cast<double>(idle_ticks) / static_cast<double>(ticks);
+    }
+
+    uint64_t timing_system::get_host_idle_us() {
+        return host_idle_us;
+    }
+
     uint64_t timing_system::get_global_time_us() {
         uint64_t passed = global_timer - last_global_time_ticks;
         auto frequency = get_clock_frequency_mhz();
@@ -97,8 +337,25 @@ namespace eka2l1 {
         last_global_time_ticks = 0;
         last_global_time_us = 0;
         idle_ticks = 0;
+        host_idle_us = 0;
 
         CPU_HZ = 250000000;
+
+        pacing = pacing_mode::turbo;
+        pacing_speed = 1.0;
+        sync_host_clock();
+    }
+
+    void timing_system::sync_host_clock() {
+        host_anchor = std::chrono::steady_clock::now();
+        guest_anchor = get_ticks();
+    }
+
+    void timing_system::set_pacing_mode(const pacing_mode mode, const double speed) {
+        pacing = mode;
+        pacing_speed = (mode == pacing_mode::scaled && speed > 0.0) ? speed : 1.0;
+
+        sync_host_clock();
     }
 
     void timing_system::restore_register_event(int evt_type, const std::string &name, timed_callback callback) {
@@ -111,13 +368,11 @@ namespace eka2l1 {
     }
 
     void timing_system::swap_userdata_event(int event_type, std::uint64_t old_userdata, std::uint64_t new_userdata) {
-        auto e = std::find_if(events.begin(), events.end(), [=](const event &ei) {
-            return (ei.event_user_data == old_userdata) && (ei.event_type == event_type);
-        });
+        events.set_userdata(events.find(event_type, old_userdata), new_userdata);
+    }
 
-        if (e != events.end()) {
-            e->event_user_data = new_userdata;
-        }
+    void timing_system::swap_userdata_event(event_handle handle, std::uint64_t new_userdata) {
+        events.set_userdata(handle, new_userdata);
     }
 
     void timing_system::unregister_all_events() {
@@ -128,76 +383,124 @@ namespace eka2l1 {
         downcount -= ticks;
     }
 
-    void timing_system::schedule_event(int64_t cycles_into_future, int event_type, uint64_t userdata) {
-        std::lock_guard<std::mutex> guard(mut);
+    event_handle timing_system::schedule_event(int64_t cycles_into_future, int event_type, uint64_t userdata) {
         event evt;
 
         evt.event_time = get_ticks() + cycles_into_future;
         evt.event_type = event_type;
         evt.event_user_data = userdata;
 
-        events.push_back(evt);
+        return events.push(evt);
+    }
 
-        std::stable_sort(events.begin(), events.end(),
-            [](const event &lhs, const event &rhs) {
-                return lhs.event_time > rhs.event_time;
-            });
+    event_handle timing_system::schedule_event_imm(int event_type, uint64_t userdata) {
+        return schedule_event(0, event_type, userdata);
     }
 
-    void timing_system::schedule_event_imm(int event_type, uint64_t userdata) {
-        schedule_event(0, event_type, userdata);
+    void timing_system::schedule_event_thread_safe(int64_t cycles_into_future, int event_type, uint64_t userdata) {
+        ts_events.push(posted_event{ event_type, cycles_into_future, userdata });
+
+        if (idle_waiting.load()) {
+            const std::lock_guard<std::mutex> guard(idle_lock);
+            idle_cv.notify_one();
+        }
     }
 
     void timing_system::unschedule_event(int event_type, uint64_t usrdata) {
-        std::lock_guard<std::mutex> guard(mut);
+        events.remove(events.find(event_type, usrdata));
+    }
 
-        auto res = std::find_if(events.begin(), events.end(),
-            [&](auto evt) { return (evt.event_type == event_type) && (evt.event_user_data == usrdata); });
+    void timing_system::unschedule_event(event_handle handle) {
+        events.remove(handle);
+    }
+
+    void timing_system::remove_event(int event_type) {
+        const std::vector<event_handle> handles = events.find_all(event_type);
 
-        if (res != events.end()) {
-            events.erase(res);
+        if (!handles.empty()) {
+            events.remove(handles.front());
         }
     }
 
-    void timing_system::remove_event(int event_type) {
-        std::lock_guard<std::mutex> guard(mut);
+    uint64_t timing_system::wait_for_ticks(const uint64_t target) {
+        using clock = std::chrono::steady_clock;
+
+        const double host_seconds = static_cast<double>(target - guest_anchor) / (static_cast<double>(CPU_HZ) * pacing_speed);
+        const clock::time_point deadline = host_anchor
+            + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(host_seconds));
+
+        const clock::time_point sleep_start = clock::now();
+
+        if (deadline <= sleep_start) {
+            // The guest is behind. Don't sleep, and don't let it build up either
+            if (sleep_start - deadline > MAX_PACING_LAG) {
+                host_anchor = sleep_start;
+                guest_anchor = target;
+            }
+
+            return target;
+        }
+
+        {
+            std::unique_lock<std::mutex> guard(idle_lock);
+            idle_waiting = true;
+
+            idle_cv.wait_until(guard, deadline, [this]() { return !ts_events.empty(); });
+            idle_waiting = false;
+        }
 
-        auto res = std::find_if(events.begin(), events.end(),
-            [&](auto evt) { return (evt.event_type == event_type); });
+        const clock::time_point sleep_end = clock::now();
+        host_idle_us += std::chrono::duration_cast<std::chrono::microseconds>(sleep_end - sleep_start).count();
 
-        if (res != events.end()) {
-            events.erase(res);
+        if (sleep_end >= deadline) {
+            return target;
         }
+
+        // Woken up by a posted event, stop where the host clock is
+        const double host_passed = std::chrono::duration<double>(sleep_end - host_anchor).count();
+        const uint64_t reached = guest_anchor + static_cast<uint64_t>(host_passed * static_cast<double>(CPU_HZ) * pacing_speed);
+
+        return std::clamp(reached, get_ticks(), target);
     }
 
     void timing_system::idle(int max_idle) {
-        auto dc = downcount;
+        move_events();
 
-        if (max_idle != 0 && dc > max_idle) {
-            dc = max_idle;
-        }
+        const uint64_t now = get_ticks();
 
-        if (events.size() > 0 && dc > 0) {
-            event first_event = events[0];
+        // With nothing scheduled, idle until the end of the slice
+        uint64_t skip = (downcount > 0) ? downcount : 0;
 
-            size_t cexecuted = slice_len - downcount;
-            size_t cnextevt = first_event.event_time - global_timer;
+        if (!events.empty()) {
+            const uint64_t next_event_time = events.top().event_time;
+            skip = (next_event_time > now) ? next_event_time - now : 0;
+        }
 
-            if (cnextevt < cexecuted + dc) {
-                dc = cnextevt - cexecuted;
+        if (max_idle > 0) {
+            skip = std::min<uint64_t>(skip, max_idle);
+        }
 
-                if (dc < 0) {
-                    dc = 0;
-                }
-            }
+        if (skip == 0) {
+            return;
+        }
+
+        if (pacing != pacing_mode::turbo) {
+            skip = wait_for_ticks(now + skip) - now;
         }
 
-        idle_ticks += dc;
-        downcount -= dc;
+        idle_ticks += skip;
+
+        // The event may be further than the slice end. Skip the rest of the way on the global timer
+        const uint64_t slice_skip = std::min<uint64_t>(skip, (downcount > 0) ? downcount : 0);
+
+        downcount -= static_cast<int>(slice_skip);
+        global_timer += skip - slice_skip;
     }
 
     void timing_system::remove_all_events(int event_type) {
-        remove_event(event_type);
+        for (const event_handle handle : events.find_all(event_type)) {
+            events.remove(handle);
+        }
     }
 
     void timing_system::advance() {
@@ -207,21 +510,17 @@ namespace eka2l1 {
         global_timer += cycles_executed;
         slice_len = INITIAL_SLICE_LENGTH;
 
-        while (!events.empty() && events.back().event_time <= global_timer) {
-            event evt = std::move(events.back());
-            events.pop_back();
-
-            std::stable_sort(events.begin(), events.end(),
-                [](const event &lhs, const event &rhs) {
-                    return lhs.event_time > rhs.event_time;
-                });
+        while (!events.empty() && events.top().event_time <= global_timer) {
+            const event evt = events.top();
+            events.pop();
 
             event_types[evt.event_type]
                 .callback(evt.event_user_data, global_timer - evt.event_time);
         }
 
+        // Next slice ends when the earliest event is due
         if (!events.empty()) {
-            slice_len = std::min(static_cast<size_t>(events.front().event_time - global_timer),
+            slice_len = std::min(static_cast<size_t>(events.top().event_time - global_timer),
                 static_cast<std::size_t>(MAX_SLICE_LENGTH));
         }
 
@@ -229,17 +528,15 @@ namespace eka2l1 {
     }
 
     void timing_system::move_events() {
-        std::lock_guard<std::mutex> guard(mut);
+        // Nothing posted is the common case, and it doesn't need any lock
+        while (std::optional<posted_event> posted = ts_events.pop()) {
+            event evt;
 
-        for (uint32_t i = 0; i < ts_events.size(); i++) {
-            events.push_back(ts_events[i]);
+            evt.event_time = get_ticks() + posted->cycles_into_future;
+            evt.event_type = posted->event_type;
+            evt.event_user_data = posted->event_user_data;
 
-            std::stable_sort(events.begin(), events.end(),
-                [](const event &lhs, const event &rhs) {
-                    return lhs.event_time > rhs.event_time;
-                });
-
-            ts_events.erase(events.begin() + i);
+            events.push(evt);
         }
     }
 
@@ -254,7 +551,7 @@ namespace eka2l1 {
     }
 
     void timing_system::log_pending_events() {
-        for (auto evt : events) {
+        for (auto evt : events.get_sorted_events()) {
             LOG_INFO("Pending event: Time: {}, Event type pos: {}, Event userdata: {}",
                 evt.event_time, evt.event_type, evt.event_user_data);
         }
@@ -283,7 +580,6 @@ namespace eka2l1 {
     }
 
     void timing_system::do_state(common::chunkyseri &seri) {
-        std::lock_guard<std::mutex> guard(mut);
         auto s = seri.section("CoreTiming", 1);
 
         if (!s) {
@@ -305,7 +601,19 @@ namespace eka2l1 {
 
         // Since many events using a native pointer, storing the old userdata
         // Than the object will restore with new userdata, using swap_event_userdata.
-        seri.absorb_container(events, event_do_state);
+        // Saved as a list sorted from the latest to the earliest, the same as the old queue.
+        std::vector<event> saved_events = events.get_sorted_events();
+        seri.absorb_container(saved_events, event_do_state);
+
+        if (seri.get_seri_mode() == common::SERI_MODE_READ) {
+            sync_host_clock();
+            events.clear();
+
+            // Earliest first, so events with the same time keep their order
+            for (auto ite = saved_events.rbegin(); ite != saved_events.rend(); ite++) {
+                events.push(*ite);
+            }
+        }
 
         fire_mhz_changes();
     }
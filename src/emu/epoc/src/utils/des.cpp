@@ -111,4 +111,48 @@ namespace eka2l1::epoc {
 
         return nullptr;
     }
-}
\ No newline at end of file
+
+    address desc_base::get_pointer_address(eka2l1::process_ptr pr, const address self) {
+        des_type dtype = get_descriptor_type();
+
+        switch (dtype) {
+        case ptr_const: {
+            ptr_desc<std::uint8_t> *des = reinterpret_cast<decltype(des)>(this);
+            return des->data.ptr_address();
+        }
+
+        case ptr: {
+            ptr_des<std::uint8_t> *des = reinterpret_cast<decltype(des)>(this);
+            return des->data.ptr_address();
+        }
+
+        // Buffer data follows the header
+        case buf_const:
+            return self + sizeof(desc<std::uint8_t>);
+
+        case buf:
+            return self + sizeof(des<std::uint8_t>);
+
+        case ptr_to_buf: {
+            ptr_des<std::uint8_t> *pbuf = reinterpret_cast<decltype(pbuf)>(this);
+            return pbuf->data.ptr_address() + sizeof(desc<std::uint8_t>);
+        }
+
+        default:
+            break;
+        }
+
+        return 0;
+    }
+
+    bool desc_base::write_data(eka2l1::process_ptr pr, const address self, const std::uint8_t *data,
+        const std::uint32_t size) {
+        const address data_addr = get_pointer_address(pr, self);
+
+        if (!data_addr) {
+            return false;
+        }
+
+        return pr->get_page_table().write_span(data_addr, data, size);
+    }
+}
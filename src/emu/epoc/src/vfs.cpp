@@ -772,51 +772,6 @@ namespace eka2l1 {
         loader::rom *rom_cache;
         memory_system *mem;
 
-        std::optional<loader::rom_entry> burn_tree_find_entry(const std::string &vir_path) {
-            auto ite = path_iterator(vir_path);
-
-            loader::rom_dir *last_dir_found = &(rom_cache->root.root_dirs[0].dir);
-
-            // Skip through the drive
-            ite++;
-
-            std::vector<std::string> components;
-
-            for (; ite; ite++) {
-                components.push_back(*ite);
-            }
-
-            if (components.size() == 0) {
-                return std::nullopt;
-            }
-
-            for (std::size_t i = 0; i < components.size() - 1; i++) {
-                loader::rom_dir temp;
-                temp.name = common::utf8_to_ucs2(components[i]);
-
-                auto res1 = std::lower_bound(last_dir_found->subdirs.begin(), last_dir_found->subdirs.end(), temp,
-                    [](const loader::rom_dir &lhs, const loader::rom_dir &rhs) { return common::compare_ignore_case(lhs.name, rhs.name) == -1; });
-
-                if (res1 != last_dir_found->subdirs.end() && (common::compare_ignore_case(res1->name, temp.name) == 0)) {
-                    last_dir_found = &(last_dir_found->subdirs[std::distance(last_dir_found->subdirs.begin(), res1)]);
-                } else {
-                    return std::optional<loader::rom_entry>{};
-                }
-            }
-
-            loader::rom_entry temp_entry;
-            temp_entry.name = common::utf8_to_ucs2(components[components.size() - 1]);
-
-            auto res2 = std::lower_bound(last_dir_found->entries.begin(), last_dir_found->entries.end(), temp_entry,
-                [](const loader::rom_entry &lhs, const loader::rom_entry &rhs) { return common::compare_ignore_case(lhs.name, rhs.name) == -1; });
-
-            if (res2 != last_dir_found->entries.end() && !res2->dir && (common::compare_ignore_case(temp_entry.name, res2->name) == 0)) {
-                return *res2;
-            }
-
-            return std::nullopt;
-        }
-
     public:
         explicit rom_file_system(loader::rom *cache, memory_system *mem, epocver ver, const std::string &product_code)
             : physical_file_system(ver, product_code)
@@ -855,7 +810,7 @@ namespace eka2l1 {
                 return abstract_file_system_err_code::no;
             }
 
-            if (burn_tree_find_entry(common::ucs2_to_utf8(path))) {
+            if (loader::find_rom_entry(*rom_cache, path)) {
                 return abstract_file_system_err_code::ok;
             }
 
@@ -899,7 +854,7 @@ namespace eka2l1 {
                 new_path.replace(lib_pos, replace_hack_str.length(), u"\\sys\\bin");
             }
 
-            auto entry = burn_tree_find_entry(common::ucs2_to_utf8(new_path));
+            const loader::rom_entry *entry = loader::find_rom_entry(*rom_cache, new_path);
 
             if (!entry) {
                 return physical_file_system::open_file(new_path, mode);
@@ -914,7 +869,7 @@ namespace eka2l1 {
                 return std::nullopt;
             }
 
-            auto entry = burn_tree_find_entry(common::ucs2_to_utf8(path));
+            const loader::rom_entry *entry = loader::find_rom_entry(*rom_cache, path);
 
             if (!entry) {
                 return physical_file_system::get_entry_info(path);
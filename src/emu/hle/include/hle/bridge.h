@@ -42,10 +42,28 @@ namespace eka2l1 {
     namespace hle {
         using import_func = std::function<void(system *)>;
 
+        /*! \brief Get R0 to R15, in one call to the CPU.
+         *
+         * \param storage Filled if the CPU can't give a direct view of its registers.
+        */
+        inline const std::uint32_t *fetch_regs(arm::jitter &cpu, arm::arm_interface::gpr_array &storage) {
+            const std::uint32_t *regs = cpu->get_regs_view();
+
+            if (regs) {
+                return regs;
+            }
+
+            cpu->get_regs(storage);
+            return storage.data();
+        }
+
         /*! \brief Call a HLE function without return value. */
         template <typename ret, typename... args, size_t... indices>
         void call(ret (*export_fn)(system *, args...), const args_layout<args...> &layout, std::index_sequence<indices...>, arm::jitter &cpu, system *symsys) {
-            const ret result = (*export_fn)(symsys, read<args, indices, args...>(cpu, layout, symsys->get_memory_system())...);
+            [[maybe_unused]] arm::arm_interface::gpr_array storage;
+            [[maybe_unused]] const std::uint32_t *regs = (sizeof...(args) > 0) ? fetch_regs(cpu, storage) : nullptr;
+
+            const ret result = (*export_fn)(symsys, read<args, indices, args...>(regs, layout, symsys->get_memory_system())...);
 
             write_return_value(cpu, result);
         }
@@ -53,7 +71,10 @@ namespace eka2l1 {
         /*! \brief Call a HLE function with return value. */
         template <typename... args, size_t... indices>
         void call(void (*export_fn)(system *, args...), const args_layout<args...> &layout, std::index_sequence<indices...>, arm::jitter &cpu, system *symsys) {
-            (*export_fn)(symsys, read<args, indices, args...>(cpu, layout, symsys->get_memory_system())...);
+            [[maybe_unused]] arm::arm_interface::gpr_array storage;
+            [[maybe_unused]] const std::uint32_t *regs = (sizeof...(args) > 0) ? fetch_regs(cpu, storage) : nullptr;
+
+            (*export_fn)(symsys, read<args, indices, args...>(regs, layout, symsys->get_memory_system())...);
         }
 
         /*! \brief Bridge a HLE function to guest (ARM - Symbian). */
@@ -67,6 +88,24 @@ namespace eka2l1 {
             };
         }
 
+        template <typename ret, typename... args>
+        void call_bridged(ret (*export_fn)(system *, args...), system *symsys) {
+            constexpr args_layout<args...> layouts = lay_out<typename bridge_type<args>::arm_type...>();
+
+            using indices = std::index_sequence_for<args...>;
+            call(export_fn, layouts, indices(), symsys->get_cpu(), symsys);
+        }
+
+        /*! \brief Bridge a HLE function to guest, as a plain function.
+         *
+         * Unlike bridge(), one function is generated for each HLE function, so the HLE
+         * function is known at compile time and can be inlined.
+        */
+        template <auto export_fn>
+        void bridge_thunk(system *symsys) {
+            call_bridged(export_fn, symsys);
+        }
+
         /*! \brief Write function arguments to guest. */
         template <typename... args, size_t... indices>
         void write_args(arm::jitter &cpu, const std::array<arg_layout, sizeof...(indices)> &layouts, std::index_sequence<indices...>, memory_system *mem, args... lle_args) {
@@ -142,9 +181,9 @@ namespace eka2l1 {
             return call_lle<ret, args...>(mngr, cpu, asmdis, mem, addr, lle_args...);
         }
 
-#define BRIDGE_REGISTER(func_sid, func)                                               \
-    {                                                                                 \
-        func_sid, eka2l1::hle::epoc_import_func { eka2l1::hle::bridge(&func), #func } \
+#define BRIDGE_REGISTER(func_sid, func)                                                      \
+    {                                                                                        \
+        func_sid, eka2l1::hle::epoc_import_func { &eka2l1::hle::bridge_thunk<&func>, #func } \
     }
 
 #define BRIDGE_FUNC(ret, name, ...) ret name(eka2l1::system *sys, ##__VA_ARGS__)
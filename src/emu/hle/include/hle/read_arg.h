@@ -28,23 +28,23 @@
 namespace eka2l1 {
     namespace hle {
         /*! \brief Reading an argument from the registers. 
-		 * \param cpu The CPU.
+		 * \param regs R0 to R15.
 		 * \param arg The layout of that argument.
 		*/
         template <typename T>
-        std::enable_if_t<sizeof(T) <= 4, T> read_from_gpr(arm::jitter &cpu, const arg_layout &arg) {
-            const uint32_t reg = cpu->get_reg(arg.offset);
+        std::enable_if_t<sizeof(T) <= 4, T> read_from_gpr(const std::uint32_t *regs, const arg_layout &arg) {
+            const uint32_t reg = regs[arg.offset];
             return *reinterpret_cast<const T *>(&reg);
         }
 
         /*! \brief Reading an argument from the registers. 
-		 * \param cpu The CPU.
+		 * \param regs R0 to R15.
 		 * \param arg The layout of that argument.
 		*/
         template <typename T>
-        std::enable_if_t<sizeof(T) == 8, T> read_from_gpr(arm::jitter &cpu, const arg_layout &arg) {
-            const uint64_t low = cpu->get_reg(arg.offset - 1);
-            const uint64_t high = cpu->get_reg(arg.offset);
+        std::enable_if_t<sizeof(T) == 8, T> read_from_gpr(const std::uint32_t *regs, const arg_layout &arg) {
+            const uint64_t low = regs[arg.offset - 1];
+            const uint64_t high = regs[arg.offset];
 
             const uint64_t all = low | (high << 32);
 
@@ -56,55 +56,55 @@ namespace eka2l1 {
 		 * \param arg The layout of that argument.
 		*/
         template <typename T>
-        T read_from_fpr(arm::jitter &cpu, const arg_layout &arg) {
+        T read_from_fpr(const std::uint32_t *regs, const arg_layout &arg) {
             LOG_WARN("Reading from FPR unimplemented");
             return T{};
         }
 
         /*! \brief Reading an argument from stack. 
-		 * \param cpu The CPU.
+		 * \param regs R0 to R15.
 		 * \param arg The layout of that argument.
 		 * \param mem The memory system.
 		*/
         template <typename T>
-        T read_from_stack(arm::jitter &cpu, const arg_layout &layout, memory_system *mem) {
-            const address sp = cpu->get_stack_top();
+        T read_from_stack(const std::uint32_t *regs, const arg_layout &layout, memory_system *mem) {
+            const address sp = regs[13];
             const address stack_arg_offset = sp + static_cast<address>(layout.offset);
 
             return *ptr<T>(stack_arg_offset).get(mem);
         }
 
         /*! \brief Reading an argument. 
-		 * \param cpu The CPU.
+		 * \param regs R0 to R15.
 		 * \param arg The layout of that argument.
 		 * \param mem The memory system.
 		*/
         template <typename T>
-        T read(arm::jitter &cpu, const arg_layout &layout, memory_system *mem) {
+        T read(const std::uint32_t *regs, const arg_layout &layout, memory_system *mem) {
             switch (layout.loc) {
             case arg_where::stack:
-                return read_from_stack<T>(cpu, layout, mem);
+                return read_from_stack<T>(regs, layout, mem);
 
             case arg_where::gpr:
-                return read_from_gpr<T>(cpu, layout);
+                return read_from_gpr<T>(regs, layout);
 
             case arg_where::fpr:
-                return read_from_fpr<T>(cpu, layout);
+                return read_from_fpr<T>(regs, layout);
             }
 
             return T{};
         }
 
         /*! \brief Reading an argument. 
-		 * \param cpu The CPU.
+		 * \param regs R0 to R15.
 		 * \param arg The layout of that argument.
 		 * \param mem The memory system.
 		*/
         template <typename arg, size_t idx, typename... args>
-        arg read(arm::jitter &cpu, const args_layout<args...> &margs, memory_system *mem) {
+        arg read(const std::uint32_t *regs, const args_layout<args...> &margs, memory_system *mem) {
             using arm_type = typename bridge_type<arg>::arm_type;
 
-            const arm_type bridged = read<arm_type>(cpu, margs[idx], mem);
+            const arm_type bridged = read<arm_type>(regs, margs[idx], mem);
             return bridge_type<arg>::arm_to_host(bridged, mem);
         }
     }
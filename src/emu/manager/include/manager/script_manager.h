@@ -5,6 +5,7 @@
 
 #include <common/types.h>
 
+#include <atomic>
 #include <mutex>
 #include <tuple>
 #include <unordered_map>
@@ -34,6 +35,7 @@ namespace eka2l1::manager {
 
         std::vector<panic_func> panic_functions;
         std::vector<svc_func> svc_functions;
+        std::atomic<bool> svc_hooked { false };
         std::vector<pybind11::function> reschedule_functions;
 
         pybind11::scoped_interpreter interpreter;
@@ -58,6 +60,11 @@ namespace eka2l1::manager {
 
         void register_panic(const std::string &panic_cage, pybind11::function &func);
         void register_svc(int svc_num, pybind11::function &func);
+
+        /*! \brief Check if any SVC hook was registered, without taking the lock. */
+        bool has_svc_hooks() const {
+            return svc_hooked;
+        }
         void register_reschedule(pybind11::function &func);
         void register_library_hook(const std::string &name, const uint32_t ord, pybind11::function &func);
         void register_breakpoint(const uint32_t addr, pybind11::function &func);
@@ -133,6 +133,7 @@ namespace eka2l1::manager {
 
     void script_manager::register_svc(int svc_num, pybind11::function &func) {
         svc_functions.push_back(svc_func(svc_num, func));
+        svc_hooked = true;
     }
 
     void script_manager::register_reschedule(pybind11::function &func) {
@@ -0,0 +1,169 @@
+#include <arm/arm_jit_slot_pool.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace eka2l1;
+
+struct test_jit_context {
+    std::uint32_t r0 = 0;
+};
+
+// What the slot pool needs from a JIT, with the register context reduced to one register
+struct test_jit {
+    std::uint8_t **page_table;
+    bool executing = false;
+
+    std::uint32_t r0 = 0;
+
+    explicit test_jit(std::uint8_t **page_table)
+        : page_table(page_table) {
+    }
+
+    bool IsExecuting() const {
+        return executing;
+    }
+
+    void SaveContext(test_jit_context &ctx) const {
+        ctx.r0 = r0;
+    }
+
+    void LoadContext(const test_jit_context &ctx) {
+        r0 = ctx.r0;
+    }
+};
+
+static constexpr std::size_t test_page_size = 0x1000;
+static constexpr std::size_t test_pool_size = 4;
+
+using test_slot_pool = arm::basic_jit_slot_pool<test_jit, test_jit_context, 0x100, test_pool_size>;
+
+static void init_test_pool(test_slot_pool &pool) {
+    pool.init(test_page_size, [](test_slot_pool::page_array *table) {
+        return std::make_unique<test_jit>(table->data());
+    });
+}
+
+static std::uint8_t *test_page(const std::size_t idx) {
+    static std::vector<std::uint8_t> backing(0x100 * test_page_size);
+    return backing.data() + idx * test_page_size;
+}
+
+TEST_CASE("jit_slot_evict_least_recently_used", "arm") {
+    test_slot_pool pool;
+    init_test_pool(pool);
+
+    // Slot 0 starts as address space 0, the other three go to 1, 2 and 3
+    REQUIRE(pool.switch_address_space(1) == arm::memory_map_state::empty);
+    REQUIRE(pool.switch_address_space(2) == arm::memory_map_state::empty);
+    REQUIRE(pool.switch_address_space(3) == arm::memory_map_state::empty);
+
+    // Touch 1 again, so 0 is now the least recently used
+    REQUIRE(pool.switch_address_space(1) == arm::memory_map_state::up_to_date);
+    REQUIRE(pool.switch_address_space(4) == arm::memory_map_state::empty);
+
+    // Then 2
+    REQUIRE(pool.switch_address_space(5) == arm::memory_map_state::empty);
+
+    REQUIRE(pool.switch_address_space(1) == arm::memory_map_state::up_to_date);
+    REQUIRE(pool.switch_address_space(3) == arm::memory_map_state::up_to_date);
+    REQUIRE(pool.switch_address_space(4) == arm::memory_map_state::up_to_date);
+    REQUIRE(pool.switch_address_space(5) == arm::memory_map_state::up_to_date);
+
+    REQUIRE(pool.switch_address_space(2) == arm::memory_map_state::empty);
+    REQUIRE(pool.switch_address_space(0) == arm::memory_map_state::empty);
+}
+
+TEST_CASE("jit_slot_reuse_page_table", "arm") {
+    test_slot_pool pool;
+    init_test_pool(pool);
+
+    pool.switch_address_space(1);
+    test_jit *first_jit = pool.current();
+
+    pool.map(0x10000, 2 * test_page_size, test_page(1), false);
+    first_jit->r0 = 10;
+
+    pool.switch_address_space(2);
+
+    REQUIRE(pool.current() != first_jit);
+    REQUIRE(pool.current_asid() == 2);
+    REQUIRE(pool.current_page_table()[0x10] == nullptr);
+
+    // The register context follows the switch
+    REQUIRE(pool.current()->r0 == 10);
+    pool.current()->r0 = 20;
+
+    REQUIRE(pool.switch_address_space(1) == arm::memory_map_state::up_to_date);
+
+    REQUIRE(pool.current() == first_jit);
+    REQUIRE(pool.current()->r0 == 20);
+    REQUIRE(pool.current_page_table()[0x10] == test_page(1));
+    REQUIRE(pool.current_page_table()[0x11] == test_page(1) + test_page_size);
+}
+
+TEST_CASE("jit_slot_switch_while_executing", "arm") {
+    test_slot_pool pool;
+    init_test_pool(pool);
+
+    pool.switch_address_space(1);
+    pool.map(0x10000, test_page_size, test_page(1), false);
+
+    pool.switch_address_space(2);
+    test_jit *running_jit = pool.current();
+
+    running_jit->executing = true;
+
+    // The running JIT stays, with its page table now belonging to the new address space
+    REQUIRE(pool.switch_address_space(1) == arm::memory_map_state::previous);
+    REQUIRE(pool.current() == running_jit);
+    REQUIRE(pool.current_asid() == 1);
+
+    running_jit->executing = false;
+
+    // The slot that had address space 1 gave it up, its mappings are not trusted anymore
+    REQUIRE(pool.switch_address_space(3) == arm::memory_map_state::empty);
+    REQUIRE(pool.switch_address_space(1) == arm::memory_map_state::up_to_date);
+    REQUIRE(pool.current() == running_jit);
+
+    REQUIRE(pool.switch_address_space(2) == arm::memory_map_state::empty);
+}
+
+TEST_CASE("jit_slot_evict_clears_local_ranges_only", "arm") {
+    test_slot_pool pool;
+    init_test_pool(pool);
+
+    pool.switch_address_space(1);
+
+    pool.map(0x10000, 2 * test_page_size, test_page(1), false);
+    pool.map(0x20000, test_page_size, test_page(3), false);
+    pool.map(0x80000, test_page_size, test_page(4), true);
+
+    // Unmapped ranges are not tracked anymore
+    pool.unmap(0x20000, test_page_size, false);
+
+    // Fill the other slots, then evict 1
+    pool.switch_address_space(2);
+    pool.switch_address_space(3);
+    pool.switch_address_space(4);
+
+    REQUIRE(pool.switch_address_space(5) == arm::memory_map_state::empty);
+
+    const auto &table = pool.current_page_table();
+
+    REQUIRE(table[0x10] == nullptr);
+    REQUIRE(table[0x11] == nullptr);
+    REQUIRE(table[0x20] == nullptr);
+
+    // Global mappings are shared by all address spaces, so they stay
+    REQUIRE(table[0x80] == test_page(4));
+
+    // Other slots only ever got the global mapping
+    pool.switch_address_space(2);
+
+    REQUIRE(pool.current_page_table()[0x10] == nullptr);
+    REQUIRE(pool.current_page_table()[0x80] == test_page(4));
+}
@@ -0,0 +1,115 @@
+#include <arm/arm_unicorn.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace eka2l1;
+
+TEST_CASE("unicorn_get_regs", "arm") {
+    // Nothing is run, so the CPU needs none of the other systems
+    arm::arm_unicorn cpu(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    for (std::uint32_t i = 0; i < 13; i++) {
+        cpu.set_reg(i, 0x1000 + i);
+    }
+
+    cpu.set_sp(0x2000);
+    cpu.set_lr(0x3000);
+    cpu.set_pc(0x4000);
+
+    arm::arm_interface::gpr_array regs;
+    cpu.get_regs(regs);
+
+    for (std::uint32_t i = 0; i < 13; i++) {
+        REQUIRE(regs[i] == 0x1000 + i);
+    }
+
+    REQUIRE(regs[13] == 0x2000);
+    REQUIRE(regs[14] == 0x3000);
+    REQUIRE(regs[15] == 0x4000);
+
+    // Single register reads agree, including SP, LR and PC
+    for (std::uint32_t i = 0; i < regs.size(); i++) {
+        REQUIRE(cpu.get_reg(i) == regs[i]);
+    }
+}
+
+TEST_CASE("unicorn_set_regs", "arm") {
+    arm::arm_unicorn cpu(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    arm::arm_interface::gpr_array regs {};
+    cpu.set_regs(regs.data(), 0, regs.size());
+
+    // A range crossing into SP, LR and PC
+    const std::uint32_t high[] = { 0xA, 0xB, 0xC, 0xD, 0xE };
+    cpu.set_regs(high, 11, 5);
+
+    REQUIRE(cpu.get_reg(10) == 0);
+    REQUIRE(cpu.get_reg(11) == 0xA);
+    REQUIRE(cpu.get_reg(12) == 0xB);
+    REQUIRE(cpu.get_sp() == 0xC);
+    REQUIRE(cpu.get_lr() == 0xD);
+    REQUIRE(cpu.get_pc() == 0xE);
+
+    const std::uint32_t low[] = { 1, 2, 3, 4 };
+    cpu.set_regs(low, 0, 4);
+
+    cpu.get_regs(regs);
+
+    REQUIRE(std::equal(low, low + 4, regs.begin()));
+    REQUIRE(regs[4] == 0);
+    REQUIRE(regs[15] == 0xE);
+
+    // Single register writes reach SP, LR and PC too
+    cpu.set_reg(13, 0x100);
+    cpu.set_reg(14, 0x200);
+    cpu.set_reg(15, 0x300);
+
+    REQUIRE(cpu.get_sp() == 0x100);
+    REQUIRE(cpu.get_lr() == 0x200);
+    REQUIRE(cpu.get_pc() == 0x300);
+}
+
+TEST_CASE("unicorn_regs_view", "arm") {
+    arm::arm_unicorn cpu(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    // Unicorn keeps its registers to itself, callers go through get_regs instead
+    REQUIRE(cpu.get_regs_view() == nullptr);
+}
+
+TEST_CASE("unicorn_context_round_trip", "arm") {
+    arm::arm_unicorn cpu(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    arm::arm_interface::thread_context ctx {};
+
+    for (std::uint32_t i = 0; i < 16; i++) {
+        ctx.cpu_registers[i] = 0x10 * (i + 1);
+    }
+
+    ctx.sp = ctx.cpu_registers[13];
+    ctx.lr = ctx.cpu_registers[14];
+    ctx.pc = ctx.cpu_registers[15];
+
+    // Same mode, so SP and LR are not banked away
+    ctx.cpsr = cpu.get_cpsr();
+
+    cpu.load_context(ctx);
+
+    REQUIRE(cpu.get_reg(12) == 0xD0);
+    REQUIRE(cpu.get_sp() == 0xE0);
+    REQUIRE(cpu.get_pc() == 0x100);
+
+    arm::arm_interface::thread_context saved {};
+    std::fill(saved.cpu_registers.begin(), saved.cpu_registers.end(), 0xFFFFFFFF);
+
+    cpu.save_context(saved);
+
+    REQUIRE(std::equal(ctx.cpu_registers.begin(), ctx.cpu_registers.begin() + 16, saved.cpu_registers.begin()));
+    REQUIRE(std::all_of(saved.cpu_registers.begin() + 16, saved.cpu_registers.end(), [](const std::uint32_t reg) { return reg == 0; }));
+
+    REQUIRE(saved.sp == 0xE0);
+    REQUIRE(saved.lr == 0xF0);
+    REQUIRE(saved.pc == 0x100);
+}
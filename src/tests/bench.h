@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+
+namespace eka2l1::test {
+    /*! \brief Run a function for a number of times, and return the total time it took, in seconds.
+     *
+     * Benchmarks measure with this and report the result through WARN. They are tagged
+     * [.benchmark] so they stay out of the default run, use "ekatests [benchmark]" to run them.
+     */
+    template <typename F>
+    double measure(F &&func, const int total_run = 1) {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < total_run; i++) {
+            func();
+        }
+
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bench.h>
+#include <catch2/catch.hpp>
+#include <common/bytepair.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace eka2l1;
+
+// Greedy compressor, in the format the decompressor expects. Only byte values absent from the
+// page become pair tokens, so the marker is never needed.
+static std::vector<std::uint8_t> bytepair_compress_page(const std::uint8_t *page, const std::size_t size,
+    const std::size_t max_pairs) {
+    std::array<bool, 0x100> used{};
+
+    for (std::size_t i = 0; i < size; i++) {
+        used[page[i]] = true;
+    }
+
+    std::vector<std::uint8_t> free_bytes;
+
+    for (std::uint32_t b = 0; b < 0x100; b++) {
+        if (!used[b]) {
+            free_bytes.push_back(static_cast<std::uint8_t>(b));
+        }
+    }
+
+    std::vector<std::uint8_t> data(page, page + size);
+    std::array<std::array<std::uint8_t, 2>, 0x100> pairs{};
+    std::vector<std::uint8_t> tokens;
+
+    // First free byte is the marker
+    while ((free_bytes.size() > tokens.size() + 1) && (tokens.size() < max_pairs)) {
+        std::vector<std::uint32_t> counts(0x10000, 0);
+
+        for (std::size_t i = 0; i + 1 < data.size(); i++) {
+            counts[(data[i] << 8) | data[i + 1]]++;
+        }
+
+        const auto best = std::max_element(counts.begin(), counts.end());
+
+        if (*best < 3) {
+            break;
+        }
+
+        const std::uint8_t token = free_bytes[tokens.size() + 1];
+        const std::uint8_t first = static_cast<std::uint8_t>((best - counts.begin()) >> 8);
+        const std::uint8_t second = static_cast<std::uint8_t>(best - counts.begin());
+
+        std::vector<std::uint8_t> replaced;
+
+        for (std::size_t i = 0; i < data.size(); i++) {
+            if ((i + 1 < data.size()) && (data[i] == first) && (data[i + 1] == second)) {
+                replaced.push_back(token);
+                i++;
+            } else {
+                replaced.push_back(data[i]);
+            }
+        }
+
+        pairs[token] = { first, second };
+        tokens.push_back(token);
+        data = std::move(replaced);
+    }
+
+    std::vector<std::uint8_t> result;
+    result.push_back(static_cast<std::uint8_t>(tokens.size()));
+
+    if (!tokens.empty()) {
+        result.push_back(free_bytes[0]);
+
+        if (tokens.size() < 32) {
+            for (const std::uint8_t token : tokens) {
+                result.insert(result.end(), { token, pairs[token][0], pairs[token][1] });
+            }
+        } else {
+            std::uint8_t mask[32] = {};
+
+            for (const std::uint8_t token : tokens) {
+                mask[token >> 3] |= static_cast<std::uint8_t>(1 << (token & 7));
+            }
+
+            result.insert(result.end(), mask, mask + 32);
+            std::sort(tokens.begin(), tokens.end());
+
+            for (const std::uint8_t token : tokens) {
+                result.insert(result.end(), { pairs[token][0], pairs[token][1] });
+            }
+        }
+    }
+
+    result.insert(result.end(), data.begin(), data.end());
+    return result;
+}
+
+// Index table, then the pages
+static std::vector<std::uint8_t> bytepair_compress(const std::vector<std::uint8_t> &source, const std::size_t max_pairs) {
+    std::vector<std::vector<std::uint8_t>> pages;
+
+    for (std::size_t off = 0; off < source.size(); off += common::BYTEPAIR_PAGE_SIZE) {
+        const std::size_t len = std::min<std::size_t>(source.size() - off, common::BYTEPAIR_PAGE_SIZE);
+        pages.push_back(bytepair_compress_page(source.data() + off, len, max_pairs));
+    }
+
+    std::vector<std::uint8_t> result(10 + pages.size() * 2);
+
+    const std::uint32_t decompressed_size = static_cast<std::uint32_t>(source.size());
+    const std::uint16_t page_count = static_cast<std::uint16_t>(pages.size());
+
+    std::memcpy(&result[4], &decompressed_size, 4);
+    std::memcpy(&result[8], &page_count, 2);
+
+    for (std::size_t i = 0; i < pages.size(); i++) {
+        const std::uint16_t page_size = static_cast<std::uint16_t>(pages[i].size());
+        std::memcpy(&result[10 + i * 2], &page_size, 2);
+
+        result.insert(result.end(), pages[i].begin(), pages[i].end());
+    }
+
+    const std::uint32_t data_size = static_cast<std::uint32_t>(result.size());
+    std::memcpy(&result[0], &data_size, 4);
+
+    return result;
+}
+
+// Text-like data, so the pages compress and don't use every byte value
+static std::vector<std::uint8_t> make_compressible_data(const std::size_t size, const std::uint32_t seed) {
+    static const char *words[] = { "LDR R0, [R1]", "BX LR", "PUSH {R4-R7, LR}", "MOV R0, #0", "SVC 0x8D", "euser.dll" };
+
+    std::mt19937 rng(seed);
+    std::vector<std::uint8_t> data;
+
+    while (data.size() < size) {
+        const char *word = words[rng() % 6];
+        data.insert(data.end(), word, word + std::strlen(word));
+        data.push_back(static_cast<std::uint8_t>(rng() % 16));
+    }
+
+    data.resize(size);
+    return data;
+}
+
+TEST_CASE("decompress_round_trip", "bytepair") {
+    // 32 pairs or more switch the page to the mask format
+    for (const std::size_t max_pairs : { 8, 100 }) {
+        const auto source = make_compressible_data(common::BYTEPAIR_PAGE_SIZE * 11 + 1234, 7);
+        const auto compressed = bytepair_compress(source, max_pairs);
+
+        REQUIRE(compressed.size() < source.size());
+
+        std::vector<std::uint8_t> dest(source.size());
+        common::ibytepair_stream stream(compressed.data(), compressed.size());
+
+        REQUIRE(stream.read_pages(reinterpret_cast<char *>(dest.data()), dest.size()) == source.size());
+        REQUIRE(dest == source);
+    }
+}
+
+TEST_CASE("parallel_matches_page_by_page", "bytepair") {
+    const auto source = make_compressible_data(common::BYTEPAIR_PAGE_SIZE * 40 + 100, 42);
+    const auto compressed = bytepair_compress(source, 64);
+
+    std::vector<std::uint8_t> parallel(source.size());
+    std::vector<std::uint8_t> sequential(source.size());
+
+    common::ibytepair_stream parallel_stream(compressed.data(), compressed.size());
+    parallel_stream.read_pages(reinterpret_cast<char *>(parallel.data()), parallel.size());
+
+    common::ibytepair_stream sequential_stream(compressed.data(), compressed.size());
+    REQUIRE(sequential_stream.read_table());
+
+    const auto tab = sequential_stream.table();
+    std::size_t total = 0;
+
+    // Out of order, pages don't depend on each other
+    for (std::uint32_t i = tab.header.number_of_pages; i-- > 0;) {
+        const std::size_t off = i * common::BYTEPAIR_PAGE_SIZE;
+        total += sequential_stream.read_page(reinterpret_cast<char *>(&sequential[off]), i, sequential.size() - off);
+    }
+
+    REQUIRE(total == source.size());
+    REQUIRE(parallel == sequential);
+    REQUIRE(parallel == source);
+}
+
+TEST_CASE("consecutive_streams", "bytepair") {
+    // Like an E32 image, code then the rest
+    const auto code = make_compressible_data(common::BYTEPAIR_PAGE_SIZE * 5 + 12, 1);
+    const auto rest = make_compressible_data(common::BYTEPAIR_PAGE_SIZE * 2 + 700, 2);
+
+    auto compressed = bytepair_compress(code, 16);
+    const auto compressed_rest = bytepair_compress(rest, 16);
+
+    compressed.insert(compressed.end(), compressed_rest.begin(), compressed_rest.end());
+
+    std::vector<std::uint8_t> dest(code.size() + rest.size());
+    common::ibytepair_stream stream(compressed.data(), compressed.size());
+
+    REQUIRE(stream.read_pages(reinterpret_cast<char *>(dest.data()), code.size()) == code.size());
+    REQUIRE(stream.read_pages(reinterpret_cast<char *>(&dest[code.size()]), rest.size()) == rest.size());
+
+    REQUIRE(std::equal(code.begin(), code.end(), dest.begin()));
+    REQUIRE(std::equal(rest.begin(), rest.end(), dest.begin() + code.size()));
+
+    // Skip the code to get to the rest, then decode the code pages on their own, last first
+    std::fill(dest.begin(), dest.end(), 0);
+    common::ibytepair_stream rest_stream(compressed.data(), compressed.size());
+
+    REQUIRE(rest_stream.read_table());
+    rest_stream.skip_pages();
+    REQUIRE(rest_stream.read_pages(reinterpret_cast<char *>(&dest[code.size()]), rest.size()) == rest.size());
+    REQUIRE(std::equal(rest.begin(), rest.end(), dest.begin() + code.size()));
+
+    common::ibytepair_stream code_stream(std::move(compressed));
+    REQUIRE(code_stream.read_table());
+
+    for (std::uint32_t page = 6; page-- > 0;) {
+        const std::size_t page_off = page * common::BYTEPAIR_PAGE_SIZE;
+        const std::size_t page_size = std::min<std::size_t>(code.size() - page_off, common::BYTEPAIR_PAGE_SIZE);
+
+        REQUIRE(code_stream.read_page(reinterpret_cast<char *>(&dest[page_off]), page, page_size) == page_size);
+    }
+
+    REQUIRE(std::equal(code.begin(), code.end(), dest.begin()));
+}
+
+TEST_CASE("marker_and_nested_pairs", "bytepair") {
+    // 2 pairs, marker 0xFF. 0x80 = 'a' 'b', 0x81 = 0x80 0x80. 0xFF escapes the literal 0x80.
+    const std::uint8_t page[] = { 2, 0xFF, 0x80, 'a', 'b', 0x81, 0x80, 0x80,
+        0x81, 'c', 0xFF, 0x80, 0x80, 'd' };
+
+    const std::uint8_t expected[] = { 'a', 'b', 'a', 'b', 'c', 0x80, 'a', 'b', 'd' };
+    std::uint8_t dest[sizeof(expected)] = {};
+
+    REQUIRE(common::nokia_bytepair_decompress(dest, sizeof(dest), page, sizeof(page)) == sizeof(expected));
+    REQUIRE(std::memcmp(dest, expected, sizeof(expected)) == 0);
+
+    // Destination is full in the middle of a pair
+    std::uint8_t short_dest[3] = {};
+
+    REQUIRE(common::nokia_bytepair_decompress(short_dest, sizeof(short_dest), page, sizeof(page)) == 3);
+    REQUIRE(std::memcmp(short_dest, expected, 3) == 0);
+}
+
+TEST_CASE("corrupted_data", "bytepair") {
+    // Pair refers to itself
+    const std::uint8_t cyclic_page[] = { 1, 0xFF, 0x80, 'a', 0x80, 0x80 };
+    std::uint8_t dest[64];
+
+    REQUIRE(common::nokia_bytepair_decompress(dest, sizeof(dest), cyclic_page, sizeof(cyclic_page)) == 0);
+
+    // Pair table is cut short
+    const std::uint8_t short_page[] = { 3, 0xFF, 0x80, 'a' };
+    REQUIRE(common::nokia_bytepair_decompress(dest, sizeof(dest), short_page, sizeof(short_page)) == 0);
+
+    // Pages go past the end of the data
+    const auto source = make_compressible_data(common::BYTEPAIR_PAGE_SIZE * 3, 3);
+    auto compressed = bytepair_compress(source, 16);
+    compressed.resize(compressed.size() - 1);
+
+    std::vector<std::uint8_t> big_dest(source.size());
+    common::ibytepair_stream stream(compressed.data(), compressed.size());
+
+    REQUIRE(!stream.read_table());
+
+    common::ibytepair_stream pages_stream(compressed.data(), compressed.size());
+    REQUIRE(pages_stream.read_pages(reinterpret_cast<char *>(big_dest.data()), big_dest.size()) == 0);
+}
+
+TEST_CASE("decompress_throughput", "[.benchmark][bytepair]") {
+    const auto source = make_compressible_data(common::BYTEPAIR_PAGE_SIZE * 512, 1234);
+    const auto compressed = bytepair_compress(source, 128);
+
+    std::vector<std::uint8_t> dest(source.size());
+    constexpr int total_run = 8;
+
+    const double sequential_time = test::measure([&]() {
+        common::ibytepair_stream stream(compressed.data(), compressed.size());
+        stream.read_table();
+
+        for (std::uint32_t i = 0; i < stream.table().header.number_of_pages; i++) {
+            stream.read_page(reinterpret_cast<char *>(&dest[i * common::BYTEPAIR_PAGE_SIZE]), i, common::BYTEPAIR_PAGE_SIZE);
+        }
+    }, total_run);
+
+    const double parallel_time = test::measure([&]() {
+        common::ibytepair_stream stream(compressed.data(), compressed.size());
+        stream.read_pages(reinterpret_cast<char *>(dest.data()), dest.size());
+    }, total_run);
+    const double total_mb = static_cast<double>(source.size()) * total_run / (1024 * 1024);
+
+    REQUIRE(dest == source);
+
+    WARN("Bytepair decompression: " << total_mb / sequential_time << " MB/s page by page, "
+                                    << total_mb / parallel_time << " MB/s on all workers");
+}
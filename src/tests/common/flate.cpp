@@ -0,0 +1,604 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bench.h>
+#include <catch2/catch.hpp>
+#include <common/fileutils.h>
+#include <common/flate.h>
+#include <common/path.h>
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <vector>
+
+using namespace eka2l1;
+
+// Bits from the most significant one, as bit_input reads them
+struct test_bit_writer {
+    std::vector<std::uint8_t> data;
+    std::uint32_t acc = 0;
+    int acc_bits = 0;
+
+    void write(const std::uint32_t val, const int size) {
+        for (int i = size - 1; i >= 0; i--) {
+            acc = (acc << 1) | ((val >> i) & 1);
+
+            if (++acc_bits == 8) {
+                data.push_back(static_cast<std::uint8_t>(acc));
+                acc = 0;
+                acc_bits = 0;
+            }
+        }
+    }
+
+    std::size_t bit_size() const {
+        return data.size() * 8 + acc_bits;
+    }
+
+    // Words are read whole, keep some padding
+    std::vector<std::uint8_t> finish() {
+        if (acc_bits) {
+            data.push_back(static_cast<std::uint8_t>(acc << (8 - acc_bits)));
+        }
+
+        data.resize(data.size() + 8, 0);
+        return data;
+    }
+};
+
+// Same as the encoding table in flate.cpp, code lengths in the top 5 bits
+static const std::uint32_t meta_codes[] = {
+    0x10000000, 0x1c000000, 0x12000000, 0x1d000000, 0x26000000, 0x26800000, 0x2f000000, 0x37400000,
+    0x37600000, 0x37800000, 0x3fa00000, 0x3fb00000, 0x3fc00000, 0x3fd00000, 0x47e00000, 0x47e80000,
+    0x47f00000, 0x4ff80000, 0x57fc0000, 0x5ffe0000, 0x67ff0000, 0x77ff8000, 0x7fffa000, 0x7fffb000,
+    0x7fffc000, 0x7fffd000, 0x7fffe000, 0x87fff000, 0x87fff800
+};
+
+static void write_meta_code(test_bit_writer &writer, const std::uint32_t meta) {
+    const int len = meta >> flate::HUFFMAN_MAX_CODELENGTH;
+    writer.write((meta & ((1 << flate::HUFFMAN_MAX_CODELENGTH) - 1)) >> (flate::HUFFMAN_MAX_CODELENGTH - len), len);
+}
+
+static void write_run_length(test_bit_writer &writer, const int len) {
+    if (len > 0) {
+        write_run_length(writer, (len - 1) >> 1);
+        write_meta_code(writer, meta_codes[1 - (len & 1)]);
+    }
+}
+
+// Code lengths, move to front and run length coded
+static void write_code_lengths(test_bit_writer &writer, const std::vector<int> &lengths) {
+    std::array<std::uint8_t, flate::HUFFMAN_METACODE> list;
+
+    for (std::size_t i = 0; i < list.size(); i++) {
+        list[i] = static_cast<std::uint8_t>(i);
+    }
+
+    int last = 0;
+    int rl = 0;
+
+    for (const int c : lengths) {
+        if (c == last) {
+            rl++;
+            continue;
+        }
+
+        write_run_length(writer, rl);
+        rl = 0;
+
+        int j = 1;
+
+        while (list[j] != c) {
+            j++;
+        }
+
+        write_meta_code(writer, meta_codes[j + 1]);
+
+        while (--j > 0) {
+            list[j + 1] = list[j];
+        }
+
+        list[1] = static_cast<std::uint8_t>(last);
+        last = c;
+    }
+
+    write_run_length(writer, rl);
+}
+
+static std::vector<int> huffman_lengths(const std::vector<std::uint32_t> &freqs) {
+    using node = std::pair<std::uint64_t, int>;
+
+    std::priority_queue<node, std::vector<node>, std::greater<node>> queue;
+    std::vector<int> parents(freqs.size() * 2, -1);
+    std::vector<int> lengths(freqs.size(), 0);
+
+    int next_node = static_cast<int>(freqs.size());
+
+    for (std::size_t i = 0; i < freqs.size(); i++) {
+        if (freqs[i]) {
+            queue.push({ freqs[i], static_cast<int>(i) });
+        }
+    }
+
+    if (queue.size() == 1) {
+        lengths[queue.top().second] = 1;
+        return lengths;
+    }
+
+    while (queue.size() > 1) {
+        const node a = queue.top();
+        queue.pop();
+        const node b = queue.top();
+        queue.pop();
+
+        parents[a.second] = next_node;
+        parents[b.second] = next_node;
+
+        queue.push({ a.first + b.first, next_node++ });
+    }
+
+    for (std::size_t i = 0; i < freqs.size(); i++) {
+        if (freqs[i]) {
+            for (int n = static_cast<int>(i); parents[n] != -1; n = parents[n]) {
+                lengths[i]++;
+            }
+        }
+    }
+
+    return lengths;
+}
+
+// Canonical codes, shorter first then by symbol
+static std::vector<std::uint32_t> canonical_codes(const std::vector<int> &lengths) {
+    std::array<std::uint32_t, flate::HUFFMAN_MAX_CODELENGTH + 2> counts{};
+    std::array<std::uint32_t, flate::HUFFMAN_MAX_CODELENGTH + 2> next_code{};
+
+    for (const int len : lengths) {
+        if (len) {
+            counts[len]++;
+        }
+    }
+
+    std::uint32_t code = 0;
+
+    for (int len = 1; len <= flate::HUFFMAN_MAX_CODELENGTH; len++) {
+        code = (code + counts[len - 1]) << 1;
+        next_code[len] = code;
+    }
+
+    std::vector<std::uint32_t> codes(lengths.size());
+
+    for (std::size_t i = 0; i < lengths.size(); i++) {
+        if (lengths[i]) {
+            codes[i] = next_code[lengths[i]]++;
+        }
+    }
+
+    return codes;
+}
+
+static int value_code(const int value, std::uint32_t &xtra_bits, int &xtra) {
+    xtra = 0;
+    xtra_bits = 0;
+
+    if (value < 8) {
+        return value;
+    }
+
+    for (int code = 8;; code++) {
+        xtra = (code >> 2) - 1;
+        const int base = (code - (xtra << 2)) << xtra;
+
+        if (value < base + (1 << xtra)) {
+            xtra_bits = value - base;
+            return code;
+        }
+    }
+}
+
+struct test_symbol {
+    int lit_len;
+    int dist_code;
+    std::uint32_t len_xtra_bits;
+    int len_xtra;
+    std::uint32_t dist_xtra_bits;
+    int dist_xtra;
+};
+
+// Deflate in the image format, with a greedy LZ77 of the 4KB window
+static std::vector<std::uint8_t> nokia_deflate(const std::vector<std::uint8_t> &source) {
+    std::vector<test_symbol> symbols;
+    std::vector<int> head(1 << 16, -1);
+    std::vector<int> chain(source.size(), -1);
+
+    const auto hash3 = [&](const std::size_t pos) {
+        return ((source[pos] << 8) ^ (source[pos + 1] << 4) ^ source[pos + 2]) & 0xFFFF;
+    };
+
+    for (std::size_t pos = 0; pos < source.size();) {
+        int best_len = 0;
+        int best_dist = 0;
+
+        if (pos + flate::DEFLATE_MIN_LENGTH <= source.size()) {
+            int tries = 32;
+
+            for (int cand = head[hash3(pos)]; (cand >= 0) && (pos - cand <= flate::DEFLATE_MAX_DIST) && tries--; cand = chain[cand]) {
+                int len = 0;
+                const int max_len = static_cast<int>(std::min<std::size_t>(flate::DEFLATE_MAX_LENGTH, source.size() - pos));
+
+                while ((len < max_len) && (source[cand + len] == source[pos + len])) {
+                    len++;
+                }
+
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = static_cast<int>(pos - cand);
+                }
+            }
+        }
+
+        const std::size_t advance = (best_len >= flate::DEFLATE_MIN_LENGTH) ? best_len : 1;
+
+        for (std::size_t i = 0; i < advance; i++) {
+            if (pos + i + flate::DEFLATE_MIN_LENGTH <= source.size()) {
+                const int h = hash3(pos + i);
+                chain[pos + i] = head[h];
+                head[h] = static_cast<int>(pos + i);
+            }
+        }
+
+        test_symbol sym{};
+
+        if (best_len >= flate::DEFLATE_MIN_LENGTH) {
+            sym.lit_len = flate::ENCODING_LITERALS + value_code(best_len - flate::DEFLATE_MIN_LENGTH, sym.len_xtra_bits, sym.len_xtra);
+            sym.dist_code = value_code(best_dist - 1, sym.dist_xtra_bits, sym.dist_xtra);
+        } else {
+            sym.lit_len = source[pos];
+            sym.dist_code = -1;
+        }
+
+        symbols.push_back(sym);
+        pos += advance;
+    }
+
+    symbols.push_back({ flate::ENCODING_EOS, -1, 0, 0, 0, 0 });
+
+    std::vector<std::uint32_t> lit_len_freqs(flate::ENCODING_LITERAL_LEN, 0);
+    std::vector<std::uint32_t> dist_freqs(flate::ENCODING_DISTS, 0);
+
+    for (const test_symbol &sym : symbols) {
+        lit_len_freqs[sym.lit_len]++;
+
+        if (sym.dist_code >= 0) {
+            dist_freqs[sym.dist_code]++;
+        }
+    }
+
+    const auto lit_len_lengths = huffman_lengths(lit_len_freqs);
+    const auto dist_lengths = huffman_lengths(dist_freqs);
+
+    const auto lit_len_codes = canonical_codes(lit_len_lengths);
+    const auto dist_codes = canonical_codes(dist_lengths);
+
+    std::vector<int> all_lengths(lit_len_lengths);
+    all_lengths.insert(all_lengths.end(), dist_lengths.begin(), dist_lengths.end());
+
+    test_bit_writer writer;
+    write_code_lengths(writer, all_lengths);
+
+    for (const test_symbol &sym : symbols) {
+        writer.write(lit_len_codes[sym.lit_len], lit_len_lengths[sym.lit_len]);
+
+        if (sym.dist_code >= 0) {
+            writer.write(sym.len_xtra_bits, sym.len_xtra);
+            writer.write(dist_codes[sym.dist_code], dist_lengths[sym.dist_code]);
+            writer.write(sym.dist_xtra_bits, sym.dist_xtra);
+        }
+    }
+
+    return writer.finish();
+}
+
+// The inflater before the lookup tables: walk the decoding tree bit by bit, and copy matches
+// byte by byte from a 4KB ring
+static std::vector<std::uint8_t> reference_inflate(const std::vector<std::uint8_t> &compressed, const std::size_t size) {
+    flate::bit_input input(compressed.data(), static_cast<int>(compressed.size() * 8));
+    flate::encoding encode;
+
+    flate::huffman::internalize(input, encode.lit_len, flate::DEFLATE_CODES);
+    flate::huffman::decoding(reinterpret_cast<int *>(encode.lit_len), flate::ENCODING_LITERAL_LEN, encode.lit_len);
+    flate::huffman::decoding(reinterpret_cast<int *>(encode.dist), flate::ENCODING_DISTS, encode.dist, flate::DEFLATE_DIST_CODE_BASE);
+
+    std::vector<std::uint8_t> result;
+    result.reserve(size);
+
+    std::uint8_t window[flate::DEFLATE_MAX_DIST];
+    std::size_t window_pos = 0;
+
+    while (result.size() < size) {
+        int val = static_cast<int>(input.huffman(encode.lit_len)) - flate::ENCODING_LITERALS;
+
+        if (val < 0) {
+            result.push_back(static_cast<std::uint8_t>(val));
+            window[window_pos++ % flate::DEFLATE_MAX_DIST] = static_cast<std::uint8_t>(val);
+            continue;
+        }
+
+        if (val == flate::ENCODING_EOS - flate::ENCODING_LITERALS) {
+            break;
+        }
+
+        int code = val & 0xff;
+
+        if (code >= 8) {
+            const int xtra = (code >> 2) - 1;
+            code = (((code - (xtra << 2)) << xtra) | input.read(xtra));
+        }
+
+        const int len = code + flate::DEFLATE_MIN_LENGTH;
+
+        code = (input.huffman(encode.dist) - flate::ENCODING_LITERALS) & 0xff;
+
+        if (code >= 8) {
+            const int xtra = (code >> 2) - 1;
+            code = (((code - (xtra << 2)) << xtra) | input.read(xtra));
+        }
+
+        std::size_t from = window_pos + flate::DEFLATE_MAX_DIST - (code + 1);
+
+        for (int i = 0; i < len; i++) {
+            const std::uint8_t b = window[from++ % flate::DEFLATE_MAX_DIST];
+
+            result.push_back(b);
+            window[window_pos++ % flate::DEFLATE_MAX_DIST] = b;
+        }
+    }
+
+    result.resize(std::min(result.size(), size));
+    return result;
+}
+
+static std::vector<std::uint8_t> fast_inflate(const std::vector<std::uint8_t> &compressed, const std::size_t size) {
+    flate::bit_input input(compressed.data(), static_cast<int>(compressed.size() * 8));
+    flate::inflater inflate_machine(input);
+
+    inflate_machine.init();
+
+    std::vector<std::uint8_t> result(size);
+    result.resize(inflate_machine.read(result.data(), result.size()));
+
+    return result;
+}
+
+// Code-like data: repeated instruction words with different registers and offsets
+static std::vector<std::uint8_t> make_image_like_data(const std::size_t size, const std::uint32_t seed) {
+    static const std::uint32_t instructions[] = { 0xE59F0000, 0xE12FFF1E, 0xE92D4070, 0xE3A00000, 0xEF00008D, 0xE8BD8070 };
+
+    std::mt19937 rng(seed);
+    std::vector<std::uint8_t> data;
+
+    while (data.size() < size) {
+        std::uint32_t word = instructions[rng() % 6];
+
+        if (rng() % 4 == 0) {
+            word |= rng() & 0xFFF;
+        }
+
+        if (rng() % 16 == 0) {
+            word = rng();
+        }
+
+        const auto bytes = reinterpret_cast<const std::uint8_t *>(&word);
+        data.insert(data.end(), bytes, bytes + 4);
+    }
+
+    data.resize(size);
+    return data;
+}
+
+TEST_CASE("lookup_matches_decoding_tree", "flate") {
+    std::mt19937 rng(2019);
+
+    for (int round = 0; round < 200; round++) {
+        // Random complete code, from random frequencies
+        const std::size_t num_codes = (round % 2) ? flate::ENCODING_LITERAL_LEN : flate::ENCODING_DISTS;
+        std::vector<std::uint32_t> freqs(num_codes);
+
+        for (auto &freq : freqs) {
+            // Skewed, for codes longer than the lookup index
+            freq = (rng() % 3 == 0) ? 0 : (1 + (rng() % (1 << (rng() % 16))));
+        }
+
+        if (round < 4) {
+            // Single code
+            std::fill(freqs.begin(), freqs.end(), 0);
+            freqs[rng() % num_codes] = 1;
+        }
+
+        const auto lengths = huffman_lengths(freqs);
+
+        std::vector<std::uint32_t> length_words(lengths.begin(), lengths.end());
+        std::vector<std::uint32_t> tree(num_codes);
+
+        REQUIRE(flate::huffman::valid(length_words.data(), static_cast<int>(num_codes)));
+        flate::huffman::decoding(lengths.data(), static_cast<std::uint32_t>(num_codes), tree.data());
+
+        flate::huffman::lookup_table table;
+        REQUIRE(flate::huffman::lookup(length_words.data(), static_cast<std::uint32_t>(num_codes), table, true));
+
+        std::vector<std::uint8_t> random_bits(256);
+
+        for (auto &b : random_bits) {
+            b = static_cast<std::uint8_t>(rng());
+        }
+
+        flate::bit_input tree_input(random_bits.data(), static_cast<int>(random_bits.size() * 8));
+        flate::bit_input table_input(random_bits.data(), static_cast<int>(random_bits.size() * 8));
+
+        for (int i = 0; i < 64; i++) {
+            const std::uint32_t tree_symbol = tree_input.huffman(tree.data());
+            const int table_symbol = flate::huffman::decode(table_input, table);
+
+            REQUIRE(table_symbol == static_cast<int>(tree_symbol));
+
+            // Both consumed the same bits
+            REQUIRE(tree_input.read(16) == table_input.read(16));
+        }
+    }
+}
+
+TEST_CASE("inflate_round_trip", "flate") {
+    std::mt19937 rng(7);
+
+    for (const std::size_t size : { 0x10, 0x1000, 0x1001, 0x12345 }) {
+        std::vector<std::uint8_t> source = make_image_like_data(size, static_cast<std::uint32_t>(size));
+
+        // Long runs, with short distance matches
+        std::fill(source.begin() + size / 2, source.begin() + size / 2 + std::min<std::size_t>(size / 4, 700), 0xAA);
+
+        const auto compressed = nokia_deflate(source);
+
+        REQUIRE(reference_inflate(compressed, size) == source);
+        REQUIRE(fast_inflate(compressed, size) == source);
+
+        // Reading in odd sized pieces, with skips in between
+        flate::bit_input input(compressed.data(), static_cast<int>(compressed.size() * 8));
+        flate::inflater inflate_machine(input);
+
+        inflate_machine.init();
+
+        std::size_t pos = 0;
+
+        while (pos < size) {
+            const std::size_t piece = std::min<std::size_t>(1 + rng() % 5000, size - pos);
+
+            if (rng() % 4 == 0) {
+                REQUIRE(inflate_machine.skip(static_cast<int>(piece)) == static_cast<int>(piece));
+            } else {
+                std::vector<std::uint8_t> dest(piece);
+
+                REQUIRE(inflate_machine.read(dest.data(), piece) == static_cast<int>(piece));
+                REQUIRE(std::equal(dest.begin(), dest.end(), source.begin() + pos));
+            }
+
+            pos += piece;
+        }
+
+        // End of stream
+        std::uint8_t extra = 0;
+        REQUIRE(inflate_machine.read(&extra, 1) == 0);
+    }
+}
+
+TEST_CASE("inflate_truncated_stream", "flate") {
+    const auto source = make_image_like_data(0x8000, 3);
+    const auto compressed = nokia_deflate(source);
+
+    // Stream ends in the middle, the rest of the buffer is not part of it
+    flate::bit_input input(compressed.data(), static_cast<int>(compressed.size() / 2 * 8));
+    flate::inflater inflate_machine(input);
+    inflate_machine.init();
+
+    std::vector<std::uint8_t> result(source.size());
+    result.resize(inflate_machine.read(result.data(), result.size()));
+
+    REQUIRE(result.size() < source.size());
+    REQUIRE(std::equal(result.begin(), result.end(), source.begin()));
+}
+
+static void compare_inflaters(const char *name, const std::vector<std::uint8_t> &source, const std::vector<std::uint8_t> &compressed) {
+    constexpr int total_run = 8;
+    const double total_mb = static_cast<double>(source.size()) * total_run / (1024 * 1024);
+
+    std::vector<std::uint8_t> result;
+
+    const double reference_time = test::measure([&]() { result = reference_inflate(compressed, source.size()); }, total_run);
+    REQUIRE(result == source);
+
+    const double fast_time = test::measure([&]() { result = fast_inflate(compressed, source.size()); }, total_run);
+    REQUIRE(result == source);
+
+    // Miniz doesn't do the image format, give it the same data as standard deflate
+    mz_ulong miniz_size = mz_compressBound(static_cast<mz_ulong>(source.size()));
+    std::vector<std::uint8_t> miniz_compressed(miniz_size);
+
+    REQUIRE(mz_compress2(miniz_compressed.data(), &miniz_size, source.data(), static_cast<mz_ulong>(source.size()),
+                MZ_DEFAULT_COMPRESSION)
+        == MZ_OK);
+
+    const double miniz_time = test::measure([&]() {
+        mz_ulong dest_size = static_cast<mz_ulong>(source.size());
+        result.resize(source.size());
+
+        mz_uncompress(result.data(), &dest_size, miniz_compressed.data(), miniz_size);
+    },
+        total_run);
+
+    REQUIRE(result == source);
+
+    WARN(name << ": tree walk " << total_mb / reference_time << " MB/s, lookup tables " << total_mb / fast_time
+              << " MB/s, miniz " << total_mb / miniz_time << " MB/s");
+}
+
+TEST_CASE("inflate_throughput", "[.benchmark][flate]") {
+    const auto source = make_image_like_data(0x200000, 1234);
+    compare_inflaters("Synthetic code", source, nokia_deflate(source));
+}
+
+// Point EKA2L1_E32_CORPUS to a folder of E32 images to also measure with real code. Images are
+// decompressed, then deflated again, so uncompressed and bytepair images can be used too.
+TEST_CASE("inflate_throughput_corpus", "[.benchmark][flate]") {
+    const char *corpus_path = std::getenv("EKA2L1_E32_CORPUS");
+
+    if (!corpus_path) {
+        WARN("EKA2L1_E32_CORPUS is not set, skipping");
+        return;
+    }
+
+    common::dir_iterator corpus(corpus_path);
+    corpus.detail = true;
+
+    common::dir_entry entry;
+    std::vector<std::uint8_t> source;
+
+    while (corpus.next_entry(entry) == 0) {
+        if (entry.type != common::FILE_REGULAR) {
+            continue;
+        }
+
+        std::ifstream file(add_path(corpus_path, entry.name), std::ios::binary);
+        source.insert(source.end(), std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    if (source.empty()) {
+        WARN("No file in the corpus");
+        return;
+    }
+
+    compare_inflaters("Corpus", source, nokia_deflate(source));
+}
@@ -0,0 +1,533 @@
+#include <epoc/ipc.h>
+#include <epoc/kernel/hle_dispatch.h>
+#include <epoc/services/dispatch.h>
+#include <epoc/services/fs/op.h>
+#include <epoc/services/window/op.h>
+
+#include <bench.h>
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace eka2l1;
+
+TEST_CASE("ipc_msg_pool_reserve_and_release", "ipc") {
+    ipc_msg_slab slab;
+    ipc_msg_pool &root = slab.get_root_pool();
+
+    auto session_pool = std::make_unique<ipc_msg_pool>(&slab, &root);
+    REQUIRE(session_pool->reserve(2));
+
+    REQUIRE(session_pool->reserved_size() == 2);
+    REQUIRE(session_pool->free_size() == 2);
+    REQUIRE(root.free_size() == ipc_msg_slab::block_size - 2);
+
+    ipc_msg_ptr first = session_pool->allocate(nullptr);
+    ipc_msg_ptr second = session_pool->allocate(nullptr);
+
+    // The session can't take more than it reserved
+    REQUIRE(first);
+    REQUIRE(second);
+    REQUIRE(!session_pool->allocate(nullptr));
+
+    REQUIRE(slab.get(first->id) == first.get());
+
+    const std::uint32_t first_id = first->id;
+
+    {
+        ipc_msg_ptr copy = first;
+        first = nullptr;
+
+        REQUIRE(copy->ref_count == 1);
+        REQUIRE(session_pool->free_size() == 0);
+    }
+
+    // Last reference gone, back to the session
+    REQUIRE(session_pool->free_size() == 1);
+    REQUIRE(slab.get(first_id) == nullptr);
+
+    first = session_pool->allocate(nullptr);
+    REQUIRE(first->id == first_id);
+
+    first = nullptr;
+
+    // Still in use when the session goes away, so it goes to the root pool later
+    session_pool.reset();
+    REQUIRE(root.free_size() == ipc_msg_slab::block_size - 1);
+
+    second = nullptr;
+    REQUIRE(root.free_size() == ipc_msg_slab::block_size);
+}
+
+TEST_CASE("ipc_msg_slab_grow", "ipc") {
+    ipc_msg_slab slab;
+    std::vector<ipc_msg_ptr> msgs;
+
+    for (std::size_t i = 0; i < ipc_msg_slab::block_size * 3; i++) {
+        msgs.push_back(slab.get_root_pool().allocate(nullptr));
+        REQUIRE(msgs.back()->id == i);
+    }
+
+    ipc_msg *first = msgs[0].get();
+    REQUIRE(slab.size() == ipc_msg_slab::block_size * 3);
+
+    // Growing must not move the messages already handed out
+    msgs.push_back(slab.get_root_pool().allocate(nullptr));
+    REQUIRE(slab.get(0) == first);
+
+    msgs.clear();
+    REQUIRE(slab.get(0) == nullptr);
+}
+
+TEST_CASE("ipc_msg_queue_fifo_and_cancel", "ipc") {
+    ipc_msg_slab slab;
+    ipc_msg_queue queue;
+
+    std::uint32_t ids[4];
+
+    for (int i = 0; i < 4; i++) {
+        ipc_msg_ptr msg = slab.get_root_pool().allocate(nullptr);
+        msg->function = i;
+        ids[i] = msg->id;
+
+        REQUIRE(queue.push(msg));
+        REQUIRE(!queue.push(msg));
+    }
+
+    // Only the queue holds them now
+    REQUIRE(queue.size() == 4);
+    REQUIRE(slab.get(ids[2])->ref_count == 1);
+
+    // Cancel from the middle by ID
+    REQUIRE(queue.remove(slab.get(ids[1])));
+    REQUIRE(slab.get(ids[1]) == nullptr);
+    REQUIRE(queue.size() == 3);
+
+    // Oldest first
+    ipc_msg_ptr msg = queue.pop();
+    REQUIRE(msg->function == 0);
+    REQUIRE(!queue.contains(msg.get()));
+    REQUIRE(!queue.remove(msg.get()));
+
+    msg = queue.pop();
+    REQUIRE(msg->function == 2);
+
+    REQUIRE(queue.remove(slab.get(ids[3])));
+    REQUIRE(queue.empty());
+    REQUIRE(!queue.pop());
+
+    msg = nullptr;
+    REQUIRE(slab.get_root_pool().free_size() == ipc_msg_slab::block_size);
+}
+
+// Just enough of service::server to queue, accept and complete messages
+struct dummy_hle_server {
+    ipc_msg_queue delivered;
+    ipc_msg_ptr process_msg;
+
+    std::uint64_t total_function = 0;
+
+    void deliver(ipc_msg_ptr &msg) {
+        msg->msg_status = ipc_message_status::delivered;
+        delivered.push(msg);
+    }
+
+    void process(int &request_status) {
+        ipc_msg_ptr real_msg = delivered.pop();
+
+        process_msg->args = real_msg->args;
+        process_msg->function = real_msg->function;
+        process_msg->own_thr = real_msg->own_thr;
+        process_msg->msg_status = ipc_message_status::accepted;
+
+        total_function += process_msg->function;
+        request_status = 0;
+    }
+};
+
+TEST_CASE("ipc_msg_round_trip_benchmark", "[.benchmark][ipc]") {
+    constexpr int total_msg = 1000000;
+    constexpr int async_slots = 8;
+
+    ipc_msg_slab slab;
+    ipc_msg_pool session_pool(&slab, &slab.get_root_pool());
+
+    REQUIRE(session_pool.reserve(async_slots));
+
+    dummy_hle_server svr;
+    svr.process_msg = slab.get_root_pool().allocate(nullptr);
+
+    int request_status = 1;
+
+    const double elapsed = test::measure([&]() {
+        for (int i = 0; i < total_msg; i++) {
+            // Send, with a few requests outstanding like a client doing async calls
+            ipc_msg_ptr msg = session_pool.allocate(nullptr);
+            msg->function = i & 0xFF;
+            msg->args = ipc_arg(i, 0);
+
+            svr.deliver(msg);
+
+            if (svr.delivered.size() == async_slots) {
+                while (!svr.delivered.empty()) {
+                    svr.process(request_status);
+                }
+            }
+        }
+
+        while (!svr.delivered.empty()) {
+            svr.process(request_status);
+        }
+    });
+
+    WARN("Send to complete round trip: " << static_cast<std::uint64_t>(total_msg / elapsed) << " msgs/sec");
+
+    REQUIRE(request_status == 0);
+    REQUIRE(session_pool.free_size() == async_slots);
+    REQUIRE(slab.size() == ipc_msg_slab::block_size);
+}
+
+// Stand-ins for fs_server and window_server, with the opcodes they register
+struct bench_server {
+    std::uint64_t calls = 0;
+    std::uint64_t checksum = 0;
+
+    void connect(service::ipc_context ctx) {
+        calls++;
+    }
+};
+
+struct bench_fs_server : public bench_server {
+    void file_read(service::ipc_context ctx) {
+        calls++;
+        checksum += ctx.msg->args.args[0];
+    }
+
+    void file_write(service::ipc_context ctx) {
+        calls++;
+        checksum += ctx.msg->args.args[1];
+    }
+
+    void entry(service::ipc_context ctx) {
+        calls++;
+        checksum += ctx.msg->function;
+    }
+};
+
+struct bench_window_server : public bench_server {
+    void init(service::ipc_context ctx) {
+        calls++;
+    }
+
+    void send_to_command_buffer(service::ipc_context ctx) {
+        calls++;
+        checksum += ctx.msg->args.args[0];
+    }
+};
+
+static const std::vector<int> bench_fs_opcodes = { EFsEntry, EFsFileOpen, EFsFileSize, EFsFileSeek, EFsFileRead,
+    EFsFileWrite, EFsFileSubClose, EFsDirReadPacked, EFsDrive, EFsSessionPath, EFsVolume, EFsNotifyChange };
+
+static const std::vector<int> bench_ws_opcodes = { EWservMessCommandBuffer, EWservMessSyncMsgBuf, EWservMessInit };
+
+template <typename F>
+static double bench_dispatch(F dispatch, const std::vector<int> &opcodes, const int total_call) {
+    ipc_msg_slab slab;
+    service::ipc_context ctx{ nullptr, slab.get_root_pool().allocate(nullptr) };
+
+    ctx.msg->args = ipc_arg(1, 2, 0);
+
+    return test::measure([&]() {
+        for (int i = 0; i < total_call; i++) {
+            ctx.msg->function = opcodes[i % opcodes.size()];
+            dispatch(ctx);
+        }
+    });
+}
+
+TEST_CASE("ipc_dispatch_table", "ipc") {
+    service::ipc_dispatch_table<bench_server> table;
+    bench_fs_server svr;
+
+    REQUIRE(table.add(-1, &service::ipc_handler_thunk<bench_server, &bench_server::connect>, "Server::Connect"));
+    REQUIRE(table.add(EFsFileRead, &service::ipc_handler_thunk<bench_server, &bench_fs_server::file_read>, "Fs::FileRead"));
+    REQUIRE(table.add(0x10000, &service::ipc_handler_thunk<bench_server, &bench_fs_server::file_write>, "Fs::Far"));
+
+    // First registration stays
+    REQUIRE(!table.add(EFsFileRead, &service::ipc_handler_thunk<bench_server, &bench_fs_server::entry>, "Fs::Entry"));
+
+    REQUIRE(table.get(-3) == nullptr);
+    REQUIRE(table.get(EFsFileWrite) == nullptr);
+    REQUIRE(table.get(0x10001) == nullptr);
+    REQUIRE(table.get_name(EFsFileRead) == "Fs::FileRead");
+    REQUIRE(table.get_name(EFsFileWrite).empty());
+
+    ipc_msg_slab slab;
+    service::ipc_context ctx{ nullptr, slab.get_root_pool().allocate(nullptr) };
+    ctx.msg->args = ipc_arg(5, 7, 0);
+
+    table.get(-1)(&svr, ctx);
+    table.get(EFsFileRead)(&svr, ctx);
+    table.get(0x10000)(&svr, ctx);
+
+    REQUIRE(svr.calls == 3);
+    REQUIRE(svr.checksum == 12);
+}
+
+TEST_CASE("ipc_dispatch_benchmark", "[.benchmark][ipc]") {
+    constexpr int total_call = 2000000;
+
+    bench_fs_server fs;
+    bench_window_server ws;
+
+    // How servers registered handlers before
+    using old_ipc_func = std::function<void(service::ipc_context)>;
+
+    std::unordered_map<int, std::pair<std::string, old_ipc_func>> old_fs;
+    std::unordered_map<int, std::pair<std::string, old_ipc_func>> old_ws;
+
+    service::ipc_dispatch_table<bench_server> new_fs;
+    service::ipc_dispatch_table<bench_server> new_ws;
+
+    for (const int op : bench_fs_opcodes) {
+        switch (op) {
+        case EFsFileRead:
+            old_fs.emplace(op, std::make_pair("Fs::FileRead", std::bind(&bench_fs_server::file_read, &fs, std::placeholders::_1)));
+            new_fs.add(op, &service::ipc_handler_thunk<bench_server, &bench_fs_server::file_read>, "Fs::FileRead");
+            break;
+
+        case EFsFileWrite:
+            old_fs.emplace(op, std::make_pair("Fs::FileWrite", std::bind(&bench_fs_server::file_write, &fs, std::placeholders::_1)));
+            new_fs.add(op, &service::ipc_handler_thunk<bench_server, &bench_fs_server::file_write>, "Fs::FileWrite");
+            break;
+
+        default:
+            old_fs.emplace(op, std::make_pair("Fs::Other", std::bind(&bench_fs_server::entry, &fs, std::placeholders::_1)));
+            new_fs.add(op, &service::ipc_handler_thunk<bench_server, &bench_fs_server::entry>, "Fs::Other");
+            break;
+        }
+    }
+
+    old_ws.emplace(EWservMessInit, std::make_pair("Ws::Init", std::bind(&bench_window_server::init, &ws, std::placeholders::_1)));
+    new_ws.add(EWservMessInit, &service::ipc_handler_thunk<bench_server, &bench_window_server::init>, "Ws::Init");
+
+    for (const int op : { EWservMessCommandBuffer, EWservMessSyncMsgBuf }) {
+        old_ws.emplace(op, std::make_pair("Ws::CommandBuffer", std::bind(&bench_window_server::send_to_command_buffer, &ws, std::placeholders::_1)));
+        new_ws.add(op, &service::ipc_handler_thunk<bench_server, &bench_window_server::send_to_command_buffer>, "Ws::CommandBuffer");
+    }
+
+    auto old_dispatch = [](auto &funcs) {
+        return [&funcs](service::ipc_context &ctx) {
+            auto ite = funcs.find(ctx.msg->function);
+
+            if (ite != funcs.end()) {
+                ite->second.second(ctx);
+            }
+        };
+    };
+
+    auto new_dispatch = [](auto &table, bench_server *svr) {
+        return [&table, svr](service::ipc_context &ctx) {
+            if (auto handler = table.get(ctx.msg->function)) {
+                handler(svr, ctx);
+            }
+        };
+    };
+
+    const double old_fs_time = bench_dispatch(old_dispatch(old_fs), bench_fs_opcodes, total_call);
+    const double new_fs_time = bench_dispatch(new_dispatch(new_fs, &fs), bench_fs_opcodes, total_call);
+    const double old_ws_time = bench_dispatch(old_dispatch(old_ws), bench_ws_opcodes, total_call);
+    const double new_ws_time = bench_dispatch(new_dispatch(new_ws, &ws), bench_ws_opcodes, total_call);
+
+    WARN("fs_server opcodes: map " << static_cast<std::uint64_t>(total_call / old_fs_time) << " calls/sec, table "
+                                   << static_cast<std::uint64_t>(total_call / new_fs_time) << " calls/sec");
+    WARN("window_server opcodes: map " << static_cast<std::uint64_t>(total_call / old_ws_time) << " calls/sec, table "
+                                       << static_cast<std::uint64_t>(total_call / new_ws_time) << " calls/sec");
+
+    REQUIRE(fs.calls == total_call * 2);
+    REQUIRE(ws.calls == total_call * 2);
+}
+
+// What the HLE dispatch queue needs from a server, recording what it dispatched
+struct dispatch_test_server {
+    bool dispatch_pending = false;
+
+    int id;
+    int pending = 0;
+    std::vector<int> *order;
+
+    std::function<void()> on_dispatch;
+
+    explicit dispatch_test_server(const int id, std::vector<int> *order)
+        : id(id)
+        , order(order) {
+    }
+
+    void process_accepted_msg() {
+        pending--;
+        order->push_back(id);
+
+        if (on_dispatch) {
+            on_dispatch();
+        }
+    }
+
+    bool has_pending_msgs() const {
+        return pending > 0;
+    }
+};
+
+using test_dispatch_queue = kernel::basic_hle_dispatch_queue<dispatch_test_server>;
+
+static std::vector<std::shared_ptr<dispatch_test_server>> make_dispatch_servers(const int count, std::vector<int> *order) {
+    std::vector<std::shared_ptr<dispatch_test_server>> servers;
+
+    for (int i = 0; i < count; i++) {
+        servers.push_back(std::make_shared<dispatch_test_server>(i, order));
+    }
+
+    return servers;
+}
+
+TEST_CASE("hle_dispatch_fifo_across_servers", "ipc") {
+    std::vector<int> order;
+    auto servers = make_dispatch_servers(3, &order);
+    test_dispatch_queue queue;
+
+    for (const int i : { 2, 0, 1 }) {
+        servers[i]->pending = 1;
+        queue.queue(servers[i]);
+    }
+
+    // Already queued, keeps its place
+    queue.queue(servers[2]);
+    REQUIRE(queue.size() == 3);
+
+    queue.dispatch(0);
+
+    REQUIRE(order == std::vector<int>{ 2, 0, 1 });
+    REQUIRE(queue.empty());
+
+    for (const auto &svr : servers) {
+        REQUIRE(!svr->dispatch_pending);
+    }
+}
+
+TEST_CASE("hle_dispatch_requeue_backlog", "ipc") {
+    std::vector<int> order;
+    auto servers = make_dispatch_servers(3, &order);
+    test_dispatch_queue queue;
+
+    servers[0]->pending = 3;
+    servers[1]->pending = 1;
+    servers[2]->pending = 2;
+
+    for (const auto &svr : servers) {
+        queue.queue(svr);
+    }
+
+    queue.dispatch(0);
+
+    // One message at a time, servers with more go to the back
+    REQUIRE(order == std::vector<int>{ 0, 1, 2, 0, 2, 0 });
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("hle_dispatch_budget", "ipc") {
+    std::vector<int> order;
+    auto servers = make_dispatch_servers(2, &order);
+    test_dispatch_queue queue;
+
+    servers[0]->pending = 3;
+    servers[1]->pending = 2;
+
+    queue.queue(servers[0]);
+    queue.queue(servers[1]);
+
+    queue.dispatch(3);
+
+    REQUIRE(order == std::vector<int>{ 0, 1, 0 });
+    REQUIRE(queue.size() == 2);
+    REQUIRE(queue.get_stats().budget_exhausted == 1);
+
+    // The next slice carries on where the last one stopped
+    queue.dispatch(3);
+
+    REQUIRE(order == std::vector<int>{ 0, 1, 0, 1, 0 });
+    REQUIRE(queue.empty());
+
+    // Drained before the budget ran out
+    REQUIRE(queue.get_stats().budget_exhausted == 1);
+}
+
+TEST_CASE("hle_dispatch_stats", "ipc") {
+    std::vector<int> order;
+    auto servers = make_dispatch_servers(3, &order);
+    test_dispatch_queue queue;
+
+    servers[0]->pending = 2;
+    servers[1]->pending = 1;
+
+    queue.queue(servers[0]);
+    queue.queue(servers[0]);
+    queue.queue(servers[1]);
+
+    queue.dispatch(0);
+
+    // Requeues after a dispatch are not wakeups
+    REQUIRE(queue.get_stats().dispatched == 3);
+    REQUIRE(queue.get_stats().wakeups == 2);
+    REQUIRE(queue.get_stats().max_ready == 2);
+    REQUIRE(queue.get_stats().budget_exhausted == 0);
+
+    servers[2]->pending = 1;
+    queue.queue(servers[2]);
+    queue.dispatch(0);
+
+    REQUIRE(queue.get_stats().dispatched == 4);
+    REQUIRE(queue.get_stats().wakeups == 3);
+    REQUIRE(queue.get_stats().max_ready == 2);
+}
+
+TEST_CASE("hle_dispatch_server_removed_by_handler", "ipc") {
+    std::vector<int> order;
+    auto servers = make_dispatch_servers(2, &order);
+    test_dispatch_queue queue;
+
+    servers[0]->pending = 3;
+    servers[1]->pending = 1;
+
+    // Destroyed by its own handler: the kernel takes it off the list and drops its reference
+    std::weak_ptr<dispatch_test_server> first = servers[0];
+
+    servers[0]->on_dispatch = [&]() {
+        queue.remove(servers[0].get());
+        servers[0].reset();
+    };
+
+    queue.queue(servers[0]);
+    queue.queue(servers[1]);
+
+    queue.dispatch(0);
+
+    // Not queued again, even with messages left
+    REQUIRE(order == std::vector<int>{ 0, 1 });
+    REQUIRE(first.expired());
+    REQUIRE(queue.empty());
+
+    // Removed while waiting in the list
+    servers[1]->pending = 1;
+    queue.queue(servers[1]);
+    queue.remove(servers[1].get());
+
+    REQUIRE(queue.empty());
+    REQUIRE(!servers[1]->dispatch_pending);
+
+    queue.dispatch(0);
+    REQUIRE(order.size() == 2);
+}
@@ -0,0 +1,605 @@
+#include <common/chunkyseri.h>
+#include <epoc/kernel.h>
+#include <epoc/kernel/object_ix.h>
+#include <epoc/kernel/object_registry.h>
+#include <epoc/kernel/scheduler.h>
+#include <epoc/kernel/svc_table.h>
+#include <epoc/kernel/tls.h>
+#include <epoc/services/init.h>
+#include <epoc/services/property.h>
+
+#include <bench.h>
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace eka2l1;
+
+// A kernel object without a kernel, with its identity set by the test
+class test_obj : public kernel::kernel_obj {
+public:
+    explicit test_obj(const std::uint32_t id, const std::string &name, const kernel::object_type type)
+        : kernel::kernel_obj(nullptr) {
+        uid = id;
+        obj_name = name;
+        obj_type = type;
+    }
+};
+
+static kernel_obj_ptr make_test_obj(const std::uint32_t id, const std::string &name,
+    const kernel::object_type type = kernel::object_type::mutex) {
+    return std::make_shared<test_obj>(id, name, type);
+}
+
+TEST_CASE("registry_lookup", "kernel") {
+    kernel::object_registry registry;
+
+    registry.add(make_test_obj(1, "Alpha"));
+    registry.add(make_test_obj(2, "Alpha", kernel::object_type::sema));
+    registry.add(make_test_obj(3, "Beta"));
+    registry.add(make_test_obj(4, "Alpha"));
+
+    REQUIRE(registry.size() == 4);
+    REQUIRE(registry.get(3)->name() == "Beta");
+    REQUIRE(registry.get(3, kernel::object_type::sema) == nullptr);
+    REQUIRE(registry.get(5) == nullptr);
+
+    // The oldest object of the name and type comes first
+    REQUIRE(registry.get_by_name("Alpha", kernel::object_type::mutex)->unique_id() == 1);
+    REQUIRE(registry.get_by_name("Alpha", kernel::object_type::sema)->unique_id() == 2);
+    REQUIRE(registry.get_by_name("Alpha", kernel::object_type::mutex, 2)->unique_id() == 4);
+    REQUIRE(registry.get_by_name("Alpha", kernel::object_type::mutex, 5) == nullptr);
+    REQUIRE(registry.get_by_name("Gamma", kernel::object_type::mutex) == nullptr);
+
+    kernel_obj_ptr first = registry.get(1);
+    REQUIRE(registry.remove(first.get()));
+    REQUIRE(!registry.remove(first.get()));
+
+    REQUIRE(registry.get(1) == nullptr);
+    REQUIRE(registry.get_by_name("Alpha", kernel::object_type::mutex)->unique_id() == 4);
+
+    registry.rename(registry.get(4).get(), "Delta");
+
+    REQUIRE(registry.get_by_name("Alpha", kernel::object_type::mutex) == nullptr);
+    REQUIRE(registry.get_by_name("Delta", kernel::object_type::mutex)->unique_id() == 4);
+}
+
+// Enough of a system for the property macros
+struct prop_test_system {
+    kernel_system *kern;
+
+    kernel_system *get_kernel_system() {
+        return kern;
+    }
+};
+
+TEST_CASE("registry_props_from_init_macros", "kernel") {
+    kernel_system kern;
+    prop_test_system sys{ &kern };
+    prop_test_system *sysp = &sys;
+
+    const std::uint32_t bin = 0x04030201;
+
+    DEFINE_INT_PROP_D(sysp, 0x101f75b6, 0x1020e306, 42);
+    DEFINE_INT_PROP(sysp, 0x101f75b6, 0x1020e307, 43);
+    DEFINE_BIN_PROP(sysp, 0x101f75b7, 0x10208904, sizeof(bin), bin);
+
+    // Each property is indexed under its own category and key, not the ones it had before being defined
+    REQUIRE(kern.get_prop(0x101f75b6, 0x1020e306)->get_int() == 42);
+    REQUIRE(kern.get_prop(0x101f75b6, 0x1020e307)->get_int() == 43);
+    REQUIRE(kern.get_prop(0x101f75b7, 0x10208904) == prop);
+    REQUIRE(prop->get_bin().size() == sizeof(bin));
+    REQUIRE(kern.get_prop(0, 0) == nullptr);
+}
+
+TEST_CASE("registry_benchmark", "[.benchmark][kernel]") {
+    constexpr std::uint32_t total_obj = 10000;
+    constexpr std::uint32_t total_lookup = 100000;
+
+    kernel::object_registry registry;
+    std::vector<kernel_obj_ptr> list;
+
+    for (std::uint32_t i = 1; i <= total_obj; i++) {
+        kernel_obj_ptr obj = make_test_obj(i, "Object" + std::to_string(i));
+
+        registry.add(obj);
+        list.push_back(obj);
+    }
+
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<std::uint32_t> pick(1, total_obj);
+
+    std::vector<std::string> names;
+
+    for (std::uint32_t i = 0; i < total_lookup; i++) {
+        names.push_back("Object" + std::to_string(pick(rng)));
+    }
+
+    // What the kernel used to do
+    std::size_t linear_found = 0;
+
+    const double linear_elapsed = test::measure([&]() {
+        for (std::uint32_t i = 0; i < total_lookup / 100; i++) {
+            auto res = std::find_if(list.begin(), list.end(), [&](const kernel_obj_ptr &obj) {
+                return obj->name() == names[i];
+            });
+
+            linear_found += (res != list.end());
+        }
+    }) * 100;
+
+    std::size_t found = 0;
+
+    const double elapsed = test::measure([&]() {
+        for (std::uint32_t i = 0; i < total_lookup; i++) {
+            found += (registry.get_by_name(names[i], kernel::object_type::mutex) != nullptr);
+            found += (registry.get(pick(rng)) != nullptr);
+        }
+    });
+
+    WARN("Name lookups over " << total_obj << " objects: linear " << linear_elapsed / total_lookup * 1e9
+                              << " ns, registry " << elapsed / (total_lookup * 2) * 1e9 << " ns");
+
+    REQUIRE(linear_found == total_lookup / 100);
+    REQUIRE(found == total_lookup * 2);
+
+    const double remove_elapsed = test::measure([&]() {
+        for (const kernel_obj_ptr &obj : list) {
+            registry.remove(obj.get());
+        }
+    });
+    WARN("Removed " << total_obj << " objects in " << remove_elapsed * 1000 << " ms");
+
+    REQUIRE(registry.size() == 0);
+}
+
+TEST_CASE("object_ix_grow_and_reuse", "kernel") {
+    // Threads are never destroyed on close, so no kernel is needed
+    kernel::object_ix ix;
+    kernel_obj_ptr obj = make_test_obj(1, "Thread", kernel::object_type::thread);
+
+    std::vector<std::uint32_t> handles;
+
+    // Well past the old fixed table of 256
+    for (int i = 0; i < 1000; i++) {
+        handles.push_back(ix.add_object(obj));
+        REQUIRE(handles.back() != INVALID_HANDLE);
+    }
+
+    REQUIRE(obj->get_access_count() == 1000);
+
+    for (const std::uint32_t handle : handles) {
+        REQUIRE(ix.get_object(handle) == obj);
+        REQUIRE(kernel::inspect_handle(handle).handle_array_kernel);
+    }
+
+    const std::uint32_t closed = handles[500];
+    REQUIRE(ix.close(closed) == 0);
+    REQUIRE(ix.close(closed) == -1);
+
+    // The slot is reused, with a new instance. The old handle must not reach the new object
+    kernel_obj_ptr other = make_test_obj(2, "OtherThread", kernel::object_type::thread);
+    const std::uint32_t reused = ix.add_object(other);
+
+    REQUIRE(kernel::inspect_handle(reused).object_ix_index == kernel::inspect_handle(closed).object_ix_index);
+    REQUIRE(reused != closed);
+    REQUIRE(ix.get_object(closed) == nullptr);
+    REQUIRE(ix.get_object(reused) == other);
+}
+
+TEST_CASE("object_ix_do_state", "kernel") {
+    kernel::object_ix ix;
+    kernel_obj_ptr obj = make_test_obj(1, "Thread", kernel::object_type::thread);
+
+    const std::uint32_t first = ix.add_object(obj);
+    const std::uint32_t second = ix.add_object(obj);
+    ix.close(first);
+
+    std::vector<std::uint8_t> buf;
+
+    {
+        common::chunkyseri seri(nullptr, 0, common::SERI_MODE_MESAURE);
+        ix.do_state(seri);
+        buf.resize(seri.size());
+    }
+
+    {
+        common::chunkyseri seri(buf.data(), buf.size(), common::SERI_MODE_WRITE);
+        ix.do_state(seri);
+    }
+
+    kernel::object_ix loaded;
+
+    {
+        common::chunkyseri seri(buf.data(), buf.size(), common::SERI_MODE_READ);
+        loaded.do_state(seri);
+    }
+
+    // Without a kernel the objects can't be resolved, but the slots must match
+    REQUIRE(loaded.close(first) == -1);
+
+    const std::uint32_t third = loaded.add_object(obj);
+    REQUIRE(kernel::inspect_handle(third).object_ix_index == kernel::inspect_handle(first).object_ix_index);
+    REQUIRE(third != first);
+    REQUIRE(third != second);
+}
+
+TEST_CASE("object_ix_benchmark", "[.benchmark][kernel]") {
+    constexpr int total_handle = 30000;
+
+    kernel::object_ix ix;
+    kernel_obj_ptr obj = make_test_obj(1, "Thread", kernel::object_type::thread);
+
+    std::vector<std::uint32_t> handles(total_handle);
+
+    const double elapsed = test::measure([&]() {
+        for (int i = 0; i < total_handle; i++) {
+            handles[i] = ix.add_object(obj);
+        }
+
+        for (int i = 0; i < total_handle; i++) {
+            ix.get_object(handles[i]);
+        }
+
+        for (int i = 0; i < total_handle; i++) {
+            ix.close(handles[i]);
+        }
+    }, 10);
+    WARN("Opened, looked up and closed " << total_handle * 10 << " handles in " << elapsed * 1000 << " ms");
+
+    REQUIRE(obj->get_access_count() == 0);
+}
+
+TEST_CASE("tls_table_against_map", "kernel") {
+    kernel::tls_table table;
+    std::unordered_map<int, std::uint32_t> reference;
+
+    std::mt19937 rng(42);
+
+    // Few handles, so slots are removed and added back often, with long probe runs
+    std::uniform_int_distribution<int> handle_dist(0, 300);
+    std::uniform_int_distribution<int> op_dist(0, 3);
+
+    for (std::uint32_t i = 1; i < 20000; i++) {
+        // DLL handles are code addresses
+        const int handle = 0x70000000 + handle_dist(rng) * 0x1000;
+
+        switch (op_dist(rng)) {
+        case 0:
+        case 1: {
+            kernel::tls_slot *slot = table.get_or_add(handle, handle);
+            REQUIRE(slot);
+            REQUIRE(slot->handle == handle);
+
+            slot->pointer = ptr<void>(i);
+            reference[handle] = i;
+            break;
+        }
+
+        case 2:
+            REQUIRE(table.remove(handle) == (reference.erase(handle) != 0));
+            break;
+
+        default: {
+            kernel::tls_slot *slot = table.find(handle);
+            auto ref_ite = reference.find(handle);
+
+            REQUIRE((slot != nullptr) == (ref_ite != reference.end()));
+
+            if (slot) {
+                REQUIRE(slot->pointer.ptr_address() == ref_ite->second);
+            }
+
+            break;
+        }
+        }
+
+        REQUIRE(table.size() == reference.size());
+    }
+
+    // No cap on the slot count
+    REQUIRE(reference.size() > 50);
+
+    for (const auto &[handle, value] : reference) {
+        REQUIRE(table.find(handle)->pointer.ptr_address() == value);
+    }
+}
+
+// What the ready queue needs from a thread
+struct test_thread {
+    std::shared_ptr<test_thread> ready_next;
+    test_thread *ready_prev = nullptr;
+    int ready_priority = -1;
+
+    int priority;
+
+    explicit test_thread(const int priority)
+        : priority(priority) {
+    }
+
+    int current_real_priority() const {
+        return priority;
+    }
+};
+
+using test_ready_queue = kernel::basic_ready_queue<test_thread>;
+
+static std::shared_ptr<test_thread> make_test_thread(const int priority) {
+    return std::make_shared<test_thread>(priority);
+}
+
+TEST_CASE("ready_queue_highest_priority_first", "kernel") {
+    test_ready_queue queue;
+
+    auto low = make_test_thread(10);
+    auto high = make_test_thread(30);
+    auto mid = make_test_thread(20);
+    auto absolute = make_test_thread(500);
+
+    REQUIRE(queue.highest_priority() == -1);
+    REQUIRE(queue.pop_highest() == nullptr);
+
+    queue.push_back(low);
+    queue.push_back(high);
+    queue.push_back(mid);
+
+    REQUIRE(queue.size() == 3);
+    REQUIRE(queue.highest_priority() == 30);
+
+    REQUIRE(queue.pop_highest() == high);
+    REQUIRE(queue.pop_highest() == mid);
+
+    // Out of range priorities are clamped to the last level
+    queue.push_back(absolute);
+    REQUIRE(queue.highest_priority() == test_ready_queue::total_priority - 1);
+    REQUIRE(queue.pop_highest() == absolute);
+
+    REQUIRE(queue.pop_highest() == low);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("ready_queue_fifo_within_priority", "kernel") {
+    test_ready_queue queue;
+
+    auto first = make_test_thread(20);
+    auto second = make_test_thread(20);
+    auto third = make_test_thread(20);
+    auto preempted = make_test_thread(20);
+
+    queue.push_back(first);
+    queue.push_back(second);
+    queue.push_back(third);
+
+    // A preempted thread keeps its place at the front
+    queue.push_front(preempted);
+
+    REQUIRE(queue.pop_highest() == preempted);
+    REQUIRE(queue.pop_highest() == first);
+    REQUIRE(queue.pop_highest() == second);
+    REQUIRE(queue.pop_highest() == third);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("ready_queue_round_robin_on_time_slice", "kernel") {
+    test_ready_queue queue;
+    std::vector<std::shared_ptr<test_thread>> threads;
+
+    for (int i = 0; i < 3; i++) {
+        threads.push_back(make_test_thread(20));
+        queue.push_back(threads.back());
+    }
+
+    // What the scheduler does: the running thread goes to the back once its time slice expires
+    for (int round = 0; round < 7; round++) {
+        std::shared_ptr<test_thread> running = queue.pop_highest();
+        REQUIRE(running == threads[round % threads.size()]);
+        REQUIRE(!test_ready_queue::is_queued(running.get()));
+
+        queue.push_back(running);
+    }
+
+    // A lower priority thread never gets a turn
+    auto low = make_test_thread(10);
+    queue.push_back(low);
+
+    for (int round = 7; round < 10; round++) {
+        std::shared_ptr<test_thread> running = queue.pop_highest();
+        REQUIRE(running == threads[round % threads.size()]);
+
+        queue.push_back(running);
+    }
+
+    // Priority changes move the thread to the back of its new level
+    threads[1]->priority = 10;
+    queue.requeue(threads[1].get());
+
+    REQUIRE(queue.highest_priority() == 20);
+    REQUIRE(queue.pop_highest() == threads[2]);
+    REQUIRE(queue.pop_highest() == threads[0]);
+    REQUIRE(queue.pop_highest() == low);
+    REQUIRE(queue.pop_highest() == threads[1]);
+    REQUIRE(queue.empty());
+}
+
+TEST_CASE("ready_queue_remove_non_head", "kernel") {
+    test_ready_queue queue;
+
+    auto head = make_test_thread(20);
+    auto middle = make_test_thread(20);
+    auto tail = make_test_thread(20);
+
+    queue.push_back(head);
+    queue.push_back(middle);
+    queue.push_back(tail);
+
+    REQUIRE(queue.remove(middle.get()) == middle);
+    REQUIRE(!test_ready_queue::is_queued(middle.get()));
+    REQUIRE(middle->ready_next == nullptr);
+    REQUIRE(queue.size() == 2);
+
+    // Not queued anymore
+    REQUIRE(queue.remove(middle.get()) == nullptr);
+
+    // The tail is unlinked, and a thread added after goes behind the new tail
+    REQUIRE(queue.remove(tail.get()) == tail);
+    queue.push_back(middle);
+
+    REQUIRE(queue.pop_highest() == head);
+    REQUIRE(queue.pop_highest() == middle);
+    REQUIRE(queue.empty());
+
+    // The queue only held references while the threads were queued
+    REQUIRE(head.use_count() == 1);
+    REQUIRE(middle.use_count() == 1);
+    REQUIRE(tail.use_count() == 1);
+}
+
+TEST_CASE("ready_queue_empty_level_leaves_bitmap", "kernel") {
+    test_ready_queue queue;
+
+    auto high = make_test_thread(40);
+    auto high_second = make_test_thread(40);
+    auto low = make_test_thread(5);
+
+    queue.push_back(high);
+    queue.push_back(high_second);
+    queue.push_back(low);
+
+    REQUIRE(queue.remove(high.get()) == high);
+    REQUIRE(queue.highest_priority() == 40);
+
+    // Level 40 is empty now, the next pick must come from below
+    REQUIRE(queue.remove(high_second.get()) == high_second);
+    REQUIRE(queue.highest_priority() == 5);
+    REQUIRE(queue.pop_highest() == low);
+
+    REQUIRE(queue.highest_priority() == -1);
+    REQUIRE(queue.pop_highest() == nullptr);
+
+    queue.push_back(high);
+    REQUIRE(queue.highest_priority() == 40);
+    REQUIRE(queue.pop_highest() == high);
+}
+
+// Thunks record which one was called, through the system pointer they are given
+static std::vector<int> *svc_calls(eka2l1::system *sys) {
+    return reinterpret_cast<std::vector<int> *>(sys);
+}
+
+static void test_svc_a(eka2l1::system *sys) {
+    svc_calls(sys)->push_back(0);
+}
+
+static void test_svc_b(eka2l1::system *sys) {
+    svc_calls(sys)->push_back(1);
+}
+
+static void test_svc_c(eka2l1::system *sys) {
+    svc_calls(sys)->push_back(2);
+}
+
+TEST_CASE("svc_table_slow_and_fast_exec", "kernel") {
+    hle::svc_table svcs;
+    std::vector<int> calls;
+    eka2l1::system *sys = reinterpret_cast<eka2l1::system *>(&calls);
+
+    // Same low bits, one in each range
+    REQUIRE(svcs.add(0x12, { &test_svc_a, "SlowA" }));
+    REQUIRE(svcs.add(0x00800012, { &test_svc_b, "FastB" }));
+    REQUIRE(svcs.add(0x008000FF, { &test_svc_c, "FastC" }));
+
+    std::vector<std::uint32_t> hooked;
+    auto hook = [&](const std::uint32_t svcnum) { hooked.push_back(svcnum); };
+
+    REQUIRE(svcs.call(0x00800012, sys, hook));
+    REQUIRE(svcs.call(0x12, sys, hook));
+    REQUIRE(svcs.call(0x008000FF, sys, hook));
+
+    REQUIRE(calls == std::vector<int>{ 1, 0, 2 });
+    REQUIRE(hooked == std::vector<std::uint32_t>{ 0x00800012, 0x12, 0x008000FF });
+
+    REQUIRE(*svcs.get_name(0x12) == "SlowA");
+    REQUIRE(*svcs.get_name(0x00800012) == "FastB");
+
+    // Registering again replaces the thunk
+    REQUIRE(svcs.add(0x12, { &test_svc_c, "SlowC" }));
+    REQUIRE(svcs.call(0x12, sys, hook));
+
+    REQUIRE(calls.back() == 2);
+    REQUIRE(*svcs.get_name(0x12) == "SlowC");
+}
+
+TEST_CASE("svc_table_unregistered_falls_back", "kernel") {
+    hle::svc_table svcs;
+    std::vector<int> calls;
+    eka2l1::system *sys = reinterpret_cast<eka2l1::system *>(&calls);
+
+    REQUIRE(svcs.add(0x12, { &test_svc_a, "SlowA" }));
+
+    // Out of both tables
+    REQUIRE(!svcs.add(0x100, { &test_svc_b, "TooBig" }));
+    REQUIRE(!svcs.add(0x00800100, { &test_svc_b, "TooBigFast" }));
+
+    bool hooked = false;
+    auto hook = [&](const std::uint32_t) { hooked = true; };
+
+    // Registered in the other range only
+    REQUIRE(!svcs.call(0x00800012, sys, hook));
+    REQUIRE(!svcs.call(0x13, sys, hook));
+    REQUIRE(!svcs.call(0x100, sys, hook));
+    REQUIRE(!svcs.call(0x00FF0001, sys, hook));
+    REQUIRE(!svcs.call(0xFFFFFFFF, sys, hook));
+
+    REQUIRE(calls.empty());
+    REQUIRE(!hooked);
+
+    REQUIRE(svcs.get_name(0x00800012) == nullptr);
+    REQUIRE(svcs.get_name(0x100) == nullptr);
+    REQUIRE(svcs.get_call_count(0xFFFFFFFF) == 0);
+
+    svcs.clear();
+
+    REQUIRE(!svcs.call(0x12, sys, hook));
+    REQUIRE(svcs.get_name(0x12) == nullptr);
+}
+
+TEST_CASE("svc_table_count_calls", "kernel") {
+    hle::svc_table svcs;
+    std::vector<int> calls;
+    eka2l1::system *sys = reinterpret_cast<eka2l1::system *>(&calls);
+
+    svcs.add(0x12, { &test_svc_a, "SlowA" });
+    svcs.add(0x00800012, { &test_svc_b, "FastB" });
+
+    auto no_hook = [](const std::uint32_t) {};
+
+    // Not counted by default
+    svcs.call(0x12, sys, no_hook);
+    REQUIRE(svcs.get_call_count(0x12) == 0);
+
+    svcs.set_count_calls(true);
+
+    svcs.call(0x12, sys, no_hook);
+    svcs.call(0x12, sys, no_hook);
+    svcs.call(0x00800012, sys, no_hook);
+    svcs.call(0x13, sys, no_hook);
+
+    REQUIRE(svcs.get_call_count(0x12) == 2);
+    REQUIRE(svcs.get_call_count(0x00800012) == 1);
+    REQUIRE(svcs.get_call_count(0x13) == 0);
+
+    svcs.set_count_calls(false);
+    svcs.call(0x00800012, sys, no_hook);
+
+    REQUIRE(svcs.get_call_count(0x00800012) == 1);
+    REQUIRE(calls.size() == 5);
+
+    svcs.clear();
+    REQUIRE(svcs.get_call_count(0x12) == 0);
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <catch2/catch.hpp>
+
+#include <common/fileutils.h>
+#include <common/path.h>
+
+#include <epoc/loader/codeseg_cache.h>
+
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+using namespace eka2l1;
+
+static void fill_codeseg_cache_entry(loader::codeseg_cache_entry &entry, std::vector<std::uint8_t> &code,
+    std::vector<std::uint8_t> &data) {
+    code.resize(0x1234);
+    data.resize(0x57);
+
+    std::iota(code.begin(), code.end(), static_cast<std::uint8_t>(0x10));
+    std::iota(data.begin(), data.end(), static_cast<std::uint8_t>(0x80));
+
+    std::memset(&entry.header, 0, sizeof(entry.header));
+    std::memset(&entry.header_extended, 0, sizeof(entry.header_extended));
+
+    entry.epoc_ver = epocver::epoc94;
+    entry.header.uid3 = 0x10003A5C;
+    entry.header.code_size = static_cast<std::uint32_t>(code.size());
+    entry.export_dir = { 0x1000, 0x1040, 0x10C0 };
+    entry.dll_names = { "euser{000a0000}.dll", "efsrv{000a0000}.dll" };
+    entry.code_addr = 0x70000000;
+    entry.data_addr = 0x00400000;
+    entry.dependency_hashes = { 0x1122334455667788ULL, 0x8877665544332211ULL };
+    entry.code = code.data();
+    entry.code_size = static_cast<std::uint32_t>(code.size());
+    entry.data = data.data();
+    entry.data_size = static_cast<std::uint32_t>(data.size());
+}
+
+TEST_CASE("codeseg_cache_store_and_find", "codeseg_cache") {
+    const std::string folder = "codeseg_cache_test/";
+    const std::string path = "Z:\\Sys\\Bin\\Test.dll";
+
+    std::vector<std::uint8_t> code;
+    std::vector<std::uint8_t> data;
+
+    {
+        loader::codeseg_cache cache(folder);
+        loader::codeseg_cache_entry entry;
+
+        fill_codeseg_cache_entry(entry, code, data);
+        REQUIRE(cache.store(path, 500, 1234, 0xDEADBEEFULL, entry));
+    }
+
+    // The index is written when the cache goes away, look it up from a new one
+    loader::codeseg_cache cache(folder);
+
+    // The path is not case sensitive
+    loader::codeseg_cache_entry_ptr entry = cache.find("z:\\sys\\bin\\test.dll", 500, 1234, epocver::epoc94);
+
+    REQUIRE(entry);
+    REQUIRE(entry->header.uid3 == 0x10003A5C);
+    REQUIRE(entry->export_dir == std::vector<std::uint32_t>{ 0x1000, 0x1040, 0x10C0 });
+    REQUIRE(entry->dll_names.size() == 2);
+    REQUIRE(entry->dll_names[1] == "efsrv{000a0000}.dll");
+    REQUIRE(entry->code_addr == 0x70000000);
+    REQUIRE(entry->data_addr == 0x00400000);
+    REQUIRE(entry->dependency_hashes.size() == 2);
+    REQUIRE(entry->dependency_hashes[0] == 0x1122334455667788ULL);
+
+    // Code is copied straight from the mapping, so it has to be aligned
+    REQUIRE(reinterpret_cast<std::uintptr_t>(entry->code) % 16 == 0);
+    REQUIRE(entry->code_size == code.size());
+    REQUIRE(std::memcmp(entry->code, code.data(), code.size()) == 0);
+    REQUIRE(entry->data_size == data.size());
+    REQUIRE(std::memcmp(entry->data, data.data(), data.size()) == 0);
+
+    const loader::e32img img = loader::make_e32img_from_cache(entry);
+
+    REQUIRE(img.cache_entry == entry);
+    REQUIRE(img.ed.syms == entry->export_dir);
+    REQUIRE(img.import_section.imports.size() == 2);
+    REQUIRE(img.import_section.imports[0].dll_name == "euser{000a0000}.dll");
+
+    // A changed image, or another EPOC version, has no entry
+    REQUIRE_FALSE(cache.find(path, 501, 1234, epocver::epoc94));
+    REQUIRE_FALSE(cache.find(path, 500, 1235, epocver::epoc94));
+    REQUIRE_FALSE(cache.find(path, 500, 1234, epocver::epoc93));
+    REQUIRE_FALSE(cache.find("Z:\\Sys\\Bin\\Other.dll", 500, 1234, epocver::epoc94));
+
+    entry.reset();
+
+    common::remove(eka2l1::add_path(folder, "00000000deadbeef_" + std::to_string(static_cast<int>(epocver::epoc94)) + ".cseg"));
+    common::remove(eka2l1::add_path(folder, "index.txt"));
+    common::remove(folder);
+}
@@ -22,3 +22,123 @@
 #include <epoc/kernel/libmanager.h>
 
 #include <epoc/vfs.h>
+
+#include <catch2/catch.hpp>
+#include <common/bytepair.h>
+#include <common/fileutils.h>
+#include <common/path.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using namespace eka2l1;
+
+// Point EKA2L1_E32_CORPUS to a folder of E32 images (for example, sys/bin of a device dump) to run
+TEST_CASE("load_e32img_corpus", "e32img") {
+    const char *corpus_path = std::getenv("EKA2L1_E32_CORPUS");
+
+    if (!corpus_path) {
+        WARN("EKA2L1_E32_CORPUS is not set, skipping");
+        return;
+    }
+
+    common::dir_iterator corpus(corpus_path);
+    corpus.detail = true;
+
+    common::dir_entry entry;
+
+    std::size_t total_image = 0;
+    std::size_t total_size = 0;
+    double elapsed = 0;
+
+    while (corpus.next_entry(entry) == 0) {
+        if (entry.type != common::FILE_REGULAR) {
+            continue;
+        }
+
+        symfile image_file = physical_file_proxy(add_path(corpus_path, entry.name), READ_MODE | BIN_MODE);
+
+        if (!image_file) {
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto image = loader::parse_e32img(image_file);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (image) {
+            total_image++;
+            total_size += image->uncompressed_size;
+        }
+    }
+
+    WARN("Loaded " << total_image << " images (" << total_size / 1024 << " KB uncompressed) in " << elapsed * 1000
+                   << " ms");
+}
+
+// Parsing for demand paging must give the same image, with the code pages decoded on their own
+TEST_CASE("demand_paged_e32img_corpus", "e32img") {
+    const char *corpus_path = std::getenv("EKA2L1_E32_CORPUS");
+
+    if (!corpus_path) {
+        WARN("EKA2L1_E32_CORPUS is not set, skipping");
+        return;
+    }
+
+    common::dir_iterator corpus(corpus_path);
+    corpus.detail = true;
+
+    common::dir_entry entry;
+
+    std::size_t total_paged = 0;
+    std::size_t total_code_page = 0;
+    double eager_elapsed = 0;
+    double demand_elapsed = 0;
+
+    while (corpus.next_entry(entry) == 0) {
+        if (entry.type != common::FILE_REGULAR) {
+            continue;
+        }
+
+        const std::string path = add_path(corpus_path, entry.name);
+
+        auto start = std::chrono::steady_clock::now();
+        auto image = loader::parse_e32img(physical_file_proxy(path, READ_MODE | BIN_MODE));
+        eager_elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        auto paged_image = loader::parse_e32img(physical_file_proxy(path, READ_MODE | BIN_MODE), true, true);
+        demand_elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        REQUIRE(image.has_value() == paged_image.has_value());
+
+        if (!paged_image || !paged_image->code_pages) {
+            continue;
+        }
+
+        const std::uint32_t code_offset = image->header.code_offset;
+        const std::uint32_t code_size = image->header.code_size;
+
+        REQUIRE(paged_image->ed.syms == image->ed.syms);
+        REQUIRE(paged_image->iat.its == image->iat.its);
+        REQUIRE(std::equal(image->data.begin() + code_offset + code_size, image->data.end(),
+            paged_image->data.begin() + code_offset + code_size));
+
+        std::vector<char> page(common::BYTEPAIR_PAGE_SIZE);
+
+        for (std::uint32_t page_off = 0; page_off < code_size; page_off += common::BYTEPAIR_PAGE_SIZE) {
+            const std::uint32_t size = std::min<std::uint32_t>(code_size - page_off, common::BYTEPAIR_PAGE_SIZE);
+
+            REQUIRE(paged_image->code_pages->read_page(page.data(), page_off / common::BYTEPAIR_PAGE_SIZE, size) == size);
+            REQUIRE(std::equal(page.begin(), page.begin() + size, image->data.begin() + code_offset + page_off));
+
+            total_code_page++;
+        }
+
+        total_paged++;
+    }
+
+    WARN("Parsed " << total_paged << " bytepair images (" << total_code_page << " code pages) in " << demand_elapsed * 1000
+                   << " ms leaving the code compressed, " << eager_elapsed * 1000 << " ms decompressing everything");
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2019 EKA2L1 Team.
+ * 
+ * This file is part of EKA2L1 project 
+ * (see bentokun.github.com/EKA2L1).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <bench.h>
+#include <catch2/catch.hpp>
+
+#include <epoc/loader/rom.h>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace eka2l1;
+
+static constexpr address synthetic_rom_base = 0x80000000;
+
+struct synthetic_rom_entry {
+    std::u16string name;
+    std::uint32_t size;
+    address addr;
+    std::uint8_t attrib;
+};
+
+template <typename T>
+static void put_rom_data(std::vector<std::uint8_t> &rom, const std::size_t off, const T val) {
+    std::memcpy(rom.data() + off, &val, sizeof(T));
+}
+
+static std::u16string to_u16(const std::string &str) {
+    return std::u16string(str.begin(), str.end());
+}
+
+// Append a directory to the ROM, returns its address
+static address write_rom_dir(std::vector<std::uint8_t> &rom, const std::vector<synthetic_rom_entry> &entries) {
+    const std::size_t dir_off = rom.size();
+    rom.resize(dir_off + 4);
+
+    for (const auto &entry : entries) {
+        const std::size_t off = rom.size();
+        rom.resize(off + 10 + entry.name.size() * 2);
+
+        put_rom_data<std::uint32_t>(rom, off, entry.size);
+        put_rom_data<std::uint32_t>(rom, off + 4, entry.addr);
+        put_rom_data<std::uint8_t>(rom, off + 8, entry.attrib);
+        put_rom_data<std::uint8_t>(rom, off + 9, static_cast<std::uint8_t>(entry.name.size()));
+        std::memcpy(rom.data() + off + 10, entry.name.data(), entry.name.size() * 2);
+
+        rom.resize((rom.size() + 3) & ~3);
+    }
+
+    put_rom_data<std::int32_t>(rom, dir_off, static_cast<std::int32_t>(rom.size() - dir_off - 4));
+    return synthetic_rom_base + static_cast<address>(dir_off);
+}
+
+// Make a ROM with files at Top<i>\Sub<j>\File<k>.dll
+static std::vector<std::uint8_t> make_synthetic_rom(const int top_count, const int sub_count, const int file_count) {
+    std::vector<std::uint8_t> rom(sizeof(loader::rom_header), 0);
+    std::vector<synthetic_rom_entry> tops;
+
+    for (int i = 0; i < top_count; i++) {
+        std::vector<synthetic_rom_entry> subs;
+
+        for (int j = 0; j < sub_count; j++) {
+            std::vector<synthetic_rom_entry> files;
+
+            for (int k = 0; k < file_count; k++) {
+                files.push_back({ to_u16("File" + std::to_string(k) + ".dll"), static_cast<std::uint32_t>(k),
+                    synthetic_rom_base + static_cast<address>(i * 0x10000 + j * 0x100 + k), 0 });
+            }
+
+            subs.push_back({ to_u16("Sub" + std::to_string(j)), 0, write_rom_dir(rom, files), 0x10 });
+        }
+
+        tops.push_back({ to_u16("Top" + std::to_string(i)), 0, write_rom_dir(rom, subs), 0x10 });
+    }
+
+    const address root_dir_addr = write_rom_dir(rom, tops);
+    const std::size_t root_list_off = rom.size();
+
+    rom.resize(root_list_off + 12);
+    put_rom_data<std::int32_t>(rom, root_list_off, 1);
+    put_rom_data<std::uint32_t>(rom, root_list_off + 4, 0);
+    put_rom_data<std::uint32_t>(rom, root_list_off + 8, root_dir_addr);
+
+    put_rom_data<std::uint32_t>(rom, offsetof(loader::rom_header, rom_base), synthetic_rom_base);
+    put_rom_data<std::uint32_t>(rom, offsetof(loader::rom_header, rom_size), static_cast<std::uint32_t>(rom.size()));
+    put_rom_data<std::uint32_t>(rom, offsetof(loader::rom_header, rom_root_dir_list),
+        synthetic_rom_base + static_cast<address>(root_list_off));
+
+    return rom;
+}
+
+TEST_CASE("rom_find_entry", "rom") {
+    const std::vector<std::uint8_t> data = make_synthetic_rom(2, 3, 4);
+    std::optional<loader::rom> romf = loader::load_rom(data.data(), data.size());
+
+    REQUIRE(romf);
+    REQUIRE(romf->header.rom_base == synthetic_rom_base);
+    REQUIRE(romf->entries.size() == 2 * 3 * 4);
+
+    const loader::rom_entry *entry = loader::find_rom_entry(*romf, u"Z:\\Top1\\Sub2\\File3.dll");
+
+    REQUIRE(entry);
+    REQUIRE(entry->name == u"File3.dll");
+    REQUIRE(entry->size == 3);
+    REQUIRE(entry->address_lin == synthetic_rom_base + 0x10000 + 0x200 + 3);
+
+    // Case, drive and separators don't matter
+    REQUIRE(loader::find_rom_entry(*romf, u"z:\\top1\\SUB2\\file3.DLL") == entry);
+    REQUIRE(loader::find_rom_entry(*romf, u"\\Top1\\Sub2\\File3.dll") == entry);
+    REQUIRE(loader::find_rom_entry(*romf, u"Top1/Sub2//File3.dll") == entry);
+
+    REQUIRE_FALSE(loader::find_rom_entry(*romf, u"Z:\\Top1\\Sub2\\File4.dll"));
+    REQUIRE_FALSE(loader::find_rom_entry(*romf, u"Z:\\Top1\\Sub3\\File3.dll"));
+
+    // Only files are in the index
+    REQUIRE_FALSE(loader::find_rom_entry(*romf, u"Z:\\Top1\\Sub2"));
+    REQUIRE_FALSE(loader::find_rom_entry(*romf, u"Z:\\"));
+}
+
+TEST_CASE("rom_corrupted_dir", "rom") {
+    std::vector<std::uint8_t> data = make_synthetic_rom(1, 1, 1);
+
+    // Point the root directory, last in the root directory list, out of the ROM
+    put_rom_data<std::uint32_t>(data, data.size() - 4, synthetic_rom_base + static_cast<address>(data.size()));
+
+    REQUIRE_FALSE(loader::load_rom(data.data(), data.size()));
+    REQUIRE_FALSE(loader::load_rom(data.data(), sizeof(loader::rom_header) - 1));
+}
+
+TEST_CASE("rom_load_benchmark", "[.benchmark][rom]") {
+    const int top_count = 16;
+    const int sub_count = 32;
+    const int file_count = 64;
+
+    const std::vector<std::uint8_t> data = make_synthetic_rom(top_count, sub_count, file_count);
+
+    std::optional<loader::rom> romf;
+    const double load_elapsed = test::measure([&]() { romf = loader::load_rom(data.data(), data.size()); });
+
+    REQUIRE(romf);
+
+    std::size_t found = 0;
+    std::size_t lookups = 0;
+
+    const double find_elapsed = test::measure([&]() {
+        for (int i = 0; i < top_count; i++) {
+            for (int j = 0; j < sub_count; j++) {
+                for (int k = 0; k < file_count; k++) {
+                    std::u16string path = to_u16("Z:\\top" + std::to_string(i) + "\\SUB" + std::to_string(j) + "\\file"
+                        + std::to_string(k) + ".DLL");
+
+                    found += (loader::find_rom_entry(*romf, path) != nullptr);
+                    path += u'x';
+                    found += (loader::find_rom_entry(*romf, path) != nullptr);
+
+                    lookups += 2;
+                }
+            }
+        }
+    });
+
+    REQUIRE(found == static_cast<std::size_t>(top_count * sub_count * file_count));
+
+    WARN("Loaded ROM of " << romf->entries.size() << " files in " << load_elapsed * 1000 << " ms, "
+                          << lookups << " lookups in " << find_elapsed * 1000 << " ms");
+}
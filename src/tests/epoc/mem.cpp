@@ -0,0 +1,612 @@
+#include <arm/arm_interface.h>
+#include <common/memops.h>
+#include <epoc/kernel/intrinsics.h>
+#include <epoc/mem.h>
+#include <epoc/page_table.h>
+#include <epoc/ptr.h>
+
+#include <bench.h>
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace eka2l1;
+
+// A CPU which only counts how many times the memory map is touched
+class null_cpu : public arm::arm_interface {
+public:
+    std::size_t map_count = 0;
+    std::size_t unmap_count = 0;
+
+    void run() override {}
+    void stop() override {}
+    void step() override {}
+    uint32_t get_reg(size_t idx) override { return 0; }
+    uint32_t get_sp() override { return 0; }
+    uint32_t get_pc() override { return 0; }
+    uint32_t get_vfp(size_t idx) override { return 0; }
+    void set_reg(size_t idx, uint32_t val) override {}
+    void set_cpsr(uint32_t val) override {}
+    void set_pc(uint32_t val) override {}
+    void set_lr(uint32_t val) override {}
+    void set_sp(uint32_t val) override {}
+    void set_vfp(size_t idx, uint32_t val) override {}
+    uint32_t get_lr() override { return 0; }
+    void set_entry_point(address ep) override {}
+    address get_entry_point() override { return 0; }
+    uint32_t get_cpsr() override { return 0; }
+    void save_context(thread_context &ctx) override {}
+    void load_context(const thread_context &ctx) override {}
+    void set_stack_top(address addr) override {}
+    address get_stack_top() override { return 0; }
+    void prepare_rescheduling() override {}
+    bool is_thumb_mode() override { return false; }
+    void page_table_changed() override {}
+    void map_backing_mem(address vaddr, size_t size, uint8_t *ptr, prot protection) override { map_count++; }
+    void unmap_memory(address addr, size_t size) override { unmap_count++; }
+    void clear_instruction_cache() override {}
+    void imb_range(address addr, std::size_t size) override {}
+};
+
+struct mem_scope_guard {
+    arm::jitter cpu;
+    memory_system mem;
+
+    mem_scope_guard()
+        : cpu(std::make_unique<null_cpu>()) {
+        mem.init(cpu, ram_code_addr, shared_data, ram_code_addr - shared_data);
+    }
+
+    ~mem_scope_guard() {
+        mem.shutdown();
+    }
+
+    null_cpu *get_cpu() {
+        return reinterpret_cast<null_cpu *>(cpu.get());
+    }
+};
+
+TEST_CASE("sparse_leaf_on_demand", "page_table") {
+    page_table table(page_size);
+
+    REQUIRE(table.get_page_info(local_data / page_size) == nullptr);
+    REQUIRE(table.get_pointer(local_data / page_size) == nullptr);
+
+    page *info = table.get_page_info(local_data / page_size, true);
+
+    REQUIRE(info != nullptr);
+    REQUIRE(info->sts == page_status::free);
+    REQUIRE(table.leaf_count == 1);
+
+    // Same section, no new leaf
+    table.get_page_info(local_data / page_size + page_leaf_number_entries - 1, true);
+    REQUIRE(table.leaf_count == 1);
+
+    table.get_page_info(local_data / page_size + page_leaf_number_entries, true);
+    REQUIRE(table.leaf_count == 2);
+}
+
+TEST_CASE("shared_leaves_from_parent", "page_table") {
+    page_table global(page_size);
+    page_table process1(page_size);
+    page_table process2(page_size);
+
+    process1.attach(&global);
+    process2.attach(&global);
+
+    std::uint8_t backing[page_size] = { 0x45 };
+    const std::uint32_t shared_page = shared_data / page_size;
+
+    *global.get_page_info(shared_page, true) = { 1, page_status::committed, prot::read_write };
+    *global.get_page_pointer(shared_page, true) = backing;
+
+    REQUIRE(process1.get_pointer(shared_page) == backing);
+    REQUIRE(process2.get_pointer(shared_page) == backing);
+    REQUIRE(process1.read<std::uint8_t>(shared_data) == 0x45);
+
+    // Shared leaves are not counted to the process
+    REQUIRE(process1.leaf_count == 0);
+    REQUIRE(!process1.owned[shared_data / page_leaf_size]);
+
+    // Changes done in the global table are visible without any copy
+    process2.write<std::uint8_t>(shared_data + 1, 0x12);
+    REQUIRE(process1.read<std::uint8_t>(shared_data + 1) == 0x12);
+}
+
+TEST_CASE("memory_saved_per_process", "page_table") {
+    page_table table(page_size);
+
+    // A typical process: stack, heap and a few small chunks
+    table.get_page_info(local_data / page_size, true);
+    table.get_page_info(dll_static_data / page_size, true);
+    table.get_page_info((shared_data - page_size) / page_size, true);
+
+    const std::size_t usage = table.get_host_memory_usage();
+    const std::size_t flat_usage = page_table::get_flat_host_memory_usage();
+
+    INFO("Sparse table: " << usage / 1024 << " KB, flat table: " << flat_usage / 1024 << " KB");
+
+    REQUIRE(usage * 100 < flat_usage);
+}
+
+TEST_CASE("free_range_top_down", "page_table") {
+    page_table table(page_size);
+    std::uint32_t result = 0;
+
+    const std::uint32_t beg = local_data / page_size;
+    const std::uint32_t end = beg + page_leaf_number_entries * 2;
+
+    // Empty table, highest run wins
+    REQUIRE(table.find_free_range_top_down(beg, end, 3, result));
+    REQUIRE(result == end - 3);
+
+    // Hole of 5 pages crossing a bitmap word boundary, below a used top
+    table.mark_pages(beg + 70, end - beg - 70, true);
+    table.mark_pages(beg, 62, true);
+
+    REQUIRE(table.find_free_range_top_down(beg, end, 8, result));
+    REQUIRE(result == beg + 62);
+    REQUIRE(!table.find_free_range_top_down(beg, end, 9, result));
+
+    REQUIRE(!table.is_range_free(beg + 61, 2));
+    REQUIRE(table.is_range_free(beg + 62, 8));
+
+    // Free a whole leaf again
+    table.mark_pages(beg + page_leaf_number_entries, page_leaf_number_entries, false);
+    REQUIRE(table.find_free_range_top_down(beg, end, page_leaf_number_entries, result));
+    REQUIRE(result == beg + page_leaf_number_entries);
+}
+
+// Reference search: walk every page from the top, like a plain scan would do
+static std::uint32_t naive_find_top_down(page_table &table, const std::uint32_t beg, const std::uint32_t end,
+    const std::uint32_t count) {
+    std::uint32_t free_run = 0;
+
+    for (std::uint32_t i = end; i > beg; i--) {
+        const page *info = table.get_page_info(i - 1);
+
+        if (info && info->sts != page_status::free) {
+            free_run = 0;
+            continue;
+        }
+
+        if (++free_run == count) {
+            return (i - 1) * page_size;
+        }
+    }
+
+    return 0;
+}
+
+TEST_CASE("chunk_range_stress", "page_table") {
+    mem_scope_guard guard;
+    memory_system &mem = guard.mem;
+
+    address_space space(mem.get_global_page_table(), mem.get_page_size());
+    mem.set_current_address_space(space);
+
+    constexpr address region_beg = local_data;
+    constexpr address region_end = local_data + 0x4000000;
+
+    std::mt19937 rng(0x45);
+    std::vector<std::pair<address, std::uint32_t>> chunks;
+
+    constexpr int total_op = 5000;
+    std::size_t created = 0;
+
+    double naive_time = 0;
+    double bitmap_time = 0;
+
+    for (int i = 0; i < total_op; i++) {
+        // Destroy some from time to time to make holes
+        if (!chunks.empty() && (rng() % 3 == 0)) {
+            const std::size_t victim = rng() % chunks.size();
+            REQUIRE(mem.unchunk(chunks[victim].first, chunks[victim].second) == 0);
+
+            chunks.erase(chunks.begin() + victim);
+            continue;
+        }
+
+        const std::uint32_t size = ((rng() % 32) + 1) * page_size;
+
+        auto start = std::chrono::steady_clock::now();
+        const address expected = naive_find_top_down(*mem.get_current_page_table(), region_beg / page_size,
+            (region_end - page_size + 1) / page_size, size / page_size);
+
+        naive_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+
+        ptr<void> chunk = mem.chunk_range(region_beg, region_end, 0, page_size, size, prot::read_write);
+
+        bitmap_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        REQUIRE(chunk.ptr_address() == expected);
+
+        if (chunk.ptr_address() != 0) {
+            chunks.emplace_back(chunk.ptr_address(), size);
+            created++;
+        }
+    }
+
+    WARN("Created " << created << " chunks in " << bitmap_time * 1000 << " ms, page scan alone takes "
+                    << naive_time * 1000 << " ms");
+
+    for (const auto &[chunk_addr, chunk_size] : chunks) {
+        REQUIRE(mem.unchunk(chunk_addr, chunk_size) == 0);
+    }
+
+    REQUIRE(space.get_local_ranges().empty());
+}
+
+TEST_CASE("span_across_chunks", "memory_system") {
+    mem_scope_guard guard;
+    memory_system &mem = guard.mem;
+
+    address_space space(mem.get_global_page_table(), mem.get_page_size());
+    mem.set_current_address_space(space);
+
+    // Two chunks next to each other in guest memory, each with its own host mapping
+    ptr<void> low = mem.chunk(local_data, 0, 0x2000, 0x2000, prot::read_write);
+    ptr<void> high = mem.chunk(local_data + 0x2000, 0, 0x2000, 0x2000, prot::read_write);
+
+    REQUIRE(low.ptr_address() == local_data);
+    REQUIRE(high.ptr_address() == local_data + 0x2000);
+
+    host_span_iterator spans = mem.get_host_spans(local_data + 0x1000, 0x2000);
+    host_span span;
+
+    std::uint32_t total_size = 0;
+    int span_count = 0;
+
+    while (spans.next(span)) {
+        REQUIRE(span.addr == local_data + 0x1000 + total_size);
+        REQUIRE(span.host == mem.get_real_pointer(span.addr));
+
+        total_size += span.size;
+        span_count++;
+    }
+
+    // Host mappings may happen to be next to each other, then there is only one span
+    REQUIRE(spans.finished());
+    REQUIRE(total_size == 0x2000);
+    REQUIRE(span_count <= 2);
+
+    std::vector<std::uint8_t> source(0x100);
+
+    for (std::size_t i = 0; i < source.size(); i++) {
+        source[i] = static_cast<std::uint8_t>(i);
+    }
+
+    // Accessor crossing the chunk boundary
+    const address boundary = local_data + 0x2000;
+    REQUIRE(mem.write(boundary - 0x80, source.data(), static_cast<std::uint32_t>(source.size())));
+    REQUIRE(mem.read<std::uint32_t>(boundary - 2) == 0x81807F7E);
+
+    std::vector<std::uint8_t> dest(source.size());
+    REQUIRE(mem.read(boundary - 0x80, dest.data(), static_cast<std::uint32_t>(dest.size())));
+    REQUIRE(dest == source);
+
+    // Overlapping guest copy, backward and forward
+    REQUIRE(mem.copy(boundary - 0x40, boundary - 0x80, 0x100));
+    REQUIRE(mem.read<std::uint8_t>(boundary + 0xBF) == 0xFF);
+    REQUIRE(mem.read<std::uint8_t>(boundary - 0x40) == 0x00);
+
+    REQUIRE(mem.copy(boundary - 0x80, boundary - 0x40, 0x100));
+    REQUIRE(mem.read(boundary - 0x80, dest.data(), static_cast<std::uint32_t>(dest.size())));
+    REQUIRE(dest == source);
+
+    // Reserved memory in the middle stops the walk
+    mem.decommit(high, 0x1000);
+    REQUIRE(!mem.read(boundary - 0x80, dest.data(), static_cast<std::uint32_t>(dest.size())));
+
+    mem.unchunk(low, 0x2000);
+    mem.unchunk(high, 0x2000);
+}
+
+TEST_CASE("demand_paged_range", "memory_system") {
+    mem_scope_guard guard;
+    memory_system &mem = guard.mem;
+
+    address_space space(mem.get_global_page_table(), mem.get_page_size());
+    mem.set_current_address_space(space);
+
+    // Reserved only, like the code chunk of a demand paged codeseg
+    constexpr std::uint32_t range_size = 0x8000;
+    ptr<void> code = mem.chunk(ram_code_addr, 0, 0, range_size, prot::read_write_exec);
+    REQUIRE(code.ptr_address() == ram_code_addr);
+
+    std::vector<address> faults;
+
+    mem.add_page_fault_handler(ram_code_addr, range_size, [&](const address page_addr) {
+        faults.push_back(page_addr);
+
+        // The last page can't be loaded
+        if (page_addr == ram_code_addr + range_size - page_size) {
+            return false;
+        }
+
+        mem.commit(ptr<void>(page_addr), page_size);
+
+        std::uint32_t *words = reinterpret_cast<std::uint32_t *>(mem.get_real_pointer(page_addr));
+
+        for (std::uint32_t i = 0; i < page_size / 4; i++) {
+            words[i] = page_addr + i * 4;
+        }
+
+        return true;
+    });
+
+    // Single page access
+    REQUIRE(mem.read<std::uint32_t>(ram_code_addr + 0x1010) == ram_code_addr + 0x1010);
+    REQUIRE(faults.size() == 1);
+
+    // Already in, no more faults
+    REQUIRE(*reinterpret_cast<std::uint32_t *>(mem.get_real_pointer(ram_code_addr + 0x1020)) == ram_code_addr + 0x1020);
+    REQUIRE(faults.size() == 1);
+
+    // Across two pages, the first one is in already
+    std::uint32_t words[4] = {};
+    REQUIRE(mem.read(ram_code_addr + 0x1FF8, words, sizeof(words)));
+    REQUIRE(words[3] == ram_code_addr + 0x2004);
+    REQUIRE(faults.size() == 2);
+
+    // Spans and copies bring in whole ranges
+    host_span_iterator spans = mem.get_host_spans(ram_code_addr + 0x3000, 0x2000);
+    host_span span;
+
+    while (spans.next(span)) {
+    }
+
+    REQUIRE(spans.finished());
+    REQUIRE(faults.size() == 4);
+
+    REQUIRE(mem.copy(ram_code_addr + 0x5000, ram_code_addr + 0x3000, 0x10));
+    REQUIRE(mem.read<std::uint32_t>(ram_code_addr + 0x5004) == ram_code_addr + 0x3004);
+    REQUIRE(faults.size() == 5);
+
+    // Pages nobody touched stay reserved
+    REQUIRE(mem.get_global_page_table()->get_page_info(ram_code_addr / page_size)->sts == page_status::reserved);
+    REQUIRE(mem.get_global_page_table()->get_page_info((ram_code_addr + 0x6000) / page_size)->sts == page_status::reserved);
+
+    // Failed loads fail the access. Cross pages, so reserved memory is never dereferenced
+    std::uint32_t value = 0;
+    REQUIRE(!mem.read(ram_code_addr + range_size - page_size - 2, &value, sizeof(value)));
+    REQUIRE(faults.back() == ram_code_addr + range_size - page_size);
+
+    // Without the handler, reserved memory is invalid again
+    mem.remove_page_fault_handler(ram_code_addr);
+    const std::size_t fault_count = faults.size();
+
+    REQUIRE(!mem.read(ram_code_addr + page_size - 2, &value, sizeof(value)));
+    REQUIRE(faults.size() == fault_count);
+
+    mem.unchunk(code, range_size);
+}
+
+TEST_CASE("address_space_local_range_diff", "address_space") {
+    mem_scope_guard guard;
+    memory_system &mem = guard.mem;
+
+    address_space space1(mem.get_global_page_table(), mem.get_page_size());
+    address_space space2(mem.get_global_page_table(), mem.get_page_size());
+
+    mem.set_current_address_space(space1);
+    ptr<void> local1 = mem.chunk_range(local_data, shared_data, 0, 0x4000, 0x4000, prot::read_write);
+
+    mem.set_current_address_space(space2);
+    ptr<void> local2 = mem.chunk_range(local_data, shared_data, 0, 0x2000, 0x2000, prot::read_write);
+    ptr<void> global = mem.chunk_range(shared_data, ram_code_addr, 0, 0x1000, 0x1000, prot::read_write);
+
+    REQUIRE(local1.ptr_address() != 0);
+    REQUIRE(local2.ptr_address() != 0);
+    REQUIRE(global.ptr_address() != 0);
+
+    REQUIRE(space1.get_local_ranges().size() == 1);
+    REQUIRE(space2.get_local_ranges().size() == 1);
+
+    // Global chunk is visible in both address spaces without any copy
+    mem.write<std::uint32_t>(global.ptr_address(), 0xDEADBEEF);
+    mem.set_current_address_space(space1);
+    REQUIRE(mem.read<std::uint32_t>(global.ptr_address()) == 0xDEADBEEF);
+
+    // Only the local ranges are remapped
+    null_cpu *cpu = guard.get_cpu();
+    cpu->map_count = 0;
+    cpu->unmap_count = 0;
+
+    mem.set_current_address_space(space2);
+
+    REQUIRE(cpu->unmap_count == 1);
+    REQUIRE(cpu->map_count == 1);
+
+    mem.decommit(local2, 0x2000);
+    REQUIRE(space2.get_local_ranges().size() == 0);
+
+    // Decommit a page in the middle splits the range
+    mem.set_current_address_space(space1);
+    mem.decommit(local1 + 0x1000, 0x1000);
+    REQUIRE(space1.get_local_ranges().size() == 2);
+
+    mem.unchunk(local1, 0x4000);
+    REQUIRE(space1.get_local_ranges().size() == 0);
+
+    mem.unchunk(global, 0x1000);
+}
+
+TEST_CASE("address_space_switch_benchmark", "[.benchmark][address_space]") {
+    mem_scope_guard guard;
+    memory_system &mem = guard.mem;
+
+    std::vector<std::unique_ptr<address_space>> spaces;
+
+    // Roughly what a process has: stack, heap, name chunk and some global chunks
+    for (int i = 0; i < 4; i++) {
+        spaces.push_back(std::make_unique<address_space>(mem.get_global_page_table(), mem.get_page_size()));
+        mem.set_current_address_space(*spaces.back());
+
+        for (int j = 0; j < 4; j++) {
+            REQUIRE(mem.chunk_range(local_data, shared_data, 0, 0x2000, 0x10000, prot::read_write).ptr_address() != 0);
+        }
+    }
+
+    for (int i = 0; i < 16; i++) {
+        REQUIRE(mem.chunk_range(shared_data, ram_code_addr, 0, 0x1000, 0x1000, prot::read_write).ptr_address() != 0);
+    }
+
+    constexpr int total_switch = 100000;
+
+    const double elapsed = test::measure([&]() {
+        for (int i = 0; i < total_switch; i++) {
+            mem.set_current_address_space(*spaces[i % spaces.size()]);
+        }
+    });
+    WARN("Address space switches per second: " << static_cast<std::uint64_t>(total_switch / elapsed));
+
+    REQUIRE(mem.get_current_address_space() == spaces[(total_switch - 1) % spaces.size()].get());
+}
+
+// Transcribed from euser's generic C versions, which the intrinsics replace
+template <typename T>
+static std::int32_t guest_compare_reference(const T *lhs, std::int32_t lhs_length, const T *rhs, std::int32_t rhs_length) {
+    const T *end = lhs + std::min(lhs_length, rhs_length);
+
+    while (lhs < end) {
+        const std::int32_t diff = static_cast<std::int32_t>(*lhs++) - static_cast<std::int32_t>(*rhs++);
+
+        if (diff != 0) {
+            return diff;
+        }
+    }
+
+    return lhs_length - rhs_length;
+}
+
+template <typename T>
+static std::int32_t guest_string_length_reference(const T *str) {
+    const T *start = str;
+
+    while (*str) {
+        str++;
+    }
+
+    return static_cast<std::int32_t>(str - start);
+}
+
+TEST_CASE("host_memops_against_reference", "intrinsics") {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> unit_dist(1, 0xFFFF);
+
+    for (std::size_t count = 0; count < 80; count++) {
+        std::vector<std::uint16_t> lhs(count);
+
+        for (auto &unit : lhs) {
+            unit = static_cast<std::uint16_t>(unit_dist(rng));
+        }
+
+        for (std::size_t diff_pos = 0; diff_pos <= count; diff_pos++) {
+            std::vector<std::uint16_t> rhs = lhs;
+
+            if (diff_pos != count) {
+                rhs[diff_pos] ^= 0x0100;
+            }
+
+            REQUIRE(common::find_mismatch16(lhs.data(), rhs.data(), count) == diff_pos);
+            REQUIRE(common::find_mismatch8(reinterpret_cast<const std::uint8_t *>(lhs.data()),
+                        reinterpret_cast<const std::uint8_t *>(rhs.data()), count * 2)
+                == ((diff_pos == count) ? count * 2 : diff_pos * 2 + 1));
+
+            // Turn the differing unit into the terminator
+            rhs = lhs;
+            rhs.push_back(0);
+
+            if (diff_pos != count) {
+                rhs[diff_pos] = 0;
+            }
+
+            REQUIRE(common::find_null16(rhs.data(), rhs.size()) == diff_pos);
+        }
+    }
+}
+
+TEST_CASE("guest_intrinsics_across_chunks", "intrinsics") {
+    mem_scope_guard guard;
+    memory_system &mem = guard.mem;
+
+    address_space space(mem.get_global_page_table(), mem.get_page_size());
+    mem.set_current_address_space(space);
+
+    // Two chunks with their own host mapping, so the routines have to walk pages
+    ptr<void> low = mem.chunk(local_data, 0, 0x2000, 0x2000, prot::read_write);
+    ptr<void> high = mem.chunk(local_data + 0x2000, 0, 0x2000, 0x2000, prot::read_write);
+
+    const address boundary = local_data + 0x2000;
+    const address lhs = boundary - 0x105;
+    const address rhs = local_data + 0x3000 - 0x81;
+
+    std::mt19937 rng(5678);
+    std::uniform_int_distribution<int> byte_dist(1, 0xFF);
+
+    std::vector<std::uint8_t> data(0x200);
+
+    for (auto &b : data) {
+        b = static_cast<std::uint8_t>(byte_dist(rng));
+    }
+
+    REQUIRE(mem.write(lhs, data.data(), static_cast<std::uint32_t>(data.size())));
+
+    for (const std::uint32_t diff_pos : { 0U, 1U, 0x7FU, 0x80U, 0x104U, 0x105U, 0x106U, 0x1FFU, 0x200U }) {
+        std::vector<std::uint8_t> other = data;
+
+        if (diff_pos < other.size()) {
+            other[diff_pos] = static_cast<std::uint8_t>(other[diff_pos] + 0x80);
+        }
+
+        REQUIRE(mem.write(rhs, other.data(), static_cast<std::uint32_t>(other.size())));
+
+        for (const std::int32_t lhs_length : { 0, 0x100, 0x180, 0x200 }) {
+            for (const std::int32_t rhs_length : { 0x100, 0x200 }) {
+                REQUIRE(hle::compare_guest_memory8(&mem, lhs, lhs_length, rhs, rhs_length)
+                    == guest_compare_reference(data.data(), lhs_length, other.data(), rhs_length));
+
+                // Odd addresses put a UTF-16 unit on both sides of the chunk boundary
+                REQUIRE(hle::compare_guest_memory16(&mem, lhs, lhs_length / 2, rhs, rhs_length / 2)
+                    == guest_compare_reference(reinterpret_cast<const std::uint16_t *>(data.data()), lhs_length / 2,
+                        reinterpret_cast<const std::uint16_t *>(other.data()), rhs_length / 2));
+            }
+        }
+    }
+
+    // Strings ending before, at and after the boundary
+    for (const std::uint32_t null_pos : { 0x10U, 0x104U, 0x105U, 0x1F0U }) {
+        std::vector<std::uint8_t> str = data;
+        str[null_pos] = 0;
+        str[null_pos + 1] = 0;
+
+        REQUIRE(mem.write(lhs, str.data(), static_cast<std::uint32_t>(str.size())));
+        REQUIRE(hle::guest_string_length8(&mem, lhs) == guest_string_length_reference(str.data()));
+
+        std::vector<std::uint16_t> str16(str.size() / 2 + 1);
+        std::memcpy(str16.data(), str.data() + (null_pos & 1), str.size() - 1);
+        str16.back() = 0;
+
+        REQUIRE(hle::guest_string_length16(&mem, lhs + (null_pos & 1)) == guest_string_length_reference(str16.data()));
+    }
+
+    REQUIRE(mem.write<std::uint8_t>(boundary - 0x41, 0));
+    REQUIRE(hle::fill_guest_memory(&mem, boundary - 0x40, 0xAB, 0x80));
+    REQUIRE(mem.read<std::uint8_t>(boundary - 0x41) == 0);
+    REQUIRE(mem.read<std::uint32_t>(boundary - 2) == 0xABABABAB);
+    REQUIRE(mem.read<std::uint8_t>(boundary + 0x3F) == 0xAB);
+
+    // Uncommitted memory in the middle
+    mem.decommit(high, 0x1000);
+    REQUIRE(!hle::fill_guest_memory(&mem, boundary - 0x40, 0, 0x80));
+
+    mem.unchunk(low, 0x2000);
+    mem.unchunk(high, 0x2000);
+}
@@ -1,7 +1,14 @@
+#include <common/chunkyseri.h>
 #include <epoc/timing.h>
 
+#include <bench.h>
 #include <catch2/catch.hpp>
+
+#include <chrono>
 #include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
 
 using namespace eka2l1;
 
@@ -52,4 +59,236 @@ TEST_CASE("basic_scheduling", "timing_test") {
 
     advance_and_check(timing, 5000);
     advance_and_check(timing, 20000);
-}
\ No newline at end of file
+}
+
+TEST_CASE("event_order_and_cancel", "timing_test") {
+    eka2l1::timing_system timing;
+    scope_guard guard(timing);
+
+    std::vector<std::uint64_t> fired;
+    auto record_evt = timing.register_event("testRecordEvent", [&](std::uint64_t userdata, int cycles_late) {
+        fired.push_back(userdata);
+    });
+
+    timing.schedule_event(3000, record_evt, 3);
+    timing.schedule_event(1000, record_evt, 1);
+
+    // Same time, fire in the order they are scheduled
+    timing.schedule_event(2000, record_evt, 20);
+    timing.schedule_event(2000, record_evt, 21);
+
+    const event_handle cancelled = timing.schedule_event(1500, record_evt, 15);
+    const event_handle swapped = timing.schedule_event(2500, record_evt, 25);
+
+    timing.unschedule_event(cancelled);
+    timing.swap_userdata_event(swapped, 250);
+    timing.swap_userdata_event(record_evt, 3, 30);
+
+    // Handle is dead, nothing should happen
+    timing.unschedule_event(cancelled);
+
+    timing.add_ticks(timing.get_downcount());
+    timing.advance();
+
+    REQUIRE(fired == std::vector<std::uint64_t>{ 1, 20, 21, 250, 30 });
+}
+
+TEST_CASE("event_do_state_roundtrip", "timing_test") {
+    eka2l1::timing_system timing;
+    scope_guard guard(timing);
+
+    auto nopevt = timing.register_event("testNonEvent", std::bind(timed_nop_callback, std::placeholders::_1));
+
+    timing.schedule_event(5000, nopevt, 5);
+    timing.schedule_event(100, nopevt, 1);
+    timing.schedule_event(100, nopevt, 2);
+
+    std::vector<std::uint8_t> buf;
+
+    {
+        common::chunkyseri seri(nullptr, 0, common::SERI_MODE_MESAURE);
+        timing.do_state(seri);
+        buf.resize(seri.size());
+    }
+
+    {
+        common::chunkyseri seri(buf.data(), buf.size(), common::SERI_MODE_WRITE);
+        timing.do_state(seri);
+    }
+
+    timing.clear_pending_events();
+
+    {
+        common::chunkyseri seri(buf.data(), buf.size(), common::SERI_MODE_READ);
+        timing.do_state(seri);
+    }
+
+    std::vector<std::uint64_t> fired;
+    timing.restore_register_event(nopevt, "testNonEvent", [&](std::uint64_t userdata, int cycles_late) {
+        fired.push_back(userdata);
+    });
+
+    for (int i = 0; i < 2; i++) {
+        timing.add_ticks(timing.get_downcount());
+        timing.advance();
+    }
+
+    REQUIRE(fired == std::vector<std::uint64_t>{ 1, 2, 5 });
+}
+
+TEST_CASE("event_queue_benchmark", "[.benchmark][timing_test]") {
+    eka2l1::timing_system timing;
+    scope_guard guard(timing);
+
+    std::size_t fired_count = 0;
+    auto countevt = timing.register_event("testCountEvent", [&](std::uint64_t userdata, int cycles_late) {
+        fired_count++;
+    });
+
+    constexpr int total_event = 10000;
+
+    std::mt19937 rng(0x1234);
+    std::vector<event_handle> handles;
+
+    const double elapsed = test::measure([&]() {
+        for (int i = 0; i < total_event; i++) {
+            handles.push_back(timing.schedule_event(1 + rng() % 10000000, countevt, i));
+        }
+
+        // Timers are often cancelled before they fire (RTimer::Cancel, thread wakeup...)
+        for (int i = 0; i < total_event; i += 2) {
+            timing.unschedule_event(countevt, i);
+        }
+
+        for (int i = 1; i < total_event; i += 4) {
+            timing.unschedule_event(handles[i]);
+        }
+
+        while (fired_count < total_event / 4) {
+            timing.add_ticks(timing.get_downcount());
+            timing.advance();
+        }
+    });
+    WARN("Scheduled, cancelled and fired " << total_event << " events in " << elapsed * 1000 << " ms");
+
+    REQUIRE(fired_count == total_event / 4);
+}
+
+TEST_CASE("event_posted_from_threads", "timing_test") {
+    eka2l1::timing_system timing;
+    scope_guard guard(timing);
+
+    constexpr int total_thread = 4;
+    constexpr int event_per_thread = 10000;
+
+    std::vector<int> fired_per_thread(total_thread);
+    auto hostevt = timing.register_event("testHostEvent", [&](std::uint64_t userdata, int cycles_late) {
+        fired_per_thread[userdata]++;
+    });
+
+    std::vector<std::thread> producers;
+
+    for (int i = 0; i < total_thread; i++) {
+        producers.emplace_back([&timing, hostevt, i]() {
+            for (int j = 0; j < event_per_thread; j++) {
+                timing.schedule_event_thread_safe(j % 100, hostevt, i);
+            }
+        });
+    }
+
+    // Keep the emulation thread running while host threads post
+    int total_fired = 0;
+
+    while (total_fired < total_thread * event_per_thread) {
+        timing.add_ticks(timing.get_downcount());
+        timing.advance();
+
+        total_fired = 0;
+
+        for (const int fired : fired_per_thread) {
+            total_fired += fired;
+        }
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    for (const int fired : fired_per_thread) {
+        REQUIRE(fired == event_per_thread);
+    }
+}
+
+static double idle_until_fired(eka2l1::timing_system &timing, bool &fired) {
+    const auto start = std::chrono::steady_clock::now();
+
+    while (!fired) {
+        timing.idle();
+        timing.advance();
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST_CASE("pacing_modes", "timing_test") {
+    eka2l1::timing_system timing;
+    scope_guard guard(timing);
+
+    bool fired = false;
+    auto evt = timing.register_event("testPacedEvent", [&](std::uint64_t userdata, int cycles_late) {
+        fired = true;
+    });
+
+    SECTION("turbo") {
+        // Ten seconds of guest time, skipped in one go
+        timing.schedule_event(timing.ms_to_cycles(10000), evt);
+        const double elapsed = idle_until_fired(timing, fired);
+
+        REQUIRE(elapsed < 1.0);
+        REQUIRE(timing.get_host_idle_us() == 0);
+        REQUIRE(timing.get_idle_ticks() == static_cast<std::uint64_t>(timing.ms_to_cycles(10000)));
+        REQUIRE(timing.get_idle_ratio() == Approx(1.0));
+    }
+
+    SECTION("real_time") {
+        timing.set_pacing_mode(pacing_mode::real_time);
+        timing.schedule_event(timing.ms_to_cycles(50), evt);
+
+        const double elapsed = idle_until_fired(timing, fired);
+
+        REQUIRE(elapsed >= 0.045);
+        REQUIRE(timing.get_host_idle_us() > 0);
+        REQUIRE(timing.get_idle_ratio() == Approx(1.0));
+    }
+
+    SECTION("scaled") {
+        timing.set_pacing_mode(pacing_mode::scaled, 4.0);
+        timing.schedule_event(timing.ms_to_cycles(200), evt);
+
+        const double elapsed = idle_until_fired(timing, fired);
+
+        REQUIRE(elapsed >= 0.045);
+        REQUIRE(elapsed < 0.2);
+    }
+
+    SECTION("woken_by_posted_event") {
+        timing.set_pacing_mode(pacing_mode::real_time);
+        timing.schedule_event(timing.ms_to_cycles(10000), evt);
+
+        bool posted_fired = false;
+        auto postevt = timing.register_event("testWakeEvent", [&](std::uint64_t userdata, int cycles_late) {
+            posted_fired = true;
+        });
+
+        std::thread poster([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            timing.schedule_event_thread_safe(0, postevt);
+        });
+
+        const double elapsed = idle_until_fired(timing, posted_fired);
+        poster.join();
+
+        REQUIRE(!fired);
+        REQUIRE(elapsed < 1.0);
+    }
+}